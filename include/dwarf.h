@@ -269,16 +269,64 @@ typedef struct dwarf_stackable_reg_state
   }
 dwarf_stackable_reg_state_t;
 
+/* Register states are kept in the rs cache in a compact,
+   variable-length form: only the columns whose rule differs from
+   DWARF_WHERE_SAME/0 are recorded, each as a ULEB128 key
+   (column * 8 + where) followed by an SLEB128 value.  Expression
+   addresses are delta-encoded, starting from the start of the row.  A typical frame
+   needs well under 16 bytes; states that do not fit in a bucket are
+   simply not cached.  */
+#ifndef DWARF_RS_PACKED_SIZE
+# define DWARF_RS_PACKED_SIZE   48
+#endif
+
+typedef struct dwarf_packed_reg_state
+  {
+    uint8_t len;                          /* number of bytes used in data[] */
+    uint8_t data[DWARF_RS_PACKED_SIZE - 1];
+  }
+dwarf_packed_reg_state_t;
+
+/* Each cached register state covers the half-open range of lookup
+   addresses [start_ip, end_ip) of one CFI row, so that all call sites
+   in a row share one entry.  Entries are found through a hash on the
+   IP which created them and, failing that, through a treap ordered by
+   start_ip.  */
 typedef struct dwarf_reg_cache_entry
   {
-    unw_word_t ip;                        /* ip this rs is for */
-    unsigned short coll_chain;  /* used for hash collisions */
-    unsigned short hint;              /* hint for next rs to try (or -1) */
-    unsigned short valid : 1;         /* optional machine-dependent signal info */
-    unsigned short signal_frame : 1;  /* optional machine-dependent signal info */
+    unw_word_t ip;                        /* ip this rs was created for */
+    unw_word_t start_ip;                  /* first lookup address of the row */
+    unw_word_t end_ip;                    /* end of the row (exclusive) */
+    uint32_t coll_chain;                  /* used for hash collisions */
+    uint32_t left, right;                 /* treap children */
+    uint32_t hint : 29;               /* hint for next rs to try (index + 1, or 0) */
+    uint32_t valid : 1;               /* entry holds a cached register state */
+    uint32_t signal_frame : 1;        /* optional machine-dependent signal info */
+    uint32_t have_pi : 1;             /* proc_info[] entry is filled in */
   }
 dwarf_reg_cache_entry_t;
 
+/* What unw_get_proc_info() reports for a row, kept next to its
+   cached register state so that a warm frame needs no FDE lookup.
+   The unwind_info and extra members of unw_proc_info_t are not
+   kept; the former is never valid after the lookup anyway.  */
+typedef struct dwarf_cached_proc_info
+  {
+    unw_word_t start_ip;
+    unw_word_t end_ip;
+#if defined(NEED_LAST_IP)
+    unw_word_t last_ip;
+#endif
+    unw_word_t lsda;
+    unw_word_t handler;
+    unw_word_t gp;
+    unw_word_t args_size;               /* DW_CFA_GNU_args_size of the row */
+    uint32_t flags;
+    int32_t format;
+    int32_t unwind_info_size;
+  }
+dwarf_cached_proc_info_t;
+
 typedef struct dwarf_cie_info
   {
     unw_word_t cie_instr_start; /* start addr. of CIE "initial_instructions" */
@@ -299,6 +347,163 @@ typedef struct dwarf_cie_info
   }
 dwarf_cie_info_t;
 
+/* Decoded CIEs, shared by all FDEs which refer to them.  The cache is
+   direct-mapped on the CIE address and invalidated along with the rs
+   cache by bumping the address space's cache_generation.  Each entry
+   is guarded by a sequence count (odd while being written), so that
+   lookups never block and are safe from signal handlers; a lookup
+   which races with a writer just parses the CIE again.  */
+#define DWARF_LOG_CIE_CACHE_SIZE        5
+#define DWARF_CIE_CACHE_SIZE            (1 << DWARF_LOG_CIE_CACHE_SIZE)
+
+struct dwarf_cie_cache_entry
+  {
+    _Atomic uint32_t seq;               /* sequence count */
+    uint32_t generation;                /* cache_generation when filled */
+    unw_word_t cie_addr;                /* address of the CIE, 0 if empty */
+    unw_word_t gp;                      /* pi->gp it was decoded with */
+    int is_debug_frame;
+    struct dwarf_cie_info dci;          /* CIE part of the info only */
+  };
+
+struct dwarf_cie_cache
+  {
+    struct dwarf_cie_cache_entry entries[DWARF_CIE_CACHE_SIZE];
+  };
+
+/* A decoded call-frame instruction.  Advances of any kind become
+   DW_CFA_advance_loc, and the other opcodes are folded into the
+   generic form which has the same effect (e.g. DW_CFA_offset_extended_sf
+   into DW_CFA_offset), with the data-alignment factor already applied
+   to OPERAND.  For an expression, OPERAND is the offset of the
+   expression from the start of the program.  LOC is the offset from
+   the start of the procedure at which the instruction takes effect;
+   for an advance, the new location.  */
+typedef struct dwarf_cfi_op
+  {
+    uint32_t loc;
+    int32_t operand;
+    uint16_t reg;
+    uint8_t op;
+  }
+dwarf_cfi_op_t;
+
+/* Decoded CFI programs, keyed by the address of their first
+   instruction, so that a lookup at another IP of a procedure does not
+   decode its FDE (and CIE) instructions again.  Like the CIE cache it
+   is direct-mapped, invalidated by cache_generation and guarded by a
+   sequence count per entry.  Programs longer than
+   DWARF_CFI_CACHE_MAX_OPS instructions (about 1 in 20 FDEs of a large
+   C++ library) or with operands which don't fit are interpreted as
+   before.  */
+#define DWARF_LOG_CFI_CACHE_SIZE        7
+#define DWARF_CFI_CACHE_SIZE            (1 << DWARF_LOG_CFI_CACHE_SIZE)
+#define DWARF_CFI_CACHE_MAX_OPS         48
+#define DWARF_CFI_CACHE_TOO_LONG        0xffff  /* nops of a long program */
+
+struct dwarf_cfi_cache_entry
+  {
+    _Atomic uint32_t seq;               /* sequence count */
+    uint32_t generation;                /* cache_generation when filled */
+    unw_word_t instr_start;             /* address of the program, 0 if empty */
+    unw_word_t instr_end;
+    unw_word_t base_ip;                 /* location LOC is relative to */
+    uint16_t nops;
+    uint8_t sorted;                     /* are the LOCs non-decreasing? */
+    uint8_t debug_frame;                /* program is in .debug_frame */
+    dwarf_cfi_op_t ops[DWARF_CFI_CACHE_MAX_OPS];
+  };
+
+struct dwarf_cfi_cache
+  {
+    struct dwarf_cfi_cache_entry entries[DWARF_CFI_CACHE_SIZE];
+  };
+
+/* The closed form of a location expression, so that the common shapes
+   need not go through the general expression interpreter each time a
+   register state is applied.  */
+typedef enum
+  {
+    DWARF_EXPR_INTERPRET,       /* none, run dwarf_eval_expr() */
+    DWARF_EXPR_REGISTER,        /* register REG itself */
+    DWARF_EXPR_STACK_OFFSET,    /* initial stack value + OFFSET */
+    DWARF_EXPR_REG_OFFSET,      /* register REG + OFFSET */
+    DWARF_EXPR_PLT              /* REG + OFFSET + ((((REG2 + OFFSET2) & MASK)
+                                   >= CMP) << SHIFT), as in PLT stubs */
+  }
+dwarf_expr_kind_t;
+
+typedef struct dwarf_expr_form
+  {
+    unw_word_t offset;
+    unw_word_t offset2;
+    unw_word_t mask;
+    unw_word_t cmp;
+    uint16_t reg;               /* DWARF register numbers */
+    uint16_t reg2;
+    uint8_t kind;
+    uint8_t deref;              /* load the value from the result */
+    uint8_t shift;
+  }
+dwarf_expr_form_t;
+
+/* Closed forms of the location expressions used by DW_CFA_expression,
+   DW_CFA_val_expression and DW_CFA_def_cfa_expression rules, keyed by
+   the address of the expression.  Register states only refer to their
+   expressions, so the forms are recognized the first time each
+   expression is evaluated.  Like the CIE cache it is direct-mapped,
+   invalidated by cache_generation and guarded by a sequence count per
+   entry.  */
+#define DWARF_LOG_EXPR_CACHE_SIZE       5
+#define DWARF_EXPR_CACHE_SIZE           (1 << DWARF_LOG_EXPR_CACHE_SIZE)
+#define DWARF_EXPR_MAX_OPS              9       /* longest closed form */
+
+struct dwarf_expr_cache_entry
+  {
+    _Atomic uint32_t seq;               /* sequence count */
+    uint32_t generation;                /* cache_generation when filled */
+    unw_word_t expr_addr;               /* address of the expression, 0 if empty */
+    dwarf_expr_form_t form;
+  };
+
+struct dwarf_expr_cache
+  {
+    struct dwarf_expr_cache_entry entries[DWARF_EXPR_CACHE_SIZE];
+  };
+
+/* Search indexes of the largest binary-search tables (.eh_frame_hdr or
+   .debug_frame) of an address space, with their keys in a static
+   B+-tree (see Gfind_proc_info_i.h).  Slots are claimed for a table
+   address and keep their index until unw_flush_cache(); an index is
+   only built once binary searches of its table have read about as
+   many entries as building it does.  Results found through an index
+   are checked against the table, so a table replaced at the same
+   address is just searched as before.  */
+#define DWARF_LOG_TABLE_INDEXES         6
+#define DWARF_TABLE_INDEXES             (1 << DWARF_LOG_TABLE_INDEXES)
+#define DWARF_TABLE_INDEX_MIN_LEN       1024    /* entries */
+
+struct dwarf_table_index
+  {
+    size_t size;                        /* of the mapping holding it all */
+    size_t len;                         /* entries in the table */
+    unsigned int height;
+    size_t offsets[10];                 /* TABLE_INDEX_MAX_HEIGHT + 1 */
+    int32_t *keys;
+  };
+
+struct dwarf_table_index_slot
+  {
+    _Atomic unw_word_t table;           /* address of the table, 0 if free */
+    _Atomic unw_word_t searches;        /* binary searches made so far */
+    _Atomic (struct dwarf_table_index *) index;
+  };
+
+struct dwarf_table_indexes
+  {
+    struct dwarf_table_index_slot slots[DWARF_TABLE_INDEXES];
+  };
+
 typedef struct dwarf_state_record
   {
     unsigned char fde_encoding;
@@ -328,8 +533,8 @@ typedef struct dwarf_cursor
     unsigned int pi_is_dynamic :1; /* proc_info found via dynamic proc info? */
     unw_proc_info_t pi;         /* info about current procedure */
 
-    short hint; /* faster lookup of the rs cache */
-    short prev_rs;
+    int hint; /* faster lookup of the rs cache */
+    int prev_rs;
   }
 dwarf_cursor_t;
 
@@ -339,33 +544,58 @@ dwarf_cursor_t;
 #define DWARF_DEFAULT_LOG_UNW_HASH_SIZE (DWARF_DEFAULT_LOG_UNW_CACHE_SIZE + 1)
 #define DWARF_DEFAULT_UNW_HASH_SIZE     (1 << DWARF_DEFAULT_LOG_UNW_HASH_SIZE)
 
-typedef unsigned char unw_hash_index_t;
+/* Largest rs cache supported by unw_set_cache_size().  */
+#define DWARF_MAX_LOG_UNW_CACHE_SIZE    24
+
+/* Adaptive sizing: every DWARF_ADAPTIVE_WINDOW lookups the cache is
+   doubled if more than 1/DWARF_ADAPTIVE_MISS_RATIO of them missed, and
+   halved (down to the size set by unw_set_cache_size()) if the window
+   took longer than DWARF_ADAPTIVE_IDLE_SECS.  */
+#define DWARF_ADAPTIVE_WINDOW           4096
+#define DWARF_ADAPTIVE_MISS_RATIO       8
+#define DWARF_ADAPTIVE_IDLE_SECS        60
+
+typedef uint32_t unw_hash_index_t;
 
 struct dwarf_rs_cache
   {
     pthread_mutex_t lock;
-    unsigned short rr_head;    /* index of least-recently allocated rs */
+    uint32_t rr_head;          /* index of least-recently allocated rs */
 
     unsigned short log_size;
     unsigned short prev_log_size;
+    unsigned short base_log_size;       /* size set by unw_set_cache_size() */
+    unsigned short adaptive;            /* grow/shrink with the miss rate? */
+
+    /* adaptive sizing statistics for the current window: */
+    uint32_t window_lookups;
+    uint32_t window_misses;
+    unw_word_t window_start;            /* CLOCK_MONOTONIC seconds */
 
     /* hash table that maps instruction pointer to rs index: */
-    unsigned short *hash;
+    uint32_t *hash;
+    uint32_t tree_root;                 /* treap of rs indices by start_ip */
 
     _Atomic uint32_t generation;        /* generation number */
 
     /* rs cache: */
-    dwarf_reg_state_t *buckets;
+    dwarf_packed_reg_state_t *buckets;
     dwarf_reg_cache_entry_t *links;
+    dwarf_cached_proc_info_t *proc_info;
 
     /* default memory, loaded in BSS segment */
-    unsigned short default_hash[DWARF_DEFAULT_UNW_HASH_SIZE];
-    dwarf_reg_state_t default_buckets[DWARF_DEFAULT_UNW_CACHE_SIZE];
+    uint32_t default_hash[DWARF_DEFAULT_UNW_HASH_SIZE];
+    dwarf_packed_reg_state_t default_buckets[DWARF_DEFAULT_UNW_CACHE_SIZE];
     dwarf_reg_cache_entry_t default_links[DWARF_DEFAULT_UNW_CACHE_SIZE];
+    dwarf_cached_proc_info_t default_proc_info[DWARF_DEFAULT_UNW_CACHE_SIZE];
   };
 
-/* A list of descriptors for loaded .debug_frame sections.  */
+/* Kinds of tables in the on-disk index cache.  */
+#define DWARF_INDEX_EH_FRAME            1
+#define DWARF_INDEX_DEBUG_FRAME         2
+#define DWARF_BUILD_ID_MAX              64      /* bytes */
 
+/* A list of descriptors for loaded .debug_frame sections.  */
 struct unw_debug_frame_list
   {
     /* The start (inclusive) and end (exclusive) of the described region.  */
@@ -374,17 +604,40 @@ struct unw_debug_frame_list
     /* The debug frame itself.  */
     char *debug_frame;
     size_t debug_frame_size;
+    /* The file mapping or decompressed copy holding it.  */
+    void *debug_frame_map;
+    size_t debug_frame_map_size;
     /* Index (for binary search).  */
     struct table_entry *index;
     size_t index_size;
+    size_t index_len;
+    /* Build-id of the file, keying the on-disk index cache.  */
+    uint8_t build_id[DWARF_BUILD_ID_MAX];
+    size_t build_id_len;
     /* Pointer to next descriptor.  */
     struct unw_debug_frame_list *next;
   };
 
+/* A binary-search table built from the .eh_frame of an object which
+   has no .eh_frame_hdr (or one without a table), in place of the linear
+   search of its FDEs.  The entries are relative to the .eh_frame.  */
+struct dwarf_eh_frame_table
+  {
+    unw_word_t phdr;            /* dlpi_phdr of the object */
+    unw_word_t eh_frame;        /* 0 if it has none */
+    struct table_entry *index;  /* NULL if it cannot be searched */
+    size_t index_size;          /* of the memory holding the index */
+    size_t len;                 /* entries in the index */
+    struct dwarf_eh_frame_table *next;
+  };
+
 /* Convenience macros: */
 #define dwarf_init                      UNW_ARCH_OBJ (dwarf_init)
+#define dwarf_index_cache_load          UNW_ARCH_OBJ (dwarf_index_cache_load)
+#define dwarf_index_cache_store         UNW_ARCH_OBJ (dwarf_index_cache_store)
 #define dwarf_callback                  UNW_OBJ (dwarf_callback)
 #define dwarf_find_proc_info            UNW_OBJ (dwarf_find_proc_info)
+#define dwarf_index_eh_frame            UNW_OBJ (dwarf_index_eh_frame)
 #define dwarf_find_debug_frame          UNW_OBJ (dwarf_find_debug_frame)
 #define dwarf_search_unwind_table       UNW_OBJ (dwarf_search_unwind_table)
 #define dwarf_find_unwind_table         UNW_OBJ (dwarf_find_unwind_table)
@@ -392,22 +645,40 @@ struct unw_debug_frame_list
 #define dwarf_put_unwind_info           UNW_OBJ (dwarf_put_unwind_info)
 #define dwarf_eval_expr                 UNW_OBJ (dwarf_eval_expr)
 #define dwarf_stack_aligned             UNW_OBJ (dwarf_stack_aligned)
+#define dwarf_get_expr_form             UNW_OBJ (dwarf_get_expr_form)
+#define dwarf_eval_expr_form            UNW_OBJ (dwarf_eval_expr_form)
 #define dwarf_extract_proc_info_from_fde \
                 UNW_OBJ (dwarf_extract_proc_info_from_fde)
 #define dwarf_find_save_locs            UNW_OBJ (dwarf_find_save_locs)
 #define dwarf_make_proc_info            UNW_OBJ (dwarf_make_proc_info)
+#define dwarf_prefetch_proc             UNW_OBJ (dwarf_prefetch_proc)
 #define dwarf_apply_reg_state           UNW_OBJ (dwarf_apply_reg_state)
 #define dwarf_reg_states_iterate        UNW_OBJ (dwarf_reg_states_iterate)
 #define dwarf_read_encoded_pointer      UNW_OBJ (dwarf_read_encoded_pointer)
 #define dwarf_step                      UNW_OBJ (dwarf_step)
 #define dwarf_flush_rs_cache            UNW_OBJ (dwarf_flush_rs_cache)
+#define dwarf_rs_cache_init_thread_key  UNW_OBJ (dwarf_rs_cache_init_thread_key)
 
 extern int dwarf_init (void);
+
+extern struct table_entry *dwarf_index_cache_load (const uint8_t *build_id,
+                                                   size_t build_id_len,
+                                                   int kind,
+                                                   size_t section_size,
+                                                   size_t *len, size_t *size);
+extern void dwarf_index_cache_store (const uint8_t *build_id,
+                                     size_t build_id_len, int kind,
+                                     size_t section_size,
+                                     const struct table_entry *table,
+                                     size_t len);
+
 #ifndef UNW_REMOTE_ONLY
 extern int dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr);
 extern int dwarf_find_proc_info (unw_addr_space_t as, unw_word_t ip,
                                  unw_proc_info_t *pi,
                                  int need_unwind_info, void *arg);
+extern long dwarf_index_eh_frame (unw_word_t eh_frame, unw_word_t *range,
+                                  struct table_entry *table);
 #endif /* !UNW_REMOTE_ONLY */
 extern int dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug,
                                    unw_word_t ip, unw_word_t segbase,
@@ -430,6 +701,11 @@ extern int dwarf_eval_expr (struct dwarf_cursor *c, unw_word_t stack_val, unw_wo
 extern int
 dwarf_stack_aligned(struct dwarf_cursor *c, unw_word_t cfa_addr,
                     unw_word_t rbp_addr, unw_word_t *offset);
+extern void dwarf_get_expr_form (struct dwarf_cursor *c, unw_word_t addr,
+                                 dwarf_expr_form_t *form);
+extern int dwarf_eval_expr_form (struct dwarf_cursor *c, unw_word_t stack_val,
+                                 unw_word_t addr, const dwarf_expr_form_t *form,
+                                 unw_word_t *valp, int *is_register);
 
 extern int dwarf_extract_proc_info_from_fde (unw_addr_space_t as,
                                              unw_accessors_t *a,
@@ -441,6 +717,9 @@ extern int dwarf_extract_proc_info_from_fde (unw_addr_space_t as,
                                              void *arg);
 extern int dwarf_find_save_locs (struct dwarf_cursor *c);
 extern int dwarf_make_proc_info (struct dwarf_cursor *c);
+extern int dwarf_prefetch_proc (struct dwarf_cursor *c, unw_word_t ip,
+                                unw_word_t hi, unw_word_t *end_ip,
+                                unw_word_t *nrows);
 extern int dwarf_apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs);
 extern int dwarf_reg_states_iterate (struct dwarf_cursor *c, unw_reg_states_callback cb, void *token);
 extern int dwarf_read_encoded_pointer (unw_addr_space_t as,
@@ -451,5 +730,6 @@ extern int dwarf_read_encoded_pointer (unw_addr_space_t as,
                                        unw_word_t *valp, void *arg);
 extern int dwarf_step (struct dwarf_cursor *c);
 extern int dwarf_flush_rs_cache (struct dwarf_rs_cache *cache);
+extern void dwarf_rs_cache_init_thread_key (void);
 
 #endif /* dwarf_h */
@@ -141,6 +141,7 @@ dwarf_readu8 (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
   int ret;
 
   *addr += 1;
+  UNW_STATS_INC (accessor_calls);
   ret = (*a->access_mem) (as, aligned_addr, &val, 0, arg);
 #if UNW_BYTE_ORDER == UNW_LITTLE_ENDIAN
   val >>= 8*off;
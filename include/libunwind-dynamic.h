@@ -176,6 +176,25 @@ extern void _U_dyn_register (unw_dyn_info_t *);
    This routine is NOT signal-safe.  */
 extern void _U_dyn_cancel (unw_dyn_info_t *);
 
+/* Register the unwind info for N procedures at once, as one change of
+   the registry seen by remote unwinders.
+   This routine is NOT signal-safe.  */
+extern void _U_dyn_register_batch (unw_dyn_info_t **, size_t);
+
+/* Cancel the unwind info for N procedures at once.
+   This routine is NOT signal-safe.  */
+extern void _U_dyn_cancel_batch (unw_dyn_info_t **, size_t);
+
+/* Register the unwind info in the .eh_frame section at BEGIN, up to its
+   zero terminator, as libgcc's __register_frame() does.  The section
+   must stay in place until it is deregistered.
+   This routine is NOT signal-safe.  */
+extern void _U_register_frame (void *);
+
+/* Cancel the unwind info registered by _U_register_frame(BEGIN).
+   This routine is NOT signal-safe.  */
+extern void _U_deregister_frame (void *);
+
 
 /* Convenience routines.  */
 
@@ -51,7 +51,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include <libunwind.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -271,6 +273,9 @@ do {                                                                        \
 #define unwi_dyn_remote_find_proc_info  UNWI_OBJ(dyn_remote_find_proc_info)
 #define unwi_dyn_remote_put_unwind_info UNWI_OBJ(dyn_remote_put_unwind_info)
 #define unwi_dyn_validate_cache         UNWI_OBJ(dyn_validate_cache)
+#define unwi_dyn_index_add              UNWI_OBJ(dyn_index_add)
+#define unwi_dyn_index_remove           UNWI_OBJ(dyn_index_remove)
+#define unwi_dyn_index_idle             UNWI_ARCH_OBJ(dyn_index_idle)
 
 extern int unwi_find_dynamic_proc_info (unw_addr_space_t as,
                                         unw_word_t ip,
@@ -301,6 +306,24 @@ extern int unwi_dyn_validate_cache (unw_addr_space_t as, void *arg);
 extern unw_dyn_info_list_t _U_dyn_info_list;
 extern pthread_mutex_t _U_dyn_info_list_lock;
 
+/* Keep the address index of the local dynamic unwind info in step with
+   _U_dyn_info_list.  Called with _U_dyn_info_list_lock held.  */
+extern void unwi_dyn_index_add (unw_dyn_info_t *di);
+extern void unwi_dyn_index_remove (unw_dyn_info_t *di);
+/* Whether no local lookup may be using what it found in either.  */
+extern int unwi_dyn_index_idle (void);
+
+/* Intern a backtrace for unw_backtrace_id(), see mi/stack-store.c.  */
+#define unwi_stack_intern               UNWI_OBJ(stack_intern)
+extern int unwi_stack_intern (void **ips, int n, uint64_t *id);
+
+/* Step a cursor to the frame with a given stack pointer, for the
+   longjmp() of libunwind-setjmp, see mi/Gstep_to_sp.c.  Not part of
+   the API, but not HIDDEN either, as libunwind-setjmp is another
+   shared object.  */
+#define unwi_step_to_sp                 UNWI_OBJ(step_to_sp)
+extern int unwi_step_to_sp (unw_cursor_t *cursor, unw_word_t sp);
+
 #define unw_address_is_valid UNWI_ARCH_OBJ(address_is_valid)
 HIDDEN bool unw_address_is_valid(unw_word_t, size_t);
 
@@ -366,6 +389,9 @@ static inline unw_word_t unw_page_start(unw_word_t addr)
 
 extern void mi_init (void);     /* machine-independent initializations */
 extern unw_word_t _U_dyn_info_list_addr (void);
+extern int _U_dyn_info_find (unw_word_t ip, unw_dyn_info_t **dip);
+extern void _U_dyn_info_lookup_begin (void);
+extern void _U_dyn_info_lookup_end (void);
 
 /* This is needed/used by ELF targets only.  */
 
@@ -418,6 +444,85 @@ static inline void invalidate_edi (struct elf_dyn_info *edi)
 # define PT_ARM_EXIDX           0x70000001      /* ARM unwind segment */
 #endif /* !PT_ARM_EXIDX */
 
+/* Unwinder statistics, see unw_get_stats().  Each thread counts into a
+   block of its own from a preallocated pool, so bumping a counter needs
+   no atomic read-modify-write; unw_get_stats() sums all blocks.  A
+   thread takes its block with a compare-and-swap on the owner, which is
+   safe in a signal handler, and reuses the blocks of exited threads of
+   its process.
+   Threads beyond the pool share a block with atomic additions.  The
+   counters are compiled out with --disable-stats.  */
+
+#ifdef CONFIG_STATS
+
+#define unwi_stats_tls          UNW_OBJ(stats_tls)
+#define unwi_stats_claim        UNW_OBJ(stats_claim)
+
+#define UNWI_STATS_NUM_COUNTERS \
+        (offsetof (unw_stats_t, rs_cache_size) / sizeof (unw_word_t))
+
+struct unwi_stats_block
+  {
+    atomic_long owner;          /* thread ID, or 0 if never claimed */
+    atomic_long pid;            /* process of the owner */
+    int shared;                 /* counted into by several threads */
+    _Atomic unw_word_t counters[UNWI_STATS_NUM_COUNTERS];
+  };
+
+HIDDEN extern thread_local struct unwi_stats_block *unwi_stats_tls
+  __attribute__((tls_model("initial-exec")));
+HIDDEN extern struct unwi_stats_block *unwi_stats_claim (void);
+
+static ALWAYS_INLINE void
+unwi_stats_add (size_t counter, unw_word_t n)
+{
+  struct unwi_stats_block *b = unwi_stats_tls;
+
+  if (unlikely (b == NULL))
+    b = unwi_stats_claim ();
+  if (unlikely (b->shared))
+    atomic_fetch_add_explicit (&b->counters[counter], n,
+                               memory_order_relaxed);
+  else
+    atomic_store_explicit (&b->counters[counter],
+                           atomic_load_explicit (&b->counters[counter],
+                                                 memory_order_relaxed) + n,
+                           memory_order_relaxed);
+}
+
+#define UNW_STATS_ADD(field, n)                                         \
+        unwi_stats_add (offsetof (unw_stats_t, field) / sizeof (unw_word_t), (n))
+#define UNW_STATS_INC(field)    UNW_STATS_ADD (field, 1)
+/* Count into element I of the per-frame-type array FIELD.  */
+#define UNW_STATS_INC_FRAME(field, i)                                   \
+        unwi_stats_add (offsetof (unw_stats_t, field) / sizeof (unw_word_t) \
+                        + (size_t) (i), 1)
+
+#else /* !CONFIG_STATS */
+
+#define UNW_STATS_ADD(field, n)         ((void) (n))
+#define UNW_STATS_INC(field)            ((void) 0)
+#define UNW_STATS_INC_FRAME(field, i)   ((void) (i))
+
+#endif /* !CONFIG_STATS */
+
+/* Static (USDT) probes for perf, bpftrace and SystemTap, in provider
+   "libunwind".  A probe is a single nop plus an ELF note while nobody
+   is tracing; without <sys/sdt.h> it compiles to nothing and its
+   arguments are not evaluated.  */
+#ifdef HAVE_SDT
+# include <sys/sdt.h>
+# define UNW_PROBE(name)                STAP_PROBE (libunwind, name)
+# define UNW_PROBE1(name, a)            STAP_PROBE1 (libunwind, name, a)
+# define UNW_PROBE2(name, a, b)         STAP_PROBE2 (libunwind, name, a, b)
+# define UNW_PROBE3(name, a, b, c)      STAP_PROBE3 (libunwind, name, a, b, c)
+#else
+# define UNW_PROBE(name)                do { } while (0)
+# define UNW_PROBE1(name, a)            do { } while (0)
+# define UNW_PROBE2(name, a, b)         do { } while (0)
+# define UNW_PROBE3(name, a, b, c)      do { } while (0)
+#endif
+
 #define DWARF_GET_MEM_LOC(l)    DWARF_GET_LOC(l)
 #define DWARF_GET_REG_LOC(l)    ((unw_regnum_t) DWARF_GET_LOC(l))
 
@@ -31,6 +31,10 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
    gcc/config/aarch64/aarch64.h:DWARF_FRAME_REGISTERS.  */
 #define DWARF_NUM_PRESERVED_REGS        97
 
+/* Leave room in the rs cache for frames which save all of x19-x30
+   and d8-d15, and for the expression-based sigreturn frame.  */
+#define DWARF_RS_PACKED_SIZE            96
+
 /* Return TRUE if the ADDR_SPACE uses big-endian byte-order.  */
 #define dwarf_is_big_endian(addr_space) 0
 
@@ -72,7 +72,12 @@ struct unw_addr_space
     unw_word_t dyn_generation;          /* see dyn-common.h */
     unw_word_t dyn_info_list_addr;      /* (cached) dyn_info_list_addr */
     struct dwarf_rs_cache global_cache;
+    struct dwarf_cie_cache cie_cache;
+    struct dwarf_cfi_cache cfi_cache;
+    struct dwarf_expr_cache expr_cache;
+    struct dwarf_table_indexes table_indexes;
     struct unw_debug_frame_list *debug_frames;
+    _Atomic (struct dwarf_eh_frame_table *) eh_frame_tables;
   };
 
 struct MAY_ALIAS cursor
@@ -238,6 +243,7 @@ dwarf_get (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t *val)
      happen?  */
   assert (!DWARF_IS_FP_LOC (loc));
 
+  UNW_STATS_INC (accessor_calls);
   if (DWARF_IS_REG_LOC (loc))
     return (*c->as->acc.access_reg) (c->as, DWARF_GET_REG_LOC (loc), val,
                                      0, c->as_arg);
@@ -258,6 +264,7 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
      happen?  */
   assert (!DWARF_IS_FP_LOC (loc));
 
+  UNW_STATS_INC (accessor_calls);
   if (DWARF_IS_REG_LOC (loc))
     return (*c->as->acc.access_reg) (c->as, DWARF_GET_REG_LOC (loc), &val,
                                      1, c->as_arg);
@@ -288,6 +295,8 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #define tdep_reuse_frame(c,frame)       do {} while(0)
 #define tdep_stash_frame                UNW_OBJ(tdep_stash_frame)
 #define tdep_trace                      UNW_OBJ(tdep_trace)
+#define tdep_trace_to_sp(cur,sp)        0
+#define tdep_trace_reserve(n)           0
 
 #ifdef UNW_LOCAL_ONLY
 # define tdep_find_proc_info(c,ip,n)                            \
@@ -332,7 +341,8 @@ extern int tdep_access_reg (struct cursor *c, unw_regnum_t reg,
                             unw_word_t *valp, int write);
 extern int tdep_access_fpreg (struct cursor *c, unw_regnum_t reg,
                               unw_fpreg_t *valp, int write);
-extern int tdep_trace (unw_cursor_t *cursor, void **addresses, int *n);
+extern int tdep_trace (unw_cursor_t *cursor, void **addresses,
+                       unw_word_t *sps, int *n);
 extern void tdep_stash_frame (struct dwarf_cursor *c,
                               struct dwarf_reg_state *rs);
 
@@ -54,7 +54,12 @@ struct unw_addr_space
     unw_word_t dyn_generation;          /* see dyn-common.h */
     unw_word_t dyn_info_list_addr;      /* (cached) dyn_info_list_addr */
     struct dwarf_rs_cache global_cache;
+    struct dwarf_cie_cache cie_cache;
+    struct dwarf_cfi_cache cfi_cache;
+    struct dwarf_expr_cache expr_cache;
+    struct dwarf_table_indexes table_indexes;
     struct unw_debug_frame_list *debug_frames;
+    _Atomic (struct dwarf_eh_frame_table *) eh_frame_tables;
    };
 
 struct MAY_ALIAS cursor
@@ -241,7 +246,9 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #define tdep_cache_frame(c)             0
 #define tdep_reuse_frame(c,frame)       do {} while(0)
 #define tdep_stash_frame(c,rs)          do {} while(0)
-#define tdep_trace(cur,addr,n)          (-UNW_ENOINFO)
+#define tdep_trace(cur,addr,sp,n)       (-UNW_ENOINFO)
+#define tdep_trace_to_sp(cur,sp)        0
+#define tdep_trace_reserve(n)           0
 
 #ifdef UNW_LOCAL_ONLY
 # define tdep_find_proc_info(c,ip,n)                            \
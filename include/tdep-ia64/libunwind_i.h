@@ -233,7 +233,9 @@ struct ia64_global_unwind_state
 #define tdep_cache_frame(c)             0
 #define tdep_reuse_frame(c,frame)       do {} while(0)
 #define tdep_stash_frame(c,rs)          do {} while(0)
-#define tdep_trace(cur,addr,n)          (-UNW_ENOINFO)
+#define tdep_trace(cur,addr,sp,n)       (-UNW_ENOINFO)
+#define tdep_trace_to_sp(cur,sp)        0
+#define tdep_trace_reserve(n)           0
 #define tdep_get_as(c)                  ((c)->as)
 #define tdep_get_as_arg(c)              ((c)->as_arg)
 #define tdep_get_ip(c)                  ((c)->ip)
@@ -56,12 +56,23 @@ typedef struct
     int64_t frame_type     : 3;  /* unw_tdep_frame_type_t classification */
     int64_t last_frame     : 1;  /* non-zero if last frame in chain */
     int64_t cfa_reg_rsp    : 1;  /* cfa dwarf base register is rsp vs. rbp */
-    int64_t cfa_reg_offset : 29; /* cfa is at this offset from base register value */
+    int64_t cfa_reg_offset : 22; /* cfa is at this offset from base register value */
     int64_t rbp_cfa_offset : 15; /* rbp saved at this offset from cfa (-1 = not saved) */
     int64_t rsp_cfa_offset : 15; /* rsp saved at this offset from cfa (-1 = not saved) */
+    uint64_t saved_regs    : 6;  /* X86_64_SAVED_* registers the frame restores */
+    int64_t regs_complex   : 1;  /* non-zero if register rules need a full unw_step() */
   }
 unw_tdep_frame_t;
 
+/* Bits of unw_tdep_frame_t saved_regs.  */
+#define X86_64_SAVED_RBX        (1 << 0)
+#define X86_64_SAVED_RBP        (1 << 1)
+#define X86_64_SAVED_R12        (1 << 2)
+#define X86_64_SAVED_R13        (1 << 3)
+#define X86_64_SAVED_R14        (1 << 4)
+#define X86_64_SAVED_R15        (1 << 5)
+#define X86_64_SAVED_ALL        0x3f
+
 struct unw_addr_space
   {
     struct unw_accessors acc;
@@ -73,7 +84,12 @@ struct unw_addr_space
     unw_word_t dyn_generation;          /* see dyn-common.h */
     unw_word_t dyn_info_list_addr;      /* (cached) dyn_info_list_addr */
     struct dwarf_rs_cache global_cache;
+    struct dwarf_cie_cache cie_cache;
+    struct dwarf_cfi_cache cfi_cache;
+    struct dwarf_expr_cache expr_cache;
+    struct dwarf_table_indexes table_indexes;
     struct unw_debug_frame_list *debug_frames;
+    _Atomic (struct dwarf_eh_frame_table *) eh_frame_tables;
    };
 
 struct MAY_ALIAS cursor
@@ -96,6 +112,8 @@ struct MAY_ALIAS cursor
       }
     sigcontext_format;
     unw_word_t sigcontext_addr;
+
+    int frame_pointer_only;             /* UNW_INIT_FRAME_POINTER */
   };
 
 #define AS_ARG_UCONTEXT_MASK ~0x1UL
@@ -200,6 +218,8 @@ dwarf_get (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t *val)
   if (DWARF_IS_NULL_LOC (loc))
     return -UNW_EBADREG;
 
+  if (!DWARF_IS_VAL_LOC (loc))
+    UNW_STATS_INC (accessor_calls);
   if (DWARF_IS_REG_LOC (loc))
     return (*c->as->acc.access_reg) (c->as, DWARF_GET_REG_LOC (loc), val,
                                      0, c->as_arg);
@@ -219,6 +239,7 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
   if (DWARF_IS_NULL_LOC (loc))
     return -UNW_EBADREG;
 
+  UNW_STATS_INC (accessor_calls);
   if (DWARF_IS_REG_LOC (loc))
     return (*c->as->acc.access_reg) (c->as, DWARF_GET_REG_LOC (loc), &val,
                                      1, c->as_arg);
@@ -249,6 +270,8 @@ dwarf_put (struct dwarf_cursor *c, dwarf_loc_t loc, unw_word_t val)
 #endif
 #define tdep_stash_frame                UNW_OBJ(stash_frame)
 #define tdep_trace                      UNW_OBJ(tdep_trace)
+#define tdep_trace_to_sp                UNW_OBJ(trace_to_sp)
+#define tdep_trace_reserve              UNW_OBJ(trace_reserve)
 #define x86_64_r_uc_addr                UNW_OBJ(r_uc_addr)
 
 #ifdef UNW_LOCAL_ONLY
@@ -297,6 +320,9 @@ extern void tdep_stash_frame (struct dwarf_cursor *c,
                               struct dwarf_reg_state *rs);
 
 extern int tdep_getcontext_trace (unw_tdep_context_t *);
-extern int tdep_trace (unw_cursor_t *cursor, void **addresses, int *n);
+extern int tdep_trace (unw_cursor_t *cursor, void **addresses,
+                       unw_word_t *sps, int *n);
+extern int tdep_trace_to_sp (unw_cursor_t *cursor, unw_word_t sp);
+extern int tdep_trace_reserve (size_t n);
 
 #endif /* X86_64_LIBUNWIND_I_H */
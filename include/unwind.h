@@ -143,6 +143,10 @@ extern _Unwind_Reason_Code _Unwind_Backtrace (_Unwind_Trace_Fn, void *);
    procedures.  */
 extern void *_Unwind_FindEnclosingFunction (void *);
 
+/* Register the .eh_frame section of generated code, or cancel it.  */
+extern void __register_frame (void *);
+extern void __deregister_frame (void *);
+
 /* See also Linux Standard Base Spec:
     http://www.linuxbase.org/spec/refspecs/LSB_1.3.0/gLSB/gLSB/libgcc-s.html */
 
@@ -204,6 +204,19 @@ trace_cache_get (void)
   }
 }
 
+/* Map frame type FRAME_TYPE to its unw_get_stats() counter.  */
+static inline int
+trace_stats_frame (int frame_type)
+{
+  switch (frame_type)
+  {
+  case UNW_AARCH64_FRAME_STANDARD:   return UNW_STATS_FRAME_STANDARD;
+  case UNW_AARCH64_FRAME_SIGRETURN:  return UNW_STATS_FRAME_SIGRETURN;
+  case UNW_AARCH64_FRAME_GUESSED:    return UNW_STATS_FRAME_GUESSED;
+  default:                           return UNW_STATS_FRAME_OTHER;
+  }
+}
+
 /* Initialise frame properties for address cache slot F at address
    PC using current CFA, FP and SP values.  Modifies CURSOR to
    that location, performs one unw_step(), and fills F with what
@@ -316,6 +329,7 @@ trace_lookup (unw_cursor_t *cursor,
     if (likely(addr == pc))
     {
       Debug (4, "found address after %ld steps\n", i);
+      UNW_STATS_INC_FRAME (trace_hits, trace_stats_frame (frame->frame_type));
       return frame;
     }
 
@@ -347,7 +361,9 @@ trace_lookup (unw_cursor_t *cursor,
   if (! addr)
     ++cache->used;
 
-  return trace_init_addr (frame, cursor, cfa, pc, fp, sp);
+  frame = trace_init_addr (frame, cursor, cfa, pc, fp, sp);
+  UNW_STATS_INC_FRAME (trace_misses, trace_stats_frame (frame->frame_type));
+  return frame;
 }
 
 /* Fast stack backtrace for AArch64.
@@ -360,6 +376,10 @@ trace_lookup (unw_cursor_t *cursor,
    stored into BUFFER. Uses an internal thread-specific cache to
    accelerate queries.
 
+   If SPS is not NULL, the stack pointer of each frame, as
+   unw_get_reg() gives it for UNW_REG_SP, is stored to it at the same
+   index as the frame's address in BUFFER.
+
    The caller should fall back to a unw_step() loop if this function
    fails by returning -UNW_ESTOPUNWIND, meaning the routine hit a
    stack frame that is too complex to be traced in the fast path.
@@ -400,7 +420,7 @@ trace_lookup (unw_cursor_t *cursor,
 
      unw_getcontext(&ctx);
      unw_init_local(&cur, &ctx);
-     if ((ret = unw_tdep_trace(&cur, addrs, &depth)) < 0)
+     if ((ret = unw_tdep_trace(&cur, addrs, NULL, &depth)) < 0)
      {
        depth = 0;
        unw_getcontext(&ctx);
@@ -414,7 +434,8 @@ trace_lookup (unw_cursor_t *cursor,
      }
 */
 HIDDEN int
-tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
+tdep_trace (unw_cursor_t *cursor, void **buffer, unw_word_t *sps,
+            int *size)
 {
   struct cursor *c = (struct cursor *) cursor;
   struct dwarf_cursor *d = &c->dwarf;
@@ -469,6 +490,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     /* If we don't have information for this frame, give up. */
     if (unlikely(! f))
     {
+      UNW_STATS_INC_FRAME (trace_aborts, UNW_STATS_FRAME_OTHER);
       ret = -UNW_ENOINFO;
       break;
     }
@@ -518,6 +540,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
         {
           /* Cached frame has no LR and neither do we. */
           Debug (1, "returning -UNW_ESTOPUNWIND, depth %d\n", depth);
+          UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
           *size = depth;
           return -UNW_ESTOPUNWIND;
         }
@@ -562,6 +585,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
           caller we had to stop.  Data collected so far may still be
           useful to the caller, so let it know how far we got.  */
       Debug (1, "returning -UNW_ESTOPUNWIND, depth %d\n", depth);
+      UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
       *size = depth;
       return -UNW_ESTOPUNWIND;
     }
@@ -571,9 +595,15 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
 
     /* If we failed or ended up somewhere bogus, stop. */
     if (unlikely(ret < 0 || pc < 0x4000))
+    {
+      if (ret < 0)
+        UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
       break;
+    }
 
     /* Record this address in stack trace. We skipped the first address. */
+    if (sps)
+      sps[depth] = sp;
     buffer[depth++] = (void *) pc;
   }
 
@@ -205,6 +205,20 @@ trace_cache_get (void)
   }
 }
 
+/* Map frame type FRAME_TYPE to its unw_get_stats() counter.  */
+static inline int
+trace_stats_frame (int frame_type)
+{
+  switch (frame_type)
+  {
+  case UNW_ARM_FRAME_STANDARD:   return UNW_STATS_FRAME_STANDARD;
+  case UNW_ARM_FRAME_SIGRETURN:  return UNW_STATS_FRAME_SIGRETURN;
+  case UNW_ARM_FRAME_GUESSED:    return UNW_STATS_FRAME_GUESSED;
+  case UNW_ARM_FRAME_SYSCALL:    return UNW_STATS_FRAME_SPECIAL;
+  default:                       return UNW_STATS_FRAME_OTHER;
+  }
+}
+
 /* Initialise frame properties for address cache slot F at address
    PC using current CFA, R7 and SP values.  Modifies CURSOR to
    that location, performs one unw_step(), and fills F with what
@@ -300,6 +314,7 @@ trace_lookup (unw_cursor_t *cursor,
     if (likely(addr == pc))
     {
       Debug (4, "found address after %d steps\n", i);
+      UNW_STATS_INC_FRAME (trace_hits, trace_stats_frame (frame->frame_type));
       return frame;
     }
 
@@ -331,7 +346,9 @@ trace_lookup (unw_cursor_t *cursor,
   if (! addr)
     ++cache->used;
 
-  return trace_init_addr (frame, cursor, cfa, pc, r7, sp);
+  frame = trace_init_addr (frame, cursor, cfa, pc, r7, sp);
+  UNW_STATS_INC_FRAME (trace_misses, trace_stats_frame (frame->frame_type));
+  return frame;
 }
 
 /* Fast stack backtrace for ARM.
@@ -344,6 +361,12 @@ trace_lookup (unw_cursor_t *cursor,
    stored into BUFFER. Uses an internal thread-specific cache to
    accelerate queries.
 
+   If SPS is not NULL, the stack pointer of each frame, as
+   unw_get_reg() gives it for UNW_REG_SP, is stored to it at the same
+   index as the frame's address in BUFFER, and BUFFER receives the
+   addresses as unw_get_reg() gives them for UNW_REG_IP instead of
+   the call sites.
+
    The caller should fall back to a unw_step() loop if this function
    fails by returning -UNW_ESTOPUNWIND, meaning the routine hit a
    stack frame that is too complex to be traced in the fast path.
@@ -384,7 +407,7 @@ trace_lookup (unw_cursor_t *cursor,
 
      unw_getcontext(&ctx);
      unw_init_local(&cur, &ctx);
-     if ((ret = unw_tdep_trace(&cur, addrs, &depth)) < 0)
+     if ((ret = unw_tdep_trace(&cur, addrs, NULL, &depth)) < 0)
      {
        depth = 0;
        unw_getcontext(&ctx);
@@ -398,7 +421,8 @@ trace_lookup (unw_cursor_t *cursor,
      }
 */
 HIDDEN int
-tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
+tdep_trace (unw_cursor_t *cursor, void **buffer, unw_word_t *sps,
+            int *size)
 {
   struct cursor *c = (struct cursor *) cursor;
   struct dwarf_cursor *d = &c->dwarf;
@@ -453,6 +477,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     /* If we don't have information for this frame, give up. */
     if (unlikely(! f))
     {
+      UNW_STATS_INC_FRAME (trace_aborts, UNW_STATS_FRAME_OTHER);
       ret = -UNW_ENOINFO;
       break;
     }
@@ -545,6 +570,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
           caller we had to stop.  Data collected so far may still be
           useful to the caller, so let it know how far we got.  */
       Debug (1, "returning UNW_ESTOPUNWIND, depth %d\n", depth);
+      UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
       *size = depth;
       return -UNW_ESTOPUNWIND;
     }
@@ -554,10 +580,20 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
 
     /* If we failed or ended up somewhere bogus, stop. */
     if (unlikely(ret < 0 || pc < 0x4000))
+    {
+      if (ret < 0)
+        UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
       break;
+    }
 
     /* Record this address in stack trace. We skipped the first address. */
-    buffer[depth++] = (void *) (pc - d->use_prev_instr);
+    if (sps)
+    {
+      sps[depth] = sp;
+      buffer[depth++] = (void *) pc;
+    }
+    else
+      buffer[depth++] = (void *) (pc - d->use_prev_instr);
   }
 
 #if UNW_DEBUG
@@ -39,6 +39,8 @@ _UCD_access_mem (unw_addr_space_t  as UNUSED,
 
   struct UCD_info *ui = arg;
 
+  UNW_PROBE1 (coredump_read, addr);
+
   unw_word_t addr_last = addr + sizeof (*val) - 1;
 
   unsigned i;
@@ -188,51 +188,322 @@ read_operand (unw_addr_space_t as, unw_accessors_t *a,
   return ret;
 }
 
+/* An operation of an expression being matched against the closed
+   forms.  */
+struct expr_op
+  {
+    uint8_t opcode;
+    unw_word_t operand1, operand2;
+  };
+
+/* Return 1 and the constant in *VALP if OP pushes a constant.  */
+static inline int
+expr_op_const (const struct expr_op *op, unw_word_t *valp)
+{
+  unw_word_t val = op->operand1;
+
+  if (op->opcode >= DW_OP_lit0 && op->opcode <= DW_OP_lit31)
+    {
+      *valp = op->opcode - DW_OP_lit0;
+      return 1;
+    }
+
+  switch (op->opcode)
+    {
+    case DW_OP_const1u:
+    case DW_OP_const2u:
+    case DW_OP_const4u:
+    case DW_OP_const8u:
+    case DW_OP_constu:
+    case DW_OP_const8s:
+    case DW_OP_consts:
+      break;
+
+    case DW_OP_const1s:
+      if (val & 0x80)
+        val |= ((unw_word_t) -1) << 8;
+      break;
+
+    case DW_OP_const2s:
+      if (val & 0x8000)
+        val |= ((unw_word_t) -1) << 16;
+      break;
+
+    case DW_OP_const4s:
+      if (val & 0x80000000)
+        val |= (((unw_word_t) -1) << 16) << 16;
+      break;
+
+    default:
+      return 0;
+    }
+  *valp = val;
+  return 1;
+}
+
+/* Return 1 and the register and offset if OP pushes a register plus an
+   offset.  */
+static inline int
+expr_op_breg (const struct expr_op *op, uint16_t *regp, unw_word_t *offp)
+{
+  if (op->opcode >= DW_OP_breg0 && op->opcode <= DW_OP_breg31)
+    {
+      *regp = op->opcode - DW_OP_breg0;
+      *offp = op->operand1;
+      return 1;
+    }
+  if (op->opcode == DW_OP_bregx && op->operand1 <= UINT16_MAX)
+    {
+      *regp = op->operand1;
+      *offp = op->operand2;
+      return 1;
+    }
+  return 0;
+}
+
+/* Match the expression at ADDR against the closed forms.  FORM is left
+   as DWARF_EXPR_INTERPRET if it has none, or can't be read.  */
+static void
+compile_expr (struct dwarf_cursor *c, unw_word_t addr,
+              dwarf_expr_form_t *form)
+{
+  struct expr_op ops[DWARF_EXPR_MAX_OPS];
+  unw_addr_space_t as = c->as;
+  unw_accessors_t *a = unw_get_accessors_int (as);
+  void *arg = c->as_arg;
+  unw_word_t len, end_addr, shift, k;
+  dwarf_expr_form_t f;
+  uint8_t signature;
+  int n = 0, i = 0;
+
+  memset (form, 0, sizeof (*form));
+  memset (&f, 0, sizeof (f));
+
+  if (dwarf_read_uleb128 (as, a, &addr, &len, arg) < 0)
+    return;
+
+  for (end_addr = addr + len; addr < end_addr; )
+    {
+      if (n == DWARF_EXPR_MAX_OPS
+          || dwarf_readu8 (as, a, &addr, &ops[n].opcode, arg) < 0)
+        return;
+      if (ops[n].opcode == DW_OP_nop)
+        continue;
+
+      signature = operands[ops[n].opcode];
+      ops[n].operand1 = ops[n].operand2 = 0;
+      if (NUM_OPERANDS (signature) > 0
+          && read_operand (as, a, &addr, OPND1_TYPE (signature),
+                           &ops[n].operand1, arg) < 0)
+        return;
+      if (NUM_OPERANDS (signature) > 1
+          && read_operand (as, a, &addr, OPND2_TYPE (signature),
+                           &ops[n].operand2, arg) < 0)
+        return;
+      ++n;
+    }
+
+  /* The CFA of the PLT stubs which the GNU linkers generate, e.g.
+     breg7 8; breg16 0; lit15; and; lit11; ge; lit3; shl; plus.  */
+  if (n == 9
+      && expr_op_breg (&ops[0], &f.reg, &f.offset)
+      && expr_op_breg (&ops[1], &f.reg2, &f.offset2)
+      && expr_op_const (&ops[2], &f.mask) && ops[3].opcode == DW_OP_and
+      && expr_op_const (&ops[4], &f.cmp) && ops[5].opcode == DW_OP_ge
+      && expr_op_const (&ops[6], &shift) && ops[7].opcode == DW_OP_shl
+      && shift < 8 * sizeof (unw_word_t) && ops[8].opcode == DW_OP_plus)
+    {
+      f.shift = shift;
+      f.kind = DWARF_EXPR_PLT;
+      *form = f;
+      return;
+    }
+
+  /* The interpreter stops at the first register name.  */
+  if (n > 0 && ops[0].opcode >= DW_OP_reg0 && ops[0].opcode <= DW_OP_reg31)
+    {
+      form->reg = ops[0].opcode - DW_OP_reg0;
+      form->kind = DWARF_EXPR_REGISTER;
+      return;
+    }
+
+  /* Otherwise a register or the initial stack value plus constants,
+     optionally dereferenced.  */
+  f.kind = DWARF_EXPR_STACK_OFFSET;
+  if (n > 0 && expr_op_breg (&ops[0], &f.reg, &f.offset))
+    {
+      f.kind = DWARF_EXPR_REG_OFFSET;
+      i = 1;
+    }
+  for (; i < n; ++i)
+    {
+      if (f.deref)
+        return;
+      if (ops[i].opcode == DW_OP_plus_uconst)
+        f.offset += ops[i].operand1;
+      else if (ops[i].opcode == DW_OP_deref)
+        f.deref = 1;
+      else if (i + 1 < n && expr_op_const (&ops[i], &k)
+               && ops[i + 1].opcode == DW_OP_plus)
+        f.offset += k, ++i;
+      else if (i + 1 < n && expr_op_const (&ops[i], &k)
+               && ops[i + 1].opcode == DW_OP_minus)
+        f.offset -= k, ++i;
+      else
+        return;
+    }
+  *form = f;
+}
+
+static inline struct dwarf_expr_cache_entry *
+expr_cache_entry (unw_addr_space_t as, unw_word_t addr)
+{
+  /* based on (sqrt(5)/2-1)*2^64 */
+  unw_word_t h = addr * (unw_word_t) 0x9e3779b97f4a7c16ULL;
+
+  return &as->expr_cache.entries[h >> (8 * sizeof (unw_word_t)
+                                       - DWARF_LOG_EXPR_CACHE_SIZE)];
+}
+
+static inline int
+lookup_expr (unw_addr_space_t as, unw_word_t addr, dwarf_expr_form_t *form)
+{
+  struct dwarf_expr_cache_entry *e = expr_cache_entry (as, addr);
+  uint32_t seq;
+  int found;
+
+  seq = atomic_load_explicit (&e->seq, memory_order_acquire);
+  if (seq & 1)
+    return 0;
+  found = (e->expr_addr == addr
+           && e->generation == atomic_load (&as->cache_generation));
+  if (found)
+    *form = e->form;
+  atomic_thread_fence (memory_order_acquire);
+  return found && atomic_load_explicit (&e->seq, memory_order_relaxed) == seq;
+}
+
+static inline void
+cache_expr (unw_addr_space_t as, unw_word_t addr,
+            const dwarf_expr_form_t *form)
+{
+  struct dwarf_expr_cache_entry *e = expr_cache_entry (as, addr);
+  uint32_t seq;
+
+  /* If someone else is updating the entry, let them.  */
+  seq = atomic_load_explicit (&e->seq, memory_order_relaxed);
+  if ((seq & 1)
+      || !atomic_compare_exchange_strong (&e->seq, &seq, seq + 1))
+    return;
+  atomic_thread_fence (memory_order_release);
+
+  e->expr_addr = addr;
+  e->generation = atomic_load (&as->cache_generation);
+  e->form = *form;
+
+  atomic_store_explicit (&e->seq, seq + 2, memory_order_release);
+}
+
+/* Get the closed form of the expression at ADDR (the address of its
+   length), from the cache if possible.  */
+HIDDEN void
+dwarf_get_expr_form (struct dwarf_cursor *c, unw_word_t addr,
+                     dwarf_expr_form_t *form)
+{
+  int caching = c->as->caching_policy != UNW_CACHE_NONE;
+
+  if (caching && lookup_expr (c->as, addr, form))
+    return;
+
+  compile_expr (c, addr, form);
+  Debug (15, "expression at 0x%lx has form %d\n", (long) addr, form->kind);
+
+  if (caching)
+    cache_expr (c->as, addr, form);
+}
+
+/* Evaluate the expression at ADDR, whose closed form is FORM.  */
 HIDDEN int
-dwarf_stack_aligned(struct dwarf_cursor *c, unw_word_t cfa_addr,
-                    unw_word_t rbp_addr, unw_word_t *cfa_offset) {
+dwarf_eval_expr_form (struct dwarf_cursor *c, unw_word_t stack_val,
+                      unw_word_t addr, const dwarf_expr_form_t *form,
+                      unw_word_t *valp, int *is_register)
+{
+  unw_addr_space_t as = c->as;
   unw_accessors_t *a;
+  unw_word_t val, val2, len;
   int ret;
-  void *arg;
-  unw_word_t len;
-  uint8_t opcode;
-  unw_word_t operand1;
 
-  a = unw_get_accessors_int (c->as);
-  arg = c->as_arg;
+  UNW_STATS_INC (expr_evals);
+  *is_register = 0;
 
-  ret = dwarf_read_uleb128(c->as, a, &rbp_addr, &len, arg);
-  if (len != 2 || ret < 0)
-    return 0;
+  switch ((dwarf_expr_kind_t) form->kind)
+    {
+    case DWARF_EXPR_REGISTER:
+      *valp = dwarf_to_unw_regnum (form->reg);
+      *is_register = 1;
+      return 0;
 
-  ret = dwarf_readu8(c->as, a, &rbp_addr, &opcode, arg);
-  if (ret < 0 || opcode != DW_OP_breg6)
-    return 0;
+    case DWARF_EXPR_STACK_OFFSET:
+      val = stack_val;
+      break;
 
-  ret = read_operand(c->as, a, &rbp_addr,
-                     OPND1_TYPE(operands[opcode]), &operand1, arg);
+    case DWARF_EXPR_REG_OFFSET:
+      if ((ret = unw_get_reg (dwarf_to_cursor (c),
+                              dwarf_to_unw_regnum (form->reg), &val)) < 0)
+        return ret;
+      break;
 
-  if (ret < 0 || operand1 != 0)
-    return 0;
+    case DWARF_EXPR_PLT:
+      if ((ret = unw_get_reg (dwarf_to_cursor (c),
+                              dwarf_to_unw_regnum (form->reg), &val)) < 0
+          || (ret = unw_get_reg (dwarf_to_cursor (c),
+                                 dwarf_to_unw_regnum (form->reg2), &val2)) < 0)
+        return ret;
+      val2 = (val2 + form->offset2) & form->mask;
+      val += (unw_word_t) (sword (as, val2) >= sword (as, form->cmp))
+             << form->shift;
+      break;
 
-  ret = dwarf_read_uleb128(c->as, a, &cfa_addr, &len, arg);
-  if (ret < 0 || len != 3)
-    return 0;
+    case DWARF_EXPR_INTERPRET:
+    default:
+      UNW_STATS_INC (expr_interpreted);
+      a = unw_get_accessors_int (as);
+      if ((ret = dwarf_read_uleb128 (as, a, &addr, &len, c->as_arg)) < 0)
+        return ret;
+      return dwarf_eval_expr (c, stack_val, &addr, len, valp, is_register);
+    }
 
-  ret = dwarf_readu8(c->as, a, &cfa_addr, &opcode, arg);
-  if (ret < 0 || opcode != DW_OP_breg6)
-    return 0;
+  val += form->offset;
+  if (form->deref)
+    {
+      a = unw_get_accessors_int (as);
+      if ((ret = dwarf_readw (as, a, &val, valp, c->as_arg)) < 0)
+        return ret;
+    }
+  else
+    *valp = val;
+  Debug (14, "final value = 0x%lx\n", (unsigned long) *valp);
+  return 0;
+}
+
+/* Check for the expressions of a GCC generated frame realigning rsp:
+   rbp saved at breg6 0, and the CFA loaded from a constant offset from
+   rbp (breg6 N; deref).  */
+HIDDEN int
+dwarf_stack_aligned(struct dwarf_cursor *c, unw_word_t cfa_addr,
+                    unw_word_t rbp_addr, unw_word_t *cfa_offset) {
+  dwarf_expr_form_t form;
 
-  ret = read_operand(c->as, a, &cfa_addr,
-                     OPND1_TYPE(operands[opcode]), &operand1, arg);
-  if (ret < 0)
+  dwarf_get_expr_form (c, rbp_addr, &form);
+  if (form.kind != DWARF_EXPR_REG_OFFSET || form.reg != 6
+      || form.offset != 0 || form.deref)
     return 0;
 
-  ret = dwarf_readu8(c->as, a, &cfa_addr, &opcode, arg);
-  if (ret < 0 || opcode != DW_OP_deref)
+  dwarf_get_expr_form (c, cfa_addr, &form);
+  if (form.kind != DWARF_EXPR_REG_OFFSET || form.reg != 6 || !form.deref)
     return 0;
 
-  *cfa_offset = operand1;
+  *cfa_offset = form.offset;
   return 1;
 }
 
@@ -45,7 +45,7 @@ is_cie_id (unw_word_t val, int is_debug_frame)
 static inline int
 parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
            const unw_proc_info_t *pi, struct dwarf_cie_info *dci,
-           int is_debug_frame, void *arg)
+           int is_debug_frame, int *cacheablep, void *arg)
 {
   uint8_t version, ch, augstr[5], fde_encoding, handler_encoding;
   uint8_t address_size, segment_size;
@@ -192,6 +192,9 @@ parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
         /* read the personality-routine pointer-encoding format.  */
         if ((ret = dwarf_readu8 (as, a, &addr, &handler_encoding, arg)) < 0)
           return ret;
+        /* A function-relative handler depends on the FDE.  */
+        if ((handler_encoding & DW_EH_PE_APPL_MASK) == DW_EH_PE_funcrel)
+          *cacheablep = 0;
         if ((ret = dwarf_read_encoded_pointer (as, a, &addr, handler_encoding,
                                                pi, &dci->handler, arg)) < 0)
           return ret;
@@ -223,6 +226,68 @@ parse_cie (unw_addr_space_t as, unw_accessors_t *a, unw_word_t addr,
   return 0;
 }
 
+static inline struct dwarf_cie_cache_entry *
+cie_cache_entry (unw_addr_space_t as, unw_word_t cie_addr)
+{
+  /* based on (sqrt(5)/2-1)*2^64 */
+  unw_word_t h = cie_addr * (unw_word_t) 0x9e3779b97f4a7c16ULL;
+
+  return &as->cie_cache.entries[h >> (8 * sizeof (unw_word_t)
+                                      - DWARF_LOG_CIE_CACHE_SIZE)];
+}
+
+/* Copy the decoded CIE at CIE_ADDR into DCI if it is cached.  */
+static inline int
+lookup_cie (unw_addr_space_t as, unw_word_t cie_addr,
+            const unw_proc_info_t *pi, struct dwarf_cie_info *dci,
+            int is_debug_frame)
+{
+  struct dwarf_cie_cache_entry *e = cie_cache_entry (as, cie_addr);
+  uint32_t seq;
+  int found;
+
+  if (as->caching_policy == UNW_CACHE_NONE)
+    return 0;
+
+  seq = atomic_load_explicit (&e->seq, memory_order_acquire);
+  if (seq & 1)
+    return 0;
+  found = (e->cie_addr == cie_addr && e->gp == pi->gp
+           && e->is_debug_frame == is_debug_frame
+           && e->generation == atomic_load (&as->cache_generation));
+  if (found)
+    memcpy (dci, &e->dci, sizeof (*dci));
+  atomic_thread_fence (memory_order_acquire);
+  return found && atomic_load_explicit (&e->seq, memory_order_relaxed) == seq;
+}
+
+static inline void
+cache_cie (unw_addr_space_t as, unw_word_t cie_addr,
+           const unw_proc_info_t *pi, const struct dwarf_cie_info *dci,
+           int is_debug_frame)
+{
+  struct dwarf_cie_cache_entry *e = cie_cache_entry (as, cie_addr);
+  uint32_t seq;
+
+  if (as->caching_policy == UNW_CACHE_NONE)
+    return;
+
+  /* If someone else is updating the entry, let them.  */
+  seq = atomic_load_explicit (&e->seq, memory_order_relaxed);
+  if ((seq & 1)
+      || !atomic_compare_exchange_strong (&e->seq, &seq, seq + 1))
+    return;
+  atomic_thread_fence (memory_order_release);
+
+  e->cie_addr = cie_addr;
+  e->gp = pi->gp;
+  e->is_debug_frame = is_debug_frame;
+  e->generation = atomic_load (&as->cache_generation);
+  memcpy (&e->dci, dci, sizeof (*dci));
+
+  atomic_store_explicit (&e->seq, seq + 2, memory_order_release);
+}
+
 /* Extract proc-info from the FDE starting at address ADDR.
 
    Pass BASE as zero for eh_frame behaviour, or a pointer to
@@ -244,6 +309,7 @@ dwarf_extract_proc_info_from_fde (unw_addr_space_t as, unw_accessors_t *a,
   uint32_t u32val;
 
   Debug (12, "FDE @ 0x%lx\n", (long) addr);
+  UNW_STATS_INC (fde_parses);
 
   memset (&dci, 0, sizeof (dci));
 
@@ -311,8 +377,19 @@ dwarf_extract_proc_info_from_fde (unw_addr_space_t as, unw_accessors_t *a,
 
   Debug (15, "looking for CIE at address %lx\n", (long) cie_addr);
 
-  if ((ret = parse_cie (as, a, cie_addr, pi, &dci, is_debug_frame, arg)) < 0)
-    return ret;
+  if (lookup_cie (as, cie_addr, pi, &dci, is_debug_frame))
+    UNW_STATS_INC (cie_cache_hits);
+  else
+    {
+      int cacheable = 1;
+
+      UNW_STATS_INC (cie_parses);
+      if ((ret = parse_cie (as, a, cie_addr, pi, &dci, is_debug_frame,
+                            &cacheable, arg)) < 0)
+        return ret;
+      if (cacheable)
+        cache_cie (as, cie_addr, pi, &dci, is_debug_frame);
+    }
 
   /* IP-range has same encoding as FDE pointers, except that it's
      always an absolute value: */
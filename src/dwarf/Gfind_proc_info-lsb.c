@@ -94,22 +94,216 @@ linear_search (unw_addr_space_t as, unw_word_t ip,
     }
   return -UNW_ENOINFO;
 }
+
+/* Walk the .eh_frame or .debug_frame section at BASE, up to its
+   terminator or END.  If TABLE and RANGE are NULL, only the FDE headers
+   are read and the number of FDEs is returned.  Otherwise the FDEs
+   which cover any code are stored in TABLE, with their start address
+   relative to IP_BASE and their offset from BASE, and their number is
+   returned.  RANGE, if not NULL, receives the lowest start and highest
+   end address of those FDEs.  FDEs which cannot be parsed are left out.
+   An .eh_frame FDE too far from BASE or IP_BASE for the table makes it
+   return -1.  */
+static long
+fde_index_make (unw_word_t base, unw_word_t end, unw_word_t ip_base,
+                int is_debug_frame, struct table_entry *table,
+                unw_word_t *range)
+{
+  unw_accessors_t *a = unw_get_accessors_int (unw_local_addr_space);
+  unw_word_t addr = base;
+  long count = 0;
+
+  if (range)
+    {
+      range[0] = ~(unw_word_t) 0;
+      range[1] = 0;
+    }
+
+  while (addr < end)
+    {
+      unw_word_t item_start = addr, item_end, fde_addr;
+      unw_proc_info_t this_pi;
+      uint32_t u32val = 0;
+      uint64_t u64val = 0, cie_id = 0, id_for_cie;
+
+      dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
+      if (u32val == 0)
+        break;
+
+      if (u32val != 0xffffffff)
+        {
+          item_end = addr + u32val;
+          dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
+          cie_id = u32val;
+          id_for_cie = 0xffffffff;
+        }
+      else
+        {
+          /* Extended length.  */
+          dwarf_readu64 (unw_local_addr_space, a, &addr, &u64val, NULL);
+          item_end = addr + u64val;
+          dwarf_readu64 (unw_local_addr_space, a, &addr, &cie_id, NULL);
+          id_for_cie = 0xffffffffffffffffull;
+        }
+      addr = item_end;
+
+      /* .eh_frame CIEs have an id of 0.  */
+      if (cie_id == (is_debug_frame ? id_for_cie : 0))
+        continue;
+      if (!table && !range)
+        {
+          ++count;
+          continue;
+        }
+
+      fde_addr = item_start;
+      if (dwarf_extract_proc_info_from_fde (unw_local_addr_space, a,
+                                            &fde_addr, &this_pi, base,
+                                            0, is_debug_frame, NULL) < 0
+          || this_pi.start_ip == this_pi.end_ip)
+        continue;
+      if (range)
+        {
+          if (this_pi.start_ip < range[0])
+            range[0] = this_pi.start_ip;
+          if (this_pi.end_ip > range[1])
+            range[1] = this_pi.end_ip;
+        }
+      if (!table)
+        {
+          ++count;
+          continue;
+        }
+      if (!is_debug_frame
+          && ((unw_sword_t) (this_pi.start_ip - ip_base)
+                != (int32_t) (this_pi.start_ip - ip_base)
+              || item_start - base > INT32_MAX))
+        return -1;
+      table[count].start_ip_offset = this_pi.start_ip - ip_base;
+      table[count].fde_offset = item_start - base;
+      ++count;
+    }
+  return count;
+}
+/* Read the header of the CIE or FDE at ADDR, which must end by END.
+   Set *PTR to its CIE pointer, or its CIE id, and *PTR_ADDR to where
+   that is stored.  Returns 1 for a CIE, 0 for an FDE or -1.  */
+static int
+fde_index_header (unw_accessors_t *a, unw_word_t addr, unw_word_t end,
+                  int is_debug_frame, unw_word_t *ptr_addr, int64_t *ptr)
+{
+  uint32_t u32val = 0;
+  uint64_t u64val = 0;
+  int32_t s32val = 0;
+
+  if (end - addr < 8)
+    return -1;
+  dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
+  if (u32val != 0xffffffff)
+    {
+      if (u32val < 4 || end - addr < u32val)
+        return -1;
+      *ptr_addr = addr;
+      dwarf_reads32 (unw_local_addr_space, a, &addr, &s32val, NULL);
+      *ptr = s32val;
+    }
+  else
+    {
+      if (end - addr < 16)
+        return -1;
+      dwarf_readu64 (unw_local_addr_space, a, &addr, &u64val, NULL);
+      if (u64val < 8 || end - addr < u64val)
+        return -1;
+      *ptr_addr = addr;
+      dwarf_reads64 (unw_local_addr_space, a, &addr, ptr, NULL);
+    }
+  /* .eh_frame CIEs have an id of 0, .debug_frame ones all ones.  */
+  return *ptr == (is_debug_frame ? -1 : 0);
+}
+
+/* Check that the LEN entries of TABLE, as fde_index_make() would have
+   made them for the section at BASE up to END, each give the offset of
+   an FDE, with a CIE in the section, of a function at the entry's start
+   address.  An index read from a file has to be checked that far before
+   it is used.  Returns 0 if they do, or -1.  */
+static int
+fde_index_check (unw_word_t base, unw_word_t end, unw_word_t ip_base,
+                 int is_debug_frame, const struct table_entry *table,
+                 size_t len)
+{
+  unw_accessors_t *a = unw_get_accessors_int (unw_local_addr_space);
+  unw_word_t fde_addr, cie_addr, ptr_addr;
+  unw_proc_info_t pi;
+  int64_t ptr;
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    {
+      fde_addr = base + table[i].fde_offset;
+      if (fde_index_header (a, fde_addr, end, is_debug_frame,
+                            &ptr_addr, &ptr) != 0)
+        return -1;
+      cie_addr = is_debug_frame ? base + ptr : ptr_addr - ptr;
+      if (cie_addr < base || cie_addr >= end
+          || fde_index_header (a, cie_addr, end, is_debug_frame,
+                               &ptr_addr, &ptr) != 1
+          || dwarf_extract_proc_info_from_fde (unw_local_addr_space, a,
+                                               &fde_addr, &pi, base, 0,
+                                               is_debug_frame, NULL) < 0
+          || pi.start_ip == pi.end_ip
+          || (int32_t) (pi.start_ip - ip_base) != table[i].start_ip_offset)
+        {
+          Debug (1, "index entry %zu does not match the FDE at 0x%lx\n",
+                 i, (long) (base + table[i].fde_offset));
+          return -1;
+        }
+    }
+  return 0;
+}
+
+/* Index the .eh_frame at EH_FRAME, up to its terminator, for
+   _U_register_frame().  If TABLE is NULL, set RANGE to the lowest
+   start and the highest end address of its functions and return their
+   number.  Otherwise store that many entries in TABLE, relative to
+   RANGE[0], sorted, and return their number, or -1 if they are too far
+   apart for the table.  */
+HIDDEN long
+dwarf_index_eh_frame (unw_word_t eh_frame, unw_word_t *range,
+                      struct table_entry *table)
+{
+  long count;
+
+  if (!table)
+    return fde_index_make (eh_frame, ~(unw_word_t) 0, 0, 0, NULL, range);
+
+  count = fde_index_make (eh_frame, ~(unw_word_t) 0, range[0], 0, table,
+                          NULL);
+  if (count > 0)
+    sort_table (table, count);
+  return count;
+}
 #endif /* !UNW_REMOTE_ONLY */
 
 #ifdef CONFIG_DEBUG_FRAME
-/* Load .debug_frame section from FILE.  Allocates and returns space
-   in *BUF, and sets *BUFSIZE to its size.  IS_LOCAL is 1 if using the
+/* Load .debug_frame section from FILE.  Sets *BUF to it and *BUFSIZE
+   to its size, and *MAP and *MAPSIZE to the memory to unmap when done
+   with it: the pages of the file mapping which hold the section, or
+   the buffer it was decompressed into.  Copies the build-id of the
+   file, if any, to BUILD_ID and sets *BUILD_ID_LEN.  IS_LOCAL is 1 if using the
    local process, in which case we can search the system debug file
    directory; 0 for other address spaces, in which case we do
    not. Returns 0 on success, 1 on error.  Succeeds even if the file
    contains no .debug_frame.  */
-/* XXX: Could use mmap; but elf_map_image keeps tons mapped in.  */
 
 static int
-load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
+load_debug_frame (const char *file, char **buf, size_t *bufsize,
+                  void **map, size_t *mapsize, uint8_t *build_id,
+                  size_t *build_id_len, int is_local)
 {
   struct elf_image ei;
   Elf_W (Shdr) *shdr;
+  const uint8_t *id;
+  size_t start, end, size, id_len;
   int ret;
 
   ei.image = NULL;
@@ -118,6 +312,14 @@ load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
   if (ret != 0)
     return ret;
 
+  *build_id_len = 0;
+  id = elf_w (get_build_id) (&ei, &id_len);
+  if (id && id_len <= DWARF_BUILD_ID_MAX)
+    {
+      memcpy (build_id, id, id_len);
+      *build_id_len = id_len;
+    }
+
   shdr = elf_w (find_section) (&ei, ".debug_frame");
   if (!shdr ||
       (shdr->sh_offset + shdr->sh_size > ei.size))
@@ -157,6 +359,10 @@ load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
 
 	  Debug (4, "read %zd->%zd bytes of .debug_frame from offset %zd\n",
 		 shdr->sh_size, *bufsize, shdr->sh_offset);
+	  *map = *buf;
+	  *mapsize = *bufsize;
+	  mi_munmap(ei.image, ei.size);
+	  return 0;
 	}
       else
 #endif /* HAVE_ZLIB */
@@ -167,27 +373,24 @@ load_debug_frame (const char *file, char **buf, size_t *bufsize, int is_local)
 	  return 1;
         }
     }
-  else
-    {
 #endif
-      *bufsize = shdr->sh_size;
 
-      GET_MEMORY (*buf, *bufsize);
-      if (!*buf)
-        {
-          Debug (2, "failed to allocate .debug_frame buffer, skipping\n");
-          mi_munmap(ei.image, ei.size);
-          return 1;
-        }
-
-      memcpy(*buf, shdr->sh_offset + ei.image, *bufsize);
-
-      Debug (4, "read %zd bytes of .debug_frame from offset %zd\n",
-	     *bufsize, shdr->sh_offset);
-#if defined(SHF_COMPRESSED)
-    }
-#endif
-  mi_munmap(ei.image, ei.size);
+  /* Rather than copying the section, keep the pages of the (read-only,
+     private) file mapping which hold it and unmap the rest.  */
+  *buf = (char *) ei.image + shdr->sh_offset;
+  *bufsize = shdr->sh_size;
+  Debug (4, "mapped %zd bytes of .debug_frame at offset %zd\n",
+         shdr->sh_size, shdr->sh_offset);
+
+  size = UNW_ALIGN (ei.size, unw_page_size);
+  start = unw_page_start (shdr->sh_offset);
+  end = UNW_ALIGN (shdr->sh_offset + shdr->sh_size, unw_page_size);
+  if (start > 0)
+    mi_munmap (ei.image, start);
+  if (end < size)
+    mi_munmap ((char *) ei.image + end, size - end);
+  *map = (char *) ei.image + start;
+  *mapsize = end - start;
   return 0;
 }
 
@@ -238,7 +441,9 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
   char *name = path;
   int err;
   char *buf;
-  size_t bufsize;
+  size_t bufsize, mapsize, build_id_len;
+  uint8_t build_id[DWARF_BUILD_ID_MAX];
+  void *map;
 
   /* First, see if we loaded this frame already.  */
 
@@ -265,7 +470,8 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
   else
     name = (char*) dlname;
 
-  err = load_debug_frame (name, &buf, &bufsize, as == unw_local_addr_space);
+  err = load_debug_frame (name, &buf, &bufsize, &map, &mapsize, build_id,
+                          &build_id_len, as == unw_local_addr_space);
 
   if (!err)
     {
@@ -273,6 +479,7 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
       if (!fdesc)
         {
           Debug (2, "failed to allocate frame list entry\n");
+          mi_munmap (map, mapsize);
           return 0;
         }
 
@@ -280,7 +487,13 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
       fdesc->end = end;
       fdesc->debug_frame = buf;
       fdesc->debug_frame_size = bufsize;
+      fdesc->debug_frame_map = map;
+      fdesc->debug_frame_map_size = mapsize;
       fdesc->index = NULL;
+      fdesc->index_size = 0;
+      fdesc->index_len = 0;
+      memcpy (fdesc->build_id, build_id, build_id_len);
+      fdesc->build_id_len = build_id_len;
       fdesc->next = as->debug_frames;
 
       as->debug_frames = fdesc;
@@ -289,122 +502,6 @@ locate_debug_info (unw_addr_space_t as, unw_word_t addr, const char *dlname,
   return fdesc;
 }
 
-static size_t
-debug_frame_index_make (struct unw_debug_frame_list *fdesc)
-{
-  unw_accessors_t *a = unw_get_accessors_int (unw_local_addr_space);
-  char *buf = fdesc->debug_frame;
-  size_t bufsize = fdesc->debug_frame_size;
-  unw_word_t addr = (unw_word_t) (uintptr_t) buf;
-  size_t count = 0;
-
-  while (addr < (unw_word_t) (uintptr_t) (buf + bufsize))
-    {
-      unw_word_t item_start = addr, item_end = 0;
-      uint32_t u32val = 0;
-      uint64_t cie_id = 0;
-      uint64_t id_for_cie;
-
-      dwarf_readu32 (unw_local_addr_space, a, &addr, &u32val, NULL);
-
-      if (u32val == 0)
-        break;
-
-      if (u32val != 0xffffffff)
-        {
-          uint32_t cie_id32 = 0;
-
-          item_end = addr + u32val;
-          dwarf_readu32 (unw_local_addr_space, a, &addr, &cie_id32, NULL);
-          cie_id = cie_id32;
-          id_for_cie = 0xffffffff;
-        }
-      else
-        {
-          uint64_t u64val = 0;
-
-          /* Extended length.  */
-          dwarf_readu64 (unw_local_addr_space, a, &addr, &u64val, NULL);
-          item_end = addr + u64val;
-
-          dwarf_readu64 (unw_local_addr_space, a, &addr, &cie_id, NULL);
-          id_for_cie = 0xffffffffffffffffull;
-        }
-
-      /*Debug (1, "CIE/FDE id = %.8x\n", (int) cie_id);*/
-
-      if (cie_id == id_for_cie)
-        {
-          ;
-          /*Debug (1, "Found CIE at %.8x.\n", item_start);*/
-        }
-      else
-        {
-          unw_word_t fde_addr = item_start;
-          unw_proc_info_t this_pi;
-          int err;
-
-          /*Debug (1, "Found FDE at %.8x\n", item_start);*/
-
-          err = dwarf_extract_proc_info_from_fde (unw_local_addr_space,
-                                                  a, &fde_addr,
-                                                  &this_pi,
-                                                  (uintptr_t) buf, 0, 1,
-                                                  NULL);
-
-          if (!err)
-            {
-              Debug (15, "start_ip = %lx, end_ip = %lx\n",
-                     (long) this_pi.start_ip, (long) this_pi.end_ip);
-
-              if (fdesc->index)
-                {
-                  struct table_entry *e = &fdesc->index[count];
-
-                  e->fde_offset = item_start - (unw_word_t) (uintptr_t) buf;
-                  e->start_ip_offset = this_pi.start_ip;
-                }
-
-              count++;
-            }
-        /*else
-            Debug (1, "FDE parse failed\n");*/
-        }
-
-      addr = item_end;
-    }
-  return count;
-}
-
-static void
-debug_frame_index_sort (struct unw_debug_frame_list *fdesc)
-{
-  size_t i, j, k, n = fdesc->index_size / sizeof (*fdesc->index);
-  struct table_entry *a = fdesc->index;
-  struct table_entry t;
-
-  /* Use a simple Shell sort as it relatively fast and
-   * does not require additional memory. */
-
-  for (k = n / 2; k > 0; k /= 2)
-    {
-      for (i = k; i < n; i++)
-        {
-          t = a[i];
-
-          for (j = i; j >= k; j -= k)
-            {
-              if (t.start_ip_offset >= a[j - k].start_ip_offset)
-                break;
-
-              a[j] = a[j - k];
-            }
-
-          a[j] = t;
-        }
-    }
-}
-
 int
 dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
                         unw_word_t segbase, const char* obj_name,
@@ -431,16 +528,36 @@ dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
       return found;
     }
 
-  /* Now create a binary-search table, if it does not already exist. */
+  /* Now create a binary-search table, if it does not already exist.
+     Counting the FDEs only takes their headers; then they are parsed
+     once to fill the table.  */
+
+  if (!fdesc->index && fdesc->build_id_len)
+    fdesc->index = dwarf_index_cache_load (fdesc->build_id,
+                                           fdesc->build_id_len,
+                                           DWARF_INDEX_DEBUG_FRAME,
+                                           fdesc->debug_frame_size,
+                                           &fdesc->index_len,
+                                           &fdesc->index_size);
+
+  if (fdesc->index
+      && fde_index_check ((uintptr_t) fdesc->debug_frame,
+                          (uintptr_t) fdesc->debug_frame
+                          + fdesc->debug_frame_size, 0, 1,
+                          fdesc->index, fdesc->index_len) < 0)
+    {
+      mi_munmap (fdesc->index, fdesc->index_size);
+      fdesc->index = NULL;
+      fdesc->index_len = 0;
+    }
 
   if (!fdesc->index)
     {
-      /* Find all FDE entries in debug_frame, and make into a sorted
-         index. First determine an index element count. */
-
-      size_t count = debug_frame_index_make (fdesc);
+      unw_word_t base = (uintptr_t) fdesc->debug_frame;
+      unw_word_t end = base + fdesc->debug_frame_size;
+      long count = fde_index_make (base, end, 0, 1, NULL, NULL);
 
-      if (!count)
+      if (count <= 0)
         {
           Debug (15, "no CIE/FDE found in .debug_frame\n");
           return found;
@@ -458,16 +575,14 @@ dwarf_find_debug_frame (int found, unw_dyn_info_t *di_debug, unw_word_t ip,
 
       /* Then fill and sort the index. */
 
-      debug_frame_index_make (fdesc);
-      debug_frame_index_sort (fdesc);
-
-    /*for (i = 0; i < count; i++)
-        {
-          const struct table_entry *e = &fdesc->index[i];
-
-          Debug (15, "ip %x, FDE offset %x\n",
-                 e->start_ip_offset, e->fde_offset);
-        }*/
+      count = fde_index_make (base, end, 0, 1, fdesc->index, NULL);
+      sort_table (fdesc->index, count);
+      fdesc->index_len = count;
+      if (count > 0 && fdesc->build_id_len)
+        dwarf_index_cache_store (fdesc->build_id, fdesc->build_id_len,
+                                 DWARF_INDEX_DEBUG_FRAME,
+                                 fdesc->debug_frame_size,
+                                 fdesc->index, count);
     }
 
   di->format = UNW_INFO_FORMAT_TABLE;
@@ -529,6 +644,117 @@ out:
   return eh_frame;
 }
 
+/* Return the build-id of the object INFO describes, from its notes in
+   memory, and set *LEN to its length, or return NULL.  */
+static const uint8_t *
+phdr_build_id (struct dl_phdr_info *info, size_t *len)
+{
+  const Elf_W (Phdr) *phdr = info->dlpi_phdr;
+  const uint8_t *notes, *id;
+  long n;
+
+  for (n = 0; n < info->dlpi_phnum; ++n, ++phdr)
+    if (phdr->p_type == PT_NOTE)
+      {
+        notes = (const uint8_t *) (uintptr_t) (info->dlpi_addr
+                                               + phdr->p_vaddr);
+        id = elf_w (find_build_id_note) (notes, notes + phdr->p_memsz, len);
+        if (id)
+          return id;
+      }
+  return NULL;
+}
+
+/* Return the binary-search table of the .eh_frame of the object INFO
+   describes, building it on first use.  EH_FRAME is the address of
+   the .eh_frame, or 0 to look it up in the object's section headers,
+   and END bounds it.  The tables are kept until unw_flush_cache(), so
+   that neither the file nor the FDEs have to be read again, and in the
+   on-disk index cache, if there is one.  */
+static struct dwarf_eh_frame_table *
+get_eh_frame_table (struct dl_phdr_info *info, unw_word_t eh_frame,
+                    unw_word_t end)
+{
+  unw_addr_space_t as = unw_local_addr_space;
+  struct dwarf_eh_frame_table *t, *head;
+  unw_word_t phdr = (unw_word_t) (uintptr_t) info->dlpi_phdr;
+  const uint8_t *build_id = NULL;
+  size_t build_id_len = 0;
+  long count;
+
+  head = atomic_load_explicit (&as->eh_frame_tables, memory_order_acquire);
+  for (t = head; t; t = t->next)
+    if (t->phdr == phdr)
+      return t;
+
+  GET_MEMORY (t, sizeof (*t));
+  if (!t)
+    return NULL;
+  t->phdr = phdr;
+  t->eh_frame = eh_frame ? eh_frame : dwarf_find_eh_frame_section (info);
+  t->index = NULL;
+  t->index_size = 0;
+  t->len = 0;
+
+  count = 0;
+  if (t->eh_frame)
+    {
+      build_id = phdr_build_id (info, &build_id_len);
+      if (build_id)
+        t->index = dwarf_index_cache_load (build_id, build_id_len,
+                                           DWARF_INDEX_EH_FRAME,
+                                           end - t->eh_frame,
+                                           &t->len, &t->index_size);
+      if (t->index && fde_index_check (t->eh_frame, end, t->eh_frame, 0,
+                                       t->index, t->len) < 0)
+        {
+          mi_munmap (t->index, t->index_size);
+          t->index = NULL;
+          t->len = 0;
+        }
+      if (!t->index)
+        count = fde_index_make (t->eh_frame, end, t->eh_frame, 0, NULL,
+                                NULL);
+    }
+  if (count > 0)
+    {
+      t->index_size = count * sizeof (struct table_entry);
+      GET_MEMORY (t->index, t->index_size);
+      if (t->index)
+        {
+          count = fde_index_make (t->eh_frame, end, t->eh_frame, 0,
+                                  t->index, NULL);
+          if (count > 0)
+            {
+              sort_table (t->index, count);
+              t->len = count;
+              Debug (4, "indexed .eh_frame of `%s', %ld FDEs\n",
+                     info->dlpi_name, count);
+              if (build_id)
+                dwarf_index_cache_store (build_id, build_id_len,
+                                         DWARF_INDEX_EH_FRAME,
+                                         end - t->eh_frame, t->index, count);
+            }
+          else
+            {
+              Debug (1, "cannot index .eh_frame of `%s'\n", info->dlpi_name);
+              mi_munmap (t->index, t->index_size);
+              t->index = NULL;
+            }
+        }
+    }
+
+  /* Another thread may have added the same object meanwhile; either
+     copy will do.  */
+  do
+    t->next = head;
+  while (!atomic_compare_exchange_weak_explicit (&as->eh_frame_tables,
+                                                 &head, t,
+                                                 memory_order_release,
+                                                 memory_order_acquire));
+  return t;
+}
+
 struct dwarf_callback_data
   {
     /* in: */
@@ -559,6 +785,7 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
   long n;
   int found = 0;
   struct dwarf_eh_frame_hdr synth_eh_frame_hdr;
+  struct dwarf_eh_frame_table *eh_table = NULL;
 #ifdef CONFIG_DEBUG_FRAME
   unw_word_t start, end;
 #endif /* CONFIG_DEBUG_FRAME*/
@@ -612,10 +839,9 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
     }
   else
     {
-      Elf_W (Addr) eh_frame;
       Debug (1, "no .eh_frame_hdr section found\n");
-      eh_frame = dwarf_find_eh_frame_section (info);
-      if (eh_frame)
+      eh_table = get_eh_frame_table (info, 0, max_load_addr);
+      if (eh_table && eh_table->eh_frame)
         {
           Debug (1, "using synthetic .eh_frame_hdr section for %s\n",
                  info->dlpi_name);
@@ -624,7 +850,7 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
 	    ((sizeof(Elf_W (Addr)) == 4) ? DW_EH_PE_udata4 : DW_EH_PE_udata8);
           synth_eh_frame_hdr.fde_count_enc = DW_EH_PE_omit;
           synth_eh_frame_hdr.table_enc = DW_EH_PE_omit;
-	  synth_eh_frame_hdr.eh_frame = eh_frame;
+	  synth_eh_frame_hdr.eh_frame = eh_table->eh_frame;
           hdr = &synth_eh_frame_hdr;
         }
     }
@@ -676,7 +902,29 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
         return ret;
 
       if (hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata4)
-          && hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata8))
+          && hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata8)
+          && hdr->eh_frame_ptr_enc != DW_EH_PE_omit
+          && (eh_table = get_eh_frame_table (info, eh_frame_start,
+                                             max_load_addr))
+          && eh_table->index)
+        {
+          /* Search the table built from the .eh_frame instead.  */
+          di->format = UNW_INFO_FORMAT_REMOTE_TABLE;
+          di->start_ip = p_text->p_vaddr + load_base;
+          di->end_ip = p_text->p_vaddr + load_base + p_text->p_memsz;
+          di->u.rti.name_ptr = (unw_word_t) (uintptr_t) info->dlpi_name;
+          di->u.rti.table_data = (unw_word_t) (uintptr_t) eh_table->index;
+          di->u.rti.table_len = (eh_table->len * sizeof (struct table_entry)
+                                 / sizeof (unw_word_t));
+          di->u.rti.segbase = eh_table->eh_frame;
+
+          found = 1;
+          Debug (15, "found .eh_frame table `%s': segbase=0x%lx, len=%lu\n",
+                 info->dlpi_name, (long) di->u.rti.segbase,
+                 (long) di->u.rti.table_len);
+        }
+      else if (hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata4)
+               && hdr->table_enc != (DW_EH_PE_datarel | DW_EH_PE_sdata8))
         {
           /* If there is no search table or it has an unsupported
              encoding, fall back on linear search.  */
@@ -701,8 +949,6 @@ dwarf_callback (struct dl_phdr_info *info, size_t size, void *ptr)
           Debug (1, "eh_frame_start = %lx eh_frame_end = %lx\n",
                  eh_frame_start, eh_frame_end);
 
-          /* XXX we know how to build a local binary search table for
-             .debug_frame, so we could do that here too.  */
           found = linear_search (unw_local_addr_space, ip,
                                  eh_frame_start, eh_frame_end, fde_count,
                                  pi, need_unwind_info, NULL);
@@ -783,16 +1029,17 @@ dwarf_find_proc_info (unw_addr_space_t as, unw_word_t ip,
   cb_data.di.format = -1;
   cb_data.di_debug.format = -1;
 
+  UNW_PROBE1 (fde_lookup_start, ip);
+  UNW_STATS_INC (phdr_walks);
   SIGPROCMASK (SIG_SETMASK, &unwi_full_mask, &saved_mask);
   ret = as->iterate_phdr_function (dwarf_callback, &cb_data);
   SIGPROCMASK (SIG_SETMASK, &saved_mask, NULL);
 
-  if (ret > 0)
+  if (ret > 0 && cb_data.single_fde)
+    /* already got the result in *pi */
+    ret = 0;
+  else if (ret > 0)
     {
-      if (cb_data.single_fde)
-	/* already got the result in *pi */
-	return 0;
-
       /* search the table: */
       if (cb_data.di.format != -1)
 	ret = dwarf_search_unwind_table_int (as, ip, &cb_data.di,
@@ -801,17 +1048,154 @@ dwarf_find_proc_info (unw_addr_space_t as, unw_word_t ip,
 	ret = -UNW_ENOINFO;
 
       if (ret == -UNW_ENOINFO && cb_data.di_debug.format != -1)
-	ret = dwarf_search_unwind_table_int (as, ip, &cb_data.di_debug, pi,
-					     need_unwind_info, arg);
+	{
+	  /* Keep the nearer of the next procedures the tables know.  */
+	  unw_word_t next = cb_data.di.format != -1 ? pi->end_ip : 0;
+
+	  ret = dwarf_search_unwind_table_int (as, ip, &cb_data.di_debug, pi,
+					       need_unwind_info, arg);
+	  if (ret == -UNW_ENOINFO && next > ip
+	      && (pi->end_ip <= ip || next < pi->end_ip))
+	    pi->end_ip = next;
+	}
     }
   else
     ret = -UNW_ENOINFO;
 
+  UNW_PROBE2 (fde_lookup_end, ip, ret);
   return ret;
 }
 
 #endif /* !UNW_REMOTE_ONLY */
 
+/* Copy the keys of the sdata4 TABLE of LEN entries into a new search
+   index.  LOCAL_TABLE is the table if it is in local memory, otherwise
+   it is read through the accessors, in one pass in table order.  */
+static struct dwarf_table_index *
+build_table_index (unw_addr_space_t as, unw_word_t table, size_t len,
+                   const struct table_entry *local_table, void *arg)
+{
+  unw_accessors_t *a = unw_get_accessors_int (as);
+  struct dwarf_table_index *ix;
+  size_t offsets[TABLE_INDEX_MAX_HEIGHT + 1], hdr_size, size, i;
+  unsigned int height;
+  int32_t *leaves, key, prev = INT32_MIN;
+  unw_word_t addr;
+
+  height = table_index_layout (len, offsets);
+  /* The nodes start on a cache line.  */
+  hdr_size = (sizeof (*ix) + 63) & ~(size_t) 63;
+  size = hdr_size + offsets[height] * TABLE_INDEX_B * sizeof (int32_t);
+  GET_MEMORY (ix, size);
+  if (!ix)
+    return NULL;
+  ix->size = size;
+  ix->len = len;
+  ix->height = height;
+  memcpy (ix->offsets, offsets, sizeof (offsets));
+  ix->keys = (int32_t *) ((char *) ix + hdr_size);
+
+  leaves = ix->keys + offsets[height - 1] * TABLE_INDEX_B;
+  for (i = 0; i < len; ++i)
+    {
+      if (local_table)
+        key = local_table[i].start_ip_offset;
+      else
+        {
+          addr = table + i * sizeof (struct table_entry);
+          if (dwarf_reads32 (as, a, &addr, &key, arg) < 0)
+            break;
+        }
+      /* lookup() relies on the table being sorted, so must we.  */
+      if (key < prev)
+        break;
+      leaves[i] = prev = key;
+    }
+  if (i < len)
+    {
+      Debug (1, "cannot index table at 0x%lx\n", (long) table);
+      mi_munmap (ix, size);
+      return NULL;
+    }
+  for (; i < (offsets[height] - offsets[height - 1]) * TABLE_INDEX_B; ++i)
+    leaves[i] = INT32_MAX;
+  table_index_fill (ix->keys, offsets, height);
+
+  Debug (4, "indexed table at 0x%lx, %lu entries\n", (long) table, (long) len);
+  return ix;
+}
+
+/* Return the search index of the sdata4 TABLE of LEN entries, or NULL
+   if it should be binary-searched.  The index is built once the
+   binary searches have read as many entries as that takes.  */
+static struct dwarf_table_index *
+get_table_index (unw_addr_space_t as, unw_word_t table, size_t len,
+                 const struct table_entry *local_table, void *arg)
+{
+  struct dwarf_table_index_slot *slot = NULL;
+  struct dwarf_table_index *ix;
+  unw_word_t h, t, searches, log_len;
+  unsigned int i;
+
+  if (len < DWARF_TABLE_INDEX_MIN_LEN || len > UINT32_MAX)
+    return NULL;
+
+  /* based on (sqrt(5)/2-1)*2^64 */
+  h = (table * (unw_word_t) 0x9e3779b97f4a7c16ULL)
+      >> (8 * sizeof (unw_word_t) - DWARF_LOG_TABLE_INDEXES);
+  for (i = 0; i < DWARF_TABLE_INDEXES; ++i)
+    {
+      slot = &as->table_indexes.slots[(h + i) % DWARF_TABLE_INDEXES];
+      t = atomic_load_explicit (&slot->table, memory_order_acquire);
+      if (t == 0)
+        atomic_compare_exchange_strong (&slot->table, &t, table);
+      if (t == 0 || t == table)
+        break;
+    }
+  if (i == DWARF_TABLE_INDEXES)
+    return NULL;
+
+  ix = atomic_load_explicit (&slot->index, memory_order_acquire);
+  if (ix)
+    return ix->len == len ? ix : NULL;
+
+  for (log_len = 0; (len >> log_len) > 1; ++log_len)
+    ;
+  searches = atomic_fetch_add (&slot->searches, 1) + 1;
+  /* Exactly one search reaches the threshold and builds the index.  */
+  if (searches != (len + log_len - 1) / log_len)
+    return NULL;
+
+  ix = build_table_index (as, table, len, local_table, arg);
+  if (ix)
+    atomic_store_explicit (&slot->index, ix, memory_order_release);
+  return ix;
+}
+
+#ifndef UNW_REMOTE_ONLY
+
+/* Like lookup(), through the search index of TABLE if it has one.  */
+static const struct table_entry *
+local_lookup (unw_addr_space_t as, const struct table_entry *table,
+              size_t table_size, int32_t rel_ip)
+{
+  size_t len = table_size / sizeof (struct table_entry), hi;
+  struct dwarf_table_index *ix;
+
+  ix = get_table_index (as, (uintptr_t) table, len, table, NULL);
+  if (ix)
+    {
+      hi = table_index_search (ix->keys, ix->offsets, ix->height, len, rel_ip);
+      if ((hi == 0 || table[hi - 1].start_ip_offset <= rel_ip)
+          && (hi == len || rel_ip < table[hi].start_ip_offset))
+        return hi ? table + hi - 1 : NULL;
+      Debug (1, "stale index of table at %p\n", table);
+    }
+  return lookup (table, table_size, rel_ip);
+}
+
+#endif /* !UNW_REMOTE_ONLY */
+
 #ifndef UNW_LOCAL_ONLY
 
 /* Helper to read a table entry field, widening 32-bit entries to 64-bit. */
@@ -842,11 +1226,46 @@ remote_lookup (unw_addr_space_t as,
                                : sizeof (struct table_entry);
   size_t table_len = table_size / entry_size;
   unw_accessors_t *a = unw_get_accessors_int (as);
+  struct dwarf_table_index *ix = NULL;
   size_t lo, hi, mid;
   unw_word_t e_addr = 0;
   int64_t start = 0;
   int ret;
 
+  if (!is_64bit)
+    ix = get_table_index (as, table, table_len, NULL, arg);
+  if (ix)
+    {
+      int64_t next = 0;
+
+      /* Only the entries around the result are read, to check it.  */
+      hi = table_index_search (ix->keys, ix->offsets, ix->height,
+                               table_len, rel_ip);
+      if (hi < table_len)
+        {
+          e_addr = table + hi * entry_size;
+          if ((ret = remote_read_entry (as, a, &e_addr, &next, 0, arg)) < 0)
+            return ret;
+        }
+      if (hi > 0)
+        {
+          e_addr = table + (hi - 1) * entry_size;
+          if ((ret = remote_read_entry (as, a, &e_addr, start_ip_offset,
+                                        0, arg)) < 0
+              || (ret = remote_read_entry (as, a, &e_addr, fde_offset,
+                                           0, arg)) < 0)
+            return ret;
+        }
+      if ((hi == 0 || *start_ip_offset <= rel_ip)
+          && (hi == table_len || rel_ip < next))
+        {
+          if (hi < table_len)
+            *last_ip_offset = next;
+          return hi > 0;
+        }
+      Debug (1, "stale index of table at 0x%lx\n", (long) table);
+    }
+
   /* do a binary search for right entry: */
   for (lo = 0, hi = table_len; lo < hi;)
     {
@@ -861,7 +1280,14 @@ remote_lookup (unw_addr_space_t as,
         lo = mid + 1;
     }
   if (hi <= 0)
-    return 0;
+    {
+      e_addr = table;
+      if (table_len > 0
+          && (ret = remote_read_entry (as, a, &e_addr, last_ip_offset,
+                                       is_64bit, arg)) < 0)
+        return ret;
+      return 0;
+    }
   e_addr = table + (hi - 1) * entry_size;
   if ((ret = remote_read_entry (as, a, &e_addr, start_ip_offset, is_64bit, arg)) < 0
    || (ret = remote_read_entry (as, a, &e_addr, fde_offset, is_64bit, arg)) < 0
@@ -921,7 +1347,7 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
          endianness is the target one.  */
       as = unw_local_addr_space;
       table_data = fdesc->index;
-      table_len = fdesc->index_size;
+      table_len = fdesc->index_len * sizeof (*fdesc->index);
       debug_frame_base = (uintptr_t) fdesc->debug_frame;
 #endif
     }
@@ -934,6 +1360,7 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
   } else {
     ip_base = segbase;
   }
+  last_ip = di->end_ip;
 
 #ifndef UNW_REMOTE_ONLY
   if (as == unw_local_addr_space)
@@ -950,15 +1377,15 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
               found_fde_offset = (unw_word_t) e64->fde_offset;
               if (&e64[1] < &table64[table_len / sizeof (struct table_entry64)])
                 last_ip = (unw_word_t) e64[1].start_ip_offset + ip_base;
-              else
-                last_ip = di->end_ip;
             }
+          else if (table_len >= sizeof (struct table_entry64))
+            last_ip = (unw_word_t) table64[0].start_ip_offset + ip_base;
         }
       else
         {
           const struct table_entry *table = (const struct table_entry *) table_data;
           const struct table_entry *e;
-          e = lookup (table, table_len, ip - ip_base);
+          e = local_lookup (as, table, table_len, ip - ip_base);
           if (e)
             {
               found_entry = 1;
@@ -966,9 +1393,9 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
               found_fde_offset = (unw_word_t) e->fde_offset;
               if (&e[1] < &table[table_len / sizeof (struct table_entry)])
                 last_ip = e[1].start_ip_offset + ip_base;
-              else
-                last_ip = di->end_ip;
             }
+          else if (table_len >= sizeof (struct table_entry))
+            last_ip = table[0].start_ip_offset + ip_base;
         }
     }
   else
@@ -987,8 +1414,8 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
           found_entry = 1;
           found_start_ip_offset = (unw_word_t) found_start;
           found_fde_offset = (unw_word_t) found_fde;
-          last_ip = (unw_word_t) last_ip_offset64 + ip_base;
         }
+      last_ip = (unw_word_t) last_ip_offset64 + ip_base;
 #endif
     }
   if (!found_entry)
@@ -996,7 +1423,9 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
       Debug (1, "IP %lx inside range %lx-%lx, but no explicit unwind info found\n",
              (long) ip, (long) di->start_ip, (long) di->end_ip);
       /* IP is inside this table's range, but there is no explicit
-         unwind info.  */
+         unwind info.  Say where the next procedure may start, so that
+         unw_prefetch_unwind_info() can skip the gap.  */
+      pi->end_ip = last_ip;
       return -UNW_ENOINFO;
     }
   Debug (15, "ip=0x%lx, start_ip=0x%lx\n",
@@ -1026,11 +1455,13 @@ dwarf_search_unwind_table (unw_addr_space_t as, unw_word_t ip,
 
 #if defined(NEED_LAST_IP)
   pi->last_ip = last_ip;
-#else
-  (void)last_ip;
 #endif
   if (ip < pi->start_ip || ip >= pi->end_ip)
-    return -UNW_ENOINFO;
+    {
+      /* In the gap after a procedure, as above.  */
+      pi->end_ip = last_ip;
+      return -UNW_ENOINFO;
+    }
 
   return 0;
 }
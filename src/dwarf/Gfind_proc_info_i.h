@@ -68,4 +68,112 @@ lookup64 (const struct table_entry64 *table, size_t table_size, int64_t rel_ip)
   return e;
 }
 
+/* Sort the LEN entries of TABLE by start address, for lookup().  */
+static inline void
+sort_table (struct table_entry *table, size_t len)
+{
+  size_t i, j, k;
+  struct table_entry t;
+
+  /* Use a simple Shell sort as it relatively fast and
+   * does not require additional memory. */
+
+  for (k = len / 2; k > 0; k /= 2)
+    {
+      for (i = k; i < len; i++)
+        {
+          t = table[i];
+
+          for (j = i; j >= k; j -= k)
+            {
+              if (t.start_ip_offset >= table[j - k].start_ip_offset)
+                break;
+
+              table[j] = table[j - k];
+            }
+
+          table[j] = t;
+        }
+    }
+}
+
+/* The keys of a large sdata4 table can be copied into a static B+-tree
+   with nodes of TABLE_INDEX_B keys, one cache line.  The bottom layer
+   holds the keys in table order, padded with INT32_MAX, and each key
+   of an upper-layer node is the last key of the corresponding child.
+   The layers are stored from the root down, starting at node
+   OFFSETS[H] of KEYS, so that the few upper ones stay in cache.  A
+   search takes one cache miss per layer, about log16(N) of them
+   instead of log2(N), and the keys of a node can be compared all at
+   once by the vector unit.  */
+#define TABLE_INDEX_B           16
+#define TABLE_INDEX_MAX_HEIGHT  9       /* enough for 2^32 keys */
+
+/* Set OFFSETS[0..HEIGHT] for LEN keys and return HEIGHT.  OFFSETS[HEIGHT]
+   is the total number of nodes.  */
+static inline unsigned int
+table_index_layout (size_t len, size_t *offsets)
+{
+  size_t nodes[TABLE_INDEX_MAX_HEIGHT];
+  unsigned int height = 0, h;
+
+  do
+    {
+      len = (len + TABLE_INDEX_B - 1) / TABLE_INDEX_B;
+      nodes[height++] = len ? len : 1;
+    }
+  while (len > 1 && height < TABLE_INDEX_MAX_HEIGHT);
+
+  offsets[0] = 0;
+  for (h = 0; h < height; ++h)
+    offsets[h + 1] = offsets[h] + nodes[height - 1 - h];
+  return height;
+}
+
+/* Fill the upper layers of the index from its bottom layer.  */
+static inline void
+table_index_fill (int32_t *keys, const size_t *offsets, unsigned int height)
+{
+  const int32_t *child;
+  size_t j, children;
+  unsigned int h, i;
+
+  for (h = height - 1; h-- > 0; )
+    {
+      children = offsets[h + 2] - offsets[h + 1];
+      for (j = 0; j < offsets[h + 1] - offsets[h]; ++j)
+        for (i = 0; i < TABLE_INDEX_B; ++i)
+          {
+            child = keys + (offsets[h + 1] + j * TABLE_INDEX_B + i)
+                           * TABLE_INDEX_B;
+            keys[(offsets[h] + j) * TABLE_INDEX_B + i] =
+              j * TABLE_INDEX_B + i < children
+              ? child[TABLE_INDEX_B - 1] : INT32_MAX;
+          }
+    }
+}
+
+/* Return the number of keys not greater than REL_IP, which is one more
+   than the position of the entry lookup() would return.  */
+static inline size_t
+table_index_search (const int32_t *keys, const size_t *offsets,
+                    unsigned int height, size_t len, int32_t rel_ip)
+{
+  const int32_t *node;
+  unsigned int h, i, c;
+  size_t j = 0;
+
+  for (h = 0; h < height; ++h)
+    {
+      node = keys + (offsets[h] + j) * TABLE_INDEX_B;
+      for (c = 0, i = 0; i < TABLE_INDEX_B; ++i)
+        c += node[i] <= rel_ip;
+      /* Then REL_IP is INT32_MAX, or not less than any key.  */
+      if (c == TABLE_INDEX_B && h + 1 < height)
+        return len;
+      j = j * TABLE_INDEX_B + c;
+    }
+  return j < len ? j : len;
+}
+
 #endif /* dwarf_find_proc_info_i_h */
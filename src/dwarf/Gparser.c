@@ -27,12 +27,13 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include "libunwind_i.h"
 #include <stddef.h>
 #include <limits.h>
+#include <time.h>
 
 #define alloc_reg_state()       (mempool_alloc (&dwarf_reg_state_pool))
 #define free_reg_state(rs)      (mempool_free (&dwarf_reg_state_pool, rs))
 
-#define DWARF_UNW_CACHE_SIZE(log_size)   (1 << log_size)
-#define DWARF_UNW_HASH_SIZE(log_size)    (1 << (log_size + 1))
+#define DWARF_UNW_CACHE_SIZE(log_size)   ((uint32_t) 1 << (log_size))
+#define DWARF_UNW_HASH_SIZE(log_size)    ((uint32_t) 1 << ((log_size) + 1))
 
 static inline int
 read_regnum (unw_addr_space_t as, unw_accessors_t *a, unw_word_t *addr,
@@ -94,337 +95,439 @@ aarch64_negate_ra_sign_state(dwarf_state_record_t *sr);
 
 #endif
 
-/* Run a CFI program to update the register state.  */
-static int
-run_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
-                 unw_word_t *ip, unw_word_t end_ip,
-		 unw_word_t *addr, unw_word_t end_addr,
-		 dwarf_stackable_reg_state_t **rs_stack,
-                 struct dwarf_cie_info *dci)
+/* Address space and argument to read the CFI program of the current
+   procedure with.  */
+static inline unw_addr_space_t
+cfi_addr_space (struct dwarf_cursor *c, void **argp)
 {
-  unw_addr_space_t as;
-  void *arg;
-
   if (c->pi.flags & UNW_PI_FLAG_DEBUG_FRAME)
     {
       /* .debug_frame CFI is stored in local address space.  */
-      as = unw_local_addr_space;
-      arg = NULL;
+      *argp = NULL;
+      return unw_local_addr_space;
     }
-  else
+  *argp = c->as_arg;
+  return c->as;
+}
+
+/* A call-frame instruction in the generic form of dwarf_cfi_op_t, but
+   with full-width operands.  */
+struct cfi_insn
+  {
+    unw_word_t operand;
+    unw_word_t reg;
+    uint8_t op;
+  };
+
+/* Decode the call-frame instruction at *ADDR into INSN.  Advances
+   move *IP and are returned as DW_CFA_advance_loc.  */
+static int
+read_cfi_op (struct dwarf_cursor *c, unw_addr_space_t as, unw_accessors_t *a,
+             unw_word_t *addr, unw_word_t *ip, struct dwarf_cie_info *dci,
+             struct cfi_insn *insn, void *arg)
+{
+  unw_word_t operand = 0, regnum = 0, val = 0, len;
+  uint8_t u8, op;
+  uint16_t u16;
+  uint32_t u32;
+  int ret;
+
+  if ((ret = dwarf_readu8 (as, a, addr, &op, arg)) < 0)
+    return ret;
+
+  if (op & DWARF_CFA_OPCODE_MASK)
     {
-      as = c->as;
-      arg = c->as_arg;
+      operand = op & DWARF_CFA_OPERAND_MASK;
+      op &= ~DWARF_CFA_OPERAND_MASK;
     }
-  unw_accessors_t *a = unw_get_accessors_int (as);
-  int ret = 0;
-
-  while (*ip <= end_ip && *addr < end_addr && ret >= 0)
+  insn->op = op;
+  switch ((dwarf_cfa_t) op)
     {
-      unw_word_t operand = 0, regnum, val, len;
-      uint8_t u8, op;
-      uint16_t u16;
-      uint32_t u32;
+    case DW_CFA_advance_loc:
+      *ip += operand * dci->code_align;
+      Debug (15, "CFA_advance_loc to 0x%lx\n", (long) *ip);
+      break;
 
-      if ((ret = dwarf_readu8 (as, a, addr, &op, arg)) < 0)
+    case DW_CFA_advance_loc1:
+      if ((ret = dwarf_readu8 (as, a, addr, &u8, arg)) < 0)
         break;
+      *ip += u8 * dci->code_align;
+      insn->op = DW_CFA_advance_loc;
+      Debug (15, "CFA_advance_loc1 to 0x%lx\n", (long) *ip);
+      break;
 
-      if (op & DWARF_CFA_OPCODE_MASK)
-        {
-          operand = op & DWARF_CFA_OPERAND_MASK;
-          op &= ~DWARF_CFA_OPERAND_MASK;
-        }
-      switch ((dwarf_cfa_t) op)
-        {
-        case DW_CFA_advance_loc:
-          *ip += operand * dci->code_align;
-          Debug (15, "CFA_advance_loc to 0x%lx\n", (long) *ip);
-          break;
+    case DW_CFA_advance_loc2:
+      if ((ret = dwarf_readu16 (as, a, addr, &u16, arg)) < 0)
+        break;
+      *ip += u16 * dci->code_align;
+      insn->op = DW_CFA_advance_loc;
+      Debug (15, "CFA_advance_loc2 to 0x%lx\n", (long) *ip);
+      break;
 
-        case DW_CFA_advance_loc1:
-          if ((ret = dwarf_readu8 (as, a, addr, &u8, arg)) < 0)
-            break;
-          *ip += u8 * dci->code_align;
-          Debug (15, "CFA_advance_loc1 to 0x%lx\n", (long) *ip);
-          break;
+    case DW_CFA_advance_loc4:
+      if ((ret = dwarf_readu32 (as, a, addr, &u32, arg)) < 0)
+        break;
+      *ip += u32 * dci->code_align;
+      insn->op = DW_CFA_advance_loc;
+      Debug (15, "CFA_advance_loc4 to 0x%lx\n", (long) *ip);
+      break;
 
-        case DW_CFA_advance_loc2:
-          if ((ret = dwarf_readu16 (as, a, addr, &u16, arg)) < 0)
-            break;
-          *ip += u16 * dci->code_align;
-          Debug (15, "CFA_advance_loc2 to 0x%lx\n", (long) *ip);
+    case DW_CFA_MIPS_advance_loc8:
+#ifdef UNW_TARGET_MIPS
+      {
+        uint64_t u64 = 0;
+
+        if ((ret = dwarf_readu64 (as, a, addr, &u64, arg)) < 0)
           break;
+        *ip += u64 * dci->code_align;
+        insn->op = DW_CFA_advance_loc;
+        Debug (15, "CFA_MIPS_advance_loc8\n");
+        break;
+      }
+#else
+      Debug (1, "DW_CFA_MIPS_advance_loc8 on non-MIPS target\n");
+      ret = -UNW_EINVAL;
+      break;
+#endif
 
-        case DW_CFA_advance_loc4:
-          if ((ret = dwarf_readu32 (as, a, addr, &u32, arg)) < 0)
-            break;
-          *ip += u32 * dci->code_align;
-          Debug (15, "CFA_advance_loc4 to 0x%lx\n", (long) *ip);
+    case DW_CFA_offset:
+      regnum = operand;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
+        {
+          Debug (1, "Invalid register number %u in DW_cfa_OFFSET\n",
+                 (unsigned int) regnum);
+          ret = -UNW_EBADREG;
           break;
+        }
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
+        break;
+      val *= dci->data_align;
+      Debug (15, "CFA_offset r%lu at cfa+0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_MIPS_advance_loc8:
-#ifdef UNW_TARGET_MIPS
-          {
-            uint64_t u64 = 0;
+    case DW_CFA_offset_extended:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      val *= dci->data_align;
+      insn->op = DW_CFA_offset;
+      Debug (15, "CFA_offset_extended r%lu at cf+0x%lx\n",
+             (long) regnum, (long) val);
+      break;
 
-            if ((ret = dwarf_readu64 (as, a, addr, &u64, arg)) < 0)
-              break;
-            *ip += u64 * dci->code_align;
-            Debug (15, "CFA_MIPS_advance_loc8\n");
-            break;
-          }
-#else
-          Debug (1, "DW_CFA_MIPS_advance_loc8 on non-MIPS target\n");
+    case DW_CFA_offset_extended_sf:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      val *= dci->data_align;
+      insn->op = DW_CFA_offset;
+      Debug (15, "CFA_offset_extended_sf r%lu at cf+0x%lx\n",
+             (long) regnum, (long) val);
+      break;
+
+    case DW_CFA_restore:
+      regnum = operand;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
+        {
+          Debug (1, "Invalid register number %u in DW_CFA_restore\n",
+                 (unsigned int) regnum);
           ret = -UNW_EINVAL;
           break;
-#endif
+        }
+      Debug (15, "CFA_restore r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_offset:
-          regnum = operand;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in DW_cfa_OFFSET\n",
-                     (unsigned int) regnum);
-              ret = -UNW_EBADREG;
-              break;
-            }
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset r%lu at cfa+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
+    case DW_CFA_restore_extended:
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &regnum, arg)) < 0)
+        break;
+      if (regnum >= DWARF_NUM_PRESERVED_REGS)
+        {
+          Debug (1, "Invalid register number %u in "
+                 "DW_CFA_restore_extended\n", (unsigned int) regnum);
+          ret = -UNW_EINVAL;
           break;
+        }
+      insn->op = DW_CFA_restore;
+      Debug (15, "CFA_restore_extended r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_offset_extended:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset_extended r%lu at cf+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+    case DW_CFA_nop:
+      break;
 
-        case DW_CFA_offset_extended_sf:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, val * dci->data_align);
-          Debug (15, "CFA_offset_extended_sf r%lu at cf+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+    case DW_CFA_set_loc:
+      if ((ret = dwarf_read_encoded_pointer (as, a, addr, dci->fde_encoding,
+                                             &c->pi, ip,
+                                             arg)) < 0)
+        break;
+      insn->op = DW_CFA_advance_loc;
+      Debug (15, "CFA_set_loc to 0x%lx\n", (long) *ip);
+      break;
 
-        case DW_CFA_restore:
-          regnum = operand;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in DW_CFA_restore\n",
-                     (unsigned int) regnum);
-              ret = -UNW_EINVAL;
-              break;
-            }
-          sr->rs_current.reg.where[regnum] = sr->rs_initial.reg.where[regnum];
-          sr->rs_current.reg.val[regnum] = sr->rs_initial.reg.val[regnum];
-          Debug (15, "CFA_restore r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_undefined:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        break;
+      Debug (15, "CFA_undefined r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_restore_extended:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &regnum, arg)) < 0)
-            break;
-          if (regnum >= DWARF_NUM_PRESERVED_REGS)
-            {
-              Debug (1, "Invalid register number %u in "
-                     "DW_CFA_restore_extended\n", (unsigned int) regnum);
-              ret = -UNW_EINVAL;
-              break;
-            }
-          sr->rs_current.reg.where[regnum] = sr->rs_initial.reg.where[regnum];
-          sr->rs_current.reg.val[regnum] = sr->rs_initial.reg.val[regnum];
-          Debug (15, "CFA_restore_extended r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_same_value:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        break;
+      Debug (15, "CFA_same_value r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_nop:
-          break;
+    case DW_CFA_register:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      Debug (15, "CFA_register r%lu to r%lu\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_set_loc:
-          if ((ret = dwarf_read_encoded_pointer (as, a, addr, dci->fde_encoding,
-                                                 &c->pi, ip,
-                                                 arg)) < 0)
-            break;
-          Debug (15, "CFA_set_loc to 0x%lx\n", (long) *ip);
-          break;
+    case DW_CFA_remember_state:
+      Debug (15, "CFA_remember_state\n");
+      break;
 
-        case DW_CFA_undefined:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_UNDEF, 0);
-          Debug (15, "CFA_undefined r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_restore_state:
+      Debug (15, "CFA_restore_state\n");
+      break;
 
-        case DW_CFA_same_value:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_SAME, 0);
-          Debug (15, "CFA_same_value r%lu\n", (long) regnum);
-          break;
+    case DW_CFA_def_cfa:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      /* NOT factored! */
+      Debug (15, "CFA_def_cfa r%lu+0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_register:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_REG, val);
-          Debug (15, "CFA_register r%lu to r%lu\n", (long) regnum, (long) val);
-          break;
+    case DW_CFA_def_cfa_sf:
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      val *= dci->data_align;                   /* factored! */
+      insn->op = DW_CFA_def_cfa;
+      Debug (15, "CFA_def_cfa_sf r%lu+0x%lx\n", (long) regnum, (long) val);
+      break;
 
-        case DW_CFA_remember_state:
-	  if (push_rstate_stack(rs_stack) < 0)
-	    {
-              Debug (1, "Out of memory in DW_CFA_remember_state\n");
-              ret = -UNW_ENOMEM;
-              break;
-	    }
-          (*rs_stack)->state = sr->rs_current;
-          Debug (15, "CFA_remember_state\n");
-          break;
+    case DW_CFA_def_cfa_register:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        break;
+      Debug (15, "CFA_def_cfa_register r%lu\n", (long) regnum);
+      break;
 
-        case DW_CFA_restore_state:
-          if (!*rs_stack)
-            {
-              Debug (1, "register-state stack underflow\n");
-              ret = -UNW_EINVAL;
-              break;
-            }
-          sr->rs_current = (*rs_stack)->state;
-          pop_rstate_stack(rs_stack);
-          Debug (15, "CFA_restore_state\n");
-          break;
+    case DW_CFA_def_cfa_offset:
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
+        break;
+      /* NOT factored! */
+      Debug (15, "CFA_def_cfa_offset 0x%lx\n", (long) val);
+      break;
 
-        case DW_CFA_def_cfa:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);   /* NOT factored! */
-          Debug (15, "CFA_def_cfa r%lu+0x%lx\n", (long) regnum, (long) val);
-          break;
+    case DW_CFA_def_cfa_offset_sf:
+      if ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0)
+        break;
+      val *= dci->data_align;                   /* factored! */
+      insn->op = DW_CFA_def_cfa_offset;
+      Debug (15, "CFA_def_cfa_offset_sf 0x%lx\n", (long) val);
+      break;
 
-        case DW_CFA_def_cfa_sf:
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0,
-                   val * dci->data_align);              /* factored! */
-          Debug (15, "CFA_def_cfa_sf r%lu+0x%lx\n",
-                 (long) regnum, (long) (val * dci->data_align));
-          break;
+    case DW_CFA_def_cfa_expression:
+      /* Save the address of the DW_FORM_block for later evaluation. */
+      val = *addr;
 
-        case DW_CFA_def_cfa_register:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            break;
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
-          Debug (15, "CFA_def_cfa_register r%lu\n", (long) regnum);
-          break;
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
+        break;
 
-        case DW_CFA_def_cfa_offset:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            break;
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, val);   /* NOT factored! */
-          Debug (15, "CFA_def_cfa_offset 0x%lx\n", (long) val);
-          break;
+      Debug (15, "CFA_def_cfa_expr @ 0x%lx [%lu bytes]\n",
+             (long) *addr, (long) len);
+      *addr += len;
+      break;
 
-        case DW_CFA_def_cfa_offset_sf:
-          if ((ret = dwarf_read_sleb128 (as, a, addr, &val, arg)) < 0)
-            break;
-          set_reg (sr, DWARF_CFA_OFF_COLUMN, 0,
-                   val * dci->data_align);      /* factored! */
-          Debug (15, "CFA_def_cfa_offset_sf 0x%lx\n",
-                 (long) (val * dci->data_align));
-          break;
+    case DW_CFA_expression:
+    case DW_CFA_val_expression:
+      if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+        break;
 
-        case DW_CFA_def_cfa_expression:
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_EXPR, *addr);
+      /* Save the address of the DW_FORM_block for later evaluation. */
+      val = *addr;
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            break;
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
+        break;
 
-          Debug (15, "CFA_def_cfa_expr @ 0x%lx [%lu bytes]\n",
-                 (long) *addr, (long) len);
-          *addr += len;
-          break;
+      Debug (15, "CFA_%sexpression r%lu @ 0x%lx [%lu bytes]\n",
+             op == DW_CFA_val_expression ? "val_" : "",
+             (long) regnum, (long) val, (long) len);
+      *addr += len;
+      break;
 
-        case DW_CFA_expression:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            break;
+    case DW_CFA_GNU_args_size:
+      if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
+        break;
+      Debug (15, "CFA_GNU_args_size %lu\n", (long) val);
+      break;
 
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, regnum, DWARF_WHERE_EXPR, *addr);
+    case DW_CFA_GNU_negative_offset_extended:
+      /* A comment in GCC says that this is obsoleted by
+         DW_CFA_offset_extended_sf, but that it's used by older
+         PowerPC code.  */
+      if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
+          || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
+        break;
+      val = ~(val * dci->data_align) + 1;
+      insn->op = DW_CFA_offset;
+      Debug (15, "CFA_GNU_negative_offset_extended cfa+0x%lx\n", (long) val);
+      break;
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            break;
+    case DW_CFA_GNU_window_save:
+#if defined(UNW_TARGET_SPARC) || defined(UNW_TARGET_AARCH64)
+      /* SPARC: save all 16 windowed registers; aarch64:
+         DW_CFA_AARCH64_negate_ra_state.  */
+      Debug (15, "CFA_GNU_window_save\n");
+      break;
+#else
+      /* FALL THROUGH */
+#endif
+    case DW_CFA_lo_user:
+    case DW_CFA_hi_user:
+      Debug (1, "Unexpected CFA opcode 0x%x\n", op);
+      ret = -UNW_EINVAL;
+      break;
 
-          Debug (15, "CFA_expression r%lu @ 0x%lx [%lu bytes]\n",
-                 (long) regnum, (long) addr, (long) len);
-          *addr += len;
-          break;
+    default:
+      /* other opcodes are ignored */
+      insn->op = DW_CFA_nop;
+      break;
+    }
 
-        case DW_CFA_val_expression:
-          if ((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-            break;
+  insn->reg = regnum;
+  insn->operand = val;
+  return ret;
+}
 
-          /* Save the address of the DW_FORM_block for later evaluation. */
-          set_reg (sr, regnum, DWARF_WHERE_VAL_EXPR, *addr);
+/* Apply the decoded instruction INSN to the register state.  */
+static int
+apply_cfi_op (dwarf_state_record_t *sr, const struct cfi_insn *insn,
+              dwarf_stackable_reg_state_t **rs_stack)
+{
+  unw_word_t regnum = insn->reg;
 
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &len, arg)) < 0)
-            break;
+  if (regnum >= DWARF_NUM_PRESERVED_REGS)
+    return -UNW_EBADREG;
 
-          Debug (15, "CFA_val_expression r%lu @ 0x%lx [%lu bytes]\n",
-                 (long) regnum, (long) addr, (long) len);
-          *addr += len;
-          break;
+  switch ((dwarf_cfa_t) insn->op)
+    {
+    case DW_CFA_advance_loc:
+    case DW_CFA_nop:
+      break;
 
-        case DW_CFA_GNU_args_size:
-          if ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0)
-            break;
-          sr->args_size = val;
-          Debug (15, "CFA_GNU_args_size %lu\n", (long) val);
-          break;
+    case DW_CFA_offset:
+      set_reg (sr, regnum, DWARF_WHERE_CFAREL, insn->operand);
+      break;
 
-        case DW_CFA_GNU_negative_offset_extended:
-          /* A comment in GCC says that this is obsoleted by
-             DW_CFA_offset_extended_sf, but that it's used by older
-             PowerPC code.  */
-          if (((ret = read_regnum (as, a, addr, &regnum, arg)) < 0)
-              || ((ret = dwarf_read_uleb128 (as, a, addr, &val, arg)) < 0))
-            break;
-          set_reg (sr, regnum, DWARF_WHERE_CFAREL, ~(val * dci->data_align) + 1);
-          Debug (15, "CFA_GNU_negative_offset_extended cfa+0x%lx\n",
-                 (long) (~(val * dci->data_align) + 1));
-          break;
+    case DW_CFA_restore:
+      sr->rs_current.reg.where[regnum] = sr->rs_initial.reg.where[regnum];
+      sr->rs_current.reg.val[regnum] = sr->rs_initial.reg.val[regnum];
+      break;
+
+    case DW_CFA_undefined:
+      set_reg (sr, regnum, DWARF_WHERE_UNDEF, 0);
+      break;
+
+    case DW_CFA_same_value:
+      set_reg (sr, regnum, DWARF_WHERE_SAME, 0);
+      break;
+
+    case DW_CFA_register:
+      set_reg (sr, regnum, DWARF_WHERE_REG, insn->operand);
+      break;
+
+    case DW_CFA_remember_state:
+      if (push_rstate_stack(rs_stack) < 0)
+        {
+          Debug (1, "Out of memory in DW_CFA_remember_state\n");
+          return -UNW_ENOMEM;
+        }
+      (*rs_stack)->state = sr->rs_current;
+      break;
+
+    case DW_CFA_restore_state:
+      if (!*rs_stack)
+        {
+          Debug (1, "register-state stack underflow\n");
+          return -UNW_EINVAL;
+        }
+      sr->rs_current = (*rs_stack)->state;
+      pop_rstate_stack(rs_stack);
+      break;
+
+    case DW_CFA_def_cfa:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
+      set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, insn->operand);
+      break;
+
+    case DW_CFA_def_cfa_register:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_REG, regnum);
+      break;
+
+    case DW_CFA_def_cfa_offset:
+      set_reg (sr, DWARF_CFA_OFF_COLUMN, 0, insn->operand);
+      break;
+
+    case DW_CFA_def_cfa_expression:
+      set_reg (sr, DWARF_CFA_REG_COLUMN, DWARF_WHERE_EXPR, insn->operand);
+      break;
+
+    case DW_CFA_expression:
+      set_reg (sr, regnum, DWARF_WHERE_EXPR, insn->operand);
+      break;
+
+    case DW_CFA_val_expression:
+      set_reg (sr, regnum, DWARF_WHERE_VAL_EXPR, insn->operand);
+      break;
+
+    case DW_CFA_GNU_args_size:
+      sr->args_size = insn->operand;
+      break;
 
-        case DW_CFA_GNU_window_save:
 #ifdef UNW_TARGET_SPARC
-          /* This is a special CFA to handle all 16 windowed registers
-             on SPARC.  */
-          for (regnum = 16; regnum < 32; ++regnum)
-            set_reg (sr, regnum, DWARF_WHERE_CFAREL,
-                     (regnum - 16) * sizeof (unw_word_t));
-          Debug (15, "CFA_GNU_window_save\n");
-          break;
+    case DW_CFA_GNU_window_save:
+      /* This is a special CFA to handle all 16 windowed registers
+         on SPARC.  */
+      for (regnum = 16; regnum < 32; ++regnum)
+        set_reg (sr, regnum, DWARF_WHERE_CFAREL,
+                 (regnum - 16) * sizeof (unw_word_t));
+      break;
 #elif UNW_TARGET_AARCH64
-          /* This is a specific opcode on aarch64, DW_CFA_AARCH64_negate_ra_state */
-          Debug (15, "DW_CFA_AARCH64_negate_ra_state\n");
-          aarch64_negate_ra_sign_state(sr);
-          break;
-#else
-          /* FALL THROUGH */
+    case DW_CFA_GNU_window_save:
+      /* This is a specific opcode on aarch64, DW_CFA_AARCH64_negate_ra_state */
+      aarch64_negate_ra_sign_state(sr);
+      break;
 #endif
-        case DW_CFA_lo_user:
-        case DW_CFA_hi_user:
-          Debug (1, "Unexpected CFA opcode 0x%x\n", op);
-          ret = -UNW_EINVAL;
-          break;
-        }
+
+    default:
+      /* Only a torn read of a cached program gets here.  */
+      return -UNW_EINVAL;
+    }
+  return 0;
+}
+
+/* Run a CFI program to update the register state.  */
+static int
+run_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
+                 unw_word_t *ip, unw_word_t end_ip,
+		 unw_word_t *addr, unw_word_t end_addr,
+		 dwarf_stackable_reg_state_t **rs_stack,
+                 struct dwarf_cie_info *dci)
+{
+  void *arg;
+  unw_addr_space_t as = cfi_addr_space (c, &arg);
+  unw_accessors_t *a = unw_get_accessors_int (as);
+  struct cfi_insn insn;
+  int ret = 0;
+
+  while (*ip <= end_ip && *addr < end_addr && ret >= 0)
+    {
+      if ((ret = read_cfi_op (c, as, a, addr, ip, dci, &insn, arg)) < 0)
+        break;
+      UNW_STATS_INC (cfi_instructions);
+      ret = apply_cfi_op (sr, &insn, rs_stack);
     }
 
   if (ret > 0)
@@ -432,6 +535,212 @@ run_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
   return ret;
 }
 
+static inline struct dwarf_cfi_cache_entry *
+cfi_cache_entry (unw_addr_space_t as, unw_word_t instr_start)
+{
+  /* based on (sqrt(5)/2-1)*2^64 */
+  unw_word_t h = instr_start * (unw_word_t) 0x9e3779b97f4a7c16ULL;
+
+  return &as->cfi_cache.entries[h >> (8 * sizeof (unw_word_t)
+                                      - DWARF_LOG_CFI_CACHE_SIZE)];
+}
+
+static inline int
+cfi_op_is_expression (uint8_t op)
+{
+  return (op == DW_CFA_def_cfa_expression || op == DW_CFA_expression
+          || op == DW_CFA_val_expression);
+}
+
+/* Store INSN of the program at INSTR_START in its compact form OP, if
+   it fits.  */
+static inline int
+pack_cfi_op (dwarf_cfi_op_t *op, const struct cfi_insn *insn,
+             unw_word_t instr_start)
+{
+  unw_word_t operand = insn->operand;
+
+  if (cfi_op_is_expression (insn->op))
+    {
+      /* The expression is part of the program.  */
+      operand -= instr_start;
+      if (operand > INT32_MAX)
+        return -1;
+    }
+  else if ((unw_word_t) (int32_t) operand != operand)
+    return -1;
+  op->op = insn->op;
+  op->reg = insn->reg;
+  op->operand = (int32_t) operand;
+  return 0;
+}
+
+/* Apply the decoded instructions OPS[0..N) of the program at
+   INSTR_START which take effect at or before END_IP, and return the
+   range of the resulting row in *ROW_START and *ROW_END.  */
+static int
+run_cfi_ops (struct dwarf_cursor *c, dwarf_state_record_t *sr,
+             const dwarf_cfi_op_t *ops, unsigned int n, int sorted,
+             unw_word_t instr_start, unw_word_t base_ip, unw_word_t end_ip,
+             unw_word_t *row_start, unw_word_t *row_end)
+{
+  dwarf_stackable_reg_state_t *rs_stack = NULL;
+  struct cfi_insn insn;
+  unw_word_t end_loc;
+  unsigned int i, k, lo, hi;
+  int ret = 0;
+
+  if (end_ip < base_ip)
+    k = 0;
+  else
+    {
+      end_loc = end_ip - base_ip;
+      if (end_loc > UINT32_MAX)
+        end_loc = UINT32_MAX;
+
+      /* K is the first instruction which takes effect after END_IP.  */
+      if (sorted)
+        {
+          for (lo = 0, hi = n; lo < hi; )
+            {
+              unsigned int mid = (lo + hi) / 2;
+
+              if (ops[mid].loc <= end_loc)
+                lo = mid + 1;
+              else
+                hi = mid;
+            }
+          k = lo;
+        }
+      else
+        for (k = 0; k < n && ops[k].loc <= end_loc; ++k)
+          ;
+    }
+
+  for (i = 0; i < k && ret >= 0; ++i)
+    {
+      insn.op = ops[i].op;
+      insn.reg = ops[i].reg;
+      if (cfi_op_is_expression (insn.op))
+        insn.operand = instr_start + (uint32_t) ops[i].operand;
+      else
+        insn.operand = (unw_word_t) ops[i].operand;
+      UNW_STATS_INC (cfi_instructions);
+      ret = apply_cfi_op (sr, &insn, &rs_stack);
+    }
+  empty_rstate_stack(&rs_stack);
+
+  *row_start = base_ip + (k > 0 ? ops[k - 1].loc : 0);
+  *row_end = k < n ? base_ip + ops[k].loc : c->pi.end_ip;
+  return ret;
+}
+
+/* Run the CFI program [INSTR_START, INSTR_END) up to END_IP from its
+   decoded form, decoding and caching it first if need be.  Returns 1
+   if it did, with the range of the row as for run_cfi_ops(), and 0 if
+   the program has to be interpreted from the unwind info instead:
+   there is no cache, the program is too long, or it could not be
+   decoded up front.  */
+static int
+run_cached_cfi_program (struct dwarf_cursor *c, dwarf_state_record_t *sr,
+                        unw_word_t base_ip, unw_word_t end_ip,
+                        unw_word_t instr_start, unw_word_t instr_end,
+                        struct dwarf_cie_info *dci,
+                        unw_word_t *row_start, unw_word_t *row_end)
+{
+  dwarf_cfi_op_t ops[DWARF_CFI_CACHE_MAX_OPS];
+  struct dwarf_cfi_cache_entry *e;
+  int debug_frame = (c->pi.flags & UNW_PI_FLAG_DEBUG_FRAME) != 0;
+  uint32_t generation, seq;
+  unsigned int n;
+  int ret, sorted;
+
+  if (c->as->caching_policy == UNW_CACHE_NONE)
+    return 0;
+
+  e = cfi_cache_entry (c->as, instr_start);
+  generation = atomic_load (&c->as->cache_generation);
+
+  seq = atomic_load_explicit (&e->seq, memory_order_acquire);
+  if (!(seq & 1) && e->instr_start == instr_start
+      && e->instr_end == instr_end && e->base_ip == base_ip
+      && e->debug_frame == debug_frame && e->generation == generation)
+    {
+      dwarf_state_record_t saved = *sr;
+
+      n = e->nops;
+      if (n > DWARF_CFI_CACHE_MAX_OPS)
+        ret = 0;
+      else
+        {
+          ret = run_cfi_ops (c, sr, e->ops, n, e->sorted, instr_start,
+                             base_ip, end_ip, row_start, row_end);
+          ret = ret < 0 ? ret : 1;
+        }
+      atomic_thread_fence (memory_order_acquire);
+      if (atomic_load_explicit (&e->seq, memory_order_relaxed) == seq)
+        return ret;
+      /* The entry changed under us; start over the slow way.  */
+      *sr = saved;
+      return 0;
+    }
+
+  /* Decode the whole program.  Anything unusual is left to the
+     interpreter, which reports errors only if it gets that far.  */
+  {
+    void *arg;
+    unw_addr_space_t as = cfi_addr_space (c, &arg);
+    unw_accessors_t *a = unw_get_accessors_int (as);
+    unw_word_t addr = instr_start, ip = base_ip;
+    struct cfi_insn insn;
+
+    n = 0;
+    sorted = 1;
+    while (addr < instr_end)
+      {
+        if (n == DWARF_CFI_CACHE_MAX_OPS)
+          {
+            n = DWARF_CFI_CACHE_TOO_LONG;
+            break;
+          }
+        if (read_cfi_op (c, as, a, &addr, &ip, dci, &insn, arg) < 0
+            || ip < base_ip || ip - base_ip > UINT32_MAX)
+          return 0;
+        if (insn.op == DW_CFA_nop)
+          continue;
+        if (pack_cfi_op (&ops[n], &insn, instr_start) < 0)
+          return 0;
+        ops[n].loc = ip - base_ip;
+        if (n > 0 && ops[n].loc < ops[n - 1].loc)
+          sorted = 0;
+        ++n;
+      }
+  }
+
+  /* Publish it, unless someone else is updating the entry.  */
+  seq = atomic_load_explicit (&e->seq, memory_order_relaxed);
+  if (!(seq & 1) && atomic_compare_exchange_strong (&e->seq, &seq, seq + 1))
+    {
+      atomic_thread_fence (memory_order_release);
+      e->instr_start = instr_start;
+      e->instr_end = instr_end;
+      e->base_ip = base_ip;
+      e->debug_frame = debug_frame;
+      e->generation = generation;
+      e->nops = n;
+      e->sorted = sorted;
+      if (n <= DWARF_CFI_CACHE_MAX_OPS)
+        memcpy (e->ops, ops, n * sizeof (ops[0]));
+      atomic_store_explicit (&e->seq, seq + 2, memory_order_release);
+    }
+
+  if (n > DWARF_CFI_CACHE_MAX_OPS)
+    return 0;
+  ret = run_cfi_ops (c, sr, ops, n, sorted, instr_start, base_ip, end_ip,
+                     row_start, row_end);
+  return ret < 0 ? ret : 1;
+}
+
 static int
 fetch_proc_info (struct dwarf_cursor *c, unw_word_t ip)
 {
@@ -533,12 +842,18 @@ setup_fde (struct dwarf_cursor *c, dwarf_state_record_t *sr)
   struct dwarf_cie_info *dci = c->pi.unwind_info;
   sr->rs_current.ret_addr_column  = dci->ret_addr_column;
   unw_word_t addr = dci->cie_instr_start;
-  unw_word_t curr_ip = 0;
+  unw_word_t curr_ip = 0, row_start, row_end;
   dwarf_stackable_reg_state_t *rs_stack = NULL;
-  ret = run_cfi_program (c, sr, &curr_ip, ~(unw_word_t) 0, &addr,
-			 dci->cie_instr_end,
-			 &rs_stack, dci);
-  empty_rstate_stack(&rs_stack);
+  ret = run_cached_cfi_program (c, sr, 0, ~(unw_word_t) 0,
+                                dci->cie_instr_start, dci->cie_instr_end,
+                                dci, &row_start, &row_end);
+  if (ret == 0)
+    {
+      ret = run_cfi_program (c, sr, &curr_ip, ~(unw_word_t) 0, &addr,
+                             dci->cie_instr_end,
+                             &rs_stack, dci);
+      empty_rstate_stack(&rs_stack);
+    }
   if (ret < 0)
     return ret;
 
@@ -546,74 +861,242 @@ setup_fde (struct dwarf_cursor *c, dwarf_state_record_t *sr)
   return 0;
 }
 
+/* Run the FDE program up to IP.  If ROW_START is non-NULL, also
+   return the half-open range of lookup addresses [*ROW_START,
+   *ROW_END) in which the resulting row is valid: it ends at the next
+   location the program advances to, or at the end of the procedure.  */
 static inline int
-parse_fde (struct dwarf_cursor *c, unw_word_t ip, dwarf_state_record_t *sr)
+parse_fde (struct dwarf_cursor *c, unw_word_t ip, dwarf_state_record_t *sr,
+           unw_word_t *row_start, unw_word_t *row_end)
 {
-  int ret;
+  int ret = 0;
   struct dwarf_cie_info *dci = c->pi.unwind_info;
   unw_word_t addr = dci->fde_instr_start;
-  unw_word_t curr_ip = c->pi.start_ip;
+  unw_word_t curr_ip = c->pi.start_ip, row_ip = curr_ip;
   dwarf_stackable_reg_state_t *rs_stack = NULL;
   /* Process up to current `ip` for signal frame and `ip - 1` for normal call frame
      See `c->use_prev_instr` use in `fetch_proc_info` for details. */
-  ret = run_cfi_program (c, sr, &curr_ip, ip - c->use_prev_instr, &addr, dci->fde_instr_end,
-			 &rs_stack, dci);
-  empty_rstate_stack(&rs_stack);
+  unw_word_t end_ip = ip - c->use_prev_instr;
+  unw_word_t start, end;
+
+  ret = run_cached_cfi_program (c, sr, c->pi.start_ip, end_ip,
+                                dci->fde_instr_start, dci->fde_instr_end,
+                                dci, &start, &end);
   if (ret < 0)
     return ret;
+  if (ret == 0)
+    {
+      /* Run one row at a time, so that we know where the last one
+         began.  */
+      while (ret >= 0 && curr_ip <= end_ip && addr < dci->fde_instr_end)
+        {
+          row_ip = curr_ip;
+          ret = run_cfi_program (c, sr, &curr_ip, row_ip, &addr,
+                                 dci->fde_instr_end, &rs_stack, dci);
+        }
+      empty_rstate_stack(&rs_stack);
+      if (ret < 0)
+        return ret;
+
+      if (curr_ip > end_ip)
+        {
+          start = row_ip;
+          end = curr_ip;
+        }
+      else
+        {
+          start = curr_ip;
+          end = c->pi.end_ip;
+        }
+    }
+
+  if (row_start)
+    {
+      /* Never claim more than we know about.  */
+      if (start > end_ip || end <= end_ip)
+	{
+	  start = end_ip;
+	  end = end_ip + 1;
+	}
+      *row_start = start;
+      *row_end = end;
+    }
+  return 0;
+}
 
+/* Release the tables of CACHE unless they are the statically
+   allocated default ones.  They were allocated for prev_log_size.  */
+static void
+rs_cache_release (struct dwarf_rs_cache *cache)
+{
+  if (cache->hash && cache->hash != cache->default_hash)
+    mi_munmap(cache->hash, DWARF_UNW_HASH_SIZE(cache->prev_log_size)
+                            * sizeof (cache->hash[0]));
+  if (cache->buckets && cache->buckets != cache->default_buckets)
+    mi_munmap(cache->buckets, DWARF_UNW_CACHE_SIZE(cache->prev_log_size)
+                            * sizeof (cache->buckets[0]));
+  if (cache->links && cache->links != cache->default_links)
+    mi_munmap(cache->links, DWARF_UNW_CACHE_SIZE(cache->prev_log_size)
+                            * sizeof (cache->links[0]));
+  if (cache->proc_info && cache->proc_info != cache->default_proc_info)
+    mi_munmap(cache->proc_info, DWARF_UNW_CACHE_SIZE(cache->prev_log_size)
+                                * sizeof (cache->proc_info[0]));
+  cache->hash = NULL;
+  cache->buckets = NULL;
+  cache->links = NULL;
+  cache->proc_info = NULL;
+}
+
+static unw_word_t
+rs_cache_clock (void)
+{
+#ifdef CLOCK_MONOTONIC
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) == 0)
+    return ts.tv_sec;
+#endif
   return 0;
 }
 
-HIDDEN int
-dwarf_flush_rs_cache (struct dwarf_rs_cache *cache)
+/* Allocate empty tables for cache->log_size entries.  If that fails,
+   the cache falls back to the default tables and -UNW_ENOMEM is
+   returned; the cache is usable either way.  */
+static int
+rs_cache_alloc (struct dwarf_rs_cache *cache)
 {
-  int i;
+  size_t i;
+  int ret = 0;
+
+  if (cache->log_size != DWARF_DEFAULT_LOG_UNW_CACHE_SIZE)
+    {
+      GET_MEMORY(cache->hash, DWARF_UNW_HASH_SIZE(cache->log_size)
+                               * sizeof (cache->hash[0]));
+      GET_MEMORY(cache->buckets, DWARF_UNW_CACHE_SIZE(cache->log_size)
+                                  * sizeof (cache->buckets[0]));
+      GET_MEMORY(cache->links, DWARF_UNW_CACHE_SIZE(cache->log_size)
+                                  * sizeof (cache->links[0]));
+      GET_MEMORY(cache->proc_info, DWARF_UNW_CACHE_SIZE(cache->log_size)
+                                    * sizeof (cache->proc_info[0]));
+      cache->prev_log_size = cache->log_size;
+      if (!cache->hash || !cache->buckets || !cache->links
+          || !cache->proc_info)
+        {
+          Debug (1, "Unable to allocate cache memory");
+          rs_cache_release (cache);
+          ret = -UNW_ENOMEM;
+        }
+    }
 
-  if (cache->log_size == DWARF_DEFAULT_LOG_UNW_CACHE_SIZE
-      || !cache->hash) {
-    cache->hash = cache->default_hash;
-    cache->buckets = cache->default_buckets;
-    cache->links = cache->default_links;
-    cache->log_size = DWARF_DEFAULT_LOG_UNW_CACHE_SIZE;
-  } else {
-    if (cache->hash && cache->hash != cache->default_hash)
-      mi_munmap(cache->hash, DWARF_UNW_HASH_SIZE(cache->prev_log_size)
-                              * sizeof (cache->hash[0]));
-    if (cache->buckets && cache->buckets != cache->default_buckets)
-      mi_munmap(cache->buckets, DWARF_UNW_CACHE_SIZE(cache->prev_log_size)
-                              * sizeof (cache->buckets[0]));
-    if (cache->links && cache->links != cache->default_links)
-      mi_munmap(cache->links, DWARF_UNW_CACHE_SIZE(cache->prev_log_size)
-                              * sizeof (cache->links[0]));
-    GET_MEMORY(cache->hash, DWARF_UNW_HASH_SIZE(cache->log_size)
-                             * sizeof (cache->hash[0]));
-    GET_MEMORY(cache->buckets, DWARF_UNW_CACHE_SIZE(cache->log_size)
-                                * sizeof (cache->buckets[0]));
-    GET_MEMORY(cache->links, DWARF_UNW_CACHE_SIZE(cache->log_size)
-                                * sizeof (cache->links[0]));
-    if (!cache->hash || !cache->buckets || !cache->links)
-      {
-        Debug (1, "Unable to allocate cache memory");
-        return -UNW_ENOMEM;
-      }
-    cache->prev_log_size = cache->log_size;
-  }
+  if (!cache->hash)
+    {
+      cache->hash = cache->default_hash;
+      cache->buckets = cache->default_buckets;
+      cache->links = cache->default_links;
+      cache->proc_info = cache->default_proc_info;
+      cache->log_size = DWARF_DEFAULT_LOG_UNW_CACHE_SIZE;
+    }
+  cache->prev_log_size = cache->log_size;
 
   cache->rr_head = 0;
 
   for (i = 0; i < DWARF_UNW_CACHE_SIZE(cache->log_size); ++i)
     {
       cache->links[i].coll_chain = -1;
+      cache->links[i].left = -1;
+      cache->links[i].right = -1;
+      cache->links[i].hint = 0;
       cache->links[i].ip = 0;
       cache->links[i].valid = 0;
+      cache->links[i].have_pi = 0;
     }
   for (i = 0; i< DWARF_UNW_HASH_SIZE(cache->log_size); ++i)
     cache->hash[i] = -1;
+  cache->tree_root = -1;
 
-  return 0;
+  cache->window_lookups = 0;
+  cache->window_misses = 0;
+  if (cache->adaptive)
+    cache->window_start = rs_cache_clock ();
+
+  return ret;
+}
+
+HIDDEN int
+dwarf_flush_rs_cache (struct dwarf_rs_cache *cache)
+{
+  rs_cache_release (cache);
+
+  /* A log_size of zero means the cache size was never set. */
+  if (cache->log_size == 0 || cache->log_size > DWARF_MAX_LOG_UNW_CACHE_SIZE)
+    cache->log_size = DWARF_DEFAULT_LOG_UNW_CACHE_SIZE;
+
+  return rs_cache_alloc (cache);
+}
+
+#if defined(HAVE___CACHE_PER_THREAD) && HAVE___CACHE_PER_THREAD
+
+/* Per-thread caches larger than the default size live in mmap'd
+   memory which must be released when the thread exits.  The key is
+   created from unw_set_cache_size(), which is the only way to get such
+   a cache, so that nothing here runs for the first time in a signal
+   handler.  */
+
+#pragma weak pthread_once
+#pragma weak pthread_key_create
+#pragma weak pthread_setspecific
+
+static pthread_once_t rs_cache_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t rs_cache_key;
+static atomic_bool rs_cache_key_valid = 0;
+
+static void
+rs_cache_thread_exit (void *arg)
+{
+  struct dwarf_rs_cache *cache = arg;
+
+  /* Drop back to the static default tables; the cache stays usable
+     should this thread unwind again from a later destructor.  */
+  cache->log_size = DWARF_DEFAULT_LOG_UNW_CACHE_SIZE;
+  dwarf_flush_rs_cache (cache);
+}
+
+static void
+rs_cache_create_key (void)
+{
+  if (pthread_key_create (&rs_cache_key, rs_cache_thread_exit) == 0)
+    atomic_store (&rs_cache_key_valid, 1);
 }
 
+HIDDEN void
+dwarf_rs_cache_init_thread_key (void)
+{
+  if (pthread_once != NULL && pthread_key_create != NULL)
+    pthread_once (&rs_cache_key_once, rs_cache_create_key);
+}
+
+static inline void
+rs_cache_track_thread (struct dwarf_rs_cache *cache)
+{
+  if (cache->hash != cache->default_hash
+      && atomic_load (&rs_cache_key_valid))
+    pthread_setspecific (rs_cache_key, cache);
+}
+
+#else /* !HAVE___CACHE_PER_THREAD */
+
+HIDDEN void
+dwarf_rs_cache_init_thread_key (void)
+{
+}
+
+static inline void
+rs_cache_track_thread (struct dwarf_rs_cache *cache UNUSED)
+{
+}
+
+#endif /* !HAVE___CACHE_PER_THREAD */
+
 static inline struct dwarf_rs_cache *
 get_rs_cache (unw_addr_space_t as, intrmask_t *saved_maskp)
 {
@@ -642,10 +1125,21 @@ get_rs_cache (unw_addr_space_t as, intrmask_t *saved_maskp)
   if ((atomic_load (&as->cache_generation) != atomic_load (&cache->generation))
        || !cache->hash)
     {
-      /* cache_size is only set in the global_cache, copy it over before flushing */
-      cache->log_size = as->global_cache.log_size;
-      if (dwarf_flush_rs_cache (cache) < 0)
-        return NULL;
+      /* cache_size is only set in the global_cache, copy it over before
+         flushing.  An adaptive cache keeps the size it has grown to,
+         unless the size settings themselves changed.  */
+      if (cache != &as->global_cache)
+        {
+          if (!cache->adaptive || !as->global_cache.adaptive
+              || cache->base_log_size != as->global_cache.base_log_size)
+            cache->log_size = as->global_cache.log_size;
+          cache->adaptive = as->global_cache.adaptive;
+          cache->base_log_size = as->global_cache.base_log_size;
+        }
+      /* On allocation failure this falls back to the default size. */
+      dwarf_flush_rs_cache (cache);
+      if (cache != &as->global_cache)
+        rs_cache_track_thread (cache);
       atomic_store (&cache->generation, atomic_load (&as->cache_generation));
     }
 
@@ -672,48 +1166,197 @@ hash (unw_word_t ip, unsigned short log_size)
   return (unw_hash_index_t) (ip * magic >> ((sizeof(unw_word_t) * 8) - (log_size + 1)));
 }
 
+/* The address the unwind info of C's frame is looked up for; see
+   fetch_proc_info() and parse_fde().  */
+static inline unw_word_t
+rs_lookup_ip (struct dwarf_cursor *c)
+{
+  return c->ip - c->use_prev_instr;
+}
+
 static inline long
-cache_match (struct dwarf_rs_cache *cache, unsigned short index, unw_word_t ip)
+cache_match (struct dwarf_rs_cache *cache, uint32_t index, unw_word_t ip)
+{
+  return (cache->links[index].valid
+          && cache->links[index].start_ip <= ip
+          && ip < cache->links[index].end_ip);
+}
+
+/* Treap priority of entry INDEX.  Entries are recycled in round-robin
+   order, which is unrelated to their start_ip, so a hash of the index
+   serves as the random priority.  */
+static inline uint32_t CONST_ATTR
+rs_tree_prio (uint32_t index)
+{
+  index ^= index >> 16;
+  index *= 0x85ebca6b;
+  index ^= index >> 13;
+  index *= 0xc2b2ae35;
+  return index ^ (index >> 16);
+}
+
+/* Order entries by start_ip, breaking ties by index.  */
+static inline int
+rs_tree_before (struct dwarf_rs_cache *cache, uint32_t a, uint32_t b)
+{
+  unw_word_t sa = cache->links[a].start_ip, sb = cache->links[b].start_ip;
+
+  return sa < sb || (sa == sb && a < b);
+}
+
+static void
+rs_tree_insert (struct dwarf_rs_cache *cache, uint32_t *root, uint32_t index)
+{
+  dwarf_reg_cache_entry_t *links = cache->links;
+  uint32_t r = *root, child;
+
+  if (r >= DWARF_UNW_CACHE_SIZE(cache->log_size))
+    {
+      links[index].left = links[index].right = -1;
+      *root = index;
+      return;
+    }
+
+  if (rs_tree_before (cache, index, r))
+    {
+      rs_tree_insert (cache, &links[r].left, index);
+      child = links[r].left;
+      if (rs_tree_prio (child) > rs_tree_prio (r))
+        {
+          links[r].left = links[child].right;
+          links[child].right = r;
+          *root = child;
+        }
+    }
+  else
+    {
+      rs_tree_insert (cache, &links[r].right, index);
+      child = links[r].right;
+      if (rs_tree_prio (child) > rs_tree_prio (r))
+        {
+          links[r].right = links[child].left;
+          links[child].left = r;
+          *root = child;
+        }
+    }
+}
+
+static void
+rs_tree_remove (struct dwarf_rs_cache *cache, uint32_t index)
+{
+  dwarf_reg_cache_entry_t *links = cache->links;
+  uint32_t size = DWARF_UNW_CACHE_SIZE(cache->log_size);
+  uint32_t *p = &cache->tree_root;
+  uint32_t l, r;
+
+  while (*p != index)
+    {
+      if (*p >= size)
+        return;
+      p = rs_tree_before (cache, index, *p) ? &links[*p].left : &links[*p].right;
+    }
+
+  /* Rotate INDEX down until it has at most one child, then splice it
+     out.  */
+  for (;;)
+    {
+      l = links[index].left;
+      r = links[index].right;
+      if (l >= size)
+        {
+          *p = r;
+          break;
+        }
+      if (r >= size)
+        {
+          *p = l;
+          break;
+        }
+      if (rs_tree_prio (l) > rs_tree_prio (r))
+        {
+          links[index].left = links[l].right;
+          links[l].right = index;
+          *p = l;
+          p = &links[l].right;
+        }
+      else
+        {
+          links[index].right = links[r].left;
+          links[r].left = index;
+          *p = r;
+          p = &links[r].left;
+        }
+    }
+  links[index].left = links[index].right = -1;
+}
+
+/* Find the entry with the greatest start_ip not above IP.  */
+static int
+rs_tree_find (struct dwarf_rs_cache *cache, unw_word_t ip)
 {
-  return (cache->links[index].valid && (ip == cache->links[index].ip));
+  uint32_t size = DWARF_UNW_CACHE_SIZE(cache->log_size);
+  uint32_t index = cache->tree_root, best = -1;
+
+  while (index < size)
+    {
+      if (cache->links[index].start_ip <= ip)
+        {
+          best = index;
+          index = cache->links[index].right;
+        }
+      else
+        index = cache->links[index].left;
+    }
+  if (best < size && cache_match (cache, best, ip))
+    return best;
+  return -1;
 }
 
-static dwarf_reg_state_t *
-rs_lookup (struct dwarf_rs_cache *cache, struct dwarf_cursor *c)
+/* Find the entry for C's frame, whose unwind info is looked up for
+   IP.  */
+static int
+rs_lookup (struct dwarf_rs_cache *cache, struct dwarf_cursor *c, unw_word_t ip)
 {
-  unsigned short index;
-  unw_word_t ip = c->ip;
+  uint32_t index;
 
   if (c->hint > 0)
     {
       index = c->hint - 1;
-      if (cache_match (cache, index, ip))
-	return &cache->buckets[index];
+      if (index < DWARF_UNW_CACHE_SIZE(cache->log_size)
+          && cache_match (cache, index, ip))
+	return index;
     }
 
-  for (index = cache->hash[hash (ip, cache->log_size)];
+  for (index = cache->hash[hash (c->ip, cache->log_size)];
        index < DWARF_UNW_CACHE_SIZE(cache->log_size);
        index = cache->links[index].coll_chain)
     {
       if (cache_match (cache, index, ip))
-	return &cache->buckets[index];
+	return index;
     }
-  return NULL;
+
+  /* Another IP in the same row may have created the entry.  */
+  return rs_tree_find (cache, ip);
 }
 
-static inline dwarf_reg_state_t *
-rs_new (struct dwarf_rs_cache *cache, struct dwarf_cursor * c)
+/* Claim the least-recently allocated entry for the row
+   [START_IP, END_IP), created for IP.  */
+static uint32_t
+rs_insert (struct dwarf_rs_cache *cache, unw_word_t ip,
+           unw_word_t start_ip, unw_word_t end_ip)
 {
   unw_hash_index_t index;
-  unsigned short head;
+  uint32_t head;
 
   head = cache->rr_head;
   cache->rr_head = (head + 1) & (DWARF_UNW_CACHE_SIZE(cache->log_size) - 1);
 
-  /* remove the old rs from the hash table (if it's there): */
+  /* remove the old rs from the hash table and the tree (if it's there): */
   if (cache->links[head].ip)
     {
-      unsigned short *pindex;
+      if (cache->links[head].valid)
+        UNW_STATS_INC (rs_cache_evictions);
+      uint32_t *pindex;
       for (pindex = &cache->hash[hash (cache->links[head].ip, cache->log_size)];
 	   *pindex < DWARF_UNW_CACHE_SIZE(cache->log_size);
 	   pindex = &cache->links[*pindex].coll_chain)
@@ -724,22 +1367,272 @@ rs_new (struct dwarf_rs_cache *cache, struct dwarf_cursor * c)
 	      break;
 	    }
 	}
+      rs_tree_remove (cache, head);
     }
 
-  /* enter new rs in the hash table */
-  index = hash (c->ip, cache->log_size);
+  /* enter new rs in the hash table and the tree */
+  index = hash (ip, cache->log_size);
   cache->links[head].coll_chain = cache->hash[index];
   cache->hash[index] = head;
 
-  cache->links[head].ip = c->ip;
+  cache->links[head].ip = ip;
+  cache->links[head].start_ip = start_ip;
+  cache->links[head].end_ip = end_ip;
+  cache->links[head].hint = 0;
   cache->links[head].valid = 1;
+  cache->links[head].have_pi = 0;
+  rs_tree_insert (cache, &cache->tree_root, head);
+  return head;
+}
+
+static inline uint32_t
+rs_new (struct dwarf_rs_cache *cache, struct dwarf_cursor * c,
+        unw_word_t start_ip, unw_word_t end_ip)
+{
+  uint32_t head = rs_insert (cache, c->ip, start_ip, end_ip);
+
   cache->links[head].signal_frame = tdep_cache_frame(c) ? 1 : 0;
-  return cache->buckets + head;
+  return head;
+}
+
+/* Resize CACHE to 2^LOG_SIZE entries, keeping the most recently
+   allocated register states.  */
+static void
+rs_cache_resize (struct dwarf_rs_cache *cache, unsigned short log_size)
+{
+  uint32_t *old_hash = cache->hash;
+  dwarf_packed_reg_state_t *old_buckets = cache->buckets;
+  dwarf_reg_cache_entry_t *old_links = cache->links;
+  dwarf_cached_proc_info_t *old_proc_info = cache->proc_info;
+  unsigned short old_log_size = cache->log_size;
+  uint32_t i, old_size = DWARF_UNW_CACHE_SIZE(old_log_size);
+  uint32_t old_head = cache->rr_head;
+
+  cache->hash = NULL;
+  cache->buckets = NULL;
+  cache->links = NULL;
+  cache->proc_info = NULL;
+  cache->log_size = log_size;
+  if (rs_cache_alloc (cache) < 0 && old_log_size == cache->log_size)
+    {
+      /* Could not grow and fell back to where we started: keep the
+         old tables.  */
+      cache->hash = old_hash;
+      cache->buckets = old_buckets;
+      cache->links = old_links;
+      cache->proc_info = old_proc_info;
+      cache->rr_head = old_head;
+      return;
+    }
+
+  /* Re-insert the old entries from oldest to newest.  */
+  for (i = 0; i < old_size; ++i)
+    {
+      uint32_t from = (old_head + i) & (old_size - 1);
+      uint32_t to;
+
+      if (!old_links[from].valid)
+        continue;
+      to = rs_insert (cache, old_links[from].ip, old_links[from].start_ip,
+                      old_links[from].end_ip);
+      cache->links[to].signal_frame = old_links[from].signal_frame;
+      cache->links[to].have_pi = old_links[from].have_pi;
+      cache->buckets[to] = old_buckets[from];
+      cache->proc_info[to] = old_proc_info[from];
+    }
+
+  if (old_hash != cache->default_hash)
+    {
+      mi_munmap (old_hash, DWARF_UNW_HASH_SIZE(old_log_size) * sizeof (old_hash[0]));
+      mi_munmap (old_buckets, old_size * sizeof (old_buckets[0]));
+      mi_munmap (old_links, old_size * sizeof (old_links[0]));
+      mi_munmap (old_proc_info, old_size * sizeof (old_proc_info[0]));
+    }
+}
+
+/* Account for one lookup in an adaptive cache and resize it at the end
+   of each window.  */
+static void
+rs_cache_adapt (struct dwarf_rs_cache *cache, int miss)
+{
+  unsigned short log_size = cache->log_size;
+  unw_word_t now;
+
+  cache->window_misses += miss;
+  if (++cache->window_lookups < DWARF_ADAPTIVE_WINDOW)
+    return;
+
+  now = rs_cache_clock ();
+  if (cache->window_misses * DWARF_ADAPTIVE_MISS_RATIO > cache->window_lookups)
+    {
+      if (log_size < DWARF_MAX_LOG_UNW_CACHE_SIZE)
+        ++log_size;
+    }
+  else if (now - cache->window_start > DWARF_ADAPTIVE_IDLE_SECS
+           && log_size > cache->base_log_size)
+    --log_size;
+
+  cache->window_lookups = 0;
+  cache->window_misses = 0;
+  cache->window_start = now;
+
+  if (log_size != cache->log_size)
+    {
+      Debug (5, "resizing rs cache from 2^%u to 2^%u entries\n",
+             cache->log_size, log_size);
+      rs_cache_resize (cache, log_size);
+    }
+}
+
+static inline int
+rs_put_uleb128 (dwarf_packed_reg_state_t *prs, unw_word_t val)
+{
+  do
+    {
+      uint8_t byte = val & 0x7f;
+
+      val >>= 7;
+      if (val)
+        byte |= 0x80;
+      if (prs->len >= sizeof (prs->data))
+        return -1;
+      prs->data[prs->len++] = byte;
+    }
+  while (val);
+  return 0;
+}
+
+static inline int
+rs_put_sleb128 (dwarf_packed_reg_state_t *prs, unw_word_t val)
+{
+  unw_sword_t sval = (unw_sword_t) val;
+  int more;
+
+  do
+    {
+      uint8_t byte = sval & 0x7f;
+
+      sval >>= 7;
+      more = !((sval == 0 && !(byte & 0x40)) || (sval == -1 && (byte & 0x40)));
+      if (more)
+        byte |= 0x80;
+      if (prs->len >= sizeof (prs->data))
+        return -1;
+      prs->data[prs->len++] = byte;
+    }
+  while (more);
+  return 0;
+}
+
+static inline unw_word_t
+rs_get_uleb128 (const dwarf_packed_reg_state_t *prs, unsigned int *pos)
+{
+  unw_word_t val = 0;
+  unsigned int shift = 0;
+  uint8_t byte;
+
+  do
+    {
+      byte = prs->data[(*pos)++];
+      val |= (unw_word_t) (byte & 0x7f) << shift;
+      shift += 7;
+    }
+  while (byte & 0x80);
+  return val;
+}
+
+static inline unw_word_t
+rs_get_sleb128 (const dwarf_packed_reg_state_t *prs, unsigned int *pos)
+{
+  unw_word_t val = 0;
+  unsigned int shift = 0;
+  uint8_t byte;
+
+  do
+    {
+      byte = prs->data[(*pos)++];
+      val |= (unw_word_t) (byte & 0x7f) << shift;
+      shift += 7;
+    }
+  while (byte & 0x80);
+
+  if (shift < 8 * sizeof (unw_word_t) && (byte & 0x40))
+    val |= ((unw_word_t) -1) << shift;
+  return val;
+}
+
+/* Expression rules hold the address of the DW_FORM_block.  Store the
+   first one relative to IP and each further one relative to the
+   previous expression, so that frames with many expression rules
+   (e.g., signal trampolines) still encode in a few bytes per column.  */
+static inline int
+rs_where_is_expr (int where)
+{
+  return where == DWARF_WHERE_EXPR || where == DWARF_WHERE_VAL_EXPR;
+}
+
+/* Encode RS into PRS.  Returns -1 if the encoding does not fit.  */
+static int
+rs_pack (dwarf_packed_reg_state_t *prs, unw_word_t ip,
+         const dwarf_reg_state_t *rs)
+{
+  unw_word_t val, base = ip;
+  int i, where;
+
+  prs->len = 0;
+  if (rs_put_uleb128 (prs, rs->ret_addr_column) < 0)
+    return -1;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS + 2; ++i)
+    {
+      where = rs->reg.where[i];
+      val = rs->reg.val[i];
+      if (where == DWARF_WHERE_SAME && val == 0)
+        continue;
+      if (rs_where_is_expr (where))
+        {
+          val -= base;
+          base = rs->reg.val[i];
+        }
+      if (rs_put_uleb128 (prs, (unw_word_t) i * 8 + where) < 0
+          || rs_put_sleb128 (prs, val) < 0)
+        return -1;
+    }
+  return 0;
+}
+
+static void
+rs_unpack (const dwarf_packed_reg_state_t *prs, unw_word_t ip,
+           dwarf_reg_state_t *rs)
+{
+  unsigned int pos = 0;
+  unw_word_t key, val, base = ip;
+  int i, where;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS + 2; ++i)
+    {
+      rs->reg.where[i] = DWARF_WHERE_SAME;
+      rs->reg.val[i] = 0;
+    }
+
+  rs->ret_addr_column = rs_get_uleb128 (prs, &pos);
+  while (pos < prs->len)
+    {
+      key = rs_get_uleb128 (prs, &pos);
+      val = rs_get_sleb128 (prs, &pos);
+      i = key / 8;
+      where = key % 8;
+      if (rs_where_is_expr (where))
+        base = val = val + base;
+      rs->reg.where[i] = where;
+      rs->reg.val[i] = val;
+    }
 }
 
 static int
 create_state_record_for (struct dwarf_cursor *c, dwarf_state_record_t *sr,
-                         unw_word_t ip)
+                         unw_word_t ip, unw_word_t *row_start,
+                         unw_word_t *row_end)
 {
   int ret;
   switch (c->pi.format)
@@ -748,7 +1641,7 @@ create_state_record_for (struct dwarf_cursor *c, dwarf_state_record_t *sr,
     case UNW_INFO_FORMAT_REMOTE_TABLE:
       if ((ret = setup_fde(c, sr)) < 0)
 	return ret;
-      ret = parse_fde (c, ip, sr);
+      ret = parse_fde (c, ip, sr, row_start, row_end);
       break;
 
     case UNW_INFO_FORMAT_DYNAMIC:
@@ -763,19 +1656,17 @@ create_state_record_for (struct dwarf_cursor *c, dwarf_state_record_t *sr,
 }
 
 static inline int
-eval_location_expr (struct dwarf_cursor *c, unw_word_t stack_val, unw_addr_space_t as,
-                    unw_accessors_t *a, unw_word_t addr,
-                    dwarf_loc_t *locp, void *arg)
+eval_location_expr (struct dwarf_cursor *c, unw_word_t stack_val,
+                    unw_word_t addr, dwarf_loc_t *locp)
 {
+  dwarf_expr_form_t form;
   int ret, is_register;
-  unw_word_t len, val;
-
-  /* read the length of the expression: */
-  if ((ret = dwarf_read_uleb128 (as, a, &addr, &len, arg)) < 0)
-    return ret;
+  unw_word_t val;
 
-  /* evaluate the expression: */
-  if ((ret = dwarf_eval_expr (c, stack_val, &addr, len, &val, &is_register)) < 0)
+  /* evaluate the expression, in closed form if it has one: */
+  dwarf_get_expr_form (c, addr, &form);
+  if ((ret = dwarf_eval_expr_form (c, stack_val, addr, &form,
+                                   &val, &is_register)) < 0)
     return ret;
 
   if (is_register)
@@ -812,11 +1703,8 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
   unw_regnum_t regnum;
   unw_word_t addr, cfa, ip;
   unw_word_t prev_ip, prev_cfa;
-  unw_addr_space_t as;
   dwarf_loc_t cfa_loc;
-  unw_accessors_t *a;
   int i, ret;
-  void *arg;
 
   /* In the case that we have incorrect CFI, the return address column may be
    * outside the valid range of data and will read invalid data.  Protect
@@ -830,10 +1718,6 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
   prev_ip = c->ip;
   prev_cfa = c->cfa;
 
-  as = c->as;
-  arg = c->as_arg;
-  a = unw_get_accessors_int (as);
-
   /* Evaluate the CFA first, because it may be referred to by other
      expressions.  */
 
@@ -866,7 +1750,7 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
       /* The dwarf standard doesn't specify an initial value to be pushed on */
       /* the stack before DW_CFA_def_cfa_expression evaluation. We push on a */
       /* dummy value (0) to keep the eval_location_expr function consistent. */
-      if ((ret = eval_location_expr (c, 0, as, a, addr, &cfa_loc, arg)) < 0)
+      if ((ret = eval_location_expr (c, 0, addr, &cfa_loc)) < 0)
         return ret;
       /* the returned location better be a memory location... */
       if (DWARF_IS_REG_LOC (cfa_loc))
@@ -912,7 +1796,7 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
           addr = rs->reg.val[i];
           /* The dwarf standard requires the current CFA to be pushed on the */
           /* stack before DW_CFA_expression evaluation. */
-          if ((ret = eval_location_expr (c, cfa, as, a, addr, new_loc + i, arg)) < 0)
+          if ((ret = eval_location_expr (c, cfa, addr, new_loc + i)) < 0)
             return ret;
           break;
 
@@ -920,7 +1804,7 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
           addr = rs->reg.val[i];
           /* The dwarf standard requires the current CFA to be pushed on the */
           /* stack before DW_CFA_val_expression evaluation. */
-          if ((ret = eval_location_expr (c, cfa, as, a, addr, new_loc + i, arg)) < 0)
+          if ((ret = eval_location_expr (c, cfa, addr, new_loc + i)) < 0)
             return ret;
           new_loc[i] = DWARF_VAL_LOC (c, DWARF_GET_LOC (new_loc[i]));
           break;
@@ -964,22 +1848,74 @@ apply_reg_state (struct dwarf_cursor *c, struct dwarf_reg_state *rs)
   return ret;
 }
 
+/* Remember the procedure info just looked up for C's frame, whose
+   row has entry INDEX.  */
+static void
+rs_set_proc_info (struct dwarf_rs_cache *cache, uint32_t index,
+                  const struct dwarf_cursor *c, unw_word_t args_size)
+{
+  dwarf_cached_proc_info_t *cpi = &cache->proc_info[index];
+
+  cpi->start_ip = c->pi.start_ip;
+  cpi->end_ip = c->pi.end_ip;
+#if defined(NEED_LAST_IP)
+  cpi->last_ip = c->pi.last_ip;
+#endif
+  cpi->lsda = c->pi.lsda;
+  cpi->handler = c->pi.handler;
+  cpi->gp = c->pi.gp;
+  cpi->args_size = args_size;
+  cpi->flags = c->pi.flags;
+  cpi->format = c->pi.format;
+  cpi->unwind_info_size = c->pi.unwind_info_size;
+  cache->links[index].have_pi = 1;
+}
+
+/* Set C's procedure info as dwarf_make_proc_info() would, from entry
+   INDEX.  */
+static void
+rs_get_proc_info (struct dwarf_rs_cache *cache, uint32_t index,
+                  struct dwarf_cursor *c)
+{
+  const dwarf_cached_proc_info_t *cpi = &cache->proc_info[index];
+
+  memset (&c->pi, 0, sizeof (c->pi));
+  c->pi.start_ip = cpi->start_ip;
+  c->pi.end_ip = cpi->end_ip;
+#if defined(NEED_LAST_IP)
+  c->pi.last_ip = cpi->last_ip;
+#endif
+  c->pi.lsda = cpi->lsda;
+  c->pi.handler = cpi->handler;
+  c->pi.gp = cpi->gp;
+  c->pi.flags = cpi->flags;
+  c->pi.format = cpi->format;
+  c->pi.unwind_info_size = cpi->unwind_info_size;
+  c->args_size = cpi->args_size;
+}
+
 /* Find the saved locations. */
 static int
 find_reg_state (struct dwarf_cursor *c, dwarf_state_record_t *sr)
 {
-  dwarf_reg_state_t *rs = NULL;
   struct dwarf_rs_cache *cache;
+  /* use_prev_instr changes to that of the next frame below */
+  unw_word_t lookup_ip = rs_lookup_ip (c);
+  unw_word_t row_start = 0, row_end = 0;
+  int index = -1;
+  int miss = 0;
+  int have_pi = 0;
   int ret = 0;
   intrmask_t saved_mask;
 
   if ((cache = get_rs_cache(c->as, &saved_mask)) &&
-      (rs = rs_lookup(cache, c)))
+      (index = rs_lookup(cache, c, lookup_ip)) >= 0)
     {
       /* update hint; no locking needed: single-word writes are atomic */
-      unsigned short index = (unsigned short) (rs - cache->buckets);
       c->use_prev_instr = ! cache->links[index].signal_frame;
-      memcpy (&sr->rs_current, rs, sizeof (*rs));
+      UNW_STATS_INC (rs_cache_hits);
+      rs_unpack (&cache->buckets[index], cache->links[index].start_ip,
+                 &sr->rs_current);
     }
   else
     {
@@ -993,6 +1929,9 @@ find_reg_state (struct dwarf_cursor *c, dwarf_state_record_t *sr)
 	}
 
       assert (!cache);
+      miss = 1;
+      UNW_STATS_INC (rs_cache_misses);
+      UNW_PROBE1 (rs_cache_miss, c->ip);
 
       ret = fetch_proc_info (c, c->ip);
       int next_use_prev_instr = c->use_prev_instr;
@@ -1002,10 +1941,11 @@ find_reg_state (struct dwarf_cursor *c, dwarf_state_record_t *sr)
 	  assert(c->pi.unwind_info);
 	  struct dwarf_cie_info *dci = c->pi.unwind_info;
 	  next_use_prev_instr = ! dci->signal_frame;
-	  ret = create_state_record_for (c, sr, c->ip);
+	  ret = create_state_record_for (c, sr, c->ip, &row_start, &row_end);
 	}
       put_unwind_info (c, &c->pi);
       c->use_prev_instr = next_use_prev_instr;
+      have_pi = 1;
 
       /* Reacquire the cache lock.  We repeat the lookup in case the
        * cache was updated by another thread while we did not hold the
@@ -1015,34 +1955,37 @@ find_reg_state (struct dwarf_cursor *c, dwarf_state_record_t *sr)
 
       if (cache)
 	{
-	  rs = rs_lookup (cache, c);
-	  if (rs)
+	  index = rs_lookup (cache, c, lookup_ip);
+	  if (index >= 0)
 	    {
-	      memcpy (&sr->rs_current, rs, sizeof(*rs));
+	      rs_unpack (&cache->buckets[index], cache->links[index].start_ip,
+	                 &sr->rs_current);
 	    }
 	  else
 	    {
-	      rs = rs_new (cache, c);
-	      cache->links[rs - cache->buckets].hint = 0;
-	      memcpy (rs, &sr->rs_current, sizeof(*rs));
+	      index = rs_new (cache, c, row_start, row_end);
+	      /* A state too large for a bucket is used once and not cached. */
+	      if (rs_pack (&cache->buckets[index], row_start, &sr->rs_current) < 0)
+		cache->links[index].valid = 0;
 	    }
+	  if (have_pi && !cache->links[index].have_pi)
+	    rs_set_proc_info (cache, index, c, sr->args_size);
 	}
     }
 
-  unsigned short index = -1;
   if (cache)
     {
-      if (rs)
-	{
-	  index = (unsigned short) (rs - cache->buckets);
-	  c->hint = cache->links[index].hint;
-	  cache->links[c->prev_rs].hint = index + 1;
-	  c->prev_rs = index;
-	}
+      c->hint = cache->links[index].hint;
+      if ((uint32_t) c->prev_rs < DWARF_UNW_CACHE_SIZE(cache->log_size))
+	cache->links[c->prev_rs].hint = index + 1;
+      c->prev_rs = index;
       if (ret >= 0)
+	tdep_reuse_frame (c, cache->links[index].signal_frame);
+      if (cache->adaptive)
 	{
-	  assert (rs);
-	  tdep_reuse_frame (c, cache->links[index].signal_frame);
+	  rs_cache_adapt (cache, miss);
+	  if (cache != &c->as->global_cache)
+	    rs_cache_track_thread (cache);
 	}
       put_rs_cache (c->as, cache, &saved_mask);
     }
@@ -1064,29 +2007,124 @@ dwarf_step (struct dwarf_cursor *c)
 HIDDEN int
 dwarf_make_proc_info (struct dwarf_cursor *c)
 {
-#if 0
-  if (c->as->caching_policy == UNW_CACHE_NONE
-      || get_cached_proc_info (c) < 0)
-#endif
+  struct dwarf_rs_cache *cache;
+  unw_word_t lookup_ip = rs_lookup_ip (c);
+  unw_word_t row_start = 0, row_end = 0;
+  dwarf_state_record_t sr;
+  intrmask_t saved_mask;
+  int index, ret;
+
+  /* A frame which has been stepped through or looked up before has
+     its procedure info next to its register state.  */
+  if ((cache = get_rs_cache (c->as, &saved_mask)))
+    {
+      index = rs_lookup (cache, c, lookup_ip);
+      if (index >= 0 && cache->links[index].have_pi)
+        {
+          rs_get_proc_info (cache, index, c);
+          put_rs_cache (c->as, cache, &saved_mask);
+          UNW_STATS_INC (proc_info_hits);
+          return 0;
+        }
+      put_rs_cache (c->as, cache, &saved_mask);
+    }
+
   /* Need to check if current frame contains
      args_size, and set cursor appropriately.  Only
      needed for unw_resume */
-  dwarf_state_record_t sr;
   sr.args_size = 0;
-  int ret;
 
   /* Lookup it up the slow way... */
   ret = fetch_proc_info (c, c->ip);
   if (ret >= 0)
-      ret = create_state_record_for (c, &sr, c->ip);
+      ret = create_state_record_for (c, &sr, c->ip, &row_start, &row_end);
   put_unwind_info (c, &c->pi);
   if (ret < 0)
     return ret;
   c->args_size = sr.args_size;
 
+  /* ...and cache the row, which the next step from this frame will
+     want as well.  */
+  if ((cache = get_rs_cache (c->as, &saved_mask)))
+    {
+      index = rs_lookup (cache, c, lookup_ip);
+      if (index < 0)
+        {
+          index = rs_new (cache, c, row_start, row_end);
+          if (rs_pack (&cache->buckets[index], row_start, &sr.rs_current) < 0)
+            cache->links[index].valid = 0;
+        }
+      if (cache->links[index].valid)
+        rs_set_proc_info (cache, index, c, sr.args_size);
+      put_rs_cache (c->as, cache, &saved_mask);
+    }
   return 0;
 }
 
+/* Look up the procedure containing IP and set *END_IP to its end.  If
+   there is none, *END_IP is where the next one may start, or at most
+   IP if the lookup did not say.  If NROWS is non-NULL, also cache the
+   register states of its rows from IP up to HI, counting them in
+   *NROWS; returns 1 once the cache has had as many rows put in it as
+   it holds.  C is a scratch cursor whose frame state is
+   overwritten.  */
+HIDDEN int
+dwarf_prefetch_proc (struct dwarf_cursor *c, unw_word_t ip, unw_word_t hi,
+                     unw_word_t *end_ip, unw_word_t *nrows)
+{
+  struct dwarf_rs_cache *cache;
+  unw_word_t row_start = 0, row_end = 0;
+  dwarf_state_record_t sr;
+  intrmask_t saved_mask;
+  int index, ret;
+
+  c->use_prev_instr = 0;
+  ret = fetch_proc_info (c, ip);
+  /* Without unwind info for IP, the lookup may have said where the
+     next procedure starts.  */
+  *end_ip = c->pi.end_ip;
+  if (ret < 0)
+    return ret;
+  if (hi > c->pi.end_ip)
+    hi = c->pi.end_ip;
+
+  /* The rows are keyed by the address their unwind info is looked up
+     for, so looking up IP itself gives the row a return address of
+     IP + 1 is in.  */
+  while (nrows && ret == 0 && ip < hi)
+    {
+      sr.args_size = 0;
+      if ((ret = create_state_record_for (c, &sr, ip, &row_start,
+                                          &row_end)) < 0)
+        break;
+      if (!(cache = get_rs_cache (c->as, &saved_mask)))
+        break;
+      c->ip = ip;
+      c->hint = 0;
+      index = rs_lookup (cache, c, ip);
+      if (index < 0)
+        {
+          if (*nrows >= DWARF_UNW_CACHE_SIZE(cache->log_size))
+            ret = 1;
+          else
+            {
+              index = rs_new (cache, c, row_start, row_end);
+              if (rs_pack (&cache->buckets[index], row_start,
+                           &sr.rs_current) < 0)
+                cache->links[index].valid = 0;
+              ++*nrows;
+            }
+        }
+      if (index >= 0 && cache->links[index].valid
+          && !cache->links[index].have_pi)
+        rs_set_proc_info (cache, index, c, sr.args_size);
+      put_rs_cache (c->as, cache, &saved_mask);
+      ip = row_end;
+    }
+  put_unwind_info (c, &c->pi);
+  return ret;
+}
+
 static int
 dwarf_reg_states_dynamic_iterate(struct dwarf_cursor     *c UNUSED,
                                  unw_reg_states_callback  cb UNUSED,
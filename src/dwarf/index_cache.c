@@ -0,0 +1,260 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Opt-in on-disk cache of the binary-search tables libunwind derives
+   from unwind sections, keyed by the ELF build-id.  If the environment
+   variable UNW_INDEX_CACHE_DIR names a directory, each table built is
+   written there as <build-id>.<kind>.idx, and later processes map that
+   file instead of walking the FDEs again.
+
+   A file holds the table entries as they are used in memory, followed
+   by a trailer describing them, so that a mapping of the whole file
+   starts with the table and can be unmapped as one.  Only a directory
+   and files which no user but the current one can have written are
+   used; the caller still checks the entries against the section.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "dwarf_i.h"
+#include "libunwind_i.h"
+#include "Gfind_proc_info_i.h"
+
+#define INDEX_CACHE_MAGIC       "UNWIDX\0\0"
+#define INDEX_CACHE_VERSION     1
+#define INDEX_CACHE_BYTE_ORDER  0x01020304
+
+struct index_cache_trailer
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t kind;
+    uint32_t entry_size;
+    uint64_t len;               /* entries */
+    uint64_t section_size;      /* of the section indexed */
+  };
+
+static const char *const kind_names[] = { "", "eh_frame", "debug_frame" };
+
+/* Whether ST, of file type TYPE, can only have been written by the
+   current user: owned by the effective user, and not writable by the
+   group or others.  */
+static int
+index_cache_trusted (const struct stat *st, mode_t type)
+{
+  return (st->st_mode & S_IFMT) == type && st->st_uid == geteuid ()
+         && (st->st_mode & (S_IWGRP | S_IWOTH)) == 0;
+}
+
+/* Open the cache directory.  Returns a descriptor of it, or -1 if
+   there is none or it is not to be trusted.  */
+static int
+index_cache_dir (void)
+{
+  struct stat st;
+  const char *dir;
+  int fd;
+
+  /* Never let the environment pick where a privileged process writes.  */
+  if (getuid () != geteuid () || getgid () != getegid ())
+    return -1;
+  dir = getenv ("UNW_INDEX_CACHE_DIR");
+  if (!dir || !*dir)
+    return -1;
+
+  fd = open (dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  if (fstat (fd, &st) < 0 || !index_cache_trusted (&st, S_IFDIR))
+    {
+      Debug (1, "not using index cache directory %s: not the user's own\n",
+             dir);
+      close (fd);
+      return -1;
+    }
+  return fd;
+}
+
+/* Set NAME to the name of the cache file of the KIND table of the
+   object with BUILD_ID.  Returns 0, or -1 if there is no build-id.  */
+static int
+index_cache_name (char *name, size_t name_len, const uint8_t *build_id,
+                  size_t build_id_len, int kind)
+{
+  const char hex[] = "0123456789abcdef";
+  size_t n, i;
+
+  if (build_id_len == 0 || build_id_len > DWARF_BUILD_ID_MAX
+      || 2 * build_id_len + strlen (kind_names[kind]) + 6 > name_len)
+    return -1;
+
+  for (n = i = 0; i < build_id_len; ++i)
+    {
+      name[n++] = hex[build_id[i] >> 4];
+      name[n++] = hex[build_id[i] & 0xf];
+    }
+  snprintf (name + n, name_len - n, ".%s.idx", kind_names[kind]);
+  return 0;
+}
+
+/* Map the cached KIND table of the object with BUILD_ID, if there is
+   a valid one for a section of SECTION_SIZE bytes.  Returns the table
+   and sets *LEN to its number of entries and *SIZE to the size of the
+   mapping, or returns NULL.  */
+HIDDEN struct table_entry *
+dwarf_index_cache_load (const uint8_t *build_id, size_t build_id_len,
+                        int kind, size_t section_size,
+                        size_t *len, size_t *size)
+{
+  const struct index_cache_trailer *t;
+  struct table_entry *table;
+  char name[NAME_MAX + 1];
+  struct stat st;
+  size_t i, n;
+  void *map;
+  int dir, fd;
+
+  if (index_cache_name (name, sizeof (name), build_id, build_id_len, kind) < 0
+      || (dir = index_cache_dir ()) < 0)
+    return NULL;
+
+  fd = openat (dir, name, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+  close (dir);
+  if (fd < 0)
+    return NULL;
+  if (fstat (fd, &st) < 0 || !index_cache_trusted (&st, S_IFREG))
+    {
+      Debug (1, "ignoring index cache file %s: not the user's own\n", name);
+      close (fd);
+      return NULL;
+    }
+  if ((size_t) st.st_size < sizeof (*t)
+      || (st.st_size - sizeof (*t)) % sizeof (*table) != 0)
+    {
+      close (fd);
+      return NULL;
+    }
+  map = mi_mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return NULL;
+
+  table = map;
+  n = (st.st_size - sizeof (*t)) / sizeof (*table);
+  t = (const struct index_cache_trailer *) (table + n);
+  if (memcmp (t->magic, INDEX_CACHE_MAGIC, sizeof (t->magic)) != 0
+      || t->version != INDEX_CACHE_VERSION
+      || t->byte_order != INDEX_CACHE_BYTE_ORDER
+      || t->kind != (uint32_t) kind
+      || t->entry_size != sizeof (*table)
+      || t->len != n || n == 0 || t->section_size != section_size)
+    goto invalid;
+
+  /* The entries must still be what lookup() and the FDE parser need,
+     whoever wrote the file.  */
+  for (i = 0; i < n; ++i)
+    if ((i > 0 && table[i].start_ip_offset < table[i - 1].start_ip_offset)
+        || table[i].fde_offset < 0
+        || (size_t) table[i].fde_offset >= section_size)
+      goto invalid;
+
+  Debug (4, "mapped %zu entries from %s\n", n, name);
+  *len = n;
+  *size = st.st_size;
+  return table;
+
+ invalid:
+  Debug (1, "ignoring invalid index cache file %s\n", name);
+  mi_munmap (map, st.st_size);
+  return NULL;
+}
+
+/* Write the KIND TABLE of LEN entries of the object with BUILD_ID to
+   the cache, for a section of SECTION_SIZE bytes.  Failures are only
+   reported as debug messages.  */
+HIDDEN void
+dwarf_index_cache_store (const uint8_t *build_id, size_t build_id_len,
+                         int kind, size_t section_size,
+                         const struct table_entry *table, size_t len)
+{
+  struct index_cache_trailer t;
+  char name[NAME_MAX + 1], tmp[NAME_MAX + 32];
+  const char *p;
+  size_t n;
+  ssize_t w;
+  int dir, fd, ok;
+
+  if (index_cache_name (name, sizeof (name), build_id, build_id_len, kind) < 0
+      || (dir = index_cache_dir ()) < 0)
+    return;
+
+  memset (&t, 0, sizeof (t));
+  memcpy (t.magic, INDEX_CACHE_MAGIC, sizeof (t.magic));
+  t.version = INDEX_CACHE_VERSION;
+  t.byte_order = INDEX_CACHE_BYTE_ORDER;
+  t.kind = kind;
+  t.entry_size = sizeof (*table);
+  t.len = len;
+  t.section_size = section_size;
+
+  /* Write a private file and rename it into place, so that readers see
+     either no file or a complete one.  */
+  snprintf (tmp, sizeof (tmp), "%s.%ld.tmp", name, (long) getpid ());
+  fd = openat (dir, tmp, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC,
+               0644);
+  if (fd < 0)
+    {
+      Debug (2, "cannot create %s: %s\n", tmp, strerror (errno));
+      close (dir);
+      return;
+    }
+
+  for (p = (const char *) table, n = len * sizeof (*table); n > 0; )
+    {
+      w = write (fd, p, n);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w <= 0)
+        break;
+      p += w;
+      n -= w;
+    }
+  ok = n == 0 && write (fd, &t, sizeof (t)) == sizeof (t);
+  if (close (fd) < 0)
+    ok = 0;
+  if (!ok || renameat (dir, tmp, dir, name) < 0)
+    {
+      Debug (2, "cannot write %s: %s\n", name, strerror (errno));
+      unlinkat (dir, tmp, 0);
+    }
+  else
+    Debug (4, "wrote %zu entries to %s\n", len, name);
+  close (dir);
+}
@@ -73,6 +73,15 @@ struct ip_range_callback_data
   Elf_W (Addr) *end_ip;
 };
 
+/**
+ * Where to pass each function symbol of an image.
+ */
+struct symbol_visit_data
+{
+  void (*fn) (void *, unw_word_t, unw_word_t, const char *);
+  void  *arg;
+};
+
 /**
  * Function signature for symtab lookup callbacks
  */
@@ -451,6 +460,19 @@ elf_w (lookup_ip_range)(unw_addr_space_t as,
                                           &data);
 }
 
+static int
+elf_w (visit_symbol_callback)(const struct symbol_lookup_context *context UNUSED,
+                              const struct symbol_info *syminfo, void *data)
+{
+  struct symbol_visit_data *d = data;
+
+  d->fn (d->arg, syminfo->start_ip, syminfo->sym->st_size,
+         syminfo->strtab + syminfo->sym->st_name);
+
+  /* Keep going.  */
+  return -UNW_ENOINFO;
+}
+
 static Elf_W (Addr)
 elf_w (get_load_offset) (struct elf_image *ei, unsigned long segbase)
 {
@@ -696,6 +718,45 @@ elf_w (get_proc_name) (unw_addr_space_t as, pid_t pid, unw_word_t ip,
   return ret;
 }
 
+/* Call FN with ARG and the address, size and name of each function
+   symbol of EI loaded at SEGBASE, including the symbols of its
+   MiniDebugInfo.  The name is only valid during the call.  Symbols of
+   the symbol table and of the dynamic one may be passed twice.  */
+
+HIDDEN void
+elf_w (visit_proc_names_in_image) (unw_addr_space_t as, struct elf_image *ei,
+                                   unsigned long segbase,
+                                   void (*fn) (void *, unw_word_t, unw_word_t,
+                                               const char *),
+                                   void *arg)
+{
+  Elf_W (Addr) min_dist = ~(Elf_W (Addr))0;
+  struct symbol_lookup_context context =
+    {
+      .as = as,
+      .ei = ei,
+      .load_offset = elf_w (get_load_offset) (ei, segbase),
+      .min_dist = &min_dist,
+    };
+  struct symbol_visit_data data =
+    {
+      .fn = fn,
+      .arg = arg,
+    };
+  struct elf_image mdi;
+
+  elf_w (lookup_symbol_closeness) (as, &context,
+                                   elf_w (visit_symbol_callback), &data);
+
+  if (elf_w (extract_minidebuginfo) (ei, &mdi))
+    {
+      context.ei = &mdi;
+      elf_w (lookup_symbol_closeness) (as, &context,
+                                       elf_w (visit_symbol_callback), &data);
+      mi_munmap (mdi.image, mdi.size);
+    }
+}
+
 HIDDEN int
 elf_w (get_proc_ip_range_in_image) (unw_addr_space_t as, struct elf_image *ei,
                        unsigned long segbase,
@@ -831,78 +892,97 @@ elf_w (add_hex_byte) (char *str, uint8_t byte)
 }
 
 
-static int
-elf_w (find_build_id_path) (const struct elf_image *ei, char *path, unsigned path_len)
+HIDDEN const uint8_t *
+elf_w (find_build_id_note) (const uint8_t *notes, const uint8_t *notes_end,
+                            size_t *len)
 {
 /*
  * build-id is only available on GNU plaforms. So on non-GNU platforms this
- * function just returns fail (-1).
+ * function just returns fail (NULL).
  */
 #if defined(ELF_NOTE_GNU) && defined(NT_GNU_BUILD_ID)
+  while (notes + sizeof (Elf_W (Nhdr)) <= notes_end)
+    {
+      /* See "man 5 elf" for notes about alignment in Nhdr */
+      const Elf_W(Nhdr) *nhdr = (const Elf_W(Nhdr) *) notes;
+      const Elf_W(Word) namesz = nhdr->n_namesz;
+      const Elf_W(Word) descsz = nhdr->n_descsz;
+      const Elf_W(Word) nameasz = UNW_ALIGN(namesz, 4); /* Aligned size */
+      const char *name = (const char *) (nhdr + 1);
+      const uint8_t *desc = (const uint8_t *) name + nameasz;
+
+      notes += sizeof(*nhdr) + nameasz + UNW_ALIGN(descsz, 4);
+
+      if ((namesz != sizeof(ELF_NOTE_GNU)) ||  /* Spec says must be "GNU" with a NULL */
+          (nhdr->n_type != NT_GNU_BUILD_ID) || /* Spec says must be NT_GNU_BUILD_ID   */
+          (strcmp(name, ELF_NOTE_GNU) != 0) || /* Must be "GNU" with NULL termination */
+          descsz == 0 || notes > notes_end)
+        continue;
+
+      *len = descsz;
+      return desc;
+    }
+#endif /* defined(ELF_NOTE_GNU) */
+
+  return NULL;
+}
+
+HIDDEN const uint8_t *
+elf_w (get_build_id) (const struct elf_image *ei, size_t *len)
+{
   const Elf_W (Ehdr) *ehdr = ei->image;
   const Elf_W (Phdr) *phdr;
+  const uint8_t *notes, *notes_end, *id;
   unsigned i;
 
   if (!elf_w (valid_object) (ei))
-    return -1;
+    return NULL;
 
   phdr = (Elf_W (Phdr) *) ((uint8_t *) ehdr + ehdr->e_phoff);
 
   for (i = 0; i < ehdr->e_phnum; ++i, phdr = (const Elf_W (Phdr) *) (((const uint8_t *) phdr) + ehdr->e_phentsize))
     {
-      const uint8_t *notes;
-      const uint8_t *notes_end;
-
       /* The build-id is in a note section */
       if (phdr->p_type != PT_NOTE)
         continue;
 
       notes = elf_w (get_program_segment) (ei, phdr, &notes_end);
+      if (notes && (id = elf_w (find_build_id_note) (notes, notes_end, len)))
+        return id;
+    }
+  return NULL;
+}
 
-      while(notes < notes_end)
-        {
-          const char prefix[] = "/usr/lib/debug/.build-id/";
-
-          /* See "man 5 elf" for notes about alignment in Nhdr */
-          const Elf_W(Nhdr) *nhdr = (const Elf_W(Nhdr) *) notes;
-          const Elf_W(Word) namesz = nhdr->n_namesz;
-          const Elf_W(Word) descsz = nhdr->n_descsz;
-          const Elf_W(Word) nameasz = UNW_ALIGN(namesz, 4); /* Aligned size */
-          const char *name = (const char *) (nhdr + 1);
-          const uint8_t *desc = (const uint8_t *) name + nameasz;
-          unsigned j;
-
-          notes += sizeof(*nhdr) + nameasz + UNW_ALIGN(descsz, 4);
-
-          if ((namesz != sizeof(ELF_NOTE_GNU)) ||  /* Spec says must be "GNU" with a NULL */
-              (nhdr->n_type != NT_GNU_BUILD_ID) || /* Spec says must be NT_GNU_BUILD_ID   */
-              (strcmp(name, ELF_NOTE_GNU) != 0))   /* Must be "GNU" with NULL termination */
-            continue;
+static int
+elf_w (find_build_id_path) (const struct elf_image *ei, char *path, unsigned path_len)
+{
+  const char prefix[] = "/usr/lib/debug/.build-id/";
+  const uint8_t *desc;
+  size_t descsz, j;
 
-          /* Validate that we have enough space */
-          if (path_len < (sizeof(prefix) +     /* Path prefix inc NULL */
-                          2 +                  /* Subdirectory         */
-                          1 +                  /* Directory separator  */
-                          (2 * (descsz - 1)) + /* Leaf filename        */
-                          6))                  /* .debug extension     */
-            return -1;
+  desc = elf_w (get_build_id) (ei, &descsz);
+  if (!desc)
+    return -1;
 
-          memcpy(path, prefix, sizeof(prefix));
+  /* Validate that we have enough space */
+  if (path_len < (sizeof(prefix) +     /* Path prefix inc NULL */
+                  2 +                  /* Subdirectory         */
+                  1 +                  /* Directory separator  */
+                  (2 * (descsz - 1)) + /* Leaf filename        */
+                  6))                  /* .debug extension     */
+    return -1;
 
-          path = elf_w (add_hex_byte) (path + sizeof(prefix) - 1, *desc);
-          *path++ = '/';
+  memcpy(path, prefix, sizeof(prefix));
 
-          for(j = 1, ++desc; j < descsz; ++j, ++desc)
-            path = elf_w (add_hex_byte) (path, *desc);
+  path = elf_w (add_hex_byte) (path + sizeof(prefix) - 1, *desc);
+  *path++ = '/';
 
-          strcat(path, ".debug");
+  for(j = 1, ++desc; j < descsz; ++j, ++desc)
+    path = elf_w (add_hex_byte) (path, *desc);
 
-          return 0;
-        }
-    }
-#endif /* defined(ELF_NOTE_GNU) */
+  strcat(path, ".debug");
 
-  return -1;
+  return 0;
 }
 
 /* Load a debug section, following .gnu_debuglink if appropriate
@@ -53,6 +53,14 @@ extern int elf_w (get_proc_name_in_image) (unw_addr_space_t as,
                                            unw_word_t ip,
                                            char *buf, size_t buf_len, unw_word_t *offp);
 
+extern void elf_w (visit_proc_names_in_image) (unw_addr_space_t as,
+                                               struct elf_image *ei,
+                                               unsigned long segbase,
+                                               void (*fn) (void *, unw_word_t,
+                                                           unw_word_t,
+                                                           const char *),
+                                               void *arg);
+
 extern int elf_w (get_proc_ip_range) (unw_addr_space_t as,
                                       pid_t pid, unw_word_t ip,
                                       unw_word_t *start, unw_word_t *end, void *arg);
@@ -66,6 +74,11 @@ extern int elf_w (get_elf_filename) (unw_addr_space_t as, pid_t pid, unw_word_t
 
 extern Elf_W (Shdr)* elf_w (find_section) (const struct elf_image *ei, const char* secname);
 extern int elf_w (load_debuginfo) (const char* file, struct elf_image *ei, int is_local);
+extern const uint8_t *elf_w (find_build_id_note) (const uint8_t *notes,
+                                                  const uint8_t *notes_end,
+                                                  size_t *len);
+extern const uint8_t *elf_w (get_build_id) (const struct elf_image *ei,
+                                            size_t *len);
 
 static inline int
 elf_w (valid_object) (const struct elf_image *ei)
@@ -108,6 +121,7 @@ elf_map_image (struct elf_image *ei, const char *path)
     return -1;
   }
 
+  UNW_PROBE2 (elf_map, path, ei->size);
   return 0;
 }
 
@@ -24,6 +24,12 @@
  */
 #include "libunwind_i.h"
 
+#include <sys/uio.h>
+
+#ifdef __linux__
+# include "os-linux.h"
+#endif
+
 
 #ifdef UNW_REMOTE_ONLY
 bool
@@ -39,6 +45,11 @@ unw_address_is_valid(UNUSED unw_word_t addr, UNUSED size_t len)
  * handlers) never race on closing or reopening another thread's fds. */
 static thread_local int _mem_validate_pipe[2] = {-1, -1};
 
+/* Bytes written to the pipe and not read back yet.  They are copies of
+ * whatever memory was checked, so only a few are left in the kernel. */
+enum { VALIDATE_PIPE_BACKLOG = 16 };
+static thread_local int _mem_validate_pending;
+
 #ifdef HAVE_PIPE2
 static int
 _do_pipe2 (int pipefd[2])
@@ -80,6 +91,8 @@ _open_pipe (void)
     close (_mem_validate_pipe[0]);
   if (_mem_validate_pipe[1] != -1)
     close (_mem_validate_pipe[1]);
+  _mem_validate_pipe[0] = _mem_validate_pipe[1] = -1;
+  _mem_validate_pending = 0;
 
   return _do_pipe2 (_mem_validate_pipe);
 }
@@ -93,141 +106,244 @@ _open_pipe (void)
  *
  * This check works by using the address as a (one-byte) buffer in a
  * write-to-pipe operation.  The write will fail if the memory is not in the
- * process's address space and marked as readable. The read will force the page
- * to be swapped in if it's not already there.
+ * process's address space and marked as readable.  The pipe is drained once
+ * VALIDATE_PIPE_BACKLOG bytes are in it, so most checks cost a single system
+ * call and no more than that many bytes of memory sit in the pipe.
+ *
+ * @returns -1 if the pipe was closed behind our back and cannot be reopened.
  */
-static bool
+static int
 _write_validate (unw_word_t addr)
 {
-  int ret = -1;
-  ssize_t bytes = 0;
+  char buf[VALIDATE_PIPE_BACKLOG];
+  int ret, tries;
 
-  if (unlikely (_mem_validate_pipe[0] == -1))
+  for (tries = 0; tries < 2; ++tries)
     {
-      if (_open_pipe () != 0)
+      do
         {
-          return false;
+#ifdef HAVE_SYS_SYSCALL_H
+          /* use syscall insteadof write() so that ASAN does not complain */
+          ret = syscall (SYS_write, _mem_validate_pipe[1], addr, 1);
+#else
+          ret = write (_mem_validate_pipe[1], (void *)addr, 1);
+#endif
         }
-    }
+      while (ret < 0 && errno == EINTR);
 
-  do
-    {
-      char buf;
-      bytes = read (_mem_validate_pipe[0], &buf, 1);
-    }
-  while ( errno == EINTR );
+      if (ret > 0)
+        {
+          if (++_mem_validate_pending >= VALIDATE_PIPE_BACKLOG)
+            {
+              while (read (_mem_validate_pipe[0], buf, sizeof (buf)) > 0)
+                ;
+              _mem_validate_pending = 0;
+            }
+          return true;
+        }
+      if (errno == EFAULT)
+        return false;
 
-  if (!(bytes > 0 || errno == EAGAIN || errno == EWOULDBLOCK))
-    {
-      // re-open closed pipe
-      if (_open_pipe () != 0)
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
         {
-          return false;
+          /* pipe is full */
+          while (read (_mem_validate_pipe[0], buf, sizeof (buf)) > 0)
+            ;
+          _mem_validate_pending = 0;
         }
+      else if (_open_pipe () != 0)
+        return -1;
     }
+  return false;
+}
+
 
-  do
+#if defined(HAVE_SYS_SYSCALL_H) && defined(SYS_process_vm_readv)
+/**
+ * Test if a memory address is valid by reading it through the kernel
+ * @param[in]  addr The address to validate
+ *
+ * @returns true if the memory address is valid (readable), false otherwise.
+ *
+ * Used when no pipe can be opened.  Seccomp policies commonly deny
+ * process_vm_readv(), which is why it is not the first choice.
+ */
+static bool
+_vm_read_validate (unw_word_t addr)
+{
+  char buf;
+  struct iovec local = { &buf, 1 };
+  struct iovec remote = { (void *) addr, 1 };
+
+  return syscall (SYS_process_vm_readv, getpid (), &local, 1, &remote, 1, 0) == 1;
+}
+#endif
+
+
+/* How this thread checks pages, chosen on first use.  */
+enum
+  {
+    VALIDATE_UNKNOWN,
+    VALIDATE_PIPE,
+    VALIDATE_VM_READV,
+    VALIDATE_NONE
+  };
+static thread_local int _validate_method = VALIDATE_UNKNOWN;
+
+static void
+_select_validate_method (void)
+{
+  if (_open_pipe () == 0)
+    _validate_method = VALIDATE_PIPE;
+#if defined(HAVE_SYS_SYSCALL_H) && defined(SYS_process_vm_readv)
+  else if (_vm_read_validate ((unw_word_t) &_validate_method))
+    _validate_method = VALIDATE_VM_READV;
+#endif
+  else
+    _validate_method = VALIDATE_NONE;
+  Debug (3, "using validation method %d\n", _validate_method);
+}
+
+static bool
+_validate (unw_word_t addr)
+{
+  int ret;
+
+  if (unlikely (_validate_method == VALIDATE_UNKNOWN))
+    _select_validate_method ();
+
+  if (_validate_method == VALIDATE_PIPE)
     {
-#ifdef HAVE_SYS_SYSCALL_H
-      /* use syscall insteadof write() so that ASAN does not complain */
-      ret = syscall (SYS_write, _mem_validate_pipe[1], addr, 1);
-#else
-      ret = write (_mem_validate_pipe[1], (void *)addr, 1);
+      ret = _write_validate (addr);
+      if (ret >= 0)
+        return ret;
+      _select_validate_method ();
+    }
+#if defined(HAVE_SYS_SYSCALL_H) && defined(SYS_process_vm_readv)
+  if (_validate_method == VALIDATE_VM_READV)
+    return _vm_read_validate (addr);
 #endif
+  return false;
+}
+
+
+#ifdef __linux__
+/*
+ * Bounds of the main thread's stack, the "[stack]" mapping, found the first
+ * time a page is not in the cache.  The kernel never shrinks that mapping,
+ * so everything inside it stays readable.  The mappings of other thread
+ * stacks are anonymous and may have been merged with their neighbours, so
+ * those rely on the page cache.
+ */
+enum { STACK_RANGE_UNKNOWN, STACK_RANGE_BUSY, STACK_RANGE_DONE };
+static _Atomic int stack_range_state;
+static _Atomic unw_word_t stack_range_lo, stack_range_hi;
+
+static void
+_find_stack_range (void)
+{
+  struct map_iterator mi;
+  unsigned long lo, hi, off, flags;
+  int expected = STACK_RANGE_UNKNOWN;
+
+  if (!atomic_compare_exchange_strong (&stack_range_state, &expected,
+                                       STACK_RANGE_BUSY))
+    return;
+
+  if (maps_init (&mi, getpid ()) == 0)
+    {
+      while (maps_next (&mi, &lo, &hi, &off, &flags))
+        if (strcmp (mi.path, "[stack]") == 0)
+          {
+            if (flags & PROT_READ)
+              {
+                atomic_store (&stack_range_lo, lo);
+                atomic_store (&stack_range_hi, hi);
+                Debug (3, "stack is [%lx-%lx)\n", lo, hi);
+              }
+            break;
+          }
+      maps_close (&mi);
     }
-  while ( errno == EINTR );
+  atomic_store (&stack_range_state, STACK_RANGE_DONE);
+}
+
+static bool
+_is_in_stack_range (unw_word_t addr, size_t len)
+{
+  unw_word_t lo, hi;
+
+  if (unlikely (atomic_load (&stack_range_state) == STACK_RANGE_UNKNOWN))
+    _find_stack_range ();
 
-  return ret > 0;
+  lo = atomic_load (&stack_range_lo);
+  hi = atomic_load (&stack_range_hi);
+  return lo <= addr && addr < hi && len <= hi - addr;
 }
+#else
+static bool
+_is_in_stack_range (unw_word_t addr UNUSED, size_t len UNUSED)
+{
+  return false;
+}
+#endif
 
 
-/* Cache of already validated addresses */
-enum { NLGA = 4 };
+/*
+ * Cache of already validated pages, direct-mapped on the page number.  A
+ * conservative walk touches a handful of pages per frame (stack, code and
+ * data), so a few dozen entries keep deep stacks from thrashing it.
+ */
+enum { NLGA = 64 };
+
+static inline unsigned
+_lga_slot (unw_word_t page_addr)
+{
+  return (page_addr / unw_page_size) % NLGA;
+}
 
 #if defined(HAVE___CACHE_PER_THREAD) && HAVE___CACHE_PER_THREAD
 // thread-local variant
 static thread_local unw_word_t last_good_addr[NLGA];
-static thread_local int lga_victim;
 
 
 static bool
 _is_cached_valid_mem(unw_word_t page_addr)
 {
-  int i;
-  for (i = 0; i < NLGA; i++)
-    {
-      if (page_addr == last_good_addr[i])
-        return true;
-    }
-  return false;
+  return last_good_addr[_lga_slot (page_addr)] == page_addr;
 }
 
 
 static void
 _cache_valid_mem(unw_word_t page_addr)
 {
-  int i, victim;
-  victim = lga_victim;
-  for (i = 0; i < NLGA; i++)
-    {
-      if (last_good_addr[victim] == 0)
-        {
-          last_good_addr[victim] = page_addr;
-          return;
-        }
-      victim = (victim + 1) % NLGA;
-    }
-
-  /* All slots full. Evict the victim. */
-  last_good_addr[victim] = page_addr;
-  victim = (victim + 1) % NLGA;
-  lga_victim = victim;
+  last_good_addr[_lga_slot (page_addr)] = page_addr;
 }
 
 #else
 // global, thread safe variant
 static _Atomic unw_word_t last_good_addr[NLGA];
-static _Atomic int lga_victim;
 
 
 static bool
 _is_cached_valid_mem(unw_word_t page_addr)
 {
-  int i;
-  for (i = 0; i < NLGA; i++)
-    {
-      if (page_addr == atomic_load(&last_good_addr[i]))
-        return true;
-    }
-  return false;
+  return atomic_load_explicit (&last_good_addr[_lga_slot (page_addr)],
+                               memory_order_relaxed) == page_addr;
 }
 
 
 /**
  * Adds a known-valid page address to the cache.
  *
- * This implementation is racy as all get-out but the worst case is that cached
- * address get lost, forcing extra unnecessary validation checks.  All of the
- * atomic operations don't matter because of TOCTOU races.
+ * Two threads caching pages which share a slot simply overwrite each other;
+ * the worst case is a lost entry, forcing an extra validation check.
  */
 static void
 _cache_valid_mem(unw_word_t page_addr)
 {
-  unw_word_t zero = 0;
-  int victim = atomic_load(&lga_victim);
-  for (int i = 0; i < NLGA; i++)
-    {
-      if (atomic_compare_exchange_strong(&last_good_addr[victim], &zero, page_addr))
-        {
-          return;
-        }
-      victim = (victim + 1) % NLGA;
-    }
-
-  /* All slots full. Evict the victim. */
-  atomic_store(&last_good_addr[victim], page_addr);
-  victim = (victim + 1) % NLGA;
-  atomic_store(&lga_victim, victim);
+  atomic_store_explicit (&last_good_addr[_lga_slot (page_addr)], page_addr,
+                         memory_order_relaxed);
 }
 #endif
 
@@ -251,6 +367,8 @@ unw_address_is_valid(unw_word_t addr, size_t len)
   if (len == 0)
     return true;
 
+  UNW_STATS_INC (validation_checks);
+
   /*
    * Find the starting address of the page containing the start of the range.
    */
@@ -287,8 +405,13 @@ unw_address_is_valid(unw_word_t addr, size_t len)
     {
       if (!_is_cached_valid_mem(page_addr))
         {
+          if (_is_in_stack_range (addr, len))
+            return true;
+
           /* Check 'addr' in first page to avoid uninitialized memory access. */
-          if (!_write_validate ((page_addr == start_page_addr) ? addr : page_addr))
+          UNW_STATS_INC (validation_syscalls);
+          UNW_PROBE1 (validate_syscall, page_addr);
+          if (!_validate ((page_addr == start_page_addr) ? addr : page_addr))
             {
               Debug(1, "returning false\n");
               return false;
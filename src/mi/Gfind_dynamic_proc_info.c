@@ -36,12 +36,27 @@ local_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
 
 #else /* !UNW_REMOTE_ONLY */
 
+static inline int
+list_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
+                     int need_unwind_info, void *arg,
+                     unw_dyn_info_list_t *list)
+{
+  unw_dyn_info_t *di;
+
+  for (di = list->first; di; di = di->next)
+    if (ip >= di->start_ip && ip < di->end_ip)
+      return unwi_extract_dynamic_proc_info (as, ip, pi, di, need_unwind_info,
+                                             arg);
+  return -UNW_ENOINFO;
+}
+
 static inline int
 local_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
                       int need_unwind_info, void *arg)
 {
   unw_dyn_info_list_t *list;
   unw_dyn_info_t *di;
+  int ret = -UNW_ENOINFO;
 
 #ifndef UNW_LOCAL_ONLY
 # pragma weak _U_dyn_info_list_addr
@@ -51,11 +66,34 @@ local_find_proc_info (unw_addr_space_t as, unw_word_t ip, unw_proc_info_t *pi,
 
   // Access the `_U_dyn_info_list` from `LOCAL_ONLY` library, i.e. libunwind.so.
   list = (unw_dyn_info_list_t *) (uintptr_t) _U_dyn_info_list_addr ();
-  for (di = list->first; di; di = di->next)
-    if (ip >= di->start_ip && ip < di->end_ip)
-      return unwi_extract_dynamic_proc_info (as, ip, pi, di, need_unwind_info,
-                                             arg);
-  return -UNW_ENOINFO;
+  if (!list->first)
+    return -UNW_ENOINFO;
+
+  /* Search the address index kept next to the list, if that library
+     has one.  The lookup is counted in until it is done with what it
+     found, so that _U_deregister_frame() does not free that
+     meanwhile.  */
+#ifndef UNW_LOCAL_ONLY
+# pragma weak _U_dyn_info_find
+# pragma weak _U_dyn_info_lookup_begin
+# pragma weak _U_dyn_info_lookup_end
+  if (!_U_dyn_info_find)
+    return list_find_proc_info (as, ip, pi, need_unwind_info, arg, list);
+#endif
+
+  _U_dyn_info_lookup_begin ();
+  switch (_U_dyn_info_find (ip, &di))
+    {
+    case 1:
+      ret = unwi_extract_dynamic_proc_info (as, ip, pi, di,
+                                            need_unwind_info, arg);
+      break;
+    case -1:
+      ret = list_find_proc_info (as, ip, pi, need_unwind_info, arg, list);
+      break;
+    }
+  _U_dyn_info_lookup_end ();
+  return ret;
 }
 
 #endif /* !UNW_REMOTE_ONLY */
@@ -64,7 +64,9 @@ unw_get_proc_name_by_ip (unw_addr_space_t as, unw_word_t ip,
       if (offp)
         *offp = ip - pi.start_ip;
 
-      switch (di->format)
+      /* Only a procedure descriptor has the unw_dyn_info_t as its
+         unwind info.  */
+      switch (pi.format)
         {
         case UNW_INFO_FORMAT_DYNAMIC:
           ret = intern_string (as, a, di->u.pi.name_ptr, buf, buf_len, arg);
@@ -0,0 +1,166 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "libunwind_i.h"
+
+#ifdef CONFIG_STATS
+
+#ifdef __linux__
+# include <sys/syscall.h>
+#endif
+
+/* Blocks for this many threads are set aside; the threads beyond them
+   share one more block, counting into it with atomic additions.  */
+#define STATS_POOL_BLOCKS       64
+
+HIDDEN thread_local struct unwi_stats_block *unwi_stats_tls
+  __attribute__((tls_model("initial-exec")));
+
+static struct unwi_stats_block stats_pool[STATS_POOL_BLOCKS];
+static struct unwi_stats_block stats_shared = { .shared = 1 };
+
+#ifdef __linux__
+/* Whether the thread ID of process PID has exited.  */
+static int
+stats_thread_gone (long pid, long id)
+{
+  int saved_errno = errno, gone;
+
+  gone = syscall (SYS_tgkill, pid, id, 0) < 0 && errno == ESRCH;
+  errno = saved_errno;
+  return gone;
+}
+#endif
+
+/* Give the calling thread a block to count into: an idle one, or one
+   of a thread which has exited, whose counts stay part of the totals.
+   Without thread IDs to tell the threads apart, all share one block.
+   This may run in a signal handler, so it only takes a block with a
+   compare-and-swap; a block that already has the caller's thread ID
+   was left by an earlier thread with the same ID, or by a claim this
+   one interrupted.
+
+   Only blocks of the caller's own process are taken over.  A child of
+   fork() inherits the block the forking thread counts into, owned by
+   a thread of the parent, which to the child looks exited; were it
+   taken, two threads would count into it without atomic additions.
+   The owner's process is set once the block is taken, so a claim that
+   sees the block before then does not take it either.  */
+HIDDEN struct unwi_stats_block *
+unwi_stats_claim (void)
+{
+  struct unwi_stats_block *b = &stats_shared;
+#ifdef __linux__
+  long self = syscall (SYS_gettid), pid = getpid (), owner;
+  int i;
+
+  for (i = 0; i < STATS_POOL_BLOCKS; ++i)
+    {
+      owner = atomic_load_explicit (&stats_pool[i].owner,
+                                    memory_order_relaxed);
+      if ((owner == 0
+           || (owner == self
+               && atomic_load_explicit (&stats_pool[i].pid,
+                                        memory_order_relaxed) == pid))
+          && atomic_compare_exchange_strong (&stats_pool[i].owner, &owner,
+                                             self))
+        {
+          b = &stats_pool[i];
+          goto out;
+        }
+    }
+  for (i = 0; i < STATS_POOL_BLOCKS; ++i)
+    {
+      owner = atomic_load_explicit (&stats_pool[i].owner,
+                                    memory_order_relaxed);
+      if (atomic_load_explicit (&stats_pool[i].pid,
+                                memory_order_relaxed) == pid
+          && stats_thread_gone (pid, owner)
+          && atomic_compare_exchange_strong (&stats_pool[i].owner, &owner,
+                                             self))
+        {
+          b = &stats_pool[i];
+          goto out;
+        }
+    }
+
+ out:
+  if (b != &stats_shared)
+    atomic_store_explicit (&b->pid, pid, memory_order_relaxed);
+#endif
+  Debug (5, "thread counting into stats block %p\n", b);
+  unwi_stats_tls = b;
+  return b;
+}
+
+static void
+stats_sum (unw_word_t *sum, struct unwi_stats_block *b)
+{
+  size_t i;
+
+  for (i = 0; i < UNWI_STATS_NUM_COUNTERS; ++i)
+    sum[i] += atomic_load_explicit (&b->counters[i], memory_order_relaxed);
+}
+
+#endif /* CONFIG_STATS */
+
+int
+unw_get_stats (unw_addr_space_t as, unw_stats_t *stats)
+{
+#ifdef CONFIG_STATS
+  unw_word_t *sum = (unw_word_t *) stats;
+  int i;
+#endif
+
+  if (!atomic_load(&tdep_init_done))
+    tdep_init ();
+
+  if (!stats)
+    return -UNW_EINVAL;
+
+  memset (stats, 0, sizeof (*stats));
+#ifdef CONFIG_STATS
+  for (i = 0; i < STATS_POOL_BLOCKS; ++i)
+    stats_sum (sum, &stats_pool[i]);
+  stats_sum (sum, &stats_shared);
+#endif
+
+#if !defined(__ia64__)
+  if (as->caching_policy != UNW_CACHE_NONE)
+    {
+      unsigned short log_size = as->global_cache.log_size;
+
+      if (log_size == 0)
+        log_size = DWARF_DEFAULT_LOG_UNW_CACHE_SIZE;
+      stats->rs_cache_size = (unw_word_t) 1 << log_size;
+    }
+#else
+  (void) as;
+#endif
+#ifdef CONFIG_STATS
+  return 0;
+#else
+  /* Only the cache size is known.  */
+  return -UNW_ENOINFO;
+#endif
+}
@@ -0,0 +1,168 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "libunwind_i.h"
+
+#ifndef UNW_REMOTE_ONLY
+# include <link.h>
+#endif
+
+#if !defined(__ia64__)
+
+struct prefetch_state
+  {
+    struct cursor c;            /* scratch cursor for the lookups */
+    unw_word_t *nrows;          /* rows cached, or NULL not to cache */
+    unw_word_t nrows_buf;
+    unw_word_t nprocs;          /* procedures found */
+  };
+
+/* Look up each procedure in [LO, HI).  The lookup of an address
+   without unwind info, like the padding between procedures, says where
+   the next procedure starts; if it does not, the rest of the range is
+   taken to have no unwind info.  */
+static void
+prefetch_range (struct prefetch_state *s, unw_word_t lo, unw_word_t hi)
+{
+  unw_word_t ip = lo, end_ip;
+  int ret;
+
+  while (ip < hi)
+    {
+      ret = dwarf_prefetch_proc (&s->c.dwarf, ip, hi, &end_ip, s->nrows);
+      if (ret >= 0)
+        {
+          /* A full cache would only evict the rows just put in it.  */
+          if (ret > 0)
+            s->nrows = NULL;
+          ++s->nprocs;
+        }
+      if (end_ip <= ip)
+        {
+          Debug (2, "no unwind info from 0x%lx on\n", (long) ip);
+          break;
+        }
+      ip = end_ip;
+    }
+}
+
+#ifndef UNW_REMOTE_ONLY
+
+struct prefetch_segment
+  {
+    unw_word_t lo, hi;          /* the range left to look at */
+    unw_word_t start, end;      /* its lowest part in an object's code */
+  };
+
+static int
+prefetch_find_segment (struct dl_phdr_info *info, size_t size UNUSED,
+                       void *arg)
+{
+  struct prefetch_segment *seg = arg;
+  unw_word_t start, end;
+  int n;
+
+  for (n = 0; n < info->dlpi_phnum; ++n)
+    if (info->dlpi_phdr[n].p_type == PT_LOAD
+        && (info->dlpi_phdr[n].p_flags & PF_X))
+      {
+        start = info->dlpi_addr + info->dlpi_phdr[n].p_vaddr;
+        end = start + info->dlpi_phdr[n].p_memsz;
+        if (start < seg->lo)
+          start = seg->lo;
+        if (end > seg->hi)
+          end = seg->hi;
+        if (start < end && start < seg->start)
+          {
+            seg->start = start;
+            seg->end = end;
+          }
+      }
+  return 0;
+}
+
+#endif /* !UNW_REMOTE_ONLY */
+
+#endif /* !__ia64__ */
+
+int
+unw_prefetch_unwind_info (unw_addr_space_t as, unw_word_t lo, unw_word_t hi,
+                          int flags, void *as_arg)
+{
+  if (!atomic_load(&tdep_init_done))
+    tdep_init ();
+
+  if (flags & ~(UNW_PREFETCH_RS_CACHE | UNW_PREFETCH_TRACE_CACHE))
+    return -UNW_EINVAL;
+
+  /* Only local unwinding traces through the fast-trace caches.  */
+  if ((flags & UNW_PREFETCH_TRACE_CACHE) && as != unw_local_addr_space)
+    return -UNW_EINVAL;
+
+#if !defined(__ia64__)
+  struct prefetch_state s;
+
+  memset (&s, 0, sizeof (s));
+  s.c.dwarf.as = as;
+  s.c.dwarf.as_arg = as_arg;
+  if (flags & UNW_PREFETCH_RS_CACHE)
+    s.nrows = &s.nrows_buf;
+
+#ifndef UNW_REMOTE_ONLY
+  /* Locally, only look at the loaded objects' code, so that [0, ~0)
+     asks for all of it.  */
+  if (as == unw_local_addr_space && as->iterate_phdr_function)
+    {
+      struct prefetch_segment seg;
+
+      seg.lo = lo;
+      seg.hi = hi;
+      for (;;)
+        {
+          seg.start = seg.end = hi;
+          as->iterate_phdr_function (prefetch_find_segment, &seg);
+          if (seg.start >= seg.end)
+            break;
+          prefetch_range (&s, seg.start, seg.end);
+          seg.lo = seg.end;
+        }
+    }
+  else
+#endif
+    prefetch_range (&s, lo, hi);
+
+  Debug (2, "prefetched %lu procedures, %lu rows in [0x%lx, 0x%lx)\n",
+         (long) s.nprocs, (long) s.nrows_buf, (long) lo, (long) hi);
+  if (!s.nprocs)
+    return -UNW_ENOINFO;
+
+  if (flags & UNW_PREFETCH_TRACE_CACHE)
+    return tdep_trace_reserve (s.nprocs);
+  return 0;
+#else
+  (void) lo;
+  (void) hi;
+  (void) as_arg;
+  return -UNW_ENOINFO;
+#endif
+}
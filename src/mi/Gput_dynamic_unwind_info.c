@@ -26,8 +26,8 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 #include "libunwind_i.h"
 
 HIDDEN void
-unwi_put_dynamic_unwind_info (unw_addr_space_t as, unw_proc_info_t *pi,
-                              void *arg)
+unwi_put_dynamic_unwind_info (unw_addr_space_t as UNUSED,
+                              unw_proc_info_t *pi, void *arg UNUSED)
 {
   switch (pi->format)
     {
@@ -44,7 +44,16 @@ unwi_put_dynamic_unwind_info (unw_addr_space_t as, unw_proc_info_t *pi,
 
     case UNW_INFO_FORMAT_TABLE:
     case UNW_INFO_FORMAT_REMOTE_TABLE:
-#ifdef tdep_put_unwind_info
+#if !UNW_TARGET_IA64
+      /* The table was searched like that of a loaded object, which
+         leaves the CIE info from the pool.  */
+      if (pi->unwind_info)
+        {
+          mempool_free (&dwarf_cie_info_pool, pi->unwind_info);
+          pi->unwind_info = NULL;
+        }
+      break;
+#elif defined(tdep_put_unwind_info)
       tdep_put_unwind_info (as, pi, arg);
       break;
 #endif
@@ -26,6 +26,12 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "libunwind_i.h"
 
+#if defined(__ia64__)
+# define MAX_LOG_CACHE_SIZE     15
+#else
+# define MAX_LOG_CACHE_SIZE     DWARF_MAX_LOG_UNW_CACHE_SIZE
+#endif
+
 int
 unw_set_cache_size (unw_addr_space_t as, size_t size, int flag)
 {
@@ -35,14 +41,8 @@ unw_set_cache_size (unw_addr_space_t as, size_t size, int flag)
   if (!atomic_load(&tdep_init_done))
     tdep_init ();
 
-  if (flag != 0)
-    return -1;
-
-  /* Currently not supported for per-thread cache due to memory leak */
-  /* A pthread-key destructor would work, but is not signal safe */
-#if defined(HAVE___THREAD) && HAVE___THREAD
-  return -1;
-#endif
+  if (flag & ~UNW_CACHE_SIZE_ADAPTIVE)
+    return -UNW_EINVAL;
 
   /* Round up to next power of two, slowly but portably */
   while(power < size)
@@ -50,23 +50,40 @@ unw_set_cache_size (unw_addr_space_t as, size_t size, int flag)
       power *= 2;
       log_size++;
       /* Largest size currently supported by rs_cache */
-      if (log_size >= 15)
+      if (log_size >= MAX_LOG_CACHE_SIZE)
         break;
     }
 
 #if !defined(__ia64__)
-  if (log_size == as->global_cache.log_size)
+  struct dwarf_rs_cache *cache = &as->global_cache;
+  unsigned short adaptive = (flag & UNW_CACHE_SIZE_ADAPTIVE) != 0;
+  intrmask_t saved_mask;
+  int ret;
+
+  if (log_size == cache->base_log_size && adaptive == cache->adaptive)
     return 0;   /* no change */
 
-  as->global_cache.log_size = log_size;
-#endif
+  /* Per-thread caches pick up the new size lazily, on their next
+     lookup after the flush below; make sure they can release their
+     memory when the thread exits.  */
+  dwarf_rs_cache_init_thread_key ();
+
+  lock_acquire (&cache->lock, saved_mask);
+  cache->log_size = log_size;
+  cache->base_log_size = log_size;
+  cache->adaptive = adaptive;
 
   /* Ensure caches are empty (and initialized).  */
   unw_flush_cache (as, 0, 0);
-#ifdef __ia64__
-  return 0;
-#else
+
   /* Synchronously purge cache, to ensure memory is allocated */
-  return dwarf_flush_rs_cache(&as->global_cache);
+  ret = dwarf_flush_rs_cache (cache);
+  atomic_store (&cache->generation, atomic_load (&as->cache_generation));
+  lock_release (&cache->lock, saved_mask);
+  return ret;
+#else
+  /* Ensure caches are empty (and initialized).  */
+  unw_flush_cache (as, 0, 0);
+  return 0;
 #endif
 }
@@ -0,0 +1,51 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+#include "libunwind_i.h"
+
+/* Move CURSOR up to the frame whose stack pointer is SP, leaving it as
+   a loop of unw_step() comparing each frame's stack pointer would.
+   Return 1 if the frame was found, 0 if the end of the stack was
+   reached first, or a negative error code.  */
+int
+unwi_step_to_sp (unw_cursor_t *cursor, unw_word_t sp)
+{
+  unw_word_t cur_sp;
+  int ret;
+
+  /* Where the fast trace can find the frame and skip most of the
+     frames below it, that is all there is to do.  */
+  if (tdep_trace_to_sp (cursor, sp) > 0)
+    return 1;
+
+  do
+    {
+      if ((ret = unw_get_reg (cursor, UNW_REG_SP, &cur_sp)) < 0)
+        return ret;
+      if (cur_sp == sp)
+        return 1;
+    }
+  while ((ret = unw_step (cursor)) > 0);
+
+  return ret;
+}
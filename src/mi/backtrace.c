@@ -67,8 +67,9 @@ unw_backtrace (void **buffer, int size)
   if (unlikely (unw_init_local (&cursor, &uc) < 0))
     return 0;
 
-  if (unlikely (tdep_trace (&cursor, buffer, &n) < 0))
+  if (unlikely (tdep_trace (&cursor, buffer, NULL, &n) < 0))
     {
+      UNW_PROBE1 (trace_fallback, n);
       unw_getcontext (&uc);
       return slow_backtrace (buffer, size, &uc, 0);
     }
@@ -108,14 +109,49 @@ unw_backtrace2 (void **buffer, int size, unw_context_t* uc2, int flag)
 
   // returns the number of frames collected by tdep_trace or slow_backtrace
   // and add 1 to it (the one we retrieved above)
-  if (unlikely (tdep_trace (&cursor, buffer, &n) < 0))
+  if (unlikely (tdep_trace (&cursor, buffer, NULL, &n) < 0))
     {
+      UNW_PROBE1 (trace_fallback, n);
       return slow_backtrace (buffer, remaining_size, &uc, flag) + 1;
     }
 
   return n + 1;
 }
 
+/* Deeper stacks are cut short for unw_backtrace_id().  */
+#define BACKTRACE_ID_MAX_DEPTH  256
+
+int
+unw_backtrace_id (uint64_t *id, int size)
+{
+  void *buffer[BACKTRACE_ID_MAX_DEPTH];
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int n, ret;
+
+  if (!id || size <= 0)
+    return -UNW_EINVAL;
+  if (size > BACKTRACE_ID_MAX_DEPTH)
+    size = BACKTRACE_ID_MAX_DEPTH;
+  n = size;
+
+  tdep_getcontext_trace (&uc);
+
+  if (unlikely (unw_init_local (&cursor, &uc) < 0))
+    return -UNW_EUNSPEC;
+
+  if (unlikely (tdep_trace (&cursor, buffer, NULL, &n) < 0))
+    {
+      UNW_PROBE1 (trace_fallback, n);
+      unw_getcontext (&uc);
+      n = slow_backtrace (buffer, size, &uc, 0);
+    }
+
+  if ((ret = unwi_stack_intern (buffer, n, id)) < 0)
+    return ret;
+  return n;
+}
+
 #ifdef CONFIG_WEAK_BACKTRACE
 extern int backtrace (void **buffer, int size)
   WEAK ALIAS(unw_backtrace);
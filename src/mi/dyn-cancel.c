@@ -39,8 +39,41 @@ _U_dyn_cancel (unw_dyn_info_t *di)
 
     if (di->next)
       di->next->prev = di->prev;
+
+    unwi_dyn_index_remove (di);
   }
   mutex_unlock (&_U_dyn_info_list_lock);
 
   di->next = di->prev = NULL;
 }
+
+void
+_U_dyn_cancel_batch (unw_dyn_info_t **di, size_t n)
+{
+  size_t i;
+
+  if (n == 0)
+    return;
+
+  mutex_lock (&_U_dyn_info_list_lock);
+  {
+    ++_U_dyn_info_list.generation;
+
+    for (i = 0; i < n; ++i)
+      {
+        if (di[i]->prev)
+          di[i]->prev->next = di[i]->next;
+        else
+          _U_dyn_info_list.first = di[i]->next;
+
+        if (di[i]->next)
+          di[i]->next->prev = di[i]->prev;
+
+        unwi_dyn_index_remove (di[i]);
+      }
+  }
+  mutex_unlock (&_U_dyn_info_list_lock);
+
+  for (i = 0; i < n; ++i)
+    di[i]->next = di[i]->prev = NULL;
+}
@@ -0,0 +1,483 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Address index of the dynamic unwind info registered in this process.
+
+   The list of registered unw_dyn_info_t stays the record of what is
+   registered, and the only thing remote unwinders read, but searching
+   it takes a walk over every registered region.  Local lookups use
+   this index instead.  It has three levels, each published through a
+   pointer so that lookups need no lock:
+
+     pending	the latest registrations, appended in place
+     recent	a small array sorted by start_ip
+     main	the bulk of the entries, sorted by start_ip
+
+   When PENDING fills up it is merged into a new RECENT, and when that
+   grows past about the square root of the size of MAIN, both are
+   merged into a new MAIN, which keeps the cost of a registration
+   well below that of copying MAIN.  Cancelling clears the descriptor
+   pointer of the entry, which is dropped when its level is next
+   rebuilt.  The index keeps the start_ip and end_ip a descriptor had
+   when it was registered.
+
+   All changes are made under _U_dyn_info_list_lock.  A level which
+   has been replaced is only unmapped once no lookup is in progress,
+   and _U_deregister_frame() frees what it registered the same way.
+   Lookups count themselves in on one of several counters, each on a
+   cache line of its own and picked by thread, so that threads
+   unwinding at once do not all bounce the same line.  */
+
+#include "libunwind_i.h"
+
+#define DYN_PENDING_MAX		32
+#define DYN_RECENT_MIN		256
+#define DYN_READER_SLOTS	16
+#define DYN_CACHE_LINE		64
+
+struct dyn_index_entry
+  {
+    unw_word_t start_ip;
+    unw_word_t end_ip;
+    unw_word_t max_end;		/* largest end_ip up to this entry */
+    unw_word_t seq;		/* registration order */
+    _Atomic (unw_dyn_info_t *) di;	/* NULL once cancelled */
+  };
+
+struct dyn_index_level
+  {
+    struct dyn_index_level *retired_next;
+    size_t size;		/* size of the mapping */
+    size_t max_len;
+    unw_word_t *keys;		/* start_ip of the sorted entries */
+    size_t live;		/* entries not cancelled */
+    _Atomic size_t len;
+    struct dyn_index_entry e[];
+  };
+
+static _Atomic (struct dyn_index_level *) dyn_main;
+static _Atomic (struct dyn_index_level *) dyn_recent;
+static _Atomic (struct dyn_index_level *) dyn_pending;
+static struct
+  {
+    atomic_long n;
+  } __attribute__ ((aligned (DYN_CACHE_LINE))) dyn_readers[DYN_READER_SLOTS];
+static atomic_uint dyn_reader_next;
+/* The counter of this thread, plus one, or 0 if not picked yet.  */
+static thread_local unsigned dyn_reader_slot
+  __attribute__((tls_model("initial-exec")));
+static atomic_int dyn_index_failed;
+
+static struct dyn_index_level *dyn_retired;
+static unw_word_t dyn_seq;
+
+static struct dyn_index_level *
+level_alloc (size_t max_len)
+{
+  struct dyn_index_level *l;
+  size_t size;
+
+  size = sizeof (*l) + max_len * (sizeof (l->e[0]) + sizeof (l->keys[0]));
+  GET_MEMORY (l, size);
+  if (!l)
+    return NULL;
+  l->retired_next = NULL;
+  l->size = size;
+  l->max_len = max_len;
+  l->keys = (unw_word_t *) &l->e[max_len];
+  l->live = 0;
+  atomic_init (&l->len, 0);
+  return l;
+}
+
+/* Count a lookup in for as long as it uses the dynamic unwind info it
+   finds through the index or the list.  */
+static inline atomic_long *
+reader_count (void)
+{
+  unsigned slot = dyn_reader_slot;
+
+  if (unlikely (slot == 0))
+    dyn_reader_slot = slot = atomic_fetch_add_explicit (&dyn_reader_next, 1,
+							memory_order_relaxed)
+				% DYN_READER_SLOTS + 1;
+  return &dyn_readers[slot - 1].n;
+}
+
+void
+_U_dyn_info_lookup_begin (void)
+{
+  atomic_fetch_add (reader_count (), 1);
+}
+
+void
+_U_dyn_info_lookup_end (void)
+{
+  atomic_fetch_sub (reader_count (), 1);
+}
+
+/* Return whether no lookup is counted in.  A lookup ends on the
+   counter it began on, so each counter can be checked on its own.  */
+HIDDEN int
+unwi_dyn_index_idle (void)
+{
+  size_t i;
+
+  for (i = 0; i < DYN_READER_SLOTS; ++i)
+    if (atomic_load (&dyn_readers[i].n) != 0)
+      return 0;
+  return 1;
+}
+
+/* Unmap the replaced levels, unless a lookup may still be looking at
+   them.  The lookups count themselves in before loading the level
+   pointers, so one which starts after the count is seen as zero can
+   only see the levels that replaced these.  */
+static void
+level_reclaim (void)
+{
+  struct dyn_index_level *l;
+
+  if (!unwi_dyn_index_idle ())
+    return;
+  while ((l = dyn_retired))
+    {
+      dyn_retired = l->retired_next;
+      mi_munmap (l, l->size);
+    }
+}
+
+static void
+level_retire (struct dyn_index_level *l)
+{
+  if (!l)
+    return;
+  l->retired_next = dyn_retired;
+  dyn_retired = l;
+}
+
+static inline int
+entry_before (const struct dyn_index_entry *a, const struct dyn_index_entry *b)
+{
+  return (a->start_ip < b->start_ip
+	  || (a->start_ip == b->start_ip && a->seq < b->seq));
+}
+
+static void
+entry_copy (struct dyn_index_level *to, const struct dyn_index_entry *e,
+	    unw_dyn_info_t *di)
+{
+  size_t n = atomic_load_explicit (&to->len, memory_order_relaxed);
+  struct dyn_index_entry *d = &to->e[n];
+
+  d->start_ip = to->keys[n] = e->start_ip;
+  d->end_ip = e->end_ip;
+  d->max_end = e->end_ip;
+  if (n > 0 && to->e[n - 1].max_end > d->max_end)
+    d->max_end = to->e[n - 1].max_end;
+  d->seq = e->seq;
+  atomic_init (&d->di, di);
+  ++to->live;
+  atomic_store_explicit (&to->len, n + 1, memory_order_relaxed);
+}
+
+/* Merge the live entries of the sorted arrays A and B, of which
+   either may be NULL, into a new level.  */
+static struct dyn_index_level *
+level_merge (struct dyn_index_level *a, struct dyn_index_entry *b,
+	     size_t b_len, size_t b_live)
+{
+  struct dyn_index_level *l;
+  size_t i = 0, j = 0, a_len = 0;
+  unw_dyn_info_t *di;
+
+  if (a)
+    a_len = atomic_load_explicit (&a->len, memory_order_relaxed);
+  l = level_alloc ((a ? a->live : 0) + b_live);
+  if (!l)
+    return NULL;
+  while (i < a_len || j < b_len)
+    {
+      if (j == b_len || (i < a_len && entry_before (&a->e[i], &b[j])))
+	{
+	  if ((di = atomic_load_explicit (&a->e[i].di, memory_order_relaxed)))
+	    entry_copy (l, &a->e[i], di);
+	  ++i;
+	}
+      else
+	{
+	  if ((di = atomic_load_explicit (&b[j].di, memory_order_relaxed)))
+	    entry_copy (l, &b[j], di);
+	  ++j;
+	}
+    }
+  return l;
+}
+
+static size_t
+recent_max (size_t main_len)
+{
+  size_t n = DYN_RECENT_MIN;
+
+  while (n * n < (size_t) DYN_PENDING_MAX * main_len)
+    n *= 2;
+  return n;
+}
+
+/* Fold the full PENDING level into RECENT, and RECENT into MAIN when
+   it has grown too large.  Levels are published bottom-up, so that a
+   lookup, which loads them top-down, never misses an entry.  */
+static int
+pending_flush (struct dyn_index_level *pending)
+{
+  struct dyn_index_level *main_l, *recent, *l, *m = NULL, *fresh;
+  struct dyn_index_entry sorted[DYN_PENDING_MAX], t;
+  size_t i, j, len;
+
+  main_l = atomic_load_explicit (&dyn_main, memory_order_relaxed);
+  recent = atomic_load_explicit (&dyn_recent, memory_order_relaxed);
+
+  /* PENDING is still being searched, so sort a copy of it.
+     Registrations mostly come in address order, which makes this
+     cheap.  */
+  len = atomic_load_explicit (&pending->len, memory_order_relaxed);
+  for (i = 0; i < len; ++i)
+    {
+      t.start_ip = pending->e[i].start_ip;
+      t.end_ip = pending->e[i].end_ip;
+      t.seq = pending->e[i].seq;
+      atomic_init (&t.di, atomic_load_explicit (&pending->e[i].di,
+						memory_order_relaxed));
+      for (j = i; j > 0 && entry_before (&t, &sorted[j - 1]); --j)
+	memcpy (&sorted[j], &sorted[j - 1], sizeof (t));
+      memcpy (&sorted[j], &t, sizeof (t));
+    }
+
+  l = level_merge (recent, sorted, len, pending->live);
+  fresh = level_alloc (DYN_PENDING_MAX);
+  if (!l || !fresh)
+    goto fail;
+
+  if (l->live > recent_max (main_l ? main_l->live : 0))
+    {
+      m = level_merge (main_l, l->e,
+		       atomic_load_explicit (&l->len, memory_order_relaxed),
+		       l->live);
+      if (!m)
+	goto fail;
+      level_retire (l);
+      l = NULL;
+      atomic_store (&dyn_main, m);
+      level_retire (main_l);
+    }
+  atomic_store (&dyn_recent, l);
+  atomic_store (&dyn_pending, fresh);
+  level_retire (recent);
+  level_retire (pending);
+  return 0;
+
+ fail:
+  if (l)
+    mi_munmap (l, l->size);
+  if (fresh)
+    mi_munmap (fresh, fresh->size);
+  return -1;
+}
+
+HIDDEN void
+unwi_dyn_index_add (unw_dyn_info_t *di)
+{
+  struct dyn_index_level *pending;
+  struct dyn_index_entry *e;
+  size_t len;
+
+  if (atomic_load_explicit (&dyn_index_failed, memory_order_relaxed))
+    return;
+
+  pending = atomic_load_explicit (&dyn_pending, memory_order_relaxed);
+  if (!pending)
+    {
+      if (!(pending = level_alloc (DYN_PENDING_MAX)))
+	goto fail;
+      atomic_store (&dyn_pending, pending);
+    }
+  else if (atomic_load_explicit (&pending->len, memory_order_relaxed)
+	   == pending->max_len)
+    {
+      if (pending_flush (pending) < 0)
+	goto fail;
+      pending = atomic_load_explicit (&dyn_pending, memory_order_relaxed);
+    }
+
+  len = atomic_load_explicit (&pending->len, memory_order_relaxed);
+  e = &pending->e[len];
+  e->start_ip = di->start_ip;
+  e->end_ip = di->end_ip;
+  e->max_end = di->end_ip;
+  e->seq = ++dyn_seq;
+  atomic_init (&e->di, di);
+  ++pending->live;
+  atomic_store_explicit (&pending->len, len + 1, memory_order_release);
+  level_reclaim ();
+  return;
+
+ fail:
+  /* Lookups walk the list from now on.  */
+  Debug (1, "out of memory for the dynamic unwind info index\n");
+  atomic_store (&dyn_index_failed, 1);
+}
+
+/* Clear the entry for DI in level L.  */
+static int
+level_remove (struct dyn_index_level *l, unw_dyn_info_t *di, int sorted)
+{
+  size_t lo = 0, hi, mid, len;
+
+  if (!l)
+    return 0;
+  len = hi = atomic_load_explicit (&l->len, memory_order_relaxed);
+  if (sorted)
+    while (lo < hi)
+      {
+	mid = (lo + hi) / 2;
+	if (l->keys[mid] < di->start_ip)
+	  lo = mid + 1;
+	else
+	  hi = mid;
+      }
+  for (; lo < len; ++lo)
+    if (atomic_load_explicit (&l->e[lo].di, memory_order_relaxed) == di)
+      {
+	atomic_store_explicit (&l->e[lo].di, NULL, memory_order_relaxed);
+	--l->live;
+	return 1;
+      }
+    else if (sorted && l->e[lo].start_ip > di->start_ip)
+      break;
+  return 0;
+}
+
+HIDDEN void
+unwi_dyn_index_remove (unw_dyn_info_t *di)
+{
+  struct dyn_index_level *pending, *recent, *main_l, *m;
+
+  if (atomic_load_explicit (&dyn_index_failed, memory_order_relaxed))
+    return;
+
+  pending = atomic_load_explicit (&dyn_pending, memory_order_relaxed);
+  recent = atomic_load_explicit (&dyn_recent, memory_order_relaxed);
+  main_l = atomic_load_explicit (&dyn_main, memory_order_relaxed);
+  /* Search the sorted levels in full if DI->start_ip has changed since
+     DI was registered.  */
+  if (!level_remove (pending, di, 0)
+      && !level_remove (recent, di, 1) && !level_remove (main_l, di, 1)
+      && !level_remove (recent, di, 0) && !level_remove (main_l, di, 0))
+    {
+      Debug (1, "dynamic unwind info %p not in the index\n", di);
+      return;
+    }
+
+  /* Drop the cancelled entries of MAIN once they are the majority.  */
+  if (main_l && main_l->live
+      < atomic_load_explicit (&main_l->len, memory_order_relaxed) / 2)
+    {
+      m = NULL;
+      if (main_l->live && !(m = level_merge (main_l, NULL, 0, 0)))
+	return;
+      atomic_store (&dyn_main, m);
+      level_retire (main_l);
+    }
+  level_reclaim ();
+}
+
+static void
+level_search (struct dyn_index_level *l, unw_word_t ip,
+	      unw_dyn_info_t **best, unw_word_t *best_seq)
+{
+  size_t lo = 0, hi, mid;
+  unw_dyn_info_t *di;
+
+  if (!l)
+    return;
+  hi = atomic_load_explicit (&l->len, memory_order_acquire);
+  while (lo < hi)
+    {
+      mid = (lo + hi) / 2;
+      if (l->keys[mid] <= ip)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+  /* Only overlapping regions take more than one step.  */
+  while (lo-- > 0 && l->e[lo].max_end > ip)
+    if (ip < l->e[lo].end_ip && l->e[lo].seq > *best_seq
+	&& (di = atomic_load_explicit (&l->e[lo].di, memory_order_relaxed)))
+      {
+	*best = di;
+	*best_seq = l->e[lo].seq;
+      }
+}
+
+/* Find the most recently registered dynamic unwind info covering IP,
+   as a walk over _U_dyn_info_list would.  Return 1 and set *DIP if
+   there is one, 0 if there is none, or -1 if the index is not usable
+   and the list must be walked.  The caller must be counted in with
+   _U_dyn_info_lookup_begin() until it is done with *DIP.  */
+int
+_U_dyn_info_find (unw_word_t ip, unw_dyn_info_t **dip)
+{
+  struct dyn_index_level *pending, *recent, *main_l;
+  unw_dyn_info_t *best = NULL, *di;
+  unw_word_t best_seq = 0;
+  size_t i, len;
+
+  if (atomic_load_explicit (&dyn_index_failed, memory_order_relaxed))
+    return -1;
+
+  pending = atomic_load (&dyn_pending);
+  recent = atomic_load (&dyn_recent);
+  main_l = atomic_load (&dyn_main);
+
+  if (pending)
+    {
+      len = atomic_load_explicit (&pending->len, memory_order_acquire);
+      for (i = 0; i < len; ++i)
+	if (ip >= pending->e[i].start_ip && ip < pending->e[i].end_ip
+	    && pending->e[i].seq > best_seq
+	    && (di = atomic_load_explicit (&pending->e[i].di,
+					   memory_order_relaxed)))
+	  {
+	    best = di;
+	    best_seq = pending->e[i].seq;
+	  }
+    }
+  level_search (recent, ip, &best, &best_seq);
+  level_search (main_l, ip, &best, &best_seq);
+
+  if (atomic_load_explicit (&dyn_index_failed, memory_order_relaxed))
+    return -1;
+  *dip = best;
+  return best != NULL;
+}
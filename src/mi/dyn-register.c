@@ -39,6 +39,41 @@ _U_dyn_register (unw_dyn_info_t *di)
     if (di->next)
             di->next->prev = di;
     _U_dyn_info_list.first = di;
+
+    unwi_dyn_index_add (di);
+  }
+  mutex_unlock (&_U_dyn_info_list_lock);
+}
+
+void
+_U_dyn_register_batch (unw_dyn_info_t **di, size_t n)
+{
+  size_t i;
+
+  if (n == 0)
+    return;
+
+  /* Chain the batch up first, newest first as _U_dyn_register() would
+     have left it, so that a single store adds all of it to the list a
+     remote unwinder walks.  */
+  for (i = 0; i < n; ++i)
+    {
+      di[i]->next = i > 0 ? di[i - 1] : NULL;
+      di[i]->prev = i + 1 < n ? di[i + 1] : NULL;
+    }
+
+  mutex_lock (&_U_dyn_info_list_lock);
+  {
+    ++_U_dyn_info_list.generation;
+
+    di[0]->next = _U_dyn_info_list.first;
+    if (di[0]->next)
+      di[0]->next->prev = di[0];
+    atomic_thread_fence (memory_order_release);
+    _U_dyn_info_list.first = di[n - 1];
+
+    for (i = 0; i < n; ++i)
+      unwi_dyn_index_add (di[i]);
   }
   mutex_unlock (&_U_dyn_info_list_lock);
 }
@@ -31,6 +31,8 @@ unw_flush_cache (unw_addr_space_t as, unw_word_t lo UNUSED, unw_word_t hi UNUSED
 {
 #if !UNW_TARGET_IA64
   struct unw_debug_frame_list *w = as->debug_frames;
+  struct dwarf_eh_frame_table *t = atomic_exchange (&as->eh_frame_tables, NULL);
+  int i;
 
   while (w)
     {
@@ -39,11 +41,34 @@ unw_flush_cache (unw_addr_space_t as, unw_word_t lo UNUSED, unw_word_t hi UNUSED
       if (w->index)
         mi_munmap (w->index, w->index_size);
 
-      mi_munmap (w->debug_frame, w->debug_frame_size);
+      mi_munmap (w->debug_frame_map, w->debug_frame_map_size);
       mi_munmap (w, sizeof (*w));
       w = n;
     }
   as->debug_frames = NULL;
+
+  while (t)
+    {
+      struct dwarf_eh_frame_table *n = t->next;
+
+      if (t->index)
+        mi_munmap (t->index, t->index_size);
+      mi_munmap (t, sizeof (*t));
+      t = n;
+    }
+
+  /* Like the .debug_frame tables above, the search indexes must not be
+     in use by another thread.  */
+  for (i = 0; i < DWARF_TABLE_INDEXES; ++i)
+    {
+      struct dwarf_table_index_slot *slot = &as->table_indexes.slots[i];
+      struct dwarf_table_index *ix = atomic_exchange (&slot->index, NULL);
+
+      if (ix)
+        mi_munmap (ix, ix->size);
+      atomic_store (&slot->searches, 0);
+      atomic_store (&slot->table, 0);
+    }
 #endif
 
   /* clear dyn_info_list_addr cache: */
@@ -0,0 +1,251 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Registration of the .eh_frame emitted for generated code, in the
+   form JITs pass to libgcc's __register_frame().
+
+   Each registered .eh_frame is indexed once, into a sorted table of
+   its FDEs as in an .eh_frame_hdr, and added to the dynamic unwind info
+   like any other table, so that lookups find the registration through
+   the address index of dyn-index.c and search the table in it.  The
+   registrations are also kept in a hash table keyed by the start of
+   their .eh_frame, for _U_deregister_frame().  Lookups search the
+   table of a registration without a lock, so a deregistered one is
+   only freed once no lookup is in progress, as dyn-index.c does with
+   its levels.  */
+
+#if !defined(UNW_REMOTE_ONLY) && !defined(UNW_LOCAL_ONLY)
+#define UNW_LOCAL_ONLY
+#endif
+#include <libunwind.h>
+#include "libunwind_i.h"
+
+#if !UNW_TARGET_IA64
+
+#include "../dwarf/Gfind_proc_info_i.h"
+
+/* FDEs of a table small enough to be kept in its registration.  */
+#define FRAME_INLINE_FDES       4
+#define FRAME_MIN_BUCKETS       256
+
+struct frame_registration
+  {
+    unw_dyn_info_t di;
+    struct frame_registration *next;    /* in its hash bucket, or retired */
+    unw_word_t eh_frame;
+    size_t table_size;                  /* of the mapped table, or 0 */
+    struct table_entry inline_table[FRAME_INLINE_FDES];
+  };
+
+static define_lock (frame_lock);
+static struct mempool frame_pool;
+static int frame_pool_ready;
+static struct frame_registration **frame_buckets;
+static size_t frame_nbuckets, frame_count;
+static struct frame_registration *frame_retired;
+
+static inline size_t
+frame_hash (unw_word_t eh_frame, size_t nbuckets)
+{
+  /* based on (sqrt(5)/2-1)*2^64 */
+  return (size_t) ((eh_frame * (unw_word_t) 0x9e3779b97f4a7c16ULL)
+                   >> (8 * sizeof (unw_word_t) - 32)) & (nbuckets - 1);
+}
+
+/* Double the hash table, or allocate it.  */
+static int
+frame_buckets_grow (void)
+{
+  size_t n = frame_nbuckets ? 2 * frame_nbuckets : FRAME_MIN_BUCKETS, i;
+  struct frame_registration **b, *r, *next;
+
+  GET_MEMORY (b, n * sizeof (*b));
+  if (!b)
+    return -1;
+  for (i = 0; i < frame_nbuckets; ++i)
+    for (r = frame_buckets[i]; r; r = next)
+      {
+        next = r->next;
+        r->next = b[frame_hash (r->eh_frame, n)];
+        b[frame_hash (r->eh_frame, n)] = r;
+      }
+  if (frame_buckets)
+    mi_munmap (frame_buckets, frame_nbuckets * sizeof (*b));
+  frame_buckets = b;
+  frame_nbuckets = n;
+  return 0;
+}
+
+static void
+frame_free (struct frame_registration *r)
+{
+  if (r->table_size)
+    mi_munmap ((void *) (uintptr_t) r->di.u.rti.table_data, r->table_size);
+  mempool_free (&frame_pool, r);
+}
+
+/* Free the deregistered frames, unless a lookup may still be searching
+   them.  A lookup which starts once none is seen in progress can no
+   longer find them.  Called with frame_lock held.  */
+static void
+frame_reclaim (void)
+{
+  struct frame_registration *r;
+
+  if (!unwi_dyn_index_idle ())
+    return;
+  while ((r = frame_retired))
+    {
+      frame_retired = r->next;
+      frame_free (r);
+    }
+}
+
+void
+_U_register_frame (void *begin)
+{
+  unw_word_t eh_frame = (uintptr_t) begin, range[2];
+  struct frame_registration *r;
+  struct table_entry *table;
+  size_t table_size = 0;
+  long count;
+
+  /* An empty .eh_frame is just its terminator.  */
+  if (!begin || *(const uint32_t *) begin == 0)
+    return;
+
+  if (!atomic_load (&tdep_init_done))
+    tdep_init ();
+
+  count = dwarf_index_eh_frame (eh_frame, range, NULL);
+  if (count <= 0)
+    {
+      Debug (1, "no FDEs in .eh_frame at %p\n", begin);
+      return;
+    }
+
+  mutex_lock (&frame_lock);
+  if (!frame_pool_ready)
+    {
+      mempool_init (&frame_pool, sizeof (*r), 0);
+      frame_pool_ready = 1;
+    }
+  mutex_unlock (&frame_lock);
+
+  r = mempool_alloc (&frame_pool);
+  if (!r)
+    return;
+  table = r->inline_table;
+  if (count > FRAME_INLINE_FDES)
+    {
+      table_size = count * sizeof (*table);
+      GET_MEMORY (table, table_size);
+      if (!table)
+        {
+          mempool_free (&frame_pool, r);
+          return;
+        }
+    }
+
+  memset (&r->di, 0, sizeof (r->di));
+  r->di.start_ip = range[0];
+  r->di.end_ip = range[1];
+  r->di.format = UNW_INFO_FORMAT_IP_OFFSET;
+  r->di.u.rti.segbase = eh_frame;
+  r->di.u.rti.table_len = count * sizeof (*table) / sizeof (unw_word_t);
+  r->di.u.rti.table_data = (uintptr_t) table;
+  r->eh_frame = eh_frame;
+  r->table_size = table_size;
+
+  if (dwarf_index_eh_frame (eh_frame, range, table) != count)
+    {
+      Debug (1, ".eh_frame at %p cannot be indexed\n", begin);
+      frame_free (r);
+      return;
+    }
+
+  Debug (4, "registering .eh_frame at %p, %ld FDEs for 0x%lx-0x%lx\n",
+         begin, count, (long) range[0], (long) range[1]);
+
+  mutex_lock (&frame_lock);
+  if (frame_count >= frame_nbuckets && frame_buckets_grow () < 0)
+    {
+      mutex_unlock (&frame_lock);
+      frame_free (r);
+      return;
+    }
+  r->next = frame_buckets[frame_hash (eh_frame, frame_nbuckets)];
+  frame_buckets[frame_hash (eh_frame, frame_nbuckets)] = r;
+  ++frame_count;
+  _U_dyn_register (&r->di);
+  frame_reclaim ();
+  mutex_unlock (&frame_lock);
+}
+
+void
+_U_deregister_frame (void *begin)
+{
+  unw_word_t eh_frame = (uintptr_t) begin;
+  struct frame_registration **p, *r = NULL;
+
+  mutex_lock (&frame_lock);
+  if (frame_nbuckets)
+    for (p = &frame_buckets[frame_hash (eh_frame, frame_nbuckets)]; *p;
+         p = &(*p)->next)
+      if ((*p)->eh_frame == eh_frame)
+        {
+          r = *p;
+          *p = r->next;
+          --frame_count;
+          _U_dyn_cancel (&r->di);
+          r->next = frame_retired;
+          frame_retired = r;
+          break;
+        }
+  frame_reclaim ();
+  mutex_unlock (&frame_lock);
+
+  if (!r)
+    {
+      Debug (1, ".eh_frame at %p is not registered\n", begin);
+      return;
+    }
+
+  /* The code may be replaced by other code, whose register states must
+     not come from the caches.  */
+  atomic_fetch_add (&unw_local_addr_space->cache_generation, 1);
+}
+
+#else /* UNW_TARGET_IA64 */
+
+void
+_U_register_frame (void *begin UNUSED)
+{
+}
+
+void
+_U_deregister_frame (void *begin UNUSED)
+{
+}
+
+#endif /* UNW_TARGET_IA64 */
@@ -0,0 +1,218 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Interning of the backtraces of unw_backtrace_id().
+
+   A backtrace's ID is a 64-bit hash of its addresses.  The IDs are kept
+   in an open-addressed table and the addresses of each new backtrace
+   are appended to an arena, both in one mapping made the first time it
+   is needed and never freed, so that neither storing nor looking up a
+   backtrace takes a lock and both are safe in a signal handler.
+
+   A thread reserves room in the arena, claims a free slot by writing
+   the ID into it, copies the addresses into the reserved room and then
+   publishes them by writing their offset into the slot, so that a slot
+   is only taken if its addresses fit.  A thread finding the ID already in a slot
+   stops there, even if the addresses are not published yet, so that it
+   never waits on another thread, or on the code it interrupted.  Two
+   backtraces with the same hash share an ID.  */
+
+#if !defined(UNW_REMOTE_ONLY) && !defined(UNW_LOCAL_ONLY)
+#define UNW_LOCAL_ONLY
+#endif
+#include <libunwind.h>
+#include "libunwind_i.h"
+
+#ifndef MAP_NORESERVE
+# define MAP_NORESERVE 0
+#endif
+
+#define STACK_SLOTS             (1 << 18)
+#define STACK_ARENA_WORDS       (1 << 23)
+#define STACK_MAX_PROBES        64
+
+struct stack_store
+  {
+    _Atomic uint64_t ids[STACK_SLOTS];
+    _Atomic uint32_t offsets[STACK_SLOTS]; /* 1 + arena index, or 0 */
+    atomic_size_t arena_top;
+    unw_word_t arena[STACK_ARENA_WORDS];  /* depth, then the addresses */
+  };
+
+static _Atomic (struct stack_store *) stack_store;
+
+static struct stack_store *
+stack_store_get (void)
+{
+  struct stack_store *s, *old = NULL;
+
+  s = atomic_load_explicit (&stack_store, memory_order_acquire);
+  if (likely (s != NULL))
+    return s;
+
+  /* Pages are only backed as the store fills.  */
+  s = mi_mmap (NULL, sizeof (*s), PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (s == MAP_FAILED)
+    return NULL;
+  if (!atomic_compare_exchange_strong (&stack_store, &old, s))
+    {
+      mi_munmap (s, sizeof (*s));
+      s = old;
+    }
+  return s;
+}
+
+static inline uint64_t
+stack_hash (void **ips, int n)
+{
+  uint64_t h = (uint64_t) n * 0x9e3779b97f4a7c15ULL;
+  int i;
+
+  for (i = 0; i < n; ++i)
+    {
+      h ^= (uint64_t) (uintptr_t) ips[i];
+      h *= 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+  h ^= h >> 29;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 32;
+  /* 0 marks a free slot.  */
+  return h ? h : 1;
+}
+
+/* Reserve room for N addresses and their count in the arena of S.
+   Returns the index of the room, or -1 if the arena is full.  */
+static ssize_t
+arena_reserve (struct stack_store *s, int n)
+{
+  size_t top = atomic_load_explicit (&s->arena_top, memory_order_relaxed);
+
+  do
+    if (top + n + 1 > STACK_ARENA_WORDS)
+      return -1;
+  while (!atomic_compare_exchange_weak_explicit (&s->arena_top, &top,
+                                                 top + n + 1,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed));
+  return top;
+}
+
+/* Give back the room at OFF for N addresses, if nothing was reserved
+   after it.  */
+static void
+arena_release (struct stack_store *s, size_t off, int n)
+{
+  size_t top = off + n + 1;
+
+  atomic_compare_exchange_strong_explicit (&s->arena_top, &top, off,
+                                           memory_order_relaxed,
+                                           memory_order_relaxed);
+}
+
+/* Set *ID to the ID of the N addresses at IPS and store them if they
+   are new.  Returns 0, or -UNW_ENOMEM if they could not be stored.  */
+HIDDEN int
+unwi_stack_intern (void **ips, int n, uint64_t *id)
+{
+  struct stack_store *s;
+  uint64_t h = stack_hash (ips, n), cur;
+  ssize_t off = -1;
+  size_t slot;
+  int i;
+
+  *id = h;
+  if (unlikely (!(s = stack_store_get ())))
+    return -UNW_ENOMEM;
+
+  slot = h & (STACK_SLOTS - 1);
+  for (i = 0; i < STACK_MAX_PROBES; ++i, slot = (slot + 1) & (STACK_SLOTS - 1))
+    {
+      cur = atomic_load_explicit (&s->ids[slot], memory_order_acquire);
+      if (cur == h)
+        break;
+      if (cur != 0)
+        continue;
+
+      /* Never claim a slot which would be left without addresses.  */
+      if (off < 0 && (off = arena_reserve (s, n)) < 0)
+        {
+          Debug (1, "stack store arena full\n");
+          return -UNW_ENOMEM;
+        }
+      if (!atomic_compare_exchange_strong (&s->ids[slot], &cur, h))
+        {
+          if (cur == h)
+            break;
+          continue;
+        }
+
+      s->arena[off] = n;
+      memcpy (&s->arena[off + 1], ips, n * sizeof (ips[0]));
+      atomic_store_explicit (&s->offsets[slot], (uint32_t) off + 1,
+                             memory_order_release);
+      return 0;
+    }
+
+  if (off >= 0)
+    arena_release (s, off, n);
+  if (i < STACK_MAX_PROBES)
+    return 0;
+  Debug (1, "stack store table full\n");
+  return -UNW_ENOMEM;
+}
+
+int
+unw_stack_lookup (uint64_t id, void **buffer, int size)
+{
+  struct stack_store *s;
+  size_t slot, off;
+  uint64_t cur;
+  int i, n;
+
+  if (id == 0 || size < 0)
+    return -UNW_EINVAL;
+  if (!(s = atomic_load_explicit (&stack_store, memory_order_acquire)))
+    return -UNW_ENOINFO;
+
+  slot = id & (STACK_SLOTS - 1);
+  for (i = 0; i < STACK_MAX_PROBES; ++i, slot = (slot + 1) & (STACK_SLOTS - 1))
+    {
+      cur = atomic_load_explicit (&s->ids[slot], memory_order_acquire);
+      if (cur == 0)
+        break;
+      if (cur != id)
+        continue;
+
+      off = atomic_load_explicit (&s->offsets[slot], memory_order_acquire);
+      if (off == 0)
+        break;
+      n = (int) s->arena[off - 1];
+      if (n > size)
+        n = size;
+      memcpy (buffer, &s->arena[off], n * sizeof (buffer[0]));
+      return n;
+    }
+  return -UNW_ENOINFO;
+}
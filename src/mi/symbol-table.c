@@ -0,0 +1,323 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Preloaded symbol tables for unw_get_proc_name_preloaded().
+
+   unw_preload_symbols() reads the function symbols of each loaded
+   object, from the same places unw_get_proc_name() would, into a table
+   sorted by address in a mapping of its own, and puts the table at the
+   front of a list.  Tables on the list are never changed or freed, so
+   looking an address up walks the list and searches a table without a
+   lock, a system call or memory allocation, and is safe in a signal
+   handler.  The table of an object loaded over the addresses of an
+   unloaded one shadows the latter's.  */
+
+#if !defined(UNW_REMOTE_ONLY) && !defined(UNW_LOCAL_ONLY)
+#define UNW_LOCAL_ONLY
+#endif
+#include <libunwind.h>
+#include "libunwind_i.h"
+
+#include <limits.h>
+#include <link.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+struct symbol
+  {
+    unw_word_t start, end;
+    unw_word_t name;            /* offset in the table's strings */
+    unw_word_t parent;          /* 1 + index of the closest symbol which
+                                   contains this one's start, or 0 */
+  };
+
+struct symbol_table
+  {
+    struct symbol_table *next;  /* objects preloaded before */
+    size_t size;                /* of the mapping */
+    unw_word_t lo, hi;          /* the object's code */
+    size_t nsyms;
+    char *strings;              /* after the symbols */
+    unw_word_t object;          /* name of the object, in the strings */
+    struct symbol syms[];
+  };
+
+/* Symbols and string bytes counted, or added to the table if there is
+   one.  */
+struct symbol_builder
+  {
+    struct symbol_table *t;
+    size_t nsyms, nchars, max_syms, max_chars;
+  };
+
+static define_lock (symbol_table_lock);
+static _Atomic (struct symbol_table *) symbol_tables;
+
+static void
+symbol_add (void *arg, unw_word_t start, unw_word_t size, const char *name)
+{
+  struct symbol_builder *b = arg;
+  size_t len = strlen (name) + 1;
+
+  /* unw_get_proc_name() finds no address in an empty symbol.  */
+  if (size == 0)
+    return;
+
+  if (b->t)
+    {
+      if (b->nsyms >= b->max_syms || b->nchars + len > b->max_chars)
+        return;
+      b->t->syms[b->nsyms].start = start;
+      b->t->syms[b->nsyms].end = start + size;
+      b->t->syms[b->nsyms].name = b->nchars;
+      memcpy (b->t->strings + b->nchars, name, len);
+    }
+  b->nsyms++;
+  b->nchars += len;
+}
+
+/* Order by address, and the symbols at the same address in the order
+   found, which is that of their names.  */
+static int
+symbol_compare (const void *a, const void *b)
+{
+  const struct symbol *x = a, *y = b;
+
+  if (x->start != y->start)
+    return x->start < y->start ? -1 : 1;
+  return x->name < y->name ? -1 : x->name > y->name;
+}
+
+/* Sort the symbols of T, keep the first of each address, as
+   unw_get_proc_name() would find it, and link each symbol to the one
+   around it.  */
+static void
+symbol_table_sort (struct symbol_table *t)
+{
+  size_t i, n = 0;
+  unw_word_t p;
+
+  qsort (t->syms, t->nsyms, sizeof (t->syms[0]), symbol_compare);
+  for (i = 0; i < t->nsyms; ++i)
+    if (n == 0 || t->syms[i].start != t->syms[n - 1].start)
+      t->syms[n++] = t->syms[i];
+  t->nsyms = n;
+
+  for (i = 0; i < n; ++i)
+    {
+      for (p = i; p && t->syms[p - 1].end <= t->syms[i].start; )
+        p = t->syms[p - 1].parent;
+      t->syms[i].parent = p;
+    }
+}
+
+/* Build the table of the object named OBJECT whose code is at LO to HI.
+   Returns NULL and sets *ERR if it has no symbols or cannot be read.  */
+static struct symbol_table *
+symbol_table_build (unw_word_t lo, unw_word_t hi, const char *object,
+                    int *err)
+{
+  struct symbol_builder b = { NULL, 0, 0, 0, 0 };
+  unsigned long segbase, mapoff;
+  struct symbol_table *t;
+  struct elf_image ei;
+  char file[PATH_MAX];
+  size_t size, len = strlen (object) + 1;
+
+  if (tdep_get_elf_image (unw_local_addr_space, &ei, getpid (), lo,
+                          &segbase, &mapoff, file, sizeof (file), NULL) < 0
+      || elf_w (load_debuginfo) (file, &ei, 1) < 0)
+    {
+      Debug (1, "cannot read %s\n", object);
+      return NULL;
+    }
+
+  elf_w (visit_proc_names_in_image) (unw_local_addr_space, &ei, segbase,
+                                     symbol_add, &b);
+  if (b.nsyms == 0)
+    {
+      mi_munmap (ei.image, ei.size);
+      return NULL;
+    }
+
+  size = (sizeof (*t) + b.nsyms * sizeof (t->syms[0]) + b.nchars + len);
+  GET_MEMORY (t, size);
+  if (!t)
+    {
+      mi_munmap (ei.image, ei.size);
+      *err = -UNW_ENOMEM;
+      return NULL;
+    }
+
+  t->size = size;
+  t->lo = lo;
+  t->hi = hi;
+  t->strings = (char *) &t->syms[b.nsyms];
+  b.max_syms = b.nsyms;
+  b.max_chars = b.nchars;
+  b.nsyms = b.nchars = 0;
+  b.t = t;
+  elf_w (visit_proc_names_in_image) (unw_local_addr_space, &ei, segbase,
+                                     symbol_add, &b);
+  mi_munmap (ei.image, ei.size);
+
+  t->nsyms = b.nsyms;
+  t->object = b.nchars;
+  memcpy (t->strings + t->object, object, len);
+  symbol_table_sort (t);
+  Debug (2, "%zu symbols for %s at 0x%lx-0x%lx\n", t->nsyms, object,
+         (long) lo, (long) hi);
+  return t;
+}
+
+static int
+symbol_table_add (struct dl_phdr_info *info, size_t size UNUSED, void *arg)
+{
+  const char *object = info->dlpi_name ? info->dlpi_name : "";
+  struct symbol_table *t, *head;
+  unw_word_t lo = ~(unw_word_t) 0, hi = 0, start;
+  int n, *err = arg;
+
+  for (n = 0; n < info->dlpi_phnum; ++n)
+    if (info->dlpi_phdr[n].p_type == PT_LOAD
+        && (info->dlpi_phdr[n].p_flags & PF_X))
+      {
+        start = info->dlpi_addr + info->dlpi_phdr[n].p_vaddr;
+        if (start < lo)
+          lo = start;
+        if (start + info->dlpi_phdr[n].p_memsz > hi)
+          hi = start + info->dlpi_phdr[n].p_memsz;
+      }
+  if (lo >= hi)
+    return 0;
+
+  head = atomic_load_explicit (&symbol_tables, memory_order_relaxed);
+  for (t = head; t; t = t->next)
+    if (t->lo == lo && t->hi == hi && strcmp (t->strings + t->object, object) == 0)
+      return 0;
+
+  if ((t = symbol_table_build (lo, hi, object, err)))
+    {
+      t->next = head;
+      atomic_store_explicit (&symbol_tables, t, memory_order_release);
+    }
+  return 0;
+}
+
+int
+unw_preload_symbols (void)
+{
+  intrmask_t saved_mask;
+  int err = 0;
+
+  if (!atomic_load(&tdep_init_done))
+    tdep_init ();
+
+  if (!unw_local_addr_space->iterate_phdr_function)
+    return -UNW_ENOINFO;
+
+  lock_acquire (&symbol_table_lock, saved_mask);
+  unw_local_addr_space->iterate_phdr_function (symbol_table_add, &err);
+  lock_release (&symbol_table_lock, saved_mask);
+  return err;
+}
+
+int
+unw_get_proc_name_preloaded_by_ip (unw_word_t ip, char *buf, size_t buf_len,
+                                   unw_word_t *offp)
+{
+  struct symbol_table *t;
+  const struct symbol *s;
+  const char *name;
+  size_t lo, hi, mid, len;
+
+  if (buf_len > 0)
+    buf[0] = '\0';
+
+  for (t = atomic_load_explicit (&symbol_tables, memory_order_acquire);
+       t; t = t->next)
+    if (ip >= t->lo && ip < t->hi)
+      break;
+  if (!t)
+    return -UNW_ENOINFO;
+
+  /* Find the last symbol starting at or before IP, then the closest
+     one around it which contains IP.  */
+  for (lo = 0, hi = t->nsyms; lo < hi; )
+    {
+      mid = lo + (hi - lo) / 2;
+      if (t->syms[mid].start <= ip)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  while (lo && ip >= t->syms[lo - 1].end)
+    lo = t->syms[lo - 1].parent;
+  if (!lo)
+    return -UNW_ENOINFO;
+
+  s = &t->syms[lo - 1];
+  if (offp)
+    *offp = ip - s->start;
+  if (buf_len == 0)
+    return -UNW_ENOMEM;
+
+  name = t->strings + s->name;
+  len = strlen (name);
+  if (len >= buf_len)
+    {
+      memcpy (buf, name, buf_len - 1);
+      buf[buf_len - 1] = '\0';
+      return -UNW_ENOMEM;
+    }
+  memcpy (buf, name, len + 1);
+  return 0;
+}
+
+int
+unw_get_proc_name_preloaded (unw_cursor_t *cursor, char *buf, size_t buf_len,
+                             unw_word_t *offp)
+{
+  struct cursor *c = (struct cursor *) cursor;
+  unw_word_t ip;
+  int error;
+
+  ip = tdep_get_ip (c);
+#if !defined(__ia64__)
+  if (c->dwarf.use_prev_instr)
+    {
+#if defined(__arm__)
+      /* On arm, the least bit denotes thumb/arm mode, clear it. */
+      ip &= ~(unw_word_t)0x1;
+#endif
+      --ip;
+    }
+#endif
+  error = unw_get_proc_name_preloaded_by_ip (ip, buf, buf_len, offp);
+#if !defined(__ia64__)
+  if (c->dwarf.use_prev_instr && offp != NULL && error == 0)
+    *offp += 1;
+#endif
+  return error;
+}
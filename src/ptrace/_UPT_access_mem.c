@@ -90,6 +90,7 @@ _UPT_access_mem (unw_addr_space_t as UNUSED, unw_word_t addr, unw_word_t *val,
           if (errno)
             return -UNW_EINVAL;
 #endif
+          UNW_PROBE2 (ptrace_read, pid, tmp_addr);
           Debug (16, "mem[%lx] -> %lx\n", (long) tmp_addr, (long) tmp_val);
         }
     }
@@ -115,7 +116,10 @@ _UPT_access_mem (unw_addr_space_t as, unw_word_t addr, unw_word_t *val,
   if (ptrace(PT_IO, pid, (caddr_t)&iod, 0) == -1)
     return -UNW_EINVAL;
   if (!write)
-     Debug (16, "mem[%lx] -> %lx\n", (long) addr, (long) *val);
+    {
+      UNW_PROBE2 (ptrace_read, pid, addr);
+      Debug (16, "mem[%lx] -> %lx\n", (long) addr, (long) *val);
+    }
   return 0;
 }
 #else
@@ -69,21 +69,21 @@ siglongjmp (sigjmp_buf env, int val)
   extern int _UI_longjmp_cont;
   unw_context_t uc;
   unw_cursor_t c;
-  unw_word_t sp;
   int *cont;
 
   if (unw_getcontext (&uc) < 0 || unw_init_local (&c, &uc) < 0)
     abort ();
 
-  do
+  /* Find the frame with the saved stack pointer, and on ia64 the saved
+     backing store pointer too.  */
+  while (unwi_step_to_sp (&c, wp[JB_SP] + _JB_STK_SHIFT) > 0)
     {
-      if (unw_get_reg (&c, UNW_REG_SP, &sp) < 0)
-        abort ();
-      if (sp != (wp[JB_SP] + _JB_STK_SHIFT))
-        continue;
-
       if (!bsp_match (&c, wp))
-        continue;
+        {
+          if (unw_step (&c) <= 0)
+            break;
+          continue;
+        }
 
       /* found the right frame: */
 
@@ -137,7 +137,6 @@ siglongjmp (sigjmp_buf env, int val)
 
       abort ();
     }
-  while (unw_step (&c) > 0);
 
   abort ();
 }
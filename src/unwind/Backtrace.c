@@ -25,16 +25,55 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "unwind-internal.h"
 
+/* The most frames taken from the fast trace.  Deeper stacks are walked
+   on with unw_step(), from a cursor set up at the last traced frame by
+   _Unwind_SyncContext(), so each frame past this many costs a step.  */
+#define TRACE_LEN       128
+
 _Unwind_Reason_Code
 _Unwind_Backtrace (_Unwind_Trace_Fn trace, void *trace_parameter)
 {
   struct _Unwind_Context context;
-  unw_context_t uc;
+  unw_word_t sps[TRACE_LEN];
+  void *ips[TRACE_LEN];
+  unw_context_t uc, trace_uc;
+  unw_cursor_t cursor;
+  int i, n = TRACE_LEN;
   int ret;
 
   if (_Unwind_InitContext (&context, &uc) < 0)
     return _URC_FATAL_PHASE1_ERROR;
 
+  /* Most callbacks only ask for the IP and CFA of each frame, which
+     the fast trace gets from its frame cache.  The cursor is only
+     stepped up to a frame when the callback asks for anything else.
+     The trace writes to the registers of its context on cache misses,
+     so it gets a copy.  */
+  trace_uc = uc;
+  if (unw_init_local (&cursor, &trace_uc) == 0
+      && tdep_trace (&cursor, ips, sps, &n) >= 0)
+    {
+      for (i = 0; i < n; ++i)
+        {
+          context.traced = 1;
+          context.ip = (unw_word_t) (uintptr_t) ips[i];
+          context.sp = sps[i];
+          ++context.lag;
+          if ((*trace) (&context, trace_parameter) != _URC_NO_REASON)
+            return _URC_FATAL_PHASE1_ERROR;
+          if (!context.traced)
+            /* The callback changed the frame, which the trace does not
+               know about.  */
+            break;
+        }
+      if (i == n && n < TRACE_LEN)
+        return _URC_END_OF_STACK;
+      context.traced = 0;
+      _Unwind_SyncContext (&context);
+    }
+  else
+    UNW_PROBE1 (trace_fallback, n);
+
   /* Phase 1 (search phase) */
 
   while (1)
@@ -31,6 +31,7 @@ _Unwind_GetBSP (struct _Unwind_Context *context)
 #ifdef UNW_TARGET_IA64
   unw_word_t val;
 
+  _Unwind_SyncContext (context);
   unw_get_reg (&context->cursor, UNW_IA64_BSP, &val);
   return val;
 #else
@@ -30,6 +30,8 @@ _Unwind_GetCFA (struct _Unwind_Context *context)
 {
   unw_word_t val;
 
+  if (context->traced)
+    return context->sp;
   unw_get_reg (&context->cursor, UNW_REG_SP, &val);
   return val;
 }
@@ -35,6 +35,7 @@ _Unwind_GetGR (struct _Unwind_Context *context, int index)
        stack-pointer after reaching the end of the stack.  */
     return 0;
 
+  _Unwind_SyncContext (context);
   unw_get_reg (&context->cursor, index, &val);
   return val;
 }
@@ -30,6 +30,8 @@ _Unwind_GetIP (struct _Unwind_Context *context)
 {
   unw_word_t val;
 
+  if (context->traced)
+    return context->ip;
   unw_get_reg (&context->cursor, UNW_REG_IP, &val);
   return val;
 }
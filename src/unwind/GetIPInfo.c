@@ -33,6 +33,7 @@ _Unwind_GetIPInfo (struct _Unwind_Context *context, int *ip_before_insn)
 {
   unw_word_t val;
 
+  _Unwind_SyncContext (context);
   unw_get_reg (&context->cursor, UNW_REG_IP, &val);
   *ip_before_insn = unw_is_signal_frame (&context->cursor);
   return val;
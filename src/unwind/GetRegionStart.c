@@ -31,6 +31,7 @@ _Unwind_GetRegionStart (struct _Unwind_Context *context)
   unw_proc_info_t pi;
 
   pi.start_ip = 0;
+  _Unwind_SyncContext (context);
   unw_get_proc_info (&context->cursor, &pi);
   return pi.start_ip;
 }
@@ -25,17 +25,36 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
 #include "unwind-internal.h"
 
+/* Phase 1 notes how many steps up each frame which has a personality
+   routine is, with its IP and that routine, and phase 2 steps a fresh
+   cursor to those frames without looking up their procedure info
+   again.  No other frame has anything to do in phase 2, as there is no
+   stop function.  Past the first TRAIL_LEN such frames, phase 2 goes on
+   walking from the last one noted.  The trail takes 24 bytes per frame
+   on 64-bit targets, rather than a copy of the cursor.  */
+#define TRAIL_LEN       16
+
+struct trail_frame
+  {
+    unw_word_t ip;
+    _Unwind_Personality_Fn personality;
+    unsigned int depth;         /* steps from the thrower */
+  };
+
 _Unwind_Reason_Code
 _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
 {
   uint64_t exception_class = exception_object->exception_class;
+  struct trail_frame trail[TRAIL_LEN];
   _Unwind_Personality_Fn personality;
   struct _Unwind_Context context;
   _Unwind_Reason_Code reason;
+  _Unwind_Action actions;
   unw_proc_info_t pi;
   unw_context_t uc;
   unw_word_t ip;
-  int ret;
+  unsigned int depth = 0;
+  int ret, i, n = 0, overflow = 0;
 
   Debug (1, "(exception_object=%p)\n", exception_object);
 
@@ -56,6 +75,7 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
           else
             return _URC_FATAL_PHASE1_ERROR;
         }
+      ++depth;
 
       if (unw_get_proc_info (&context.cursor, &pi) < 0)
         return _URC_FATAL_PHASE1_ERROR;
@@ -63,6 +83,17 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
       personality = (_Unwind_Personality_Fn) (uintptr_t) pi.handler;
       if (personality)
         {
+          if (n < TRAIL_LEN)
+            {
+              if (unw_get_reg (&context.cursor, UNW_REG_IP,
+                               &trail[n].ip) < 0)
+                return _URC_FATAL_PHASE1_ERROR;
+              trail[n].personality = personality;
+              trail[n++].depth = depth;
+            }
+          else
+            overflow = 1;
+
           reason = (*personality) (_U_VERSION, _UA_SEARCH_PHASE,
                                    exception_class, exception_object,
                                    &context);
@@ -91,9 +122,32 @@ _Unwind_RaiseException (struct _Unwind_Exception *exception_object)
 
   Debug (1, "found handler for IP=%lx; entering cleanup phase\n", (long) ip);
 
-  /* Reset the cursor to the first frame: */
-  if (unw_init_local (&context.cursor, &uc) < 0)
-    return _URC_FATAL_PHASE1_ERROR;
+  /* Phase 2 (cleanup phase), stepping to the frames noted in phase 1.  */
+  if (_Unwind_InitContext (&context, &uc) < 0)
+    return _URC_FATAL_PHASE2_ERROR;
+
+  depth = 0;
+  for (i = 0; i < n; ++i)
+    {
+      for (; depth < trail[i].depth; ++depth)
+        if (unw_step (&context.cursor) <= 0)
+          return _URC_FATAL_PHASE2_ERROR;
+      if (unw_get_reg (&context.cursor, UNW_REG_IP, &ip) < 0
+          || ip != trail[i].ip)
+        return _URC_FATAL_PHASE2_ERROR;
+
+      actions = _UA_CLEANUP_PHASE;
+      if (ip == exception_object->private_2)
+        actions |= _UA_HANDLER_FRAME;
+      if (_Unwind_Phase2_frame (exception_object, &context,
+                                trail[i].personality, actions)
+          != _URC_CONTINUE_UNWIND)
+        return _URC_FATAL_PHASE2_ERROR;
+    }
+
+  /* The handler frame, which installs its context, was not among them.  */
+  if (!overflow)
+    return _URC_FATAL_PHASE2_ERROR;
 
   return _Unwind_Phase2 (exception_object, &context);
 }
@@ -35,7 +35,9 @@ _Unwind_SetGR (struct _Unwind_Context *context, int index,
 #ifdef UNW_TARGET_X86
   index = dwarf_to_unw_regnum(index);
 #endif
+  _Unwind_SyncContext (context);
   unw_set_reg (&context->cursor, index, new_value);
+  context->traced = 0;
 #ifdef UNW_TARGET_IA64
   if (index >= UNW_IA64_GR && index <= UNW_IA64_GR + 127)
     /* Clear the NaT bit. */
@@ -28,7 +28,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 void
 _Unwind_SetIP (struct _Unwind_Context *context, unsigned long new_value)
 {
+  _Unwind_SyncContext (context);
   unw_set_reg (&context->cursor, UNW_REG_IP, new_value);
+  context->traced = 0;
 }
 
 void __libunwind_Unwind_SetIP (struct _Unwind_Context *, unsigned long)
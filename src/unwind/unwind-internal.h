@@ -44,16 +44,83 @@ typedef _Unwind_Reason_Code (*_Unwind_Personality_Fn)
 struct _Unwind_Context {
   unw_cursor_t cursor;
   int end_of_stack;     /* set to 1 if the end of stack was reached */
+  /* While _Unwind_Backtrace() hands out frames from a fast trace, the
+     frame's IP and CFA are in IP and SP, and CURSOR is LAG frames
+     behind it until something needs the cursor itself.  */
+  int traced;
+  int lag;
+  unw_word_t ip, sp;
 };
 
 /* This must be a macro because unw_getcontext() must be invoked from
    the callee, even if optimization (and hence inlining) is turned
    off.  The macro arguments MUST NOT have any side-effects. */
 #define _Unwind_InitContext(context, uc)                                     \
-  ((context)->end_of_stack = 0,                                              \
+  ((context)->end_of_stack = 0, (context)->traced = (context)->lag = 0,      \
    ((unw_getcontext (uc) < 0 || unw_init_local (&(context)->cursor, uc) < 0) \
     ? -1 : 0))
 
+/* Bring the cursor of CONTEXT up to the frame it describes.  More than
+   one frame behind, the cursor is set up from the frame the trace
+   cache finds at its stack pointer, if that is the frame, rather than
+   stepped through every frame on the way.  */
+ALWAYS_INLINE static void
+_Unwind_SyncContext (struct _Unwind_Context *context)
+{
+  unw_cursor_t cursor;
+  unw_word_t ip;
+
+  if (unlikely (context->lag > 1))
+    {
+      cursor = context->cursor;
+      if (tdep_trace_to_sp (&cursor, context->sp) > 0
+          && unw_get_reg (&cursor, UNW_REG_IP, &ip) >= 0
+          && ip == context->ip)
+        {
+          context->cursor = cursor;
+          context->lag = 0;
+        }
+    }
+  for (; unlikely (context->lag > 0); --context->lag)
+    if (unw_step (&context->cursor) <= 0)
+      {
+        context->lag = 0;
+        break;
+      }
+}
+
+/* Call the personality routine of the frame at CONTEXT for the cleanup
+   phase.  Only returns, with _URC_CONTINUE_UNWIND, if unwinding goes on
+   past the frame, or with an error.  */
+ALWAYS_INLINE static _Unwind_Reason_Code
+_Unwind_Phase2_frame (struct _Unwind_Exception *exception_object,
+                      struct _Unwind_Context *context,
+                      _Unwind_Personality_Fn personality,
+                      _Unwind_Action actions)
+{
+  _Unwind_Reason_Code reason;
+
+  reason = (*personality) (_U_VERSION, actions,
+                           exception_object->exception_class,
+                           exception_object, context);
+  if (reason != _URC_CONTINUE_UNWIND)
+    {
+      if (reason == _URC_INSTALL_CONTEXT)
+        {
+          /* we may regain control via _Unwind_Resume() */
+          unw_resume (&context->cursor);
+          abort ();
+        }
+      else
+        return _URC_FATAL_PHASE2_ERROR;
+    }
+  if (actions & _UA_HANDLER_FRAME)
+    /* The personality routine for the handler-frame changed
+       it's mind; that's a no-no... */
+    abort ();
+  return _URC_CONTINUE_UNWIND;
+}
+
 ALWAYS_INLINE static _Unwind_Reason_Code
 _Unwind_Phase2 (struct _Unwind_Exception *exception_object,
                 struct _Unwind_Context *context)
@@ -115,23 +182,9 @@ _Unwind_Phase2 (struct _Unwind_Exception *exception_object,
                 actions |= _UA_HANDLER_FRAME;
             }
 
-          reason = (*personality) (_U_VERSION, actions, exception_class,
-                                   exception_object, context);
-          if (reason != _URC_CONTINUE_UNWIND)
-            {
-              if (reason == _URC_INSTALL_CONTEXT)
-                {
-                  /* we may regain control via _Unwind_Resume() */
-                  unw_resume (&context->cursor);
-                  abort ();
-                }
-              else
-                return _URC_FATAL_PHASE2_ERROR;
-            }
-          if (actions & _UA_HANDLER_FRAME)
-            /* The personality routine for the handler-frame changed
-               it's mind; that's a no-no... */
-            abort ();
+          if (_Unwind_Phase2_frame (exception_object, context, personality,
+                                    actions) != _URC_CONTINUE_UNWIND)
+            return _URC_FATAL_PHASE2_ERROR;
         }
     }
   return _URC_FATAL_PHASE2_ERROR;       /* shouldn't be reached */
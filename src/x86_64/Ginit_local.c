@@ -40,9 +40,10 @@ unw_init_local (unw_cursor_t *cursor, ucontext_t *uc)
 #else /* !UNW_REMOTE_ONLY */
 
 static int
-unw_init_local_common (unw_cursor_t *cursor, ucontext_t *uc, unsigned use_prev_instr)
+unw_init_local_common (unw_cursor_t *cursor, ucontext_t *uc, int flag)
 {
   struct cursor *c = (struct cursor *) cursor;
+  int ret;
 
   if (unlikely (!atomic_load(&tdep_init_done)))
     tdep_init ();
@@ -50,32 +51,28 @@ unw_init_local_common (unw_cursor_t *cursor, ucontext_t *uc, unsigned use_prev_i
   Debug (1, "(cursor=%p)\n", c);
 
   c->dwarf.as = unw_local_addr_space;
-  c->dwarf.as_arg = dwarf_build_as_arg(uc, /*validate*/ 0);
+  c->dwarf.as_arg = dwarf_build_as_arg(uc, (flag & UNW_INIT_VALIDATE) != 0);
   c->frames = 0;
-  return common_init (c, use_prev_instr);
+  ret = common_init (c, !(flag & UNW_INIT_SIGNAL_FRAME));
+  c->frame_pointer_only = (flag & UNW_INIT_FRAME_POINTER) != 0;
+  return ret;
 }
 
 int
 unw_init_local (unw_cursor_t *cursor, ucontext_t *uc)
 {
-  return unw_init_local_common(cursor, uc, 1);
+  return unw_init_local_common(cursor, uc, 0);
 }
 
 int
 unw_init_local2 (unw_cursor_t *cursor, ucontext_t *uc, int flag)
 {
-  if (!flag)
-    {
-      return unw_init_local_common(cursor, uc, 1);
-    }
-  else if (flag == UNW_INIT_SIGNAL_FRAME)
-    {
-      return unw_init_local_common(cursor, uc, 0);
-    }
-  else
+  if (flag & ~(UNW_INIT_SIGNAL_FRAME | UNW_INIT_FRAME_POINTER
+               | UNW_INIT_VALIDATE))
     {
       return -UNW_EINVAL;
     }
+  return unw_init_local_common(cursor, uc, flag);
 }
 
 #endif /* !UNW_REMOTE_ONLY */
@@ -88,20 +88,79 @@ unw_is_signal_frame (unw_cursor_t *cursor)
   return c->sigcontext_format != X86_64_SCF_NONE;
 }
 
+/* Like unw_is_signal_frame(), but also recognise the trampoline by its
+   code, for unw_step() without its unwind info:
+     48 c7 c0 0f 00 00 00   mov $__NR_rt_sigreturn, %rax
+     0f 05                  syscall
+   The IP may be anything here, so locally the code is only read once
+   it is known to be mapped.  */
 HIDDEN int
-x86_64_handle_signal_frame (unw_cursor_t *cursor UNUSED)
+x86_64_is_sigreturn (struct cursor *c)
+{
+  unw_word_t w0, w1, ip = c->dwarf.ip;
+
+  if (c->sigcontext_format != X86_64_SCF_NONE)
+    return 1;
+
+  if (c->dwarf.as == unw_local_addr_space
+      && !unw_address_is_valid (ip, 2 * sizeof (unw_word_t)))
+    return 0;
+  if (dwarf_get (&c->dwarf, DWARF_MEM_LOC (c, ip), &w0) < 0
+      || w0 != 0x0f0000000fc0c748
+      || dwarf_get (&c->dwarf, DWARF_MEM_LOC (c, ip + 8), &w1) < 0)
+    return 0;
+  return (w1 & 0xff) == 0x05;
+}
+
+HIDDEN int
+x86_64_handle_signal_frame (unw_cursor_t *cursor)
 {
-#if UNW_DEBUG /* To silence compiler warnings */
-  /* Should not get here because we now use kernel-provided dwarf
-     information for the signal trampoline and dwarf_step() works.
-     Hence unw_step() should never call this function. Maybe
-     restore old non-dwarf signal handling here, but then the
-     gating on unw_is_signal_frame() needs to be removed. */
   struct cursor *c = (struct cursor *) cursor;
-  Debug(1, "old format signal frame? format=%d addr=0x%lx cfa=0x%lx\n",
-        c->sigcontext_format, c->sigcontext_addr, c->dwarf.cfa);
-#endif
-  return -UNW_EBADFRAME;
+  unw_word_t ucontext = c->dwarf.cfa;
+  int i, ret;
+
+  /* Normally the kernel's unwind info for the trampoline gets
+     dwarf_step() through it; this is for unw_step() without it, as
+     with UNW_INIT_FRAME_POINTER.  The ucontext_t is at the CFA.  */
+  Debug(1, "signal frame, skip over trampoline\n");
+
+  c->sigcontext_format = X86_64_SCF_LINUX_RT_SIGFRAME;
+  c->sigcontext_addr = ucontext;
+  c->frame_info.frame_type = UNW_X86_64_FRAME_SIGRETURN;
+  c->frame_info.cfa_reg_offset = 0;
+
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+    c->dwarf.loc[i] = DWARF_NULL_LOC;
+
+  c->dwarf.loc[RAX] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RAX, 0);
+  c->dwarf.loc[RDX] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RDX, 0);
+  c->dwarf.loc[RCX] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RCX, 0);
+  c->dwarf.loc[RBX] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RBX, 0);
+  c->dwarf.loc[RSI] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RSI, 0);
+  c->dwarf.loc[RDI] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RDI, 0);
+  c->dwarf.loc[RBP] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RBP, 0);
+  c->dwarf.loc[RSP] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RSP, 0);
+  c->dwarf.loc[ R8] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R8, 0);
+  c->dwarf.loc[ R9] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R9, 0);
+  c->dwarf.loc[R10] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R10, 0);
+  c->dwarf.loc[R11] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R11, 0);
+  c->dwarf.loc[R12] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R12, 0);
+  c->dwarf.loc[R13] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R13, 0);
+  c->dwarf.loc[R14] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R14, 0);
+  c->dwarf.loc[R15] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_R15, 0);
+  c->dwarf.loc[RIP] = DWARF_LOC (ucontext + UC_MCONTEXT_GREGS_RIP, 0);
+
+  if ((ret = dwarf_get (&c->dwarf, c->dwarf.loc[RSP], &c->dwarf.cfa)) < 0
+      || (ret = dwarf_get (&c->dwarf, c->dwarf.loc[RIP], &c->dwarf.ip)) < 0)
+    {
+      Debug (2, "returning %d\n", ret);
+      return ret;
+    }
+
+  /* The interrupted instruction has not executed yet.  */
+  c->dwarf.use_prev_instr = 0;
+  c->dwarf.pi_valid = 0;
+  return 0;
 }
 
 #ifndef UNW_REMOTE_ONLY
@@ -28,8 +28,11 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 HIDDEN void
 tdep_stash_frame (struct dwarf_cursor *d, struct dwarf_reg_state *rs)
 {
+  /* Registers in the order of the X86_64_SAVED_* bits.  */
+  static const uint8_t saved_regs[] = { RBX, RBP, R12, R13, R14, R15 };
   struct cursor *c = (struct cursor *) dwarf_to_cursor (d);
   unw_tdep_frame_t *f = &c->frame_info;
+  unsigned int i;
 
   Debug (4, "ip=0x%lx cfa=0x%lx type %d cfa [where=%d val=%ld] cfaoff=%ld"
          " ra=0x%lx rbp [where=%d val=%ld @0x%lx] rsp [where=%d val=%ld @0x%lx]\n",
@@ -67,7 +70,7 @@ tdep_stash_frame (struct dwarf_cursor *d, struct dwarf_reg_state *rs)
       && (rs->reg.where[DWARF_CFA_REG_COLUMN] == DWARF_WHERE_REG)
       && (rs->reg.val[DWARF_CFA_REG_COLUMN] == RBP
           || rs->reg.val[DWARF_CFA_REG_COLUMN] == RSP)
-      && labs((long) rs->reg.val[DWARF_CFA_OFF_COLUMN]) < (1 << 28)
+      && labs((long) rs->reg.val[DWARF_CFA_OFF_COLUMN]) < (1 << 21)
       && DWARF_GET_LOC(d->loc[rs->ret_addr_column]) == d->cfa-8
       && (rs->reg.where[RBP] == DWARF_WHERE_UNDEF
           || rs->reg.where[RBP] == DWARF_WHERE_SAME
@@ -122,4 +125,37 @@ tdep_stash_frame (struct dwarf_cursor *d, struct dwarf_reg_state *rs)
   else {
     Debug (4, " unusual frame\n");
   }
+
+  /* Note which callee-saved registers the frame restores, so that
+     unwi_step_to_sp() can tell which frames it must unw_step() through.
+     Rules other than these may refer to other registers' locations,
+     except in the signal frame and for RBP in an aligned frame, and
+     no other register should be restored outside the signal frame.  */
+  f->saved_regs = 0;
+  f->regs_complex = 0;
+  for (i = 0; i < DWARF_NUM_PRESERVED_REGS; ++i)
+    if (i != RSP && i != RIP && rs->reg.where[i] != DWARF_WHERE_SAME
+        && memchr (saved_regs, i, sizeof (saved_regs)) == NULL
+        && f->frame_type != UNW_X86_64_FRAME_SIGRETURN)
+      f->regs_complex = -1;
+  for (i = 0; i < ARRAY_SIZE (saved_regs); ++i)
+    switch (rs->reg.where[saved_regs[i]])
+    {
+    case DWARF_WHERE_SAME:
+      break;
+
+    case DWARF_WHERE_UNDEF:
+    case DWARF_WHERE_CFAREL:
+    case DWARF_WHERE_CFA:
+      f->saved_regs |= 1 << i;
+      break;
+
+    default:
+      f->saved_regs |= 1 << i;
+      if (f->frame_type != UNW_X86_64_FRAME_SIGRETURN
+          && (f->frame_type != UNW_X86_64_FRAME_ALIGNED
+              || saved_regs[i] != RBP))
+        f->regs_complex = -1;
+      break;
+    }
 }
@@ -302,7 +302,7 @@ _unw_step_fallback(struct cursor *c, unw_cursor_t  *cursor)
 
   /* Try signal frame handling */
   Debug (2, ".. checking for signal trampoline ..\n");
-  if (unw_is_signal_frame (cursor) > 0)
+  if (x86_64_is_sigreturn (c) > 0)
     {
       ret = x86_64_handle_signal_frame(cursor);
       Debug (2, "returning %d\n", ret);
@@ -367,11 +367,141 @@ _unw_step_fallback(struct cursor *c, unw_cursor_t  *cursor)
   return ret;
 }
 
+/**
+ * @brief Record whether the frame stepped to is a signal trampoline.
+ * @param[in] c  Pointer to the unwind cursor
+ *
+ * Without unwind info, unw_is_signal_frame() only knows a trampoline if
+ * unw_step() recognised its code, and the next step then goes through
+ * its ucontext_t.
+ */
+static void
+_fp_mark_signal_frame (struct cursor *c)
+{
+  c->sigcontext_format = X86_64_SCF_NONE;
+#if __linux__
+  if (x86_64_is_sigreturn (c) > 0)
+    tdep_reuse_frame (&c->dwarf, X86_64_SCF_LINUX_RT_SIGFRAME);
+#endif
+}
+
+/**
+ * @brief Step along the %rbp chain only, for UNW_INIT_FRAME_POINTER.
+ * @param[in] c       Pointer to the unwind cursor
+ * @param[in] cursor  Original unwind cursor for signal frame detection
+ *
+ * For code built with -fno-omit-frame-pointer.  No unwind info is looked
+ * up: each frame is taken to have the standard layout of
+ * _try_rbp_frame_walk(), and signal trampolines are recognised by their
+ * code.  Memory is read unchecked unless UNW_INIT_VALIDATE asked for it.
+ *
+ * Only %rip, %rsp and %rbp are recovered; the other callee-saved
+ * registers are unknown after the first step.  The caller of a function
+ * interrupted before it set up its frame, as in a signal handler, is
+ * skipped.
+ *
+ * @returns 1         - success, continue unwinding
+ * @returns 0         - success, end of unwinding detected
+ * @returns otherwise - error
+ */
+static int
+_unw_step_frame_pointer (struct cursor *c, unw_cursor_t *cursor)
+{
+  unw_word_t rbp, prev_rbp, ip;
+  int validate UNUSED = 0;
+  int ret, sig;
+
+#if __linux__
+  /* Past the first frame, _fp_mark_signal_frame() has looked.  */
+  sig = c->frames ? c->sigcontext_format != X86_64_SCF_NONE
+                  : x86_64_is_sigreturn (c) > 0;
+#else
+  sig = x86_64_is_sigreturn (c) > 0;
+#endif
+  if (sig)
+    {
+      ret = x86_64_handle_signal_frame (cursor);
+      Debug (2, "signal frame, returning %d\n", ret);
+      if (ret < 0)
+        return ret;
+      _fp_mark_signal_frame (c);
+      return 1;
+    }
+
+  if ((ret = dwarf_get (&c->dwarf, c->dwarf.loc[RBP], &rbp)) < 0)
+    return ret;
+
+  /* The outermost frame clears %rbp.  Otherwise the chain must go up
+     the stack, or it is not a frame pointer.  */
+  if (rbp == 0)
+    {
+      Debug (2, "NULL %%rbp, end of call stack\n");
+      return 0;
+    }
+  if (rbp < c->dwarf.cfa)
+    {
+      Debug (1, "%%rbp %#010lx is below CFA %#010lx, not a frame pointer\n",
+             rbp, c->dwarf.cfa);
+      return -UNW_EBADFRAME;
+    }
+
+  if (c->dwarf.as == unw_local_addr_space)
+    validate = dwarf_get_validate (&c->dwarf);
+  ACCESS_MEM_FAST (ret, validate, &c->dwarf, rbp, prev_rbp);
+  if (likely (ret >= 0))
+    ACCESS_MEM_FAST (ret, validate, &c->dwarf, rbp + 8, ip);
+  if (unlikely (ret < 0))
+    return ret;
+  if (ip == 0)
+    {
+      Debug (2, "NULL return address, end of call stack\n");
+      return 0;
+    }
+  if (prev_rbp != 0 && prev_rbp <= rbp)
+    {
+      Debug (1, "caller's %%rbp %#010lx not above %#010lx\n", prev_rbp, rbp);
+      return -UNW_EBADFRAME;
+    }
+
+  c->frame_info.frame_type = UNW_X86_64_FRAME_GUESSED;
+  c->frame_info.cfa_reg_rsp = 0;
+  c->frame_info.cfa_reg_offset = 16;
+  c->frame_info.rbp_cfa_offset = -16;
+
+  c->dwarf.loc[RBX] = DWARF_NULL_LOC;
+  c->dwarf.loc[R12] = DWARF_NULL_LOC;
+  c->dwarf.loc[R13] = DWARF_NULL_LOC;
+  c->dwarf.loc[R14] = DWARF_NULL_LOC;
+  c->dwarf.loc[R15] = DWARF_NULL_LOC;
+  c->dwarf.loc[RBP] = DWARF_VAL_LOC (c, prev_rbp);
+  c->dwarf.loc[RIP] = DWARF_MEM_LOC (c, rbp + 8);
+  c->dwarf.loc[RSP] = DWARF_VAL_LOC (c, rbp + 16);
+
+  c->dwarf.cfa = rbp + 16;
+  c->dwarf.ip = ip;
+  c->dwarf.use_prev_instr = 1;
+  c->dwarf.pi_valid = 0;
+  _fp_mark_signal_frame (c);
+  return 1;
+}
+
 int
 unw_step (unw_cursor_t *cursor)
 {
   struct cursor *c = (struct cursor *) cursor;
   int val = 0;
+
+  if (c->frame_pointer_only)
+    {
+      Debug (1, "(cursor=%p, ip=0x%016lx, cfa=0x%016lx) frame pointer\n",
+             c, c->dwarf.ip, c->dwarf.cfa);
+      int ret = _unw_step_frame_pointer (c, cursor);
+      if (ret >= 0)
+        ++c->frames;
+      Debug (2, "returning %d\n", ret);
+      return ret;
+    }
+
 #if CONSERVATIVE_CHECKS
   if (c->dwarf.as == unw_local_addr_space) {
     val = dwarf_get_validate(&c->dwarf);
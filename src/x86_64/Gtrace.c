@@ -36,6 +36,23 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 /* Initial hash table size. Table expands by 2 bits (times four). */
 #define HASH_MIN_BITS 14
 
+/* Frames of the thread's last trace kept for trace_splice().  */
+#define TRACE_STACK_FRAMES 256
+
+/* The caller CFAs and return addresses tdep_trace() found, by the
+   index of the address in its BUFFER.  Entries from FROM on were read
+   from the return address slot at CFA-8; earlier ones may have come
+   from a signal frame.  COMPLETE says the trace reached the outermost
+   frame with all its frames recorded.  */
+struct trace_stack
+{
+  unw_word_t cfa[TRACE_STACK_FRAMES];
+  unw_word_t rip[TRACE_STACK_FRAMES];
+  int depth;
+  int from;
+  int complete;
+};
+
 typedef struct
 {
   unw_tdep_frame_t *frames;
@@ -43,9 +60,12 @@ typedef struct
   size_t used;
   size_t dtor_count;  /* Counts how many times our destructor has already
                          been called. */
+  struct trace_stack *stacks;   /* The last trace and the one being made. */
+  int last_stack;
+  volatile sig_atomic_t stacks_busy;
 } unw_trace_cache_t;
 
-static const unw_tdep_frame_t empty_frame = { 0, UNW_X86_64_FRAME_OTHER, -1, -1, 0, -1, -1 };
+static const unw_tdep_frame_t empty_frame = { 0, UNW_X86_64_FRAME_OTHER, -1, -1, 0, -1, -1, 0, 0 };
 static define_lock (trace_init_lock);
 static pthread_once_t trace_cache_once = PTHREAD_ONCE_INIT;
 static sig_atomic_t trace_cache_once_happen;
@@ -70,6 +90,8 @@ trace_cache_free (void *arg)
   tls_cache_destroyed = 1;
   tls_cache = NULL;
   mi_munmap (cache->frames, (1ULL << cache->log_size) * sizeof(unw_tdep_frame_t));
+  if (cache->stacks)
+    mi_munmap (cache->stacks, 2 * sizeof (struct trace_stack));
   mempool_free (&trace_cache_pool, cache);
   Debug(5, "freed cache %p\n", cache);
 }
@@ -127,9 +149,14 @@ trace_cache_create (void)
     return NULL;
   }
 
+  /* Traces work without the last one, just without reusing it.  */
+  GET_MEMORY (cache->stacks, 2 * sizeof (struct trace_stack));
+
   cache->log_size = HASH_MIN_BITS;
   cache->used = 0;
   cache->dtor_count = 0;
+  cache->last_stack = 0;
+  cache->stacks_busy = 0;
   tls_cache_destroyed = 0;  /* Paranoia: should already be 0. */
   Debug(5, "allocated cache %p\n", cache);
   return cache;
@@ -203,6 +230,20 @@ trace_cache_get (void)
   }
 }
 
+/* Map frame type FRAME_TYPE to its unw_get_stats() counter.  */
+static inline int
+trace_stats_frame (int frame_type)
+{
+  switch (frame_type)
+  {
+  case UNW_X86_64_FRAME_STANDARD:  return UNW_STATS_FRAME_STANDARD;
+  case UNW_X86_64_FRAME_SIGRETURN: return UNW_STATS_FRAME_SIGRETURN;
+  case UNW_X86_64_FRAME_GUESSED:   return UNW_STATS_FRAME_GUESSED;
+  case UNW_X86_64_FRAME_ALIGNED:   return UNW_STATS_FRAME_SPECIAL;
+  default:                         return UNW_STATS_FRAME_OTHER;
+  }
+}
+
 /* Initialise frame properties for address cache slot F at address
    RIP using current CFA, RBP and RSP values.  Modifies CURSOR to
    that location, performs one unw_step(), and fills F with what
@@ -228,6 +269,8 @@ trace_init_addr (unw_tdep_frame_t *f,
   f->cfa_reg_offset = 0;
   f->rbp_cfa_offset = -1;
   f->rsp_cfa_offset = -1;
+  f->saved_regs = 0;
+  f->regs_complex = 0;
 
   /* Reinitialise cursor to this instruction - but undo next/prev RIP
      adjustment because unw_step will redo it - and force RIP, RBP
@@ -297,6 +340,7 @@ trace_lookup (unw_cursor_t *cursor,
     if (likely(addr == rip))
     {
       Debug (4, "found address after %ld steps\n", i);
+      UNW_STATS_INC_FRAME (trace_hits, trace_stats_frame (frame->frame_type));
       return frame;
     }
 
@@ -328,7 +372,159 @@ trace_lookup (unw_cursor_t *cursor,
   if (! addr)
     ++cache->used;
 
-  return trace_init_addr (frame, cursor, cfa, rip, rbp, rsp);
+  frame = trace_init_addr (frame, cursor, cfa, rip, rbp, rsp);
+  UNW_STATS_INC_FRAME (trace_misses, trace_stats_frame (frame->frame_type));
+  return frame;
+}
+
+/* Evaluate CFA, RIP, RBP and RSP of the caller of the frame described
+   by F, whose values are in *CFAP, *RIPP, *RBPP and *RSPP, and update
+   them and D's use_prev_instr.  Returns a negative value if memory
+   could not be read, or -UNW_ESTOPUNWIND if the frame cannot be
+   traced.  */
+static ALWAYS_INLINE int
+trace_advance (struct dwarf_cursor *d,
+               unw_tdep_frame_t *f,
+               unw_word_t *cfap,
+               unw_word_t *ripp,
+               unw_word_t *rbpp,
+               unw_word_t *rspp)
+{
+  unw_word_t cfa = *cfap, rip = *ripp, rbp = *rbpp, rsp = *rspp;
+  int validate UNUSED = 0;
+  int ret = 0;
+
+  switch (f->frame_type)
+  {
+  case UNW_X86_64_FRAME_GUESSED:
+    /* Fall thru to standard processing after forcing validation. */
+    if (d->as == unw_local_addr_space)
+      dwarf_set_validate(d, 1);
+    FALLTHROUGH;
+
+  case UNW_X86_64_FRAME_STANDARD:
+    /* Advance standard traceable frame. */
+    cfa = (f->cfa_reg_rsp ? rsp : rbp) + f->cfa_reg_offset;
+    if (d->as == unw_local_addr_space)
+      validate = dwarf_get_validate(d);
+    ACCESS_MEM_FAST(ret, validate, d, cfa - 8, rip);
+    if (likely(ret >= 0) && likely(f->rbp_cfa_offset != -1))
+      ACCESS_MEM_FAST(ret, validate, d, cfa + f->rbp_cfa_offset, rbp);
+
+    /* Don't bother reading RSP from DWARF, CFA becomes new RSP. */
+    rsp = cfa;
+
+    /* Next frame needs to back up for unwind info lookup. */
+    d->use_prev_instr = 1;
+    break;
+
+  case UNW_X86_64_FRAME_SIGRETURN:
+    cfa = cfa + f->cfa_reg_offset; /* cfa now points to ucontext_t.  */
+
+    if (d->as == unw_local_addr_space)
+      validate = dwarf_get_validate(d);
+    ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RIP, rip);
+    if (likely(ret >= 0))
+      ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RBP, rbp);
+    if (likely(ret >= 0))
+      ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RSP, rsp);
+
+    /* Resume stack at signal restoration point. The stack is not
+       necessarily continuous here, especially with sigaltstack(). */
+    cfa = rsp;
+
+    /* Next frame should not back up. */
+    d->use_prev_instr = 0;
+    break;
+
+  case UNW_X86_64_FRAME_ALIGNED:
+    /* Address of RIP was pushed on the stack via a simple
+     * def_cfa_expr - result stack offset stored in cfa_reg_offset */
+    cfa = (f->cfa_reg_rsp ? rsp : rbp) + f->cfa_reg_offset;
+    if (d->as == unw_local_addr_space)
+      validate = dwarf_get_validate(d);
+    ACCESS_MEM_FAST(ret, validate, d, cfa, cfa);
+    if (likely(ret >= 0))
+      ACCESS_MEM_FAST(ret, validate, d, cfa - 8, rip);
+    if (likely(ret >= 0))
+      ACCESS_MEM_FAST(ret, validate, d, rbp, rbp);
+
+    /* Don't bother reading RSP from DWARF, CFA becomes new RSP. */
+    rsp = cfa;
+
+    /* Next frame needs to back up for unwind info lookup. */
+    d->use_prev_instr = 1;
+
+    break;
+
+  default:
+    return -UNW_ESTOPUNWIND;
+  }
+
+  *cfap = cfa;
+  *ripp = rip;
+  *rbpp = rbp;
+  *rspp = rsp;
+  return ret;
+}
+
+/* See if the caller CFA and return address CFA and RIP just found at
+   index DEPTH of BUFFER belong to LAST, the previous trace of this
+   thread, and if so complete the trace from it.  Sampling profilers
+   mostly see stacks of which only the innermost frames changed since
+   the last sample.
+
+   The frame is taken to be the same as in LAST if it has the same CFA
+   and return address there.  Its callers in LAST are taken to be
+   still live if each of their return address slots still holds the
+   address LAST has for it, which is checked.  *MATCH is the index in
+   LAST to search from; CFAs grow towards the outermost frame.
+
+   Returns the number of frames copied to BUFFER and SPS after DEPTH,
+   which may be 0 if LAST ended there, or -1 if the walk must go on.  */
+static int
+trace_splice (struct dwarf_cursor *d, const struct trace_stack *last,
+              int *match, unw_word_t cfa, unw_word_t rip,
+              void **buffer, unw_word_t *sps, int depth, int maxdepth)
+{
+  unw_word_t addr;
+  int i = *match, j, n, ret;
+
+  if (i > last->from && cfa <= last->cfa[i - 1])
+    i = last->from;
+  while (i < last->depth && last->cfa[i] < cfa)
+    ++i;
+  *match = i;
+  if (i >= last->depth || last->cfa[i] != cfa || last->rip[i] != rip)
+    return -1;
+
+  /* An incomplete trace can only be used if it has enough frames.  */
+  n = last->depth - i - 1;
+  if (n > maxdepth - depth - 1)
+    n = maxdepth - depth - 1;
+  else if (! last->complete)
+    return -1;
+
+  for (j = i + 1; j <= i + n; ++j)
+  {
+    ACCESS_MEM_FAST(ret, 0, d, last->cfa[j] - 8, addr);
+    if (ret < 0 || addr != last->rip[j])
+    {
+      Debug (3, "frame %d at cfa 0x%lx changed\n", j, last->cfa[j]);
+      *match = j + 1;
+      return -1;
+    }
+  }
+
+  Debug (2, "depth %d is frame %d of last trace, reusing %d frames\n",
+         depth, i, n);
+  for (j = 0; j < n; ++j)
+  {
+    if (sps)
+      sps[depth + 1 + j] = last->cfa[i + 1 + j];
+    buffer[depth + 1 + j] = (void *) last->rip[i + 1 + j];
+  }
+  return n;
 }
 
 /* Fast stack backtrace for x86-64.
@@ -341,6 +537,10 @@ trace_lookup (unw_cursor_t *cursor,
    stored into BUFFER. Uses an internal thread-specific cache to
    accelerate queries.
 
+   If SPS is not NULL, the stack pointer of each frame, as
+   unw_get_reg() gives it for UNW_REG_SP, is stored to it at the same
+   index as the frame's address in BUFFER.
+
    The caller should fall back to a unw_step() loop if this function
    fails by returning -UNW_ESTOPUNWIND, meaning the routine hit a
    stack frame that is too complex to be traced in the fast path.
@@ -367,6 +567,10 @@ trace_lookup (unw_cursor_t *cursor,
    e.g. if there is no more unwind information; this is not reported
    as an error.
 
+   When tracing the local address space, the outer frames the trace
+   shares with the previous trace of the calling thread are copied
+   from that, instead of being walked again; see trace_splice().
+
    The function returns a negative value for errors, -UNW_ESTOPUNWIND
    if tracing stopped because of an unusual frame unwind info.  The
    BUFFER and *SIZE reflect tracing progress up to the error frame.
@@ -381,7 +585,7 @@ trace_lookup (unw_cursor_t *cursor,
 
      unw_getcontext(&ctx);
      unw_init_local(&cur, &ctx);
-     if ((ret = unw_tdep_trace(&cur, addrs, &depth)) < 0)
+     if ((ret = unw_tdep_trace(&cur, addrs, NULL, &depth)) < 0)
      {
        depth = 0;
        unw_getcontext(&ctx);
@@ -395,16 +599,19 @@ trace_lookup (unw_cursor_t *cursor,
      }
 */
 HIDDEN int
-tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
+tdep_trace (unw_cursor_t *cursor, void **buffer, unw_word_t *sps,
+            int *size)
 {
   struct cursor *c = (struct cursor *) cursor;
   struct dwarf_cursor *d = &c->dwarf;
   unw_trace_cache_t *cache;
+  struct trace_stack *last = NULL, *next = NULL;
   unw_word_t rbp, rsp, rip, cfa;
   int maxdepth = 0;
   int depth = 0;
+  int match = 0;
+  int spliced = -1;
   int ret;
-  int validate UNUSED = 0;
 
   /* Check input parameters. */
   if (unlikely(! cursor || ! buffer || ! size || (maxdepth = *size) <= 0))
@@ -412,6 +619,15 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
 
   Debug (1, "begin ip 0x%lx cfa 0x%lx\n", d->ip, d->cfa);
 
+  /* The cache is filled from unwind info, which the caller asked us
+     not to use; unw_step() walks the frame pointers instead.  */
+  if (c->frame_pointer_only)
+  {
+    Debug (1, "returning %d, frame pointer walk\n", -UNW_ENOINFO);
+    *size = 0;
+    return -UNW_ENOINFO;
+  }
+
   /* Tell core dwarf routines to call back to us. */
   d->stash_frames = 1;
 
@@ -431,6 +647,19 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     return -UNW_ENOMEM;
   }
 
+  /* Record this trace, and use the last one, unless we interrupted a
+     trace on this thread in a signal handler.  */
+  if (cache->stacks && d->as == unw_local_addr_space
+      && d->as->caching_policy != UNW_CACHE_NONE && ! cache->stacks_busy)
+  {
+    cache->stacks_busy = 1;
+    atomic_signal_fence (memory_order_seq_cst);
+    last = &cache->stacks[cache->last_stack];
+    next = &cache->stacks[! cache->last_stack];
+    next->depth = next->from = 0;
+    match = last->from;
+  }
+
   /* Trace the stack upwards, starting from current RIP.  Adjust
      the RIP address for previous/next instruction as the main
      unwinding logic would also do.  We undo this before calling
@@ -451,6 +680,7 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
     /* If we don't have information for this frame, give up. */
     if (unlikely(! f))
     {
+      UNW_STATS_INC_FRAME (trace_aborts, UNW_STATS_FRAME_OTHER);
       ret = -UNW_ENOINFO;
       break;
     }
@@ -471,90 +701,255 @@ tdep_trace (unw_cursor_t *cursor, void **buffer, int *size)
       break;
 
     /* Evaluate CFA and registers for the next frame. */
-    switch (f->frame_type)
+    ret = trace_advance (d, f, &cfa, &rip, &rbp, &rsp);
+    if (unlikely(ret == -UNW_ESTOPUNWIND))
     {
-    case UNW_X86_64_FRAME_GUESSED:
-      /* Fall thru to standard processing after forcing validation. */
-      if (d->as == unw_local_addr_space)
-        dwarf_set_validate(d, 1);
-      FALLTHROUGH;
-
-    case UNW_X86_64_FRAME_STANDARD:
-      /* Advance standard traceable frame. */
-      cfa = (f->cfa_reg_rsp ? rsp : rbp) + f->cfa_reg_offset;
-      if (d->as == unw_local_addr_space)
-        validate = dwarf_get_validate(d);
-      ACCESS_MEM_FAST(ret, validate, d, cfa - 8, rip);
-      if (likely(ret >= 0) && likely(f->rbp_cfa_offset != -1))
-        ACCESS_MEM_FAST(ret, validate, d, cfa + f->rbp_cfa_offset, rbp);
+      /* We cannot trace through this frame, give up and tell the
+         caller we had to stop.  Data collected so far may still be
+         useful to the caller, so let it know how far we got.  */
+      UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
+      break;
+    }
 
-      /* Don't bother reading RSP from DWARF, CFA becomes new RSP. */
-      rsp = cfa;
+    Debug (4, "new cfa 0x%lx rip 0x%lx rsp 0x%lx rbp 0x%lx\n",
+           cfa, rip, rsp, rbp);
 
-      /* Next frame needs to back up for unwind info lookup. */
-      d->use_prev_instr = 1;
+    /* If we failed or ended up somewhere bogus, stop. */
+    if (unlikely(ret < 0 || rip < 0x4000))
+    {
+      if (ret < 0)
+        UNW_STATS_INC_FRAME (trace_aborts, trace_stats_frame (f->frame_type));
       break;
+    }
+
+    /* Record this address in stack trace. We skipped the first address. */
+    if (sps)
+      sps[depth] = rsp;
+    buffer[depth] = (void *) rip;
+
+    if (next)
+    {
+      /* The return address of a signal frame is not at CFA-8.  */
+      if (f->frame_type == UNW_X86_64_FRAME_SIGRETURN)
+        next->from = depth + 1;
+      else if ((spliced = trace_splice (d, last, &match, cfa, rip, buffer,
+                                        sps, depth, maxdepth)) >= 0)
+      {
+        UNW_STATS_ADD (trace_spliced, spliced);
+        depth += 1 + spliced;
+        break;
+      }
+      if (depth < TRACE_STACK_FRAMES)
+      {
+        next->cfa[depth] = cfa;
+        next->rip[depth] = rip;
+        next->depth = depth + 1;
+      }
+    }
+    ++depth;
+  }
 
-    case UNW_X86_64_FRAME_SIGRETURN:
-      cfa = cfa + f->cfa_reg_offset; /* cfa now points to ucontext_t.  */
+  if (next)
+  {
+    /* Keep what was copied from the last trace too, and swap.  */
+    if (spliced >= 0)
+    {
+      int i, from = depth - 1 - spliced;
+
+      for (i = from; i < depth && i < TRACE_STACK_FRAMES; ++i)
+      {
+        next->cfa[i] = last->cfa[match + i - from];
+        next->rip[i] = last->rip[match + i - from];
+        next->depth = i + 1;
+      }
+    }
+    next->complete = (ret >= 0 && depth < maxdepth && next->depth == depth
+                      && (spliced < 0 || last->complete));
+    cache->last_stack = ! cache->last_stack;
+    atomic_signal_fence (memory_order_seq_cst);
+    cache->stacks_busy = 0;
+  }
 
-      if (d->as == unw_local_addr_space)
-        validate = dwarf_get_validate(d);
-      ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RIP, rip);
-      if (likely(ret >= 0))
-        ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RBP, rbp);
-      if (likely(ret >= 0))
-        ACCESS_MEM_FAST(ret, validate, d, cfa + UC_MCONTEXT_GREGS_RSP, rsp);
+  Debug (1, "returning %d, depth %d\n", ret, depth);
+  *size = depth;
+  return ret;
+}
 
-      /* Resume stack at signal restoration point. The stack is not
-         necessarily continuous here, especially with sigaltstack(). */
-      cfa = rsp;
+/* Trace state of a frame tdep_trace_to_sp() has to step through.  */
+struct trace_frame
+{
+  unw_word_t cfa, rip, rbp, rsp;
+  int depth;
+  int use_prev_instr;
+};
 
-      /* Next frame should not back up. */
-      d->use_prev_instr = 0;
-      break;
+/* A frame which sets every register, in the bit after X86_64_SAVED_*.  */
+#define TRACE_BARRIER           (X86_64_SAVED_ALL + 1)
 
-    case UNW_X86_64_FRAME_ALIGNED:
-      /* Address of RIP was pushed on the stack via a simple
-       * def_cfa_expr - result stack offset stored in cfa_reg_offset */
-      cfa = (f->cfa_reg_rsp ? rsp : rbp) + f->cfa_reg_offset;
-      if (d->as == unw_local_addr_space)
-        validate = dwarf_get_validate(d);
-      ACCESS_MEM_FAST(ret, validate, d, cfa, cfa);
-      if (likely(ret >= 0))
-        ACCESS_MEM_FAST(ret, validate, d, cfa - 8, rip);
-      if (likely(ret >= 0))
-        ACCESS_MEM_FAST(ret, validate, d, rbp, rbp);
+/* Step C from the frame T, taking the registers' locations C has.  As
+   in a unw_step() loop, the signal context address is left as the last
+   signal frame stepped through set it, which unw_resume() goes by.  */
+static int
+trace_step_from (struct cursor *c, const struct cursor *orig,
+                 const struct trace_frame *t)
+{
+  c->dwarf.ip = t->rip;
+  c->dwarf.cfa = t->cfa;
+  c->dwarf.use_prev_instr = t->use_prev_instr;
+  c->dwarf.pi_valid = 0;
+  c->dwarf.loc[RIP] = DWARF_VAL_LOC (&c->dwarf, t->rip);
+  c->dwarf.loc[RBP] = DWARF_VAL_LOC (&c->dwarf, t->rbp);
+  c->dwarf.loc[RSP] = DWARF_VAL_LOC (&c->dwarf, t->rsp);
+  c->frames = orig->frames + t->depth;
+  c->sigcontext_format = X86_64_SCF_NONE;
+  return unw_step ((unw_cursor_t *) c);
+}
 
-      /* Don't bother reading RSP from DWARF, CFA becomes new RSP. */
-      rsp = cfa;
+/* Move CURSOR up to the frame whose stack pointer is SP, leaving it as
+   a unw_step() loop would.  The frame is found with the trace cache.
+   Of the frames below it, only the one below it and those which last
+   restored a callee-saved register are unw_step()ped through, each
+   on its own, in order.  Returns 1 if CURSOR is at SP, or 0 if the
+   frame was not found or the stack has a frame which has to be
+   stepped through otherwise, and the caller should use unw_step().  */
+HIDDEN int
+tdep_trace_to_sp (unw_cursor_t *cursor, unw_word_t sp)
+{
+  struct cursor *c = (struct cursor *) cursor;
+  struct cursor scratch, step;
+  struct dwarf_cursor *d = &scratch.dwarf;
+  struct trace_frame frame, from[7], *order[8], *t; /* from[1] is RBP */
+  unw_word_t rbp, rsp, rip, cfa;
+  unw_trace_cache_t *cache;
+  unw_tdep_frame_t *f;
+  unsigned int touched = 0, regs;
+  dwarf_loc_t rbp_loc;
+  ucontext_t uc;
+  int depth, i, j, n;
 
-      /* Next frame needs to back up for unwind info lookup. */
-      d->use_prev_instr = 1;
+  if (c->dwarf.as != unw_local_addr_space || c->frame_pointer_only)
+    return 0;
 
-      break;
+  if (unlikely(! (cache = trace_cache_get())))
+    return 0;
 
-    default:
-      /* We cannot trace through this frame, give up and tell the
-         caller we had to stop.  Data collected so far may still be
-         useful to the caller, so let it know how far we got.  */
-      Debug (1, "returning UNW_ESTOPUNWIND, depth %d\n", depth);
-      *size = depth;
-      return -UNW_ESTOPUNWIND;
+  /* Filling the cache reinitialises the cursor and writes registers
+     through it, so trace on a copy of the cursor and its context.  */
+  scratch = *c;
+  uc = *dwarf_get_uc (&c->dwarf);
+  d->as_arg = dwarf_build_as_arg (&uc, dwarf_get_validate (&c->dwarf));
+  d->stash_frames = 1;
+
+  rip = d->ip;
+  rsp = cfa = d->cfa;
+  if (dwarf_get (d, d->loc[RBP], &rbp) < 0)
+    return 0;
+
+  Debug (1, "begin ip 0x%lx cfa 0x%lx sp 0x%lx\n", rip, cfa, sp);
+
+  for (depth = 0; rsp != sp; ++depth)
+  {
+    frame.cfa = cfa;
+    frame.rip = rip;
+    frame.rbp = rbp;
+    frame.rsp = rsp;
+    frame.depth = depth;
+    frame.use_prev_instr = d->use_prev_instr;
+
+    rip -= d->use_prev_instr;
+    f = trace_lookup ((unw_cursor_t *) &scratch, cache, cfa, rip, rbp, rsp);
+    if (unlikely(! f || f->last_frame || f->regs_complex))
+    {
+      Debug (2, "frame at depth %d cannot be skipped\n", depth);
+      return 0;
     }
 
-    Debug (4, "new cfa 0x%lx rip 0x%lx rsp 0x%lx rbp 0x%lx\n",
-           cfa, rip, rsp, rbp);
+    /* Remember the frame which last touched each register.  A signal
+       frame restores every register, and an RBP-walked one RBP.  */
+    regs = f->saved_regs;
+    if (f->frame_type == UNW_X86_64_FRAME_SIGRETURN)
+      regs = X86_64_SAVED_ALL | TRACE_BARRIER;
+    else if (f->frame_type == UNW_X86_64_FRAME_GUESSED)
+      regs |= X86_64_SAVED_RBP;
+    touched |= regs;
+    for (i = 0; regs; ++i, regs >>= 1)
+      if (regs & 1)
+        from[i] = frame;
+
+    if (unlikely(trace_advance (d, f, &cfa, &rip, &rbp, &rsp) < 0
+                 || rip < 0x4000
+                 || (rsp <= frame.rsp
+                     && f->frame_type != UNW_X86_64_FRAME_SIGRETURN)))
+    {
+      Debug (2, "trace stopped at depth %d\n", depth);
+      return 0;
+    }
+  }
 
-    /* If we failed or ended up somewhere bogus, stop. */
-    if (unlikely(ret < 0 || rip < 0x4000))
-      break;
+  if (depth == 0)
+    return 1;
 
-    /* Record this address in stack trace. We skipped the first address. */
-    buffer[depth++] = (void *) rip;
+  /* Order the frames to step through by depth, ending with the frame
+     below SP, which gives the locations of RIP and RSP.  */
+  n = 0;
+  for (i = 0; i < (int) ARRAY_SIZE (from); ++i)
+    if ((touched & (1 << i)) && from[i].depth < frame.depth)
+    {
+      for (j = 0; j < n && order[j]->depth < from[i].depth; ++j)
+        continue;
+      if (j < n && order[j]->depth == from[i].depth)
+        continue;
+      memmove (&order[j + 1], &order[j], (n - j) * sizeof (order[0]));
+      order[j] = &from[i];
+      ++n;
+    }
+  order[n++] = &frame;
+
+  Debug (2, "found sp at depth %d, stepping through %d frames\n", depth, n);
+
+  step = *c;
+  rbp_loc = c->dwarf.loc[RBP];
+  for (i = 0; i < n; ++i)
+  {
+    t = order[i];
+    if (trace_step_from (&step, c, t) <= 0)
+      return 0;
+    if ((touched & X86_64_SAVED_RBP) && t->depth == from[1].depth)
+      rbp_loc = step.dwarf.loc[RBP];
   }
 
-  Debug (1, "returning %d, depth %d\n", ret, depth);
-  *size = depth;
+  /* RBP is where the frame which last touched it left it.  */
+  step.dwarf.loc[RBP] = rbp_loc;
+
+  if (dwarf_get (&step.dwarf, step.dwarf.loc[RSP], &rsp) < 0 || rsp != sp)
+  {
+    Debug (1, "stepped to sp 0x%lx instead\n", rsp);
+    return 0;
+  }
+
+  *c = step;
+  return 1;
+}
+
+/* Make sure the calling thread has a frame cache, which can take N
+   more addresses without having to expand and drop its contents.
+   Signals are blocked so that a handler tracing on this thread does
+   not see the cache while it is replaced.  */
+HIDDEN int
+tdep_trace_reserve (size_t n)
+{
+  unw_trace_cache_t *cache;
+  intrmask_t saved_mask;
+  int ret = 0;
+
+  SIGPROCMASK (SIG_SETMASK, &unwi_full_mask, &saved_mask);
+  cache = trace_cache_get ();
+  if (unlikely(! cache))
+    ret = -UNW_ENOMEM;
+  else
+    while (cache->used + n > (1ULL << cache->log_size) / 2)
+      if (unlikely((ret = trace_cache_expand (cache)) < 0))
+        break;
+  SIGPROCMASK (SIG_SETMASK, &saved_mask, NULL);
   return ret;
 }
@@ -75,6 +75,7 @@ common_init (struct cursor *c, unsigned use_prev_instr)
 
   c->sigcontext_format = X86_64_SCF_NONE;
   c->sigcontext_addr = 0;
+  c->frame_pointer_only = 0;
 
   c->dwarf.args_size = 0;
   c->dwarf.stash_frames = 0;
@@ -117,5 +117,11 @@ extern NORETURN void x86_64_sigreturn (unw_cursor_t *cursor);
 extern int x86_64_handle_signal_frame(unw_cursor_t *cursor);
 #define x86_64_os_step UNW_OBJ(os_step)
 extern HIDDEN int x86_64_os_step(struct cursor *c);
+#if __linux__
+# define x86_64_is_sigreturn UNW_OBJ(is_sigreturn)
+extern HIDDEN int x86_64_is_sigreturn(struct cursor *c);
+#else
+# define x86_64_is_sigreturn(c) unw_is_signal_frame ((unw_cursor_t *) (c))
+#endif
 
 #endif /* unwind_i_h */
@@ -0,0 +1,125 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Unwind through frames whose CFA is given by a DWARF expression.
+
+   Usage: [LG]perf-expr [-d depth] [-n iterations]
+
+   A function which both realigns its stack and calls alloca() makes
+   GCC keep a pointer to its incoming arguments, and describe its frame
+   with DW_CFA_def_cfa_expression (breg6 N; deref) and DW_CFA_expression
+   (breg6 N) rules.  Each iteration walks a stack of DEPTH such
+   frames.  */
+
+#include <alloca.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+static int depth = 64;
+static long iterations = 20000;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void NOINLINE
+measure (const char *label)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_stats_t s0, s1;
+  unw_word_t evals, interpreted;
+  double t0, t1;
+  long i, steps = 0;
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  t0 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    {
+      unw_getcontext (&uc);
+      if (unw_init_local (&cursor, &uc) < 0)
+	panic ("unw_init_local() failed\n");
+      while (unw_step (&cursor) > 0)
+	++steps;
+    }
+  t1 = gettime ();
+  unw_get_stats (unw_local_addr_space, &s1);
+
+  evals = s1.expr_evals - s0.expr_evals;
+  interpreted = s1.expr_interpreted - s0.expr_interpreted;
+  printf ("%s: %9.3f nsec/step, %5.2f expressions/step, "
+	  "%5.1f%% interpreted\n", label, 1e9 * (t1 - t0) / steps,
+	  (double) evals / steps, evals ? 100.0 * interpreted / evals : 0.0);
+}
+
+static int NOINLINE
+realigned (int level, size_t size)
+{
+  char buf[64] __attribute__((aligned (64)));
+  char *p = alloca (size);
+
+  /* Keep both buffers (and hence the realignment).  */
+  __asm__ __volatile__ ("" : : "r" (buf), "r" (p) : "memory");
+
+  if (level > 0)
+    level = realigned (level - 1, size);
+  else
+    {
+      measure ("default cache");
+      unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+      measure ("no cache     ");
+      unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+    }
+
+  __asm__ __volatile__ ("" : : "r" (buf), "r" (p) : "memory");
+  return level;
+}
+
+int
+main (int argc, char **argv)
+{
+  int opt;
+
+  while ((opt = getopt (argc, argv, "d:n:")) != -1)
+    switch (opt)
+      {
+      case 'd': depth = atoi (optarg); break;
+      case 'n': iterations = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-d depth] [-n iterations]\n", argv[0]);
+      }
+
+  return realigned (depth, 16 + (argc & 1));
+}
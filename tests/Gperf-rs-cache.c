@@ -0,0 +1,315 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Replay a distribution of IPs through the register-state cache.
+
+   Usage: [LG]perf-rs-cache [-s size] [-a] [-n steps] [-k sites] [-f funcs]
+			    [ipfile]
+
+   Each line of IPFILE is "OFFSET OBJECT": a hex offset relative to the
+   load address of the shared object OBJECT (dlopen()ed if needed).  The
+   offsets would normally be return addresses recorded from a profile.
+   Without IPFILE, the start of every function which has an entry in
+   the .eh_frame_hdr of any loaded object is used, with a skewed
+   distribution so that a few functions are much hotter than the
+   rest.  With -k, SITES addresses spread over each function are used
+   instead, as from that many call sites, and -f limits the number of
+   functions used per object to FUNCS.  Run it on a large C++
+   program's libraries by listing them in IPFILE or preloading them.  */
+
+#include <dlfcn.h>
+#include <link.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#if UNW_TARGET_X86_64
+# define FP_REG		UNW_X86_64_RBP
+#elif UNW_TARGET_AARCH64
+# define FP_REG		UNW_AARCH64_X29
+#endif
+
+static unw_word_t *ips;
+static size_t nips, max_ips;
+
+static unw_word_t *trace;
+static long nsteps = 1 << 20;
+static int sites;
+static unsigned long max_funcs;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void
+add_ip (unw_word_t ip)
+{
+  if (nips == max_ips)
+    {
+      max_ips = max_ips ? 2 * max_ips : 4096;
+      ips = realloc (ips, max_ips * sizeof (ips[0]));
+      if (!ips)
+	panic ("out of memory\n");
+    }
+  ips[nips++] = ip;
+}
+
+/* Add the start of each function in the binary search table of a
+   .eh_frame_hdr.  Only the encodings every toolchain emits are
+   handled.  */
+static int
+collect_fdes (struct dl_phdr_info *info, size_t size UNUSED, void *arg UNUSED)
+{
+  const unsigned char *hdr = NULL;
+  const int32_t *table;
+  uint32_t i, fde_count;
+  int n;
+
+  for (n = 0; n < info->dlpi_phnum; ++n)
+    if (info->dlpi_phdr[n].p_type == PT_GNU_EH_FRAME)
+      hdr = (const unsigned char *) (info->dlpi_addr
+				     + info->dlpi_phdr[n].p_vaddr);
+
+  /* version 1, eh_frame_ptr pcrel|sdata4, fde_count udata4,
+     table datarel|sdata4 */
+  if (!hdr || hdr[0] != 1 || hdr[1] != 0x1b || hdr[2] != 0x03
+      || hdr[3] != 0x3b)
+    return 0;
+
+  memcpy (&fde_count, hdr + 8, sizeof (fde_count));
+  table = (const int32_t *) (hdr + 12);
+  /* Keep one more entry, to size the last function used by.  */
+  if (max_funcs && fde_count > max_funcs + 1)
+    fde_count = max_funcs + 1;
+  /* unw_step() looks up IP - 1, as for a return address.  */
+  for (i = 0; i < fde_count; ++i)
+    {
+      unw_word_t start = (unw_word_t) (uintptr_t) hdr + table[2 * i];
+      unw_word_t len;
+
+      if (!sites)
+	{
+	  add_ip (start + 1);
+	  continue;
+	}
+      /* Approximate the function's size by the distance to the next
+	 one.  */
+      if (i + 1 == fde_count)
+	continue;
+      len = table[2 * (i + 1)] - table[2 * i];
+      for (n = 0; n < sites; ++n)
+	add_ip (start + 1 + n * len / sites);
+    }
+  return 0;
+}
+
+struct find_base
+  {
+    const char *name;
+    unw_word_t base;
+    int found;
+  };
+
+static int
+find_object (struct dl_phdr_info *info, size_t size UNUSED, void *arg)
+{
+  struct find_base *fb = arg;
+  const char *name = info->dlpi_name;
+  const char *slash = strrchr (name, '/');
+
+  if (strcmp (name, fb->name) == 0
+      || (slash && strcmp (slash + 1, fb->name) == 0))
+    {
+      fb->base = info->dlpi_addr;
+      fb->found = 1;
+      return 1;
+    }
+  return 0;
+}
+
+static void
+read_ips (const char *path)
+{
+  char line[4096], name[4096];
+  unsigned long long off;
+  struct find_base fb;
+  FILE *f;
+
+  f = fopen (path, "r");
+  if (!f)
+    panic ("cannot open %s\n", path);
+
+  while (fgets (line, sizeof (line), f))
+    {
+      if (sscanf (line, "%llx %4095s", &off, name) != 2)
+	continue;
+
+      fb.name = name;
+      fb.found = 0;
+      dl_iterate_phdr (find_object, &fb);
+      if (!fb.found)
+	{
+	  if (!dlopen (name, RTLD_NOW))
+	    panic ("cannot load %s: %s\n", name, dlerror ());
+	  dl_iterate_phdr (find_object, &fb);
+	  if (!fb.found)
+	    panic ("%s not found after loading it\n", name);
+	}
+      add_ip (fb.base + off);
+    }
+  fclose (f);
+}
+
+/* Without a recording, draw from the IPs so that the hottest functions
+   dominate but the tail still covers everything.  */
+static void
+make_trace (int recorded)
+{
+  unsigned long long x = 88172645463325252ULL;
+  double u;
+  long i;
+
+  trace = malloc (nsteps * sizeof (trace[0]));
+  if (!trace)
+    panic ("out of memory\n");
+
+  for (i = 0; i < nsteps; ++i)
+    {
+      if (recorded)
+	{
+	  trace[i] = ips[i % nips];
+	  continue;
+	}
+      /* xorshift64 */
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      u = (x >> 11) * (1.0 / 9007199254740992.0);
+      trace[i] = ips[(size_t) (u * u * u * nips)];
+    }
+}
+
+static void NOINLINE
+replay (const char *label)
+{
+  unw_cursor_t start, cursor;
+  unw_context_t uc;
+  unw_stats_t s0, s1;
+  unw_word_t sp, hits, misses;
+  double t0, t1;
+  long i;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&start, &uc) < 0)
+    panic ("unw_init_local() failed\n");
+  unw_get_reg (&start, UNW_REG_SP, &sp);
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  t0 = gettime ();
+  for (i = 0; i < nsteps; ++i)
+    {
+      cursor = start;
+      unw_set_reg (&cursor, UNW_REG_IP, trace[i]);
+#ifdef FP_REG
+      /* Keep any frame-pointer based rule pointing into our stack.  */
+      unw_set_reg (&cursor, FP_REG, sp);
+#endif
+      unw_step (&cursor);
+    }
+  t1 = gettime ();
+  unw_get_stats (unw_local_addr_space, &s1);
+
+  hits = s1.rs_cache_hits - s0.rs_cache_hits;
+  misses = s1.rs_cache_misses - s0.rs_cache_misses;
+  printf ("%s: %9.3f nsec/step, %5.1f%% hits\n", label,
+	  1e9 * (t1 - t0) / nsteps,
+	  hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t size = 0;
+  int adaptive = 0, opt;
+  char label[64];
+
+  while ((opt = getopt (argc, argv, "as:n:k:f:")) != -1)
+    switch (opt)
+      {
+      case 'a': adaptive = 1; break;
+      case 's': size = strtoul (optarg, NULL, 0); break;
+      case 'n': nsteps = atol (optarg); break;
+      case 'k': sites = atoi (optarg); break;
+      case 'f': max_funcs = strtoul (optarg, NULL, 0); break;
+      default:
+	panic ("Usage: %s [-s size] [-a] [-n steps] [-k sites] [-f funcs] "
+	       "[ipfile]\n", argv[0]);
+      }
+
+  if (optind < argc)
+    read_ips (argv[optind]);
+  else
+    dl_iterate_phdr (collect_fdes, NULL);
+  if (nips == 0)
+    panic ("no IPs to replay\n");
+  make_trace (optind < argc);
+
+  printf ("%zu distinct IPs, %ld steps\n", nips, nsteps);
+
+  replay ("default cache   ");
+
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  replay ("no cache        ");
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+
+  if (size)
+    {
+      if (unw_set_cache_size (unw_local_addr_space, size, 0) != 0)
+	panic ("unw_set_cache_size(%zu) failed\n", size);
+      snprintf (label, sizeof (label), "%-16zu", size);
+      replay (label);
+    }
+
+  if (adaptive)
+    {
+      if (unw_set_cache_size (unw_local_addr_space, size ? size : 256,
+			      UNW_CACHE_SIZE_ADAPTIVE) != 0)
+	panic ("unw_set_cache_size(UNW_CACHE_SIZE_ADAPTIVE) failed\n");
+      replay ("adaptive (cold) ");
+      replay ("adaptive (warm) ");
+    }
+  return 0;
+}
@@ -38,6 +38,9 @@ WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 long dummy;
 
 static long iterations = 10000;
+/* Look up each frame's procedure info before stepping from it, as the
+   search phase of an exception does.  */
+static int with_proc_info;
 
 #define KB	1024
 #define MB	(1024*1024)
@@ -58,6 +61,7 @@ measure_unwind (int maxlevel, double *step)
 {
   double stop, start;
   unw_cursor_t cursor;
+  unw_proc_info_t pi;
   unw_context_t uc;
   int ret, level = 0;
 
@@ -69,6 +73,8 @@ measure_unwind (int maxlevel, double *step)
 
   do
     {
+      if (with_proc_info && unw_get_proc_info (&cursor, &pi) < 0)
+	panic ("unw_get_proc_info() failed\n");
       ret = unw_step (&cursor);
       if (ret < 0)
 	panic ("unw_step() failed\n");
@@ -128,7 +134,8 @@ doit (const char *label, int maxlevel)
       if (i == 0)
 	first_step = step;
     }
-  printf ("%s: unw_step : 1st=%9.3f min=%9.3f avg=%9.3f nsec\n", label,
+  printf ("%s: %s : 1st=%9.3f min=%9.3f avg=%9.3f nsec\n", label,
+	  with_proc_info ? "unw_get_proc_info+unw_step" : "unw_step",
 	  1e9*first_step, 1e9*min_step, 1e9*sum_step/iterations);
 }
 
@@ -260,5 +267,12 @@ main (int argc, char **argv)
   unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_PER_THREAD);
   doit ("per-thread cache", maxlevel);
 
+  with_proc_info = 1;
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+  doit ("global cache    ", maxlevel);
+
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  doit ("no cache        ", maxlevel);
+
   return 0;
 }
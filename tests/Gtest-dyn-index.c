@@ -0,0 +1,145 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Check the lookup of many, and of overlapping, dynamic unwind info
+   registrations.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define NREGIONS	5000
+#define REGION_SIZE	64
+#define CODE_SIZE	48
+
+int verbose;
+static unw_word_t base;
+static unw_dyn_info_t di[NREGIONS], outer, inner;
+
+static void
+init_di (unw_dyn_info_t *d, unw_word_t start, unw_word_t end)
+{
+  d->start_ip = start;
+  d->end_ip = end;
+  d->format = UNW_INFO_FORMAT_DYNAMIC;
+  d->u.pi.name_ptr = 0;
+  d->u.pi.regions = NULL;
+}
+
+/* Return the dynamic unwind info found for IP, or NULL.  */
+static const unw_dyn_info_t *
+lookup (unw_word_t ip)
+{
+  unw_proc_info_t pi;
+  int i;
+
+  if (unw_get_proc_info_by_ip (unw_local_addr_space, ip, &pi, NULL) < 0
+      || pi.format != UNW_INFO_FORMAT_DYNAMIC)
+    return NULL;
+  if (pi.start_ip == outer.start_ip && pi.end_ip == outer.end_ip)
+    return &outer;
+  if (pi.start_ip == inner.start_ip && pi.end_ip == inner.end_ip)
+    return &inner;
+  i = (pi.start_ip - base) / REGION_SIZE;
+  return &di[i];
+}
+
+static void
+check_regions (int step, int registered)
+{
+  int i;
+
+  for (i = 0; i < NREGIONS; i += step)
+    {
+      UNW_TEST_CHECK (lookup (base + i * REGION_SIZE + 5)
+		      == (registered ? &di[i] : NULL), "region %d", i);
+      UNW_TEST_CHECK (lookup (base + i * REGION_SIZE + CODE_SIZE) == NULL,
+		      "info found past the code of region %d", i);
+    }
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  unw_word_t mid;
+  int i, j;
+
+  verbose = (argc > 1);
+
+  /* An address range without any code.  */
+  base = (unw_word_t) 1 << (sizeof (unw_word_t) * 8 - 4);
+  for (i = 0; i < NREGIONS; ++i)
+    init_di (&di[i], base + i * REGION_SIZE,
+	     base + i * REGION_SIZE + CODE_SIZE);
+
+  /* Register out of address order.  */
+  for (i = 0; i < NREGIONS; ++i)
+    {
+      j = (i * 7919) % NREGIONS;
+      _U_dyn_register (&di[j]);
+      UNW_TEST_CHECK (lookup (di[j].start_ip) == &di[j],
+		      "region %d just registered", j);
+    }
+  check_regions (1, 1);
+
+  /* The most recent registration covering an address wins.  */
+  init_di (&outer, base, base + NREGIONS * REGION_SIZE);
+  _U_dyn_register (&outer);
+  UNW_TEST_CHECK (lookup (base + 5) == &outer, "outer registration");
+  UNW_TEST_CHECK (lookup (base + CODE_SIZE) == &outer,
+		  "outer registration between regions");
+  mid = base + NREGIONS / 2 * REGION_SIZE;
+  init_di (&inner, mid, mid + 8);
+  _U_dyn_register (&inner);
+  UNW_TEST_CHECK (lookup (mid + 4) == &inner, "inner registration");
+  UNW_TEST_CHECK (lookup (mid + 8) == &outer,
+		  "outer registration past the inner one");
+  _U_dyn_cancel (&outer);
+  UNW_TEST_CHECK (lookup (mid + 4) == &inner,
+		  "inner registration after cancelling the outer one");
+  UNW_TEST_CHECK (lookup (mid + 8) == &di[NREGIONS / 2],
+		  "region under the cancelled outer registration");
+  _U_dyn_cancel (&inner);
+  check_regions (1, 1);
+
+  /* Cancel most of them.  */
+  for (i = 0; i < NREGIONS; ++i)
+    if (i % 4)
+      _U_dyn_cancel (&di[i]);
+  check_regions (4, 1);
+  for (i = 1; i < NREGIONS; i += 4)
+    UNW_TEST_CHECK (lookup (base + i * REGION_SIZE + 5) == NULL,
+		    "cancelled region %d", i);
+
+  for (i = 0; i < NREGIONS; i += 4)
+    _U_dyn_cancel (&di[i]);
+  check_regions (1, 0);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -0,0 +1,264 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that unwi_step_to_sp() leaves the cursor as a unw_step() loop
+   to the same frame would: every register and where it was saved,
+   whether the frame is a signal frame and, on x86-64, the rest of the
+   state the next unw_step() goes by.  */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libunwind_i.h"
+#include "compiler.h"
+#include "unw_test.h"
+
+#define MAX_FRAMES	256
+#define DEPTH		40
+
+struct frame_state
+  {
+    unw_word_t vals[UNW_REG_LAST + 1];
+    int signal_frame;
+#if UNW_TARGET_X86_64
+    dwarf_loc_t loc[DWARF_NUM_PRESERVED_REGS];
+    unw_word_t cfa, ip, args_size;
+    unsigned int use_prev_instr;
+    uintptr_t frames;
+    int sigcontext_format;
+    unw_word_t sigcontext_addr;
+#endif
+  };
+
+int verbose;
+
+static struct frame_state frames[MAX_FRAMES];
+static int nframes;
+static volatile long sink;
+static int in_signal;
+
+static void
+get_state (unw_cursor_t *cursor, struct frame_state *s)
+{
+#if UNW_TARGET_X86_64
+  struct cursor *c = (struct cursor *) cursor;
+#endif
+  int r;
+
+  memset (s, 0, sizeof (*s));
+  for (r = 0; r <= UNW_REG_LAST; ++r)
+    if (unw_is_fpreg (r) || unw_get_reg (cursor, r, &s->vals[r]) < 0)
+      s->vals[r] = 0xdead;
+  s->signal_frame = unw_is_signal_frame (cursor);
+#if UNW_TARGET_X86_64
+  memcpy (s->loc, c->dwarf.loc, sizeof (s->loc));
+  s->cfa = c->dwarf.cfa;
+  s->ip = c->dwarf.ip;
+  s->args_size = c->dwarf.args_size;
+  s->use_prev_instr = c->dwarf.use_prev_instr;
+  s->frames = c->frames;
+  s->sigcontext_format = c->sigcontext_format;
+  s->sigcontext_addr = c->sigcontext_addr;
+#endif
+}
+
+/* Check that cursor C is in the state S the unw_step() loop left it in
+   at frame N, found stepping from frame FROM.  */
+static void
+check_state (unw_cursor_t *c, const struct frame_state *s, int n, int from)
+{
+  struct frame_state now;
+  int r;
+
+  get_state (c, &now);
+  for (r = 0; r <= UNW_REG_LAST; ++r)
+    UNW_TEST_CHECK (now.vals[r] == s->vals[r],
+		    "frame %d from %d: register %d is 0x%lx, not 0x%lx",
+		    n, from, r, (long) now.vals[r], (long) s->vals[r]);
+  UNW_TEST_CHECK (now.signal_frame == s->signal_frame,
+		  "frame %d from %d: signal frame %d, not %d",
+		  n, from, now.signal_frame, s->signal_frame);
+#if UNW_TARGET_X86_64
+  for (r = 0; r < DWARF_NUM_PRESERVED_REGS; ++r)
+    UNW_TEST_CHECK (DWARF_GET_LOC (now.loc[r]) == DWARF_GET_LOC (s->loc[r])
+		    && now.loc[r].type == s->loc[r].type,
+		    "frame %d from %d: register %d at 0x%lx/%d, not 0x%lx/%d",
+		    n, from, r, (long) DWARF_GET_LOC (now.loc[r]),
+		    (int) now.loc[r].type, (long) DWARF_GET_LOC (s->loc[r]),
+		    (int) s->loc[r].type);
+  UNW_TEST_CHECK (now.cfa == s->cfa && now.ip == s->ip,
+		  "frame %d from %d: cfa/ip differ", n, from);
+  UNW_TEST_CHECK (now.args_size == s->args_size,
+		  "frame %d from %d: args_size %ld, not %ld",
+		  n, from, (long) now.args_size, (long) s->args_size);
+  UNW_TEST_CHECK (now.use_prev_instr == s->use_prev_instr,
+		  "frame %d from %d: use_prev_instr %u, not %u",
+		  n, from, now.use_prev_instr, s->use_prev_instr);
+  UNW_TEST_CHECK (now.frames == s->frames,
+		  "frame %d from %d: frames %ld, not %ld",
+		  n, from, (long) now.frames, (long) s->frames);
+  UNW_TEST_CHECK (now.sigcontext_format == s->sigcontext_format
+		  && now.sigcontext_addr == s->sigcontext_addr,
+		  "frame %d from %d: signal context %d at 0x%lx, not %d at 0x%lx",
+		  n, from, now.sigcontext_format, (long) now.sigcontext_addr,
+		  s->sigcontext_format, (long) s->sigcontext_addr);
+#endif
+}
+
+/* Check that stepping to frame N from frame FROM finds it, and that
+   the frame above it is the same as well.  */
+static void
+check_frame (unw_context_t *uc, int from, int n)
+{
+  unw_cursor_t c;
+  int i;
+
+  unw_init_local (&c, uc);
+  for (i = 0; i < from; ++i)
+    unw_step (&c);
+  UNW_TEST_CHECK (unwi_step_to_sp (&c, frames[n].vals[UNW_REG_SP]) == 1,
+		  "frame %d from %d not found", n, from);
+  check_state (&c, &frames[n], n, from);
+  if (n + 1 < nframes && unw_step (&c) > 0)
+    check_state (&c, &frames[n + 1], n + 1, from);
+}
+
+static void NOINLINE
+check_stack (void)
+{
+  unw_context_t uc;
+  unw_cursor_t c;
+  unw_stats_t s0 UNUSED, s1 UNUSED;
+  int n, pass;
+
+  unw_getcontext (&uc);
+  unw_init_local (&c, &uc);
+  nframes = 0;
+  do
+    get_state (&c, &frames[nframes++]);
+  while (nframes < MAX_FRAMES && unw_step (&c) > 0);
+  if (verbose)
+    printf ("%d frames\n", nframes);
+
+  /* The first pass fills the trace cache, the second uses it.  */
+  for (pass = 0; pass < 2; ++pass)
+    {
+      for (n = 0; n < nframes; ++n)
+	check_frame (&uc, 0, n);
+      for (n = 3; n < nframes; n += 5)
+	check_frame (&uc, 3, n);
+
+      /* Between frames, the stack pointer is not found.  */
+      unw_init_local (&c, &uc);
+      UNW_TEST_CHECK (unwi_step_to_sp (&c, frames[1].vals[UNW_REG_SP]
+					   + sizeof (unw_word_t)) == 0,
+		      "found a frame between frames");
+    }
+
+#if UNW_TARGET_X86_64
+  /* Only the few frames below which save registers are stepped.  */
+  unw_get_stats (unw_local_addr_space, &s0);
+  check_frame (&uc, 0, DEPTH);
+  unw_get_stats (unw_local_addr_space, &s1);
+  if (verbose)
+    printf ("%ld frames stepped\n",
+	    (long) (s1.rs_cache_hits + s1.rs_cache_misses
+		    - s0.rs_cache_hits - s0.rs_cache_misses));
+  UNW_TEST_CHECK (s1.rs_cache_hits + s1.rs_cache_misses
+		  - s0.rs_cache_hits - s0.rs_cache_misses < DEPTH / 2,
+		  "stepped through too many frames");
+#endif
+}
+
+static int NOINLINE recurse (int depth, long a);
+
+/* Keeps values in callee-saved registers across the call.  */
+static int NOINLINE
+recurse_saved (int depth, long a)
+{
+  long b = a * 3, c = a ^ 5, d = a + 7, e = a - 11, f = a * 13;
+  int ret;
+
+  sink = a;
+  ret = recurse (depth - 1, sink + 1);
+  return ret + (int) (b * sink + c * sink + d * sink + e * sink + f * sink);
+}
+
+/* Keeps one value.  */
+static int NOINLINE
+recurse_one (int depth, long a)
+{
+  long b = a * 7;
+  int ret;
+
+  ret = recurse (depth - 1, a + 1);
+  return ret + (int) (b * sink);
+}
+
+static int NOINLINE
+recurse (int depth, long a)
+{
+  if (depth == 0)
+    {
+      if (in_signal)
+	raise (SIGUSR1);
+      else
+	check_stack ();
+      return 0;
+    }
+  switch (depth % 3)
+    {
+    case 0:
+      return recurse_saved (depth, a) + (int) sink;
+    case 1:
+      return recurse_one (depth, a) + (int) sink;
+    default:
+      return recurse (depth - 1, a) + (int) sink;
+    }
+}
+
+static void
+handler (int sig UNUSED)
+{
+  in_signal = 0;
+  recurse (DEPTH / 2, 1);
+}
+
+int
+main (int argc, char **argv)
+{
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  recurse (DEPTH, 1);
+
+  /* Through a signal frame, which restores every register.  */
+  signal (SIGUSR1, handler);
+  in_signal = 1;
+  recurse (DEPTH, 1);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
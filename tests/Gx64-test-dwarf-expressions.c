@@ -15,6 +15,15 @@ static int nerrors;
 // which clobbers the stack, and which in turn calls recover_register below
 extern int64_t DW_CFA_expression_testcase(int64_t regnum, int64_t height);
 
+// Calls recover_register from three rows of its own CFI table and returns
+// the common result, or -1 if the three results differ
+extern int64_t DW_CFA_rows_testcase(int64_t regnum, int64_t height);
+
+// Calls recover_register through two PLT-like stubs, at either side of
+// the comparison in their CFA expression, and returns the common result,
+// or -1 if the two results differ
+extern int64_t DW_CFA_plt_testcase(int64_t regnum, int64_t height);
+
 // recover_register is called by the assembly routines. It returns the value of
 // a register at a specified height from the inner-most frame. The return value
 // is propagated back through the assembly routines to the testcase.
@@ -49,6 +58,10 @@ extern int64_t recover_register(int64_t regnum, int64_t height)
 int
 main (int argc, char **argv UNUSED)
 {
+  unw_stats_t s0, s1;
+  int stats;
+  int i;
+
   if (argc > 1)
     verbose = 1;
 
@@ -57,6 +70,28 @@ main (int argc, char **argv UNUSED)
   if (DW_CFA_expression_testcase(12, 2) != 111222333)
     panic("r12 should be restored at height 2 (DW_CFA_expression_testcase)");
 
+  // Once with the decoded CFI programs and expressions cached, once without
+  for (i = 0; i < 2; ++i)
+    {
+      if (DW_CFA_rows_testcase(12, 2) != 111222333)
+        panic("r12 should be restored at height 2 (DW_CFA_rows_testcase)");
+      if (DW_CFA_rows_testcase(UNW_REG_SP, 3) == -1)
+        panic("sp differs between the rows of DW_CFA_rows_testcase");
+      if (DW_CFA_rows_testcase(12, 3) == -1)
+        panic("r12 differs between the rows of DW_CFA_rows_testcase");
+      stats = unw_get_stats(unw_local_addr_space, &s0) == 0;
+      if (DW_CFA_plt_testcase(UNW_REG_SP, 3) == -1)
+        panic("sp differs between the stubs of DW_CFA_plt_testcase");
+      unw_get_stats(unw_local_addr_space, &s1);
+      // The CFA expression of the stubs has a closed form
+      if (stats && (s1.expr_evals == s0.expr_evals
+                    || s1.expr_interpreted != s0.expr_interpreted))
+        panic("DW_CFA_plt_testcase should not need the expression interpreter");
+      if (DW_CFA_plt_testcase(UNW_REG_IP, 3) == -1)
+        panic("ip differs between the stubs of DW_CFA_plt_testcase");
+      unw_set_caching_policy(unw_local_addr_space, UNW_CACHE_NONE);
+    }
+
   if (nerrors > 0)
     {
       fprintf (stderr, "FAILURE: detected %d errors\n", nerrors);
@@ -0,0 +1,152 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure unw_backtrace_id() against unw_backtrace(), as taken on each
+   sample of an allocation profiler, from a few different stacks.
+
+   Usage: Lperf-backtrace-id [-n samples] [-k stacks] [depth...]  */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define MAX_DEPTH	256
+
+static long samples = 1000000;
+static int stacks = 16;
+static volatile long sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void NOINLINE
+take (int id_only, long n)
+{
+  void *buffer[MAX_DEPTH];
+  uint64_t id;
+  long i;
+
+  for (i = 0; i < n; ++i)
+    if (id_only)
+      {
+	if (unw_backtrace_id (&id, MAX_DEPTH) < 0)
+	  panic ("unw_backtrace_id() failed\n");
+	sink += id;
+      }
+    else
+      sink += unw_backtrace (buffer, MAX_DEPTH);
+}
+
+/* Reach take() through one of STACKS different paths.  */
+static void NOINLINE left (int id_only, long n, unsigned path, int depth);
+static void NOINLINE right (int id_only, long n, unsigned path, int depth);
+
+static void NOINLINE
+left (int id_only, long n, unsigned path, int depth)
+{
+  if (depth == 0)
+    take (id_only, n);
+  else if (path & 1)
+    right (id_only, n, path >> 1, depth - 1);
+  else
+    left (id_only, n, path >> 1, depth - 1);
+  /* Not a tail call.  */
+  sink++;
+}
+
+static void NOINLINE
+right (int id_only, long n, unsigned path, int depth)
+{
+  if (depth == 0)
+    take (id_only, n);
+  else if (path & 1)
+    right (id_only, n, path >> 1, depth - 1);
+  else
+    left (id_only, n, path >> 1, depth - 1);
+  sink++;
+}
+
+static double
+measure (int id_only, int depth)
+{
+  long per_stack = samples / stacks;
+  double t0;
+  int k;
+
+  /* Warm up the caches and store the stacks.  */
+  for (k = 0; k < stacks; ++k)
+    left (id_only, 1, k, depth);
+
+  t0 = gettime ();
+  for (k = 0; k < stacks; ++k)
+    left (id_only, per_stack, k, depth);
+  return 1e9 * (gettime () - t0) / (per_stack * stacks);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 8, 32, 128 };
+  int opt, i, depth;
+  double bt, id;
+
+  while ((opt = getopt (argc, argv, "n:k:")) != -1)
+    switch (opt)
+      {
+      case 'n': samples = atol (optarg); break;
+      case 'k': stacks = atoi (optarg); break;
+      default:
+	panic ("Usage: %s [-n samples] [-k stacks] [depth...]\n", argv[0]);
+      }
+  if (stacks <= 0 || samples < stacks)
+    panic ("need at least one sample per stack\n");
+
+  for (i = 0; i < (optind < argc ? argc - optind
+		   : (int) (sizeof (depths) / sizeof (depths[0]))); ++i)
+    {
+      depth = optind < argc ? atoi (argv[optind + i]) : depths[i];
+      if (depth < 0 || depth > MAX_DEPTH - 8)
+	panic ("depth must be between 0 and %d\n", MAX_DEPTH - 8);
+      bt = measure (0, depth);
+      id = measure (1, depth);
+      printf ("depth %4d: unw_backtrace() %8.1f nsec, unw_backtrace_id() "
+	      "%8.1f nsec, %6.2f M samples/sec\n", depth, bt, id, 1e3 / id);
+    }
+  return 0;
+}
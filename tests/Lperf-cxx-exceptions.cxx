@@ -0,0 +1,147 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Time throwing C++ exceptions through libunwind's
+   _Unwind_RaiseException() from various depths.
+
+   Usage: Lperf-cxx-exceptions [-n iterations] [-c] [depth...]
+
+   Between the thrower and the catcher, every frame has a try block
+   which does not catch the exception, so that each has a personality
+   routine to call in both phases.  With -c, each also has an object to
+   destroy, so that the exception stops there to run the destructor
+   and is resumed.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(args...)				\
+	{ fprintf (stderr, args); exit (-1); }
+
+struct Unrelated { };
+
+struct Cleanup
+{
+  ~Cleanup () { ++destroyed; }
+  static long destroyed;
+};
+
+long Cleanup::destroyed;
+
+static volatile int sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static int NOINLINE
+thrower (int depth)
+{
+  if (depth == 0)
+    throw depth;
+  try {
+    /* defeat last-call/sibcall optimization */
+    return thrower (depth - 1) + sink;
+  } catch (Unrelated &) {
+    return -1;
+  }
+}
+
+static int NOINLINE
+thrower_cleanup (int depth)
+{
+  Cleanup c;
+
+  if (depth == 0)
+    throw depth;
+  try {
+    return thrower_cleanup (depth - 1) + sink;
+  } catch (Unrelated &) {
+    return -1;
+  }
+}
+
+static void
+measure (int depth, long iterations, int cleanup)
+{
+  double start, stop;
+  long i, caught = 0;
+
+  start = gettime ();
+  for (i = 0; i < iterations; ++i)
+    try {
+      if (cleanup)
+        thrower_cleanup (depth);
+      else
+        thrower (depth);
+    } catch (int) {
+      ++caught;
+    }
+  stop = gettime ();
+
+  if (caught != iterations)
+    panic ("caught %ld of %ld exceptions\n", caught, iterations);
+  printf ("depth %4d%s: %9.3f usec/throw, %7.3f usec/frame\n", depth,
+          cleanup ? " (cleanups)" : "",
+          1e6 * (stop - start) / iterations,
+          1e6 * (stop - start) / iterations / (depth + 1));
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int default_depths[] = { 1, 4, 16, 64, 256 };
+  long iterations = 10000;
+  int cleanup = 0, opt, i;
+
+  while ((opt = getopt (argc, argv, "n:c")) != -1)
+    switch (opt)
+      {
+      case 'n': iterations = atol (optarg); break;
+      case 'c': cleanup = 1; break;
+      default:
+        panic ("Usage: %s [-n iterations] [-c] [depth...]\n", argv[0]);
+      }
+
+  if (optind < argc)
+    for (i = optind; i < argc; ++i)
+      measure (atoi (argv[i]), iterations, cleanup);
+  else
+    for (i = 0; i < (int) (sizeof (default_depths)
+                           / sizeof (default_depths[0])); ++i)
+      measure (default_depths[i], iterations, cleanup);
+
+  if (cleanup && Cleanup::destroyed == 0)
+    panic ("no destructor ran\n");
+  return 0;
+}
@@ -0,0 +1,147 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure unw_step() along the frame-pointer chain with
+   UNW_INIT_FRAME_POINTER, with and without UNW_INIT_VALIDATE, against
+   unw_step() with the unwind info and against unw_backtrace(), from
+   various depths.
+
+   Usage: Lperf-frame-pointer [-n iterations] [depth...]  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define MAX_DEPTH	1024
+
+static long iterations = 100000;
+static volatile long sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+/* Return nanoseconds per frame for stepping N frames from UC.  */
+static double
+time_steps (unw_context_t *uc, int flag, int n)
+{
+  unw_cursor_t cursor;
+  double t0, t1;
+  long i;
+  int k;
+
+  t0 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    {
+      if (unw_init_local2 (&cursor, uc, flag) < 0)
+	return -1;
+      for (k = 0; k < n && unw_step (&cursor) > 0; ++k)
+	continue;
+      if (k != n)
+	panic ("stepped %d of %d frames with flags %#x\n", k, n, flag);
+    }
+  t1 = gettime ();
+  return 1e9 * (t1 - t0) / iterations / n;
+}
+
+static void NOINLINE
+measure (int depth)
+{
+  static void *buffer[MAX_DEPTH];
+  unw_context_t uc;
+  double t0, t1, dwarf, fp, fpv;
+  long i;
+
+  unw_getcontext (&uc);
+
+  /* Warm up the caches.  */
+  time_steps (&uc, 0, depth);
+
+  dwarf = time_steps (&uc, 0, depth);
+  fp = time_steps (&uc, UNW_INIT_FRAME_POINTER, depth);
+  fpv = time_steps (&uc, UNW_INIT_FRAME_POINTER | UNW_INIT_VALIDATE, depth);
+  if (fp < 0 || fpv < 0)
+    panic ("UNW_INIT_FRAME_POINTER not supported\n");
+
+  t0 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    sink += unw_backtrace (buffer, depth);
+  t1 = gettime ();
+
+  printf ("depth %4d: unw_step() %7.1f, frame pointer %7.1f, validated "
+	  "%7.1f, unw_backtrace() %7.1f nsec/frame\n", depth, dwarf, fp, fpv,
+	  1e9 * (t1 - t0) / iterations / depth);
+}
+
+static int NOINLINE
+recurse (int depth, int target)
+{
+  if (depth == target)
+    measure (depth);
+  else
+    recurse (depth + 1, target);
+  /* Not a tail call.  */
+  return (int) sink;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 8, 32, 128, 512 };
+  int opt, i, depth;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n': iterations = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n iterations] [depth...]\n", argv[0]);
+      }
+
+  if (optind < argc)
+    for (i = optind; i < argc; ++i)
+      {
+	depth = atoi (argv[i]);
+	if (depth <= 0 || depth > MAX_DEPTH)
+	  panic ("depth must be between 1 and %d\n", MAX_DEPTH);
+	recurse (0, depth);
+      }
+  else
+    for (i = 0; i < (int) (sizeof (depths) / sizeof (depths[0])); ++i)
+      recurse (0, depths[i]);
+  return 0;
+}
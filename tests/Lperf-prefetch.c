@@ -0,0 +1,185 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure the first sample taken in a new thread after the caches were
+   flushed, with and without prefetching the unwind info of all the
+   loaded code first, for unw_backtrace() and for a unw_step() walk.
+   The cold samples use the default cache size.
+
+   Usage: Lperf-prefetch [-n trials]
+
+   The stack goes through CHAIN different procedures, so that each of
+   its frames needs unwind info of its own.  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define MAX_DEPTH	64
+#define CHAIN		32
+
+static int trials = 20;
+static volatile long sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+struct trial
+  {
+    int prefetch;               /* flags for unw_prefetch_unwind_info() */
+    int step;                   /* walk with unw_step() */
+    double prefetch_time, sample_time;
+    unw_word_t misses;          /* rs-cache misses of the sample */
+  };
+
+static void NOINLINE
+take (struct trial *t)
+{
+  void *buffer[MAX_DEPTH];
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_stats_t s0, s1;
+  double t0, t1;
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  t0 = gettime ();
+  if (t->step)
+    {
+      unw_getcontext (&uc);
+      if (unw_init_local (&cursor, &uc) < 0)
+	panic ("unw_init_local() failed\n");
+      while (unw_step (&cursor) > 0)
+	sink++;
+    }
+  else
+    sink += unw_backtrace (buffer, MAX_DEPTH);
+  t1 = gettime ();
+  unw_get_stats (unw_local_addr_space, &s1);
+  t->sample_time = t1 - t0;
+  t->misses = s1.rs_cache_misses - s0.rs_cache_misses;
+}
+
+/* Procedures LINK0 ... LINK<CHAIN-1>, each calling the next.  */
+#define LINK(n, next)							\
+  static void NOINLINE link##n (struct trial *t)			\
+  {									\
+    next (t);								\
+    /* Not a tail call.  */						\
+    sink++;								\
+  }
+LINK (31, take)    LINK (30, link31) LINK (29, link30) LINK (28, link29)
+LINK (27, link28)  LINK (26, link27) LINK (25, link26) LINK (24, link25)
+LINK (23, link24)  LINK (22, link23) LINK (21, link22) LINK (20, link21)
+LINK (19, link20)  LINK (18, link19) LINK (17, link18) LINK (16, link17)
+LINK (15, link16)  LINK (14, link15) LINK (13, link14) LINK (12, link13)
+LINK (11, link12)  LINK (10, link11) LINK (9, link10)  LINK (8, link9)
+LINK (7, link8)    LINK (6, link7)   LINK (5, link6)   LINK (4, link5)
+LINK (3, link4)    LINK (2, link3)   LINK (1, link2)   LINK (0, link1)
+
+static void *
+run_trial (void *arg)
+{
+  struct trial *t = arg;
+  double t0, t1;
+
+  t0 = gettime ();
+  if (t->prefetch
+      && unw_prefetch_unwind_info (unw_local_addr_space, 0, ~(unw_word_t) 0,
+				   t->prefetch, NULL) < 0)
+    panic ("unw_prefetch_unwind_info() failed\n");
+  t1 = gettime ();
+  t->prefetch_time = t1 - t0;
+  link0 (t);
+  return NULL;
+}
+
+static void
+measure (int prefetch, int step, const char *label)
+{
+  double prefetch_time = 0, sample_time = 0, misses = 0;
+  struct trial t;
+  pthread_t thread;
+  int i;
+
+  for (i = 0; i < trials; ++i)
+    {
+      unw_flush_cache (unw_local_addr_space, 0, 0);
+      t.prefetch = prefetch;
+      t.step = step;
+      if (pthread_create (&thread, NULL, run_trial, &t) != 0)
+	panic ("pthread_create() failed\n");
+      pthread_join (thread, NULL);
+      prefetch_time += t.prefetch_time;
+      sample_time += t.sample_time;
+      misses += t.misses;
+    }
+
+  printf ("%s: %8.1f usec/first sample, %5.1f rs-cache misses"
+	  " (prefetch %.1f msec)\n", label, 1e6 * sample_time / trials,
+	  misses / trials, 1e3 * prefetch_time / trials);
+}
+
+int
+main (int argc, char **argv)
+{
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n': trials = atoi (optarg); break;
+      default:
+	panic ("Usage: %s [-n trials]\n", argv[0]);
+      }
+  if (trials <= 0)
+    panic ("need at least one trial\n");
+
+  measure (0, 0, "unw_backtrace(), cold      ");
+  measure (0, 1, "unw_step(), cold          ");
+
+  /* Room for the rows of all the loaded code.  Filling a cache this
+     large after the flush would slow the cold samples down.  */
+  if (unw_set_cache_size (unw_local_addr_space, 1 << 17, 0) < 0)
+    panic ("unw_set_cache_size() failed\n");
+  measure (UNW_PREFETCH_RS_CACHE | UNW_PREFETCH_TRACE_CACHE, 0,
+	   "unw_backtrace(), prefetched");
+  measure (UNW_PREFETCH_RS_CACHE, 1,
+	   "unw_step(), prefetched    ");
+  return 0;
+}
@@ -0,0 +1,149 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure finding the frame of a stack pointer, as longjmp() in
+   libunwind-setjmp does, from various depths.
+
+   Usage: Lperf-step-to-sp [-n iterations] [depth...]
+
+   The frame is that many frames up the stack, and is found with
+   unwi_step_to_sp() and with the unw_step() loop comparing each frame's
+   stack pointer which longjmp() used before.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include "libunwind_i.h"
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+static long iterations = 100000;
+static volatile long sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static int
+step_loop (unw_cursor_t *cursor, unw_word_t target)
+{
+  unw_word_t sp;
+
+  do
+    {
+      unw_get_reg (cursor, UNW_REG_SP, &sp);
+      if (sp == target)
+	return 1;
+    }
+  while (unw_step (cursor) > 0);
+  return 0;
+}
+
+static void NOINLINE
+measure (int depth)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_word_t target;
+  double t0, t1, t2;
+  long i;
+  int n;
+
+  unw_getcontext (&uc);
+  unw_init_local (&cursor, &uc);
+  for (n = 0; n <= depth && unw_step (&cursor) > 0; ++n)
+    continue;
+  unw_get_reg (&cursor, UNW_REG_SP, &target);
+
+  for (i = 0; i < iterations / 10; ++i)
+    {
+      unw_init_local (&cursor, &uc);
+      if (unwi_step_to_sp (&cursor, target) != 1)
+	panic ("frame not found\n");
+    }
+
+  t0 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    {
+      unw_init_local (&cursor, &uc);
+      unwi_step_to_sp (&cursor, target);
+    }
+  t1 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    {
+      unw_init_local (&cursor, &uc);
+      step_loop (&cursor, target);
+    }
+  t2 = gettime ();
+
+  printf ("depth %4d: unwi_step_to_sp() %8.3f usec, "
+	  "unw_step() loop %8.3f usec\n", depth,
+	  1e6 * (t1 - t0) / iterations, 1e6 * (t2 - t1) / iterations);
+}
+
+/* Keeps two values in callee-saved registers across the call.  */
+static int NOINLINE
+recurse (int depth, int target)
+{
+  long a = sink * 3, b = sink ^ 5;
+
+  if (depth == target)
+    measure (depth);
+  else
+    recurse (depth + 1, target);
+  return (int) (a * sink + b * sink);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 4, 16, 64, 256 };
+  int opt, i;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n': iterations = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n iterations] [depth...]\n", argv[0]);
+      }
+
+  if (optind < argc)
+    for (i = optind; i < argc; ++i)
+      recurse (0, atoi (argv[i]));
+  else
+    for (i = 0; i < (int) (sizeof (depths) / sizeof (depths[0])); ++i)
+      recurse (0, depths[i]);
+  return 0;
+}
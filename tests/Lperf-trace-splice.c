@@ -0,0 +1,155 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure unw_backtrace() on deep stacks of which only the innermost
+   frames change between samples, as a sampling profiler sees them,
+   with and without reusing the outer frames of the previous trace.
+
+   Usage: Lperf-trace-splice [-n samples] [-v vary] [depth...]
+
+   Each sample goes through one of VARY different innermost paths of
+   up to VARY frames below a stack of DEPTH frames which stays put.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define MAX_DEPTH	256
+
+static long samples = 1000000;
+static int vary = 4;
+static volatile long sink;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static unw_word_t
+sum (const unw_word_t *v)
+{
+  unw_word_t s = 0;
+  int i;
+
+  for (i = 0; i < UNW_STATS_FRAME_TYPES; ++i)
+    s += v[i];
+  return s;
+}
+
+static void NOINLINE
+take (void)
+{
+  void *buffer[MAX_DEPTH];
+
+  sink += unw_backtrace (buffer, MAX_DEPTH);
+}
+
+static void NOINLINE
+inner (int depth)
+{
+  if (depth == 0)
+    take ();
+  else
+    inner (depth - 1);
+  /* Not a tail call.  */
+  sink++;
+}
+
+static void NOINLINE
+measure (int depth, const char *label)
+{
+  unw_stats_t s0, s1;
+  double t0, t1;
+  long i;
+
+  if (depth > 0)
+    {
+      measure (depth - 1, label);
+      sink++;
+      return;
+    }
+
+  for (i = 0; i < vary; ++i)
+    inner (i);
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  t0 = gettime ();
+  for (i = 0; i < samples; ++i)
+    inner (i % vary);
+  t1 = gettime ();
+  unw_get_stats (unw_local_addr_space, &s1);
+
+  printf ("%s: %8.1f nsec/sample, %6.1f frames walked, %6.1f reused\n",
+	  label, 1e9 * (t1 - t0) / samples,
+	  (double) (sum (s1.trace_hits) - sum (s0.trace_hits)
+		    + sum (s1.trace_misses) - sum (s0.trace_misses)) / samples,
+	  (double) (s1.trace_spliced - s0.trace_spliced) / samples);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 16, 64, 200 };
+  char label[64];
+  int opt, i, depth;
+
+  while ((opt = getopt (argc, argv, "n:v:")) != -1)
+    switch (opt)
+      {
+      case 'n': samples = atol (optarg); break;
+      case 'v': vary = atoi (optarg); break;
+      default:
+	panic ("Usage: %s [-n samples] [-v vary] [depth...]\n", argv[0]);
+      }
+  if (samples <= 0 || vary <= 0)
+    panic ("need at least one sample and one path\n");
+
+  for (i = 0; i < (optind < argc ? argc - optind
+		   : (int) (sizeof (depths) / sizeof (depths[0]))); ++i)
+    {
+      depth = optind < argc ? atoi (argv[optind + i]) : depths[i];
+      if (depth < 0 || depth > MAX_DEPTH - vary - 8)
+	panic ("depth must be between 0 and %d\n", MAX_DEPTH - vary - 8);
+
+      snprintf (label, sizeof (label), "depth %3d, reuse   ", depth);
+      measure (depth, label);
+      unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+      snprintf (label, sizeof (label), "depth %3d, no reuse", depth);
+      measure (depth, label);
+      unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+    }
+  return 0;
+}
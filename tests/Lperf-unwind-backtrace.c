@@ -0,0 +1,151 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure _Unwind_Backtrace() from various depths.
+
+   Usage: Lperf-unwind-backtrace [-n iterations] [depth...]
+
+   The callback reads only the IP and CFA of each frame, as backtrace()
+   in glibc does, or also the LSDA, which needs a cursor in the frame.
+   A unw_step() loop reading the same is timed for comparison: it is
+   what _Unwind_Backtrace() did for every frame before it used the fast
+   trace.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include <unwind.h>
+#include "compiler.h"
+
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+static long iterations = 100000;
+static volatile int sink;
+static unsigned long sum;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static _Unwind_Reason_Code
+ip_and_cfa (struct _Unwind_Context *context, void *arg UNUSED)
+{
+  sum += _Unwind_GetIP (context) + _Unwind_GetCFA (context);
+  return _URC_NO_REASON;
+}
+
+static _Unwind_Reason_Code
+with_lsda (struct _Unwind_Context *context, void *arg UNUSED)
+{
+  sum += _Unwind_GetIP (context) + _Unwind_GetCFA (context)
+	 + _Unwind_GetLanguageSpecificData (context);
+  return _URC_NO_REASON;
+}
+
+static void
+step_loop (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_word_t ip, sp;
+
+  unw_getcontext (&uc);
+  unw_init_local (&cursor, &uc);
+  while (unw_step (&cursor) > 0)
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &ip);
+      unw_get_reg (&cursor, UNW_REG_SP, &sp);
+      sum += ip + sp;
+    }
+}
+
+static void NOINLINE
+measure (int depth)
+{
+  double t0, t1, t2, t3;
+  long i;
+
+  for (i = 0; i < iterations / 10; ++i)
+    _Unwind_Backtrace (ip_and_cfa, NULL);
+
+  t0 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    _Unwind_Backtrace (ip_and_cfa, NULL);
+  t1 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    _Unwind_Backtrace (with_lsda, NULL);
+  t2 = gettime ();
+  for (i = 0; i < iterations; ++i)
+    step_loop ();
+  t3 = gettime ();
+
+  printf ("depth %4d: IP and CFA %8.3f usec, with LSDA %8.3f usec, "
+	  "unw_step() %8.3f usec\n", depth,
+	  1e6 * (t1 - t0) / iterations, 1e6 * (t2 - t1) / iterations,
+	  1e6 * (t3 - t2) / iterations);
+}
+
+static int NOINLINE
+recurse (int depth, int target)
+{
+  if (depth == target)
+    measure (depth);
+  else
+    recurse (depth + 1, target);
+  /* Not a tail call.  */
+  return sink;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 4, 16, 64, 200 };
+  int opt, i;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n': iterations = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n iterations] [depth...]\n", argv[0]);
+      }
+
+  if (optind < argc)
+    for (i = optind; i < argc; ++i)
+      recurse (0, atoi (argv[i]));
+  else
+    for (i = 0; i < (int) (sizeof (depths) / sizeof (depths[0])); ++i)
+      recurse (0, depths[i]);
+  return sum == 1;
+}
@@ -0,0 +1,242 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that unw_backtrace_id() gives equal stacks the same ID and
+   different ones different IDs, and that unw_stack_lookup() returns the
+   addresses unw_backtrace() finds, also with threads and signal
+   handlers storing stacks at the same time, and once the store is
+   full.  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define MAX_DEPTH	64
+#define NTHREADS	4
+#define NSTACKS		200
+
+int verbose;
+
+struct sample
+  {
+    uint64_t id;
+    int ret;
+    int n;
+    void *ips[MAX_DEPTH];
+  };
+
+static volatile int sink, passes = 2;
+static int filling;
+
+/* Take the ID and the backtrace of the same stack.  Only the return
+   address into this function differs.  */
+static void NOINLINE
+sample (struct sample *s)
+{
+  s->ret = unw_backtrace_id (&s->id, MAX_DEPTH);
+  s->n = unw_backtrace (s->ips, MAX_DEPTH);
+  UNW_TEST_CHECK (s->ret == s->n || (filling && s->ret == -UNW_ENOMEM),
+		  "%d frames interned, %d traced", s->ret, s->n);
+}
+
+/* The path to sample() encodes BITS, so that each value gives a
+   different stack.  */
+static void NOINLINE left (struct sample *s, unsigned bits, int depth);
+static void NOINLINE right (struct sample *s, unsigned bits, int depth);
+
+static void NOINLINE
+left (struct sample *s, unsigned bits, int depth)
+{
+  if (depth == 0)
+    sample (s);
+  else if (bits & 1)
+    right (s, bits >> 1, depth - 1);
+  else
+    left (s, bits >> 1, depth - 1);
+  /* Not a tail call.  */
+  sink++;
+}
+
+static void NOINLINE
+right (struct sample *s, unsigned bits, int depth)
+{
+  if (depth == 0)
+    sample (s);
+  else if (bits & 1)
+    right (s, bits >> 1, depth - 1);
+  else
+    left (s, bits >> 1, depth - 1);
+  sink++;
+}
+
+static int
+lookup_matches (const struct sample *s)
+{
+  void *ips[MAX_DEPTH];
+  int n;
+
+  n = unw_stack_lookup (s->id, ips, MAX_DEPTH);
+  return n == s->n && n > 1 && memcmp (&ips[1], &s->ips[1],
+				       (n - 1) * sizeof (ips[0])) == 0;
+}
+
+static void
+check_stacks (int depth)
+{
+  static struct sample s[NSTACKS], again[NSTACKS];
+  struct sample *to[2] = { s, again };
+  void *ips[MAX_DEPTH];
+  int i, j, pass;
+
+  /* From the same call site, to walk the same stacks twice, so the
+     compiler must not unroll this loop.  */
+  for (pass = 0; pass < passes; ++pass)
+    for (i = 0; i < NSTACKS; ++i)
+      left (&to[pass][i], i, depth);
+
+  for (i = 0; i < NSTACKS; ++i)
+    {
+      UNW_TEST_CHECK (again[i].id == s[i].id,
+		      "stack %d has another ID the second time", i);
+      UNW_TEST_CHECK (lookup_matches (&s[i]),
+		      "stack %d not found by its ID", i);
+      for (j = 0; j < i; ++j)
+	UNW_TEST_CHECK (s[j].id != s[i].id,
+			"stacks %d and %d have the same ID", j, i);
+    }
+
+  /* A shorter walk is a different stack, and the lookup may be cut
+     short.  */
+  UNW_TEST_CHECK (unw_stack_lookup (s[0].id, ips, 2) == 2
+		  && memcmp (&ips[1], &s[0].ips[1], sizeof (ips[0])) == 0,
+		  "lookup of 2 frames");
+  UNW_TEST_CHECK (unw_stack_lookup (s[0].id ^ 1, ips, MAX_DEPTH) < 0,
+		  "lookup of an unknown ID");
+  UNW_TEST_CHECK (unw_stack_lookup (0, ips, MAX_DEPTH) == -UNW_EINVAL,
+		  "lookup of ID 0");
+}
+
+static struct sample in_handler;
+
+static void
+handler (int sig UNUSED)
+{
+  left (&in_handler, 5, 3);
+}
+
+static void *
+worker (void *arg)
+{
+  struct sample *s = arg;
+  int i;
+
+  for (i = 0; i < NSTACKS; ++i)
+    left (&s[i], i, 10);
+  return NULL;
+}
+
+static void
+check_threads (void)
+{
+  static struct sample s[NTHREADS][NSTACKS];
+  pthread_t th[NTHREADS];
+  int i, j;
+
+  for (i = 0; i < NTHREADS; ++i)
+    pthread_create (&th[i], NULL, worker, s[i]);
+  for (i = 0; i < NTHREADS; ++i)
+    pthread_join (th[i], NULL);
+
+  /* The threads stored the same stacks under the same IDs.  */
+  for (i = 0; i < NTHREADS; ++i)
+    for (j = 0; j < NSTACKS; ++j)
+      {
+	UNW_TEST_CHECK (s[i][j].id == s[0][j].id,
+			"stack %d has another ID in thread %d", j, i);
+	UNW_TEST_CHECK (lookup_matches (&s[i][j]),
+			"stack %d of thread %d not found by its ID", j, i);
+      }
+}
+
+/* Store new stacks until there is no more room.  A stack which did not
+   fit must not be given an ID which leads nowhere when it is stored
+   again.  */
+static void
+check_full (void)
+{
+  static struct sample s[2];
+  unsigned i;
+  int pass;
+
+  filling = 1;
+  for (i = 0; i < (1u << 20); ++i)
+    {
+      left (&s[0], i, MAX_DEPTH - 4);
+      if (s[0].ret < 0)
+	break;
+    }
+  if (verbose)
+    printf ("store full after %u stacks\n", i);
+  UNW_TEST_CHECK (s[0].ret == -UNW_ENOMEM, "store never full");
+
+  for (pass = 0; pass < passes; ++pass)
+    left (&s[pass], i, MAX_DEPTH - 4);
+  UNW_TEST_CHECK (s[1].ret == -UNW_ENOMEM || lookup_matches (&s[1]),
+		  "stack which did not fit stored without its addresses");
+  filling = 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  uint64_t id;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  UNW_TEST_CHECK (unw_backtrace_id (NULL, MAX_DEPTH) == -UNW_EINVAL,
+		  "no place for the ID");
+  UNW_TEST_CHECK (unw_backtrace_id (&id, 0) == -UNW_EINVAL, "no frames");
+
+  check_stacks (8);
+  check_stacks (20);
+  check_threads ();
+
+  signal (SIGUSR1, handler);
+  kill (getpid (), SIGUSR1);
+  UNW_TEST_CHECK (in_handler.n > 0 && lookup_matches (&in_handler),
+		  "stack of a signal handler");
+
+  check_full ();
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -0,0 +1,224 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check unw_step() with UNW_INIT_FRAME_POINTER, which follows the
+   frame-pointer chain of this program, built with frame pointers,
+   against the unwind info: every frame found must be one unw_step()
+   finds otherwise, and only the caller of a function interrupted by a
+   signal before setting up its frame may be missing.  */
+
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define DEPTH		8
+#define MAX_FRAMES	64
+
+struct frame
+  {
+    unw_word_t ip, sp;
+  };
+
+int verbose;
+static int skipped;
+static unw_word_t main_sp;
+
+/* Record up to MAX frames from UC, and count the signal frames.  */
+static int
+walk (unw_context_t *uc, int flag, struct frame *f, int max, int *signals)
+{
+  unw_cursor_t cursor;
+  int n = 0, ret;
+
+  *signals = 0;
+  if ((ret = unw_init_local2 (&cursor, uc, flag)) < 0)
+    return ret;
+  do
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &f[n].ip);
+      unw_get_reg (&cursor, UNW_REG_SP, &f[n].sp);
+      if (verbose)
+	printf ("  %s ip 0x%lx sp 0x%lx\n",
+		flag & UNW_INIT_FRAME_POINTER ? "fp   " : "dwarf",
+		(long) f[n].ip, (long) f[n].sp);
+      if (unw_is_signal_frame (&cursor) > 0)
+	++*signals;
+    }
+  while (++n < max && unw_step (&cursor) > 0);
+  return n;
+}
+
+/* Return how many of the NF frames in FP are among the ND frames in
+   DW, in the same order.  */
+static int
+match (const struct frame *dw, int nd, const struct frame *fp, int nf)
+{
+  int i, j = 0;
+
+  for (i = 0; i < nf; ++i)
+    {
+      while (j < nd && (dw[j].ip != fp[i].ip || dw[j].sp != fp[i].sp))
+	++j;
+      if (j == nd)
+	break;
+      ++j;
+    }
+  return i;
+}
+
+/* Compare the walks from UC, which must find SIGNALS signal frames, and
+   with ALL_FRAMES, all the same frames.  */
+static void
+compare (unw_context_t *uc, int flag, int signals, int all_frames)
+{
+  struct frame dw[MAX_FRAMES], fp[MAX_FRAMES];
+  int nd, nf, i, dw_signals, fp_signals;
+  unw_stats_t s0, s1;
+
+  nd = walk (uc, flag, dw, MAX_FRAMES, &dw_signals);
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  nf = walk (uc, flag | UNW_INIT_FRAME_POINTER | UNW_INIT_VALIDATE, fp,
+	     MAX_FRAMES, &fp_signals);
+  unw_get_stats (unw_local_addr_space, &s1);
+  if (nf == -UNW_EINVAL)
+    {
+      skipped = 1;
+      return;
+    }
+
+  /* Every frame up to main() has a frame pointer, but the C library's
+     frames above need not.  */
+  for (i = 0; i < nf && fp[i].sp < main_sp; ++i)
+    continue;
+  UNW_TEST_CHECK (i < nf && fp[i].sp == main_sp, "main() not reached");
+  if (i == nf)
+    return;
+  nf = i + 1;
+  UNW_TEST_CHECK (match (dw, nd, fp, nf) == nf,
+		  "%d of %d frames as found from the unwind info",
+		  match (dw, nd, fp, nf), nf);
+  UNW_TEST_CHECK (dw_signals == fp_signals && (fp_signals > 0) == signals,
+		  "%d and %d signal frames", dw_signals, fp_signals);
+  if (all_frames)
+    UNW_TEST_CHECK (nf == DEPTH + 1, "%d frames", nf);
+
+  /* No unwind info was looked at.  */
+  UNW_TEST_CHECK (s1.rs_cache_hits == s0.rs_cache_hits
+		  && s1.rs_cache_misses == s0.rs_cache_misses,
+		  "unwind info looked at");
+
+  /* The same frames without validation, not going past main().  */
+  nf = walk (uc, flag | UNW_INIT_FRAME_POINTER, fp, DEPTH, &fp_signals);
+  UNW_TEST_CHECK (nf == DEPTH && match (dw, nd, fp, nf) == nf,
+		  "%d frames without validation", nf);
+}
+
+/* Neither unw_is_signal_frame() nor the walk may read the code at a
+   bad IP.  */
+static void
+bad_ip (void)
+{
+  unw_context_t uc;
+  unw_cursor_t cursor;
+
+  unw_getcontext (&uc);
+  UNW_TEST_CHECK (unw_init_local (&cursor, &uc) == 0, "cannot init cursor");
+  unw_set_reg (&cursor, UNW_REG_IP, 0);
+  UNW_TEST_CHECK (unw_is_signal_frame (&cursor) == 0,
+		  "IP 0 taken for a signal frame");
+
+  if (unw_init_local2 (&cursor, &uc, UNW_INIT_FRAME_POINTER) < 0)
+    return;
+  unw_set_reg (&cursor, UNW_REG_IP, 16);
+  UNW_TEST_CHECK (unw_step (&cursor) > 0, "cannot step from a bad IP");
+}
+
+static void NOINLINE
+here (int in_signal)
+{
+  unw_context_t uc;
+
+  unw_getcontext (&uc);
+  compare (&uc, 0, in_signal, !in_signal);
+}
+
+static void
+handler (int sig UNUSED, siginfo_t *info UNUSED, void *ucontext)
+{
+  here (1);
+  /* From the interrupted context, as in a profiler.  */
+  compare (ucontext, UNW_INIT_SIGNAL_FRAME, 0, 0);
+}
+
+static int NOINLINE
+recurse (int depth, int sig)
+{
+  /* The caller's stack pointer is above the saved frame pointer and
+     return address.  */
+  if (depth == DEPTH - 2)
+    main_sp = (unw_word_t) __builtin_frame_address (0) + 16;
+  if (depth == 0)
+    {
+      if (sig)
+	kill (getpid (), SIGUSR1);
+      else
+	here (0);
+    }
+  else
+    recurse (depth - 1, sig);
+  /* Not a tail call.  */
+  return skipped + depth;
+}
+
+int
+main (int argc, char **argv)
+{
+  struct sigaction sa;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  bad_ip ();
+  recurse (DEPTH - 2, 0);
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_sigaction = handler;
+  sa.sa_flags = SA_SIGINFO;
+  sigaction (SIGUSR1, &sa, NULL);
+  recurse (DEPTH - 2, 1);
+
+  if (skipped)
+    {
+      printf ("SKIP: UNW_INIT_FRAME_POINTER not supported\n");
+      return UNW_TEST_EXIT_SKIP;
+    }
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
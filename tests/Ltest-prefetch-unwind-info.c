@@ -0,0 +1,220 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check unw_prefetch_unwind_info(): its arguments, that stepping after
+   prefetching the register states of all the loaded code looks up no
+   unwind info and finds the frames it finds without the cache, also
+   through a signal frame, and that a prefetch with a cache too small
+   for the rows leaves that cache usable.  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define MAX_DEPTH	64
+#define DEPTH		16
+
+int verbose;
+
+struct walk
+  {
+    unw_word_t ip[MAX_DEPTH], sp[MAX_DEPTH];
+    int depth;
+  };
+
+static volatile int sink, nwalks = 2;
+
+static void NOINLINE
+walk (struct walk *w)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+
+  w->depth = 0;
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return;
+  do
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &w->ip[w->depth]);
+      unw_get_reg (&cursor, UNW_REG_SP, &w->sp[w->depth]);
+    }
+  while (++w->depth < MAX_DEPTH && unw_step (&cursor) > 0);
+}
+
+static struct walk *handler_walk;
+
+static void
+handler (int sig UNUSED)
+{
+  walk (handler_walk);
+}
+
+static int NOINLINE
+recurse (struct walk *w, int depth, int in_signal)
+{
+  if (depth > 0)
+    recurse (w, depth - 1, in_signal);
+  else if (in_signal)
+    {
+      handler_walk = w;
+      raise (SIGUSR1);
+    }
+  else
+    walk (w);
+  /* Not a tail call.  */
+  return sink;
+}
+
+static void
+compare (const struct walk *a, const struct walk *b)
+{
+  int i;
+
+  UNW_TEST_CHECK (a->depth == b->depth,
+		  "%d frames, then %d", a->depth, b->depth);
+  UNW_TEST_CHECK (a->depth > DEPTH, "only %d frames", a->depth);
+  for (i = 0; i < a->depth && i < b->depth; ++i)
+    if (a->ip[i] != b->ip[i] || a->sp[i] != b->sp[i])
+      {
+	UNW_TEST_CHECK (a->ip[i] == b->ip[i] && a->sp[i] == b->sp[i],
+			"frame %d at ip 0x%lx sp 0x%lx instead of "
+			"ip 0x%lx sp 0x%lx", i, (long) b->ip[i],
+			(long) b->sp[i], (long) a->ip[i], (long) a->sp[i]);
+	break;
+      }
+}
+
+/* Set up walk I: without the cache, or after prefetching.  */
+static void NOINLINE
+prepare (int i)
+{
+  if (i == 0)
+    unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  else
+    {
+      unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+      UNW_TEST_CHECK (unw_prefetch_unwind_info (unw_local_addr_space, 0,
+						~(unw_word_t) 0,
+						UNW_PREFETCH_RS_CACHE,
+						NULL) == 0,
+		      "cannot prefetch into the rs cache");
+    }
+}
+
+/* Compare the walks without the cache and after prefetching.  They
+   start from the same call site, as the loop is not unrolled.  */
+static void
+check_prefetched (int in_signal, int check_misses)
+{
+  struct walk w[2];
+  unw_stats_t s0, s1;
+  int i;
+
+  for (i = 0; i < nwalks; ++i)
+    {
+      prepare (i);
+      unw_get_stats (unw_local_addr_space, &s0);
+      recurse (&w[i], DEPTH, in_signal);
+      unw_get_stats (unw_local_addr_space, &s1);
+    }
+  if (verbose)
+    printf ("%d frames, %lu rs-cache misses after prefetch\n", w[1].depth,
+	    (long) (s1.rs_cache_misses - s0.rs_cache_misses));
+  if (check_misses)
+    UNW_TEST_CHECK (s1.rs_cache_misses == s0.rs_cache_misses,
+		    "rs-cache misses after prefetching");
+  compare (&w[0], &w[1]);
+}
+
+static void *
+thread_func (void *arg UNUSED)
+{
+  void *buffer[MAX_DEPTH];
+
+  UNW_TEST_CHECK (unw_prefetch_unwind_info (unw_local_addr_space, 0,
+					    ~(unw_word_t) 0,
+					    UNW_PREFETCH_TRACE_CACHE,
+					    NULL) == 0,
+		  "cannot prefetch into the trace cache");
+  UNW_TEST_CHECK (unw_backtrace (buffer, MAX_DEPTH) > 0, "no backtrace");
+  return NULL;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  unw_accessors_t *acc = unw_get_accessors (unw_local_addr_space);
+  unw_addr_space_t as;
+  struct sigaction sa;
+  pthread_t thread;
+
+  verbose = (argc > 1);
+
+  UNW_TEST_CHECK (unw_prefetch_unwind_info (unw_local_addr_space, 0,
+					    ~(unw_word_t) 0,
+					    ~(UNW_PREFETCH_RS_CACHE
+					      | UNW_PREFETCH_TRACE_CACHE),
+					    NULL) == -UNW_EINVAL,
+		  "unknown flags accepted");
+  UNW_TEST_CHECK (unw_prefetch_unwind_info (unw_local_addr_space, 0, 4096, 0,
+					    NULL) == -UNW_ENOINFO,
+		  "info found in the first page");
+  if ((as = unw_create_addr_space (acc, 0)))
+    {
+      UNW_TEST_CHECK (unw_prefetch_unwind_info (as, 0, ~(unw_word_t) 0,
+						UNW_PREFETCH_TRACE_CACHE, NULL)
+		      == -UNW_EINVAL, "trace cache of a remote address space");
+      unw_destroy_addr_space (as);
+    }
+
+  /* The rows of everything loaded fit a cache of this size.  */
+  UNW_TEST_CHECK (unw_set_cache_size (unw_local_addr_space, 1 << 17, 0) == 0,
+		  "cannot resize the rs cache");
+  check_prefetched (0, 1);
+
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = handler;
+  sigaction (SIGUSR1, &sa, NULL);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  check_prefetched (1, 1);
+
+  /* Prefetching more rows than fit stops when the cache is full.  */
+  UNW_TEST_CHECK (unw_set_cache_size (unw_local_addr_space, 64, 0) == 0,
+		  "cannot resize the rs cache");
+  check_prefetched (0, 0);
+
+  UNW_TEST_CHECK (pthread_create (&thread, NULL, thread_func, NULL) == 0,
+		  "cannot create thread");
+  pthread_join (thread, NULL);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -0,0 +1,197 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that unw_get_proc_name_preloaded() finds the names and offsets
+   unw_get_proc_name() finds, and that it can be called from a signal
+   handler which interrupted malloc().  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define DEPTH		8
+#define NALLOCS		200000
+
+int verbose;
+
+static volatile int sink;
+static volatile sig_atomic_t done, signals, named;
+
+/* Compare the names of all the frames of this stack.  */
+static int NOINLINE
+compare (void)
+{
+  char name[256], preloaded[256];
+  unw_word_t off, preloaded_off;
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int ret, preloaded_ret, n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return 0;
+  do
+    {
+      ret = unw_get_proc_name (&cursor, name, sizeof (name), &off);
+      preloaded_ret = unw_get_proc_name_preloaded (&cursor, preloaded,
+						   sizeof (preloaded),
+						   &preloaded_off);
+      UNW_TEST_CHECK (preloaded_ret == ret, "%s found by one lookup only",
+		      name);
+      if (ret < 0 || preloaded_ret != ret)
+	continue;
+      if (verbose)
+	printf ("  %s+0x%lx\n", preloaded, (long) preloaded_off);
+      UNW_TEST_CHECK (strcmp (name, preloaded) == 0,
+		      "preloaded name %s, not %s", preloaded, name);
+      UNW_TEST_CHECK (off == preloaded_off,
+		      "preloaded offset 0x%lx, not 0x%lx",
+		      (long) preloaded_off, (long) off);
+      ++n;
+    }
+  while (unw_step (&cursor) > 0);
+  return n;
+}
+
+static int NOINLINE
+recurse (int depth)
+{
+  int n;
+
+  if (depth == 0)
+    n = compare ();
+  else
+    n = recurse (depth - 1);
+  /* Not a tail call.  */
+  return n + sink;
+}
+
+/* Symbolize the interrupted stack, which is most likely in malloc() or
+   free(), and see the loop calling them.  */
+static void
+handler (int sig UNUSED)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  char name[64];
+
+  ++signals;
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return;
+  while (unw_step (&cursor) > 0)
+    if (unw_get_proc_name_preloaded (&cursor, name, sizeof (name), NULL) == 0
+	&& strcmp (name, "malloc_loop") == 0)
+      {
+	++named;
+	break;
+      }
+}
+
+static void NOINLINE
+malloc_loop (void)
+{
+  void *p[16];
+  int i;
+
+  for (i = 0; i < NALLOCS; ++i)
+    {
+      p[i % 16] = malloc (16 + (i * 37) % 4096);
+      if (i >= 15)
+	free (p[(i + 1) % 16]);
+    }
+  for (i = NALLOCS - 15; i < NALLOCS; ++i)
+    free (p[i % 16]);
+}
+
+static void *
+signaller (void *arg)
+{
+  pthread_t target = *(pthread_t *) arg;
+
+  while (!done)
+    {
+      pthread_kill (target, SIGUSR1);
+      usleep (50);
+    }
+  return NULL;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  pthread_t self = pthread_self (), t;
+  unw_word_t ip = (unw_word_t) (uintptr_t) &recurse, off;
+  char name[256];
+
+  verbose = (argc > 1);
+
+  /* Nothing is found before the tables are made.  */
+  UNW_TEST_CHECK (unw_get_proc_name_preloaded_by_ip (ip, name, sizeof (name),
+						     &off) == -UNW_ENOINFO,
+		  "found before preloading");
+  UNW_TEST_CHECK (name[0] == '\0', "name set before preloading");
+
+  UNW_TEST_CHECK (unw_preload_symbols () == 0, "cannot preload symbols");
+  /* Again, without change.  */
+  UNW_TEST_CHECK (unw_preload_symbols () == 0, "cannot preload symbols again");
+
+  UNW_TEST_CHECK (recurse (DEPTH) > DEPTH, "too few frames compared");
+
+  UNW_TEST_CHECK (unw_get_proc_name_preloaded_by_ip (ip + 1, name,
+						     sizeof (name), &off) == 0,
+		  "recurse+1 not found");
+  UNW_TEST_CHECK (strcmp (name, "recurse") == 0 && off == 1,
+		  "found %s+0x%lx for recurse+1", name, (long) off);
+  UNW_TEST_CHECK (unw_get_proc_name_preloaded_by_ip (ip, name, 4, &off)
+		  == -UNW_ENOMEM, "name cut short without an error");
+  UNW_TEST_CHECK (strcmp (name, "rec") == 0 && off == 0,
+		  "found %s+0x%lx for recurse, cut short", name, (long) off);
+  UNW_TEST_CHECK (unw_get_proc_name_preloaded_by_ip (0, name, sizeof (name),
+						     &off) == -UNW_ENOINFO,
+		  "found a name for IP 0");
+
+  signal (SIGUSR1, handler);
+  UNW_TEST_CHECK (pthread_create (&t, NULL, signaller, &self) == 0,
+		  "cannot create the signalling thread");
+  malloc_loop ();
+  done = 1;
+  UNW_TEST_CHECK (pthread_join (t, NULL) == 0,
+		  "cannot join the signalling thread");
+  signal (SIGUSR1, SIG_DFL);
+  if (verbose)
+    printf ("%d signals, %d found malloc_loop\n", (int) signals, (int) named);
+  UNW_TEST_CHECK (signals == 0 || named > 0,
+		  "no signal handler found malloc_loop");
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
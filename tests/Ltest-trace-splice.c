@@ -0,0 +1,184 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that unw_backtrace() returns the frames unw_step() finds when
+   it reuses the outer frames of the thread's previous backtrace: from
+   stacks which differ only in the innermost frames, from stacks whose
+   inner frames are where they were but whose outer ones changed, with
+   smaller buffers, through signal frames and in several threads.  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define MAX_DEPTH	128
+#define DEPTH		32
+#define NTHREADS	4
+
+int verbose;
+
+static volatile int sink, passes = 2;
+static int sizes[] = { MAX_DEPTH, 4, MAX_DEPTH, 2, DEPTH + 3, MAX_DEPTH };
+
+/* Compare unw_backtrace() of SIZE frames with a unw_step() walk.  Only
+   the address in this function differs.  */
+static void NOINLINE
+sample (int size)
+{
+  void *buffer[MAX_DEPTH];
+  unw_word_t ip[MAX_DEPTH];
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int i, n, expected = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    {
+      UNW_TEST_CHECK (0, "cannot init cursor");
+      return;
+    }
+  do
+    unw_get_reg (&cursor, UNW_REG_IP, &ip[expected++]);
+  while (expected < MAX_DEPTH && unw_step (&cursor) > 0);
+  if (expected > size)
+    expected = size;
+
+  n = unw_backtrace (buffer, size);
+  UNW_TEST_CHECK (n == expected, "%d frames traced, %d walked", n, expected);
+  for (i = 1; i < n && i < expected; ++i)
+    if (buffer[i] != (void *) ip[i])
+      {
+	UNW_TEST_CHECK (buffer[i] == (void *) ip[i],
+			"frame %d of %d is %p, expected %p",
+			i, n, buffer[i], (void *) ip[i]);
+	break;
+      }
+}
+
+static void
+handler (int sig UNUSED)
+{
+  sample (MAX_DEPTH);
+  sample (MAX_DEPTH);
+}
+
+/* Vary the innermost frames.  */
+static void NOINLINE
+inner (int depth, int size)
+{
+  if (depth == 0)
+    sample (size);
+  else
+    inner (depth - 1, size);
+  /* Not a tail call.  */
+  sink++;
+}
+
+static void NOINLINE
+descend (int depth)
+{
+  unsigned int i;
+
+  if (depth > 0)
+    descend (depth - 1);
+  else
+    {
+      for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i)
+	inner (i % 3, sizes[i]);
+      raise (SIGUSR1);
+    }
+  sink++;
+}
+
+/* Two callers of descend() with the same frame size, so that the
+   frames of descend() are at the same addresses below either.  */
+#define OUTER(name, n)							\
+  static void NOINLINE							\
+  name (void)								\
+  {									\
+    descend (DEPTH);							\
+    sink += n;								\
+  }
+OUTER (outer_a, 1)
+OUTER (outer_b, 2)
+
+static void (*const outers[]) (void) = { outer_a, outer_b, outer_b, outer_a };
+
+static void *
+run (void *arg UNUSED)
+{
+  int pass, i;
+
+  for (pass = 0; pass < passes; ++pass)
+    for (i = 0; i < (int) (sizeof (outers) / sizeof (outers[0])); ++i)
+      outers[i] ();
+  return NULL;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  pthread_t threads[NTHREADS];
+  unw_stats_t s0, s1;
+  int stats;
+  int i;
+
+  verbose = (argc > 1);
+
+  signal (SIGUSR1, handler);
+
+  stats = unw_get_stats (unw_local_addr_space, &s0) == 0;
+  run (NULL);
+  unw_get_stats (unw_local_addr_space, &s1);
+  if (verbose)
+    printf ("%lu frames reused\n", (long) (s1.trace_spliced - s0.trace_spliced));
+#if defined(__x86_64__)
+  UNW_TEST_CHECK (s1.trace_spliced > s0.trace_spliced || !stats,
+		  "no frames reused");
+#endif
+
+  for (i = 0; i < NTHREADS; ++i)
+    UNW_TEST_CHECK (pthread_create (&threads[i], NULL, run, NULL) == 0,
+		    "cannot create thread %d", i);
+  for (i = 0; i < NTHREADS; ++i)
+    UNW_TEST_CHECK (pthread_join (threads[i], NULL) == 0,
+		    "cannot join thread %d", i);
+
+  /* Without caching every frame is walked.  */
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  unw_get_stats (unw_local_addr_space, &s0);
+  run (NULL);
+  unw_get_stats (unw_local_addr_space, &s1);
+  UNW_TEST_CHECK (s1.trace_spliced == s0.trace_spliced,
+		  "frames reused without caching");
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
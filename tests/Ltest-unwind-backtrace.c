@@ -0,0 +1,158 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that _Unwind_Backtrace() hands out the same frames as a
+   unw_step() loop, whether or not the callback asks for more than the
+   IP and CFA of a frame, and on stacks deeper than one fast trace.  */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include <unwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define MAX_FRAMES	512
+
+#if UNW_TARGET_X86_64 || UNW_TARGET_AARCH64 || UNW_TARGET_ARM
+# define HAVE_FAST_TRACE	1
+#endif
+
+int verbose;
+
+struct frames
+  {
+    int n;
+    int every;		/* ask for the region start of every EVERYth frame */
+    unw_word_t ip[MAX_FRAMES], sp[MAX_FRAMES], start[MAX_FRAMES];
+  };
+
+static struct frames expected, got;
+static volatile int sink;
+
+static _Unwind_Reason_Code
+record (struct _Unwind_Context *context, void *arg)
+{
+  struct frames *f = arg;
+
+  if (f->n == MAX_FRAMES)
+    return _URC_NORMAL_STOP;
+  if (f->every && f->n % f->every == 0)
+    f->start[f->n] = _Unwind_GetRegionStart (context);
+  f->ip[f->n] = _Unwind_GetIP (context);
+  f->sp[f->n] = _Unwind_GetCFA (context);
+  ++f->n;
+  return _URC_NO_REASON;
+}
+
+static void NOINLINE
+compare (int every)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  unw_stats_t s0, s1;
+#ifdef HAVE_FAST_TRACE
+  unw_word_t traced = 0;
+#endif
+  int i, stats UNUSED;
+
+  /* Frame 0 is this function, at different call sites.  */
+  memset (&expected, 0, sizeof (expected));
+  unw_getcontext (&uc);
+  unw_init_local (&cursor, &uc);
+  do
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &expected.ip[expected.n]);
+      unw_get_reg (&cursor, UNW_REG_SP, &expected.sp[expected.n]);
+      if (unw_get_proc_info (&cursor, &pi) == 0)
+	expected.start[expected.n] = pi.start_ip;
+      ++expected.n;
+    }
+  while (expected.n < MAX_FRAMES && unw_step (&cursor) > 0);
+
+  memset (&got, 0, sizeof (got));
+  got.every = every;
+  stats = unw_get_stats (unw_local_addr_space, &s0) == 0;
+  _Unwind_Backtrace (record, &got);
+  unw_get_stats (unw_local_addr_space, &s1);
+#ifdef HAVE_FAST_TRACE
+  /* The frames came from the fast trace.  */
+  for (i = 0; i < UNW_STATS_FRAME_TYPES; ++i)
+    traced += (s1.trace_hits[i] - s0.trace_hits[i]
+	       + s1.trace_misses[i] - s0.trace_misses[i]);
+  UNW_TEST_CHECK (traced > 0 || !stats, "no frames traced");
+#endif
+
+  if (verbose)
+    printf ("%d frames, %d by _Unwind_Backtrace()\n", expected.n, got.n);
+  UNW_TEST_CHECK (got.n == expected.n,
+		  "%d frames, %d expected", got.n, expected.n);
+  for (i = 1; i < got.n && i < expected.n; ++i)
+    {
+      UNW_TEST_CHECK (got.ip[i] == expected.ip[i],
+		      "frame %d at ip 0x%lx, not 0x%lx", i,
+		      (long) got.ip[i], (long) expected.ip[i]);
+      UNW_TEST_CHECK (got.sp[i] == expected.sp[i],
+		      "frame %d at sp 0x%lx, not 0x%lx", i,
+		      (long) got.sp[i], (long) expected.sp[i]);
+      if (every && i % every == 0)
+	UNW_TEST_CHECK (got.start[i] == expected.start[i],
+			"frame %d in a procedure at 0x%lx, not 0x%lx", i,
+			(long) got.start[i], (long) expected.start[i]);
+    }
+}
+
+static int NOINLINE
+recurse (int depth, int every)
+{
+  if (depth == 0)
+    compare (every);
+  else
+    recurse (depth - 1, every);
+  /* Not a tail call.  */
+  return sink;
+}
+
+int
+main (int argc, char **argv)
+{
+  static const int depths[] = { 1, 20, 300 };
+  size_t i;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  for (i = 0; i < sizeof (depths) / sizeof (depths[0]); ++i)
+    {
+      recurse (depths[i], 0);
+      recurse (depths[i], 1);
+      recurse (depths[i], 7);
+    }
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -0,0 +1,146 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Measure registering, looking up and cancelling many regions of
+   dynamic unwind info, as a JIT with lots of generated code would.
+
+   Usage: perf-dyn-register [-n regions] [-l lookups]
+
+   The regions are registered in a shuffled order and looked up at
+   random, through unw_get_proc_info_by_ip() so that the figures
+   include what an unwind pays per frame.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define REGION_SIZE	256
+
+static long nlookups = 1 << 20;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void
+measure (long n)
+{
+  unsigned long long x = 88172645463325252ULL;
+  unw_dyn_info_t *di;
+  unw_proc_info_t pi;
+  unw_word_t base, sum = 0;
+  double t0, t1, t2, t3;
+  long i, j, t, *order;
+
+  di = calloc (n, sizeof (di[0]));
+  order = malloc (n * sizeof (order[0]));
+  if (!di || !order)
+    panic ("out of memory\n");
+
+  /* An address range without any code.  */
+  base = (unw_word_t) 1 << (sizeof (unw_word_t) * 8 - 4);
+  for (i = 0; i < n; ++i)
+    {
+      di[i].start_ip = base + i * REGION_SIZE;
+      di[i].end_ip = di[i].start_ip + REGION_SIZE;
+      di[i].format = UNW_INFO_FORMAT_DYNAMIC;
+      order[i] = i;
+    }
+  for (i = n - 1; i > 0; --i)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      j = x % (i + 1);
+      t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+
+  t0 = gettime ();
+  for (i = 0; i < n; ++i)
+    _U_dyn_register (&di[order[i]]);
+  t1 = gettime ();
+  for (i = 0; i < nlookups; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      if (unw_get_proc_info_by_ip (unw_local_addr_space,
+				   base + (x % n) * REGION_SIZE + 16,
+				   &pi, NULL) < 0)
+	panic ("region not found\n");
+      sum += pi.start_ip;
+    }
+  t2 = gettime ();
+  for (i = 0; i < n; ++i)
+    _U_dyn_cancel (&di[order[i]]);
+  t3 = gettime ();
+
+  printf ("%8ld regions: register %8.1f nsec, lookup %9.1f nsec, "
+	  "cancel %8.1f nsec%s\n", n, 1e9 * (t1 - t0) / n,
+	  1e9 * (t2 - t1) / nlookups, 1e9 * (t3 - t2) / n,
+	  sum == 1 ? " " : "");
+
+  free (di);
+  free (order);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const long sizes[] = { 100, 10000, 200000 };
+  long n = 0;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:l:")) != -1)
+    switch (opt)
+      {
+      case 'n': n = atol (optarg); break;
+      case 'l': nlookups = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n regions] [-l lookups]\n", argv[0]);
+      }
+
+  if (n)
+    measure (n);
+  else
+    for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i)
+      measure (sizes[i]);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Measure registering, looking up and cancelling the .eh_frame of
+   generated code with _U_register_frame(), one per function as a JIT
+   emits them, and all in one .eh_frame.
+
+   Usage: perf-register-frame [-n functions] [-l lookups]
+
+   The functions are looked up at random through
+   unw_get_proc_info_by_ip(), so that the figures include what an
+   unwind pays per frame.  */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define FUNC_SIZE	256
+
+static long nlookups = 1 << 20;
+
+/* A CIE with absolute FDE addresses and a trivial CFA rule.  */
+static const uint8_t cie[] = {
+  0x10, 0, 0, 0,		/* length */
+  0, 0, 0, 0,			/* CIE id */
+  1, 'z', 'R', 0,		/* version, augmentation */
+  1, 0x78, 16,			/* code and data alignment, RA column */
+  1, 0x00,			/* FDE encoding absptr */
+  0x0c, 7, 8			/* DW_CFA_def_cfa r7, 8 */
+};
+
+#define FDE_SIZE	(4 + 4 + 2 * sizeof (unw_word_t) + 4)
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+/* Write an .eh_frame for N functions from START to P.  */
+static void
+put_eh_frame (uint8_t *p, unw_word_t start, long n)
+{
+  size_t off = sizeof (cie);
+  unw_word_t range = FUNC_SIZE;
+  uint32_t v;
+  long i;
+
+  memcpy (p, cie, sizeof (cie));
+  for (i = 0; i < n; ++i, off += FDE_SIZE)
+    {
+      v = FDE_SIZE - 4;
+      memcpy (p + off, &v, 4);
+      v = off + 4;
+      memcpy (p + off + 4, &v, 4);
+      start += FUNC_SIZE;
+      memcpy (p + off + 8, &start, sizeof (start));
+      memcpy (p + off + 8 + sizeof (start), &range, sizeof (range));
+      /* No augmentation data, DW_CFA_nops.  */
+      memset (p + off + 8 + 2 * sizeof (start), 0, 4);
+    }
+  memset (p + off, 0, 4);
+}
+
+static unw_word_t
+lookups (unw_word_t base, long n)
+{
+  unsigned long long x = 88172645463325252ULL;
+  unw_proc_info_t pi;
+  unw_word_t sum = 0;
+  long i;
+
+  for (i = 0; i < nlookups; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      if (unw_get_proc_info_by_ip (unw_local_addr_space,
+				   base + (x % n + 1) * FUNC_SIZE + 16,
+				   &pi, NULL) < 0)
+	panic ("function not found\n");
+      sum += pi.start_ip;
+    }
+  return sum;
+}
+
+static void
+measure (long n)
+{
+  size_t blob_size = sizeof (cie) + FDE_SIZE + 4;
+  uint8_t *blobs, *all;
+  unw_word_t base, sum;
+  double t0, t1, t2, t3;
+  long i;
+
+  blobs = malloc (n * blob_size);
+  all = malloc (sizeof (cie) + n * FDE_SIZE + 4);
+  if (!blobs || !all)
+    panic ("out of memory\n");
+
+  /* An address range without any code.  */
+  base = (unw_word_t) 1 << (sizeof (unw_word_t) * 8 - 4);
+  for (i = 0; i < n; ++i)
+    put_eh_frame (blobs + i * blob_size, base + i * FUNC_SIZE, 1);
+  put_eh_frame (all, base, n);
+
+  t0 = gettime ();
+  for (i = 0; i < n; ++i)
+    _U_register_frame (blobs + i * blob_size);
+  t1 = gettime ();
+  sum = lookups (base, n);
+  t2 = gettime ();
+  for (i = 0; i < n; ++i)
+    _U_deregister_frame (blobs + i * blob_size);
+  t3 = gettime ();
+
+  printf ("%8ld .eh_frames: register %8.1f nsec, lookup %9.1f nsec, "
+	  "cancel %8.1f nsec%s\n", n, 1e9 * (t1 - t0) / n,
+	  1e9 * (t2 - t1) / nlookups, 1e9 * (t3 - t2) / n,
+	  sum == 1 ? " " : "");
+
+  t0 = gettime ();
+  _U_register_frame (all);
+  t1 = gettime ();
+  sum = lookups (base, n);
+  t2 = gettime ();
+  _U_deregister_frame (all);
+  t3 = gettime ();
+
+  printf ("%8ld FDEs in one: register %8.1f nsec, lookup %9.1f nsec, "
+	  "cancel %8.1f nsec%s\n", n, 1e9 * (t1 - t0) / n,
+	  1e9 * (t2 - t1) / nlookups, 1e9 * (t3 - t2),
+	  sum == 1 ? " " : "");
+
+  free (blobs);
+  free (all);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const long sizes[] = { 100, 10000, 100000 };
+  long n = 0;
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:l:")) != -1)
+    switch (opt)
+      {
+      case 'n': n = atol (optarg); break;
+      case 'l': nlookups = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n functions] [-l lookups]\n", argv[0]);
+      }
+
+  if (n)
+    measure (n);
+  else
+    for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i)
+      measure (sizes[i]);
+  return 0;
+}
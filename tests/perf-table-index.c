@@ -0,0 +1,142 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Compare the latency of looking up .eh_frame_hdr-style tables of
+   several sizes by binary search and through a B+-tree index.
+
+   Usage: perf-table-index [-n lookups]
+
+   Each lookup depends on the previous one, as consecutive frames of
+   an unwind do, so the figures are latencies rather than throughput.
+   The remote column is the number of table reads a lookup through the
+   accessors makes.  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/time.h>
+
+#include "dwarf/Gfind_proc_info_i.h"
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+static long nlookups = 1 << 22;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void
+measure (size_t len)
+{
+  struct table_entry *table;
+  int32_t *keys, *leaves, span;
+  size_t offsets[TABLE_INDEX_MAX_HEIGHT + 1];
+  unsigned int height;
+  unsigned long long x = 88172645463325252ULL;
+  size_t i, k, hi, sum = 0;
+  const struct table_entry *e;
+  double t0, t1, t2;
+  int steps = 0;
+  long n;
+
+  table = malloc (len * sizeof (table[0]));
+  height = table_index_layout (len, offsets);
+  keys = aligned_alloc (64, offsets[height] * TABLE_INDEX_B * sizeof (keys[0]));
+  if (!table || !keys)
+    panic ("out of memory\n");
+
+  /* Functions of 16 to 528 bytes.  */
+  for (i = 0; i < len; ++i)
+    {
+      table[i].start_ip_offset = i ? table[i - 1].start_ip_offset
+				     + 16 + (i * 2654435761u) % 512 : 0;
+      table[i].fde_offset = i;
+    }
+  span = table[len - 1].start_ip_offset + 16;
+  leaves = keys + offsets[height - 1] * TABLE_INDEX_B;
+  for (i = 0; i < (offsets[height] - offsets[height - 1]) * TABLE_INDEX_B; ++i)
+    leaves[i] = i < len ? table[i].start_ip_offset : INT32_MAX;
+  table_index_fill (keys, offsets, height);
+
+  t0 = gettime ();
+  for (n = 0; n < nlookups; ++n)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      e = lookup (table, len * sizeof (table[0]),
+		  (int32_t) ((x + sum) % span));
+      sum += e->fde_offset & 1;
+    }
+  t1 = gettime ();
+  for (n = 0; n < nlookups; ++n)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      hi = table_index_search (keys, offsets, height, len,
+			       (int32_t) ((x + sum) % span));
+      sum += table[hi - 1].fde_offset & 1;
+    }
+  t2 = gettime ();
+
+  for (k = len; k > 0; k /= 2)
+    ++steps;
+  printf ("%8zu entries: binary %7.1f nsec, index %7.1f nsec; "
+	  "remote reads %2d -> 3%s\n", len,
+	  1e9 * (t1 - t0) / nlookups, 1e9 * (t2 - t1) / nlookups, steps + 2,
+	  sum == (size_t) -1 ? " " : "");
+
+  free (table);
+  free (keys);
+}
+
+int
+main (int argc, char **argv)
+{
+  static const size_t sizes[] = { 1024, 16384, 65536, 300000, 1 << 21 };
+  size_t i;
+  int opt;
+
+  while ((opt = getopt (argc, argv, "n:")) != -1)
+    switch (opt)
+      {
+      case 'n': nlookups = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-n lookups]\n", argv[0]);
+      }
+
+  for (i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i)
+    measure (sizes[i]);
+  return 0;
+}
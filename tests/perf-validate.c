@@ -0,0 +1,143 @@
+/* libunwind - a platform-independent unwind library
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Measure the cost per frame of the address validation done by
+   conservative unwinding: each frame checks its frame-pointer slot.
+
+   Usage: perf-validate [-d depth] [-n passes]  */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "libunwind_i.h"
+#include "compiler.h"
+
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#define panic(...)							  \
+	do { fprintf (stderr, __VA_ARGS__); exit (-1); } while (0)
+
+#define MAX_DEPTH	4096
+#define HEAP_PAGES	4096	/* should be >> the validator's page cache */
+
+static unw_word_t frames[MAX_DEPTH];
+static int depth = 256;
+static long passes = 1000;
+
+static inline double
+gettime (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + 1e-6*tv.tv_usec;
+}
+
+static void
+measure (const char *label, const unw_word_t *addr, int n, long npasses)
+{
+  double t0, t1;
+  long pass;
+  int i;
+
+  t0 = gettime ();
+  for (pass = 0; pass < npasses; ++pass)
+    for (i = 0; i < n; ++i)
+      if (!unw_address_is_valid (addr[i], sizeof (unw_word_t)))
+	panic ("%s: %#lx is not valid\n", label, (long) addr[i]);
+  t1 = gettime ();
+
+  printf ("%s: %9.3f nsec/frame\n", label, 1e9 * (t1 - t0) / (npasses * n));
+}
+
+/* Record the frame addresses of a deep stack, spread over several
+   pages by the locals of each frame, then validate them.  */
+static int NOINLINE
+recurse (int level, const char *label)
+{
+  volatile char pad[512];
+
+  pad[0] = level;
+  frames[level] = (unw_word_t) __builtin_frame_address (0);
+  if (level + 1 < depth)
+    return recurse (level + 1, label) + pad[0];
+
+  measure (label, frames, depth, 1);
+  measure (label, frames, depth, passes);
+  return 0;
+}
+
+static void *
+thread_stack (void *arg UNUSED)
+{
+  recurse (0, "thread stack    ");
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  static unw_word_t pages[HEAP_PAGES];
+  unw_context_t uc;
+  unw_cursor_t c;
+  pthread_t t;
+  char *heap;
+  long page_size = sysconf (_SC_PAGESIZE);
+  int opt, i;
+
+  while ((opt = getopt (argc, argv, "d:n:")) != -1)
+    switch (opt)
+      {
+      case 'd': depth = atoi (optarg); break;
+      case 'n': passes = atol (optarg); break;
+      default:
+	panic ("Usage: %s [-d depth] [-n passes]\n", argv[0]);
+      }
+  if (depth < 1 || depth > MAX_DEPTH)
+    panic ("depth must be between 1 and %d\n", MAX_DEPTH);
+
+  /* Initialize the library.  */
+  unw_getcontext (&uc);
+  if (unw_init_local (&c, &uc) < 0)
+    panic ("unw_init_local() failed\n");
+
+  printf ("%d frames, %ld passes; first line of each pair is cold\n",
+	  depth, passes);
+
+  recurse (0, "main stack      ");
+
+  if (pthread_create (&t, NULL, thread_stack, NULL) != 0
+      || pthread_join (t, NULL) != 0)
+    panic ("cannot run thread\n");
+
+  /* Every check misses the page cache.  */
+  heap = mmap (NULL, HEAP_PAGES * page_size, PROT_READ | PROT_WRITE,
+	       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (heap == MAP_FAILED)
+    panic ("mmap failed\n");
+  for (i = 0; i < HEAP_PAGES; ++i)
+    pages[i] = (unw_word_t) heap + i * page_size;
+  measure ("uncached pages  ", pages, HEAP_PAGES, passes / 100 + 1);
+  return 0;
+}
@@ -0,0 +1,107 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check unwinding through functions which only have .debug_frame
+   unwind info, served from the file mapping.  */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define DEPTH	8
+
+int verbose;
+static volatile int sink;
+
+/* Walk the stack and count the frames of recurse(), which must come
+   from the .debug_frame.  */
+static int NOINLINE
+walk (unw_word_t recurse_ip)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  int n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return 0;
+  while (unw_step (&cursor) > 0)
+    {
+      if (unw_get_proc_info (&cursor, &pi) < 0)
+	break;
+      if (verbose)
+	printf ("  start_ip 0x%lx, flags 0x%lx\n",
+		(long) pi.start_ip, (long) pi.flags);
+      if (pi.start_ip == recurse_ip && (pi.flags & UNW_PI_FLAG_DEBUG_FRAME))
+	++n;
+    }
+  return n;
+}
+
+static int NOINLINE
+recurse (int depth)
+{
+  int n;
+
+  if (depth == 0)
+    n = walk ((unw_word_t) (uintptr_t) &recurse);
+  else
+    n = recurse (depth - 1);
+  /* Not a tail call.  */
+  return n + sink;
+}
+
+int
+main (int argc, char **argv)
+{
+  int i;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+#ifndef CONFIG_DEBUG_FRAME
+  printf ("SKIP: .debug_frame support is not enabled\n");
+  return UNW_TEST_EXIT_SKIP;
+#endif
+
+  for (i = 0; i < 2; ++i)
+    UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		    "pass %d: frames not found", i);
+
+  /* The section is mapped again after a flush.  */
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found after a flush");
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -0,0 +1,258 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+
+/* Look up dynamic unwind info in another process, through the list a
+   remote unwinder reads, while that process keeps registering and
+   cancelling it in batches.  When the process is stopped, as by a
+   debugger, a batch must be either all registered or not at all.  */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/wait.h>
+
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define NBATCH		32
+#define REGION_SIZE	64
+#define STOPS		200
+#define LOOKUPS		20000
+
+extern unw_word_t _U_dyn_info_list_addr (void);
+
+int verbose;
+static int mem_fd;
+static unw_word_t list_addr;
+
+struct start_msg
+  {
+    unw_word_t list_addr;
+    unw_word_t phase_addr;
+  };
+
+enum { CANCELLING, REGISTERING, REGISTERED };
+
+static volatile sig_atomic_t stop;
+static volatile int phase;
+
+static void
+handle_term (int sig UNUSED)
+{
+  stop = 1;
+}
+
+/* Register and cancel the regions starting at BASE as one batch until
+   told to stop.  Return the number of batches which did not change
+   the generation number of the list by one.  */
+static int
+child (int fd, unw_word_t base)
+{
+  static unw_dyn_info_t di[NBATCH];
+  unw_dyn_info_t *batch[NBATCH];
+  unw_dyn_info_list_t *list;
+  struct start_msg msg;
+  uint32_t gen;
+  int i, errors = 0;
+
+  for (i = 0; i < NBATCH; ++i)
+    {
+      di[i].start_ip = base + i * REGION_SIZE;
+      di[i].end_ip = di[i].start_ip + REGION_SIZE;
+      di[i].format = UNW_INFO_FORMAT_DYNAMIC;
+      batch[i] = &di[i];
+    }
+  list = (unw_dyn_info_list_t *) (uintptr_t) _U_dyn_info_list_addr ();
+  signal (SIGTERM, handle_term);
+
+  msg.list_addr = _U_dyn_info_list_addr ();
+  msg.phase_addr = (unw_word_t) (uintptr_t) &phase;
+  if (write (fd, &msg, sizeof (msg)) != sizeof (msg))
+    return 1;
+  close (fd);
+
+  while (!stop)
+    {
+      gen = list->generation;
+      phase = REGISTERING;
+      _U_dyn_register_batch (batch, NBATCH);
+      phase = REGISTERED;
+      if (list->generation != gen + 1)
+	++errors;
+      phase = CANCELLING;
+      _U_dyn_cancel_batch (batch, NBATCH);
+      if (list->generation != gen + 2)
+	++errors;
+    }
+  return errors != 0;
+}
+
+static int
+access_mem (unw_addr_space_t as UNUSED, unw_word_t addr, unw_word_t *valp,
+	    int write, void *arg UNUSED)
+{
+  if (write
+      || pread (mem_fd, valp, sizeof (*valp), addr) != sizeof (*valp))
+    return -UNW_EINVAL;
+  return 0;
+}
+
+static int
+find_proc_info (unw_addr_space_t as UNUSED, unw_word_t ip UNUSED,
+		unw_proc_info_t *pi UNUSED, int need_unwind_info UNUSED,
+		void *arg UNUSED)
+{
+  return -UNW_ENOINFO;
+}
+
+static void
+put_unwind_info (unw_addr_space_t as UNUSED, unw_proc_info_t *pi UNUSED,
+		 void *arg UNUSED)
+{
+}
+
+static int
+get_dyn_info_list_addr (unw_addr_space_t as UNUSED, unw_word_t *addr,
+			void *arg UNUSED)
+{
+  *addr = list_addr;
+  return 0;
+}
+
+/* Look up the region containing IP, and check that what is found is
+   that region.  */
+static int
+lookup (unw_addr_space_t as, unw_word_t ip)
+{
+  unw_proc_info_t pi;
+
+  if (unw_get_proc_info_by_ip (as, ip, &pi, NULL) < 0)
+    return 0;
+  UNW_TEST_CHECK (pi.start_ip == ip - ip % REGION_SIZE
+		  && pi.end_ip == pi.start_ip + REGION_SIZE,
+		  "region at 0x%lx found as 0x%lx-0x%lx", (long) ip,
+		  (long) pi.start_ip, (long) pi.end_ip);
+  return 1;
+}
+
+int
+main (int argc, char **argv UNUSED)
+{
+  unsigned long long x = 88172645463325252ULL;
+  unsigned long hits = 0, partial = 0;
+  unw_accessors_t acc;
+  unw_addr_space_t as;
+  struct start_msg msg;
+  unw_word_t base, word;
+  int fds[2], status, i, n, now;
+  char path[64];
+  pid_t pid;
+
+  verbose = (argc > 1);
+
+  /* An address range without any code.  */
+  base = (unw_word_t) 1 << (sizeof (unw_word_t) * 8 - 4);
+
+  if (pipe (fds) < 0)
+    return UNW_TEST_EXIT_SKIP;
+  if ((pid = fork ()) == 0)
+    {
+      close (fds[0]);
+      _exit (child (fds[1], base));
+    }
+  close (fds[1]);
+  UNW_TEST_ASSERT (pid >= 0
+		   && read (fds[0], &msg, sizeof (msg)) == sizeof (msg),
+		   "the child process did not start");
+  list_addr = msg.list_addr;
+
+  snprintf (path, sizeof (path), "/proc/%d/mem", (int) pid);
+  mem_fd = open (path, O_RDONLY);
+  if (mem_fd < 0 || pread (mem_fd, &word, sizeof (word), list_addr) < 0)
+    {
+      printf ("SKIP: cannot read the memory of the child process: %s\n",
+	      strerror (errno));
+      kill (pid, SIGKILL);
+      waitpid (pid, &status, 0);
+      return UNW_TEST_EXIT_SKIP;
+    }
+
+  memset (&acc, 0, sizeof (acc));
+  acc.find_proc_info = find_proc_info;
+  acc.put_unwind_info = put_unwind_info;
+  acc.get_dyn_info_list_addr = get_dyn_info_list_addr;
+  acc.access_mem = access_mem;
+  as = unw_create_addr_space (&acc, 0);
+  UNW_TEST_ASSERT (as != NULL, "cannot create the address space");
+
+  /* Look up regions while the list changes under the lookups.  */
+  for (i = 0; i < LOOKUPS; ++i)
+    {
+      x ^= x << 13;
+      x ^= x >> 7;
+      x ^= x << 17;
+      hits += lookup (as, base + (x % NBATCH) * REGION_SIZE + 8);
+    }
+
+  /* Stop the process at random points and count the regions
+     registered.  */
+  for (i = 0; i < STOPS; ++i)
+    {
+      kill (pid, SIGSTOP);
+      waitpid (pid, &status, WUNTRACED);
+      UNW_TEST_CHECK (pread (mem_fd, &now, sizeof (now), msg.phase_addr)
+		      == sizeof (now), "cannot read the phase of the child");
+      for (n = 0, word = 0; word < NBATCH; ++word)
+	n += lookup (as, base + word * REGION_SIZE + 8);
+      if (now == REGISTERING)
+	UNW_TEST_CHECK (n == 0 || n == NBATCH,
+			"%d of %d regions registered while registering",
+			n, NBATCH);
+      else if (now == REGISTERED)
+	UNW_TEST_CHECK (n == NBATCH, "%d of %d regions registered", n, NBATCH);
+      else
+	partial += n > 0 && n < NBATCH;
+      kill (pid, SIGCONT);
+      usleep (x % 1000);
+    }
+  if (verbose)
+    printf ("%lu of %d lookups found a region, %lu of %d stops in a "
+	    "partial cancel\n", hits, LOOKUPS, partial, STOPS);
+
+  kill (pid, SIGTERM);
+  waitpid (pid, &status, 0);
+  UNW_TEST_CHECK (WIFEXITED (status) && WEXITSTATUS (status) == 0,
+		  "the child process failed");
+  unw_destroy_addr_space (as);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
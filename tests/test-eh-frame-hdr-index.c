@@ -0,0 +1,94 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include <stdint.h>
+
+#include "unw_test.h"
+
+/* Pull in the inline lookup functions directly. */
+#include "dwarf/Gfind_proc_info_i.h"
+
+#define MAX_LEN 5000
+
+/* The leaves and the upper layers, with room for padding.  */
+#define MAX_KEYS (MAX_LEN + MAX_LEN / 8 + 4 * TABLE_INDEX_B)
+
+static struct table_entry table[MAX_LEN];
+static int32_t keys[MAX_KEYS];
+static size_t offsets[TABLE_INDEX_MAX_HEIGHT + 1];
+static unsigned int height;
+
+static unsigned long long seed = 88172645463325252ULL;
+
+static unsigned int
+next_random (void)
+{
+  /* xorshift64 */
+  seed ^= seed << 13;
+  seed ^= seed >> 7;
+  seed ^= seed << 17;
+  return (unsigned int) (seed >> 32);
+}
+
+/* Fill the table with LEN sorted entries, with gaps of up to MAX_GAP
+   (0 makes repeated keys), and build its index.  */
+static void
+make_table (size_t len, unsigned int max_gap)
+{
+  int32_t ip = -(int32_t) (len * max_gap / 2), *leaves;
+  size_t i;
+
+  for (i = 0; i < len; ++i)
+    {
+      ip += max_gap ? next_random () % max_gap : 0;
+      table[i].start_ip_offset = ip;
+      table[i].fde_offset = (int32_t) i;
+    }
+
+  height = table_index_layout (len, offsets);
+  UNW_TEST_ASSERT (height >= 1 && height <= TABLE_INDEX_MAX_HEIGHT
+                   && offsets[height] * TABLE_INDEX_B <= MAX_KEYS,
+                   "len %zu: bad layout, height %u, %zu nodes",
+                   len, height, offsets[height]);
+  leaves = keys + offsets[height - 1] * TABLE_INDEX_B;
+  for (i = 0; i < (offsets[height] - offsets[height - 1]) * TABLE_INDEX_B; ++i)
+    leaves[i] = i < len ? table[i].start_ip_offset : INT32_MAX;
+  table_index_fill (keys, offsets, height);
+}
+
+/* The index must find the same entry as the binary search.  */
+static void
+check (size_t len, int32_t rel_ip)
+{
+  const struct table_entry *e = lookup (table, len * sizeof (table[0]),
+                                        rel_ip);
+  size_t hi = table_index_search (keys, offsets, height, len, rel_ip);
+
+  UNW_TEST_ASSERT ((e ? (size_t) (e - table) + 1 : 0) == hi,
+                   "len %zu, ip %d: lookup() gave %ld, the index %zu",
+                   len, (int) rel_ip, e ? (long) (e - table) : -1L, hi);
+}
+
+int
+main (void)
+{
+  size_t len, i;
+  unsigned int gap;
+
+  for (gap = 0; gap <= 64; gap = gap ? 4 * gap : 1)
+    for (len = 0; len <= MAX_LEN; len = len < 70 ? len + 1 : len * 3 + 1)
+      {
+        make_table (len, gap);
+        check (len, INT32_MIN);
+        check (len, INT32_MAX);
+        for (i = 0; i < len; ++i)
+          {
+            check (len, table[i].start_ip_offset - 1);
+            check (len, table[i].start_ip_offset);
+            check (len, table[i].start_ip_offset + 1);
+          }
+      }
+
+  return UNW_TEST_EXIT_PASS;
+}
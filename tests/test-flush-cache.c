@@ -25,37 +25,151 @@ LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
 OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
 WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 
 #define UNW_LOCAL_ONLY	/* must define this for consistency with backtrace() */
 #include <libunwind.h>
 
-int verbose;
+/* Seconds added to the monotonic clock, so that the adaptive rs
+   cache sees its lookup windows span long idle periods.  */
+static time_t clock_skew;
 
+/* Intercepted clock_gettime() call.  */
 int
-f257 (void)
+clock_gettime (clockid_t clk, struct timespec *ts)
+{
+  int ret = syscall (SYS_clock_gettime, clk, ts);
+
+  if (ret == 0 && clk == CLOCK_MONOTONIC)
+    ts->tv_sec += clock_skew;
+  return ret;
+}
+
+int verbose;
+
+/* Like unw_backtrace(), but always goes through unw_step() so that
+   every frame is looked up in the register-state cache.  */
+static int
+step_backtrace (void **buffer, int size)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_word_t ip;
+  int n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0 || unw_step (&cursor) <= 0)
+    return 0;
+  do
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &ip);
+      buffer[n++] = (void *) (uintptr_t) ip;
+    }
+  while (n < size && unw_step (&cursor) > 0);
+  return n;
+}
+
+static int
+check_backtrace (const char *what, void **expected, int n_expected, int step)
 {
   void *buffer[300];
   int i, n;
 
   if (verbose)
-    printf ("First backtrace:\n");
-  n = unw_backtrace (buffer, 300);
+    printf ("\n%s:\n", what);
+  if (step)
+    n = step_backtrace (buffer, 300);
+  else
+    n = unw_backtrace (buffer, 300);
   if (verbose)
     for (i = 0; i < n; ++i)
       printf ("[%d] ip=%p\n", i, buffer[i]);
 
-  unw_set_cache_size (unw_local_addr_space, 1023, 0);
-  unw_flush_cache (unw_local_addr_space, 0, 0);
+  /* We are called from a different site than f257()'s own frame 0
+     and may be one frame deeper; everything from f257()'s caller on
+     must match.  */
+  if (n < n_expected - 1
+      || memcmp (buffer + n - (n_expected - 1), expected + 1,
+                 (n_expected - 1) * sizeof (buffer[0])) != 0)
+    {
+      printf ("FAILURE: %s backtrace differs\n", what);
+      return 1;
+    }
+  return 0;
+}
+
+int
+f257 (void)
+{
+  void *buffer[300];
+  unw_stats_t stats;
+  unw_word_t grown;
+  int i, n, ret = 0;
 
   if (verbose)
-    printf ("\nSecond backtrace:\n");
+    printf ("First backtrace:\n");
   n = unw_backtrace (buffer, 300);
   if (verbose)
     for (i = 0; i < n; ++i)
       printf ("[%d] ip=%p\n", i, buffer[i]);
-  return 0;
+
+  unw_set_cache_size (unw_local_addr_space, 1023, 0);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  ret |= check_backtrace ("Second backtrace", buffer, n, 0);
+
+  /* Sizes beyond the old 32k-entry limit.  */
+  if (unw_set_cache_size (unw_local_addr_space, 1 << 17, 0) != 0)
+    {
+      printf ("FAILURE: unw_set_cache_size(1 << 17) failed\n");
+      ret = 1;
+    }
+  ret |= check_backtrace ("Large cache backtrace", buffer, n, 0);
+  ret |= check_backtrace ("Large cache backtrace (warm)", buffer, n, 0);
+
+  /* A tiny adaptive cache must grow while we keep unwinding.  Use the
+     shared cache, whose size unw_get_stats() reports.  */
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+  if (unw_set_cache_size (unw_local_addr_space, 4, UNW_CACHE_SIZE_ADAPTIVE) != 0)
+    {
+      printf ("FAILURE: unw_set_cache_size(4, UNW_CACHE_SIZE_ADAPTIVE) failed\n");
+      ret = 1;
+    }
+  for (i = 0; i < 2000; ++i)
+    ret |= check_backtrace ("Adaptive cache backtrace", buffer, n, 1);
+  unw_get_stats (unw_local_addr_space, &stats);
+  grown = stats.rs_cache_size;
+  if (grown <= 4)
+    {
+      printf ("FAILURE: adaptive cache did not grow (%lu entries)\n",
+              (long) grown);
+      ret = 1;
+    }
+
+  /* ...and shrink again once a lookup window spans an idle period.  */
+  clock_skew += 3600;
+  for (i = 0; i < 100 && stats.rs_cache_size >= grown; ++i)
+    {
+      ret |= check_backtrace ("Idle adaptive cache backtrace", buffer, n, 1);
+      unw_get_stats (unw_local_addr_space, &stats);
+    }
+  if (stats.rs_cache_size >= grown)
+    {
+      printf ("FAILURE: idle adaptive cache did not shrink (%lu entries)\n",
+              (long) stats.rs_cache_size);
+      ret = 1;
+    }
+
+  if (unw_set_cache_size (unw_local_addr_space, 64, ~0) == 0)
+    {
+      printf ("FAILURE: unw_set_cache_size accepted unknown flags\n");
+      ret = 1;
+    }
+  return ret;
 }
 
 #define F(n,m)					\
@@ -0,0 +1,280 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check unwinding through a program linked without .eh_frame_hdr,
+   whose FDEs libunwind has to index itself, and keeping that index in
+   the on-disk cache.  */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <link.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define DEPTH	8
+
+int verbose;
+
+/* Give the program enough FDEs before recurse() that a linear search
+   would show.  */
+#define FILLER(n)							\
+  static int NOINLINE filler##n (void) { return n + filler_sink; }
+static volatile int filler_sink;
+FILLER (0)  FILLER (1)  FILLER (2)  FILLER (3)
+FILLER (4)  FILLER (5)  FILLER (6)  FILLER (7)
+FILLER (8)  FILLER (9)  FILLER (10) FILLER (11)
+FILLER (12) FILLER (13) FILLER (14) FILLER (15)
+FILLER (16) FILLER (17) FILLER (18) FILLER (19)
+FILLER (20) FILLER (21) FILLER (22) FILLER (23)
+FILLER (24) FILLER (25) FILLER (26) FILLER (27)
+FILLER (28) FILLER (29) FILLER (30) FILLER (31)
+
+static int (*const fillers[]) (void) = {
+  filler0,  filler1,  filler2,  filler3,  filler4,  filler5,  filler6,
+  filler7,  filler8,  filler9,  filler10, filler11, filler12, filler13,
+  filler14, filler15, filler16, filler17, filler18, filler19, filler20,
+  filler21, filler22, filler23, filler24, filler25, filler26, filler27,
+  filler28, filler29, filler30, filler31
+};
+
+static int
+has_eh_frame_hdr (struct dl_phdr_info *info, size_t size UNUSED,
+		  void *arg UNUSED)
+{
+  int n;
+
+  /* The program comes first.  */
+  for (n = 0; n < info->dlpi_phnum; ++n)
+    if (info->dlpi_phdr[n].p_type == PT_GNU_EH_FRAME)
+      return 1;
+  return -1;
+}
+
+/* Walk the stack and count the frames of recurse().  */
+static int NOINLINE
+walk (unw_word_t recurse_ip)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  int n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return 0;
+  while (unw_step (&cursor) > 0)
+    {
+      if (unw_get_proc_info (&cursor, &pi) < 0)
+	break;
+      if (verbose)
+	printf ("  start_ip 0x%lx\n", (long) pi.start_ip);
+      if (pi.start_ip == recurse_ip)
+	++n;
+    }
+  return n;
+}
+
+static int NOINLINE
+recurse (int depth)
+{
+  int n;
+
+  if (depth == 0)
+    n = walk ((unw_word_t) (uintptr_t) &recurse);
+  else
+    n = recurse (depth - 1);
+  /* Not a tail call.  */
+  return n + filler_sink;
+}
+
+/* Return the size of the .eh_frame index file in DIR, which must be
+   the only one, and set PATH to it, or return -1.  */
+static long
+find_index_file (const char *dir, char *path, size_t len)
+{
+  struct dirent *d;
+  long size = -1;
+  DIR *dp;
+  FILE *f;
+
+  dp = opendir (dir);
+  if (!dp)
+    return -1;
+  while ((d = readdir (dp)))
+    if (strstr (d->d_name, ".eh_frame.idx"))
+      {
+	snprintf (path, len, "%s/%s", dir, d->d_name);
+	if ((f = fopen (path, "rb")) && fseek (f, 0, SEEK_END) == 0)
+	  size = ftell (f);
+	if (f)
+	  fclose (f);
+      }
+  closedir (dp);
+  return size;
+}
+
+static void
+check_index_cache (void)
+{
+  char dir[] = "/tmp/unw-index-cache-XXXXXX", path[4096], magic[8];
+  int32_t entries[4], swapped[4];
+  struct stat st;
+  long size;
+  FILE *f;
+  int fd;
+
+  if (!mkdtemp (dir))
+    return;
+  setenv ("UNW_INDEX_CACHE_DIR", dir, 1);
+
+  /* Building the index writes it to the cache...  */
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found while building the index");
+  size = find_index_file (dir, path, sizeof (path));
+  UNW_TEST_CHECK (size > 0, "no index file written");
+  if (size <= 0)
+    goto out;
+
+  /* ...from where it is used after a flush...  */
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found from the cached index");
+
+  /* ...unless it is damaged, when it is rebuilt and replaced.  */
+  fd = open (path, O_WRONLY);
+  UNW_TEST_CHECK (fd >= 0 && pwrite (fd, "garbage!", 8, size - 8 - 40) == 8,
+		  "cannot damage the index file");
+  if (fd >= 0)
+    close (fd);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found with a damaged index file");
+  UNW_TEST_CHECK (find_index_file (dir, path, sizeof (path)) == size,
+		  "damaged index file not replaced");
+  f = fopen (path, "rb");
+  UNW_TEST_CHECK (f && fseek (f, size - 40, SEEK_SET) == 0
+		  && fread (magic, 1, sizeof (magic), f) == sizeof (magic)
+		  && memcmp (magic, "UNWIDX", 6) == 0,
+		  "replaced index file has no trailer");
+  if (f)
+    fclose (f);
+
+  /* Entries which still look sorted but name the wrong FDEs are caught
+     when the file is loaded, too.  */
+  fd = open (path, O_RDWR);
+  UNW_TEST_CHECK (fd >= 0 && pread (fd, entries, sizeof (entries), 0)
+		  == sizeof (entries), "cannot read the index file");
+  memcpy (swapped, entries, sizeof (swapped));
+  swapped[1] = entries[3];
+  swapped[3] = entries[1];
+  UNW_TEST_CHECK (fd >= 0 && pwrite (fd, swapped, sizeof (swapped), 0)
+		  == sizeof (swapped), "cannot swap index entries");
+  if (fd >= 0)
+    close (fd);
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found with swapped index entries");
+  fd = open (path, O_RDONLY);
+  UNW_TEST_CHECK (fd >= 0 && pread (fd, swapped, sizeof (swapped), 0)
+		  == sizeof (swapped)
+		  && memcmp (swapped, entries, sizeof (entries)) == 0,
+		  "index file with swapped entries not replaced");
+  if (fd >= 0)
+    close (fd);
+
+  /* A file others could have written is not trusted, but replaced...  */
+  UNW_TEST_CHECK (chmod (path, 0664) == 0, "cannot chmod the index file");
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found with a group-writable index file");
+  UNW_TEST_CHECK (stat (path, &st) == 0 && (st.st_mode & 0777) == 0644,
+		  "group-writable index file not replaced");
+
+  /* ...and neither is such a directory, which is left alone.  */
+  unlink (path);
+  UNW_TEST_CHECK (chmod (dir, 0775) == 0, "cannot chmod the cache directory");
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found with a group-writable cache directory");
+  UNW_TEST_CHECK (find_index_file (dir, path, sizeof (path)) < 0,
+		  "index file written to a group-writable directory");
+
+ out:
+  unlink (path);
+  rmdir (dir);
+  unsetenv ("UNW_INDEX_CACHE_DIR");
+}
+
+int
+main (int argc, char **argv)
+{
+  unw_stats_t s0, s1;
+  int i;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  if (dl_iterate_phdr (has_eh_frame_hdr, NULL) == 1)
+    {
+      printf ("SKIP: program has an .eh_frame_hdr\n");
+      return UNW_TEST_EXIT_SKIP;
+    }
+
+  for (i = 0; i < 3; ++i)
+    UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		    "pass %d: frames not found", i);
+
+  /* Without the caches each frame looks its FDE up again, which must
+     not take a walk over all the FDEs before it.  */
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  unw_get_stats (unw_local_addr_space, &s0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found without caching");
+  unw_get_stats (unw_local_addr_space, &s1);
+  if (verbose)
+    printf ("%lu FDEs parsed\n", (long) (s1.fde_parses - s0.fde_parses));
+  UNW_TEST_CHECK (s1.fde_parses - s0.fde_parses < 16 * DEPTH,
+		  "%ld FDEs parsed", (long) (s1.fde_parses - s0.fde_parses));
+
+  /* The index is rebuilt after a flush.  */
+  unw_flush_cache (unw_local_addr_space, 0, 0);
+  UNW_TEST_CHECK (recurse (DEPTH - 1) == DEPTH,
+		  "frames not found after a flush");
+
+  check_index_cache ();
+
+  for (i = 0; i < (int) (sizeof (fillers) / sizeof (fillers[0])); ++i)
+    UNW_TEST_CHECK (fillers[i] () == i, "filler %d", i);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
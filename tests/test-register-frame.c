@@ -0,0 +1,285 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check unwinding through generated code whose .eh_frame is registered
+   with _U_register_frame(), and its lookup after many registrations
+   and cancellations, also while another thread deregisters it.  */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define NFUNCS		64
+#define FUNC_SIZE	16
+
+int verbose;
+
+/* x86-64 code which calls the function passed to it, without a frame
+   pointer:
+
+	sub	$24, %rsp
+	call	*%rdi
+	add	$24, %rsp
+	ret  */
+static const uint8_t code[] = {
+  0x48, 0x83, 0xec, 0x18, 0xff, 0xd7, 0x48, 0x83, 0xc4, 0x18, 0xc3
+};
+
+/* A CIE for x86-64 with pc-relative FDE addresses, with CFA = rsp + 8
+   and the return address at CFA - 8 on entry.  */
+static const uint8_t cie[] = {
+  0x14, 0, 0, 0,		/* length */
+  0, 0, 0, 0,			/* CIE id */
+  1, 'z', 'R', 0,		/* version, augmentation */
+  1, 0x78, 16,			/* code and data alignment, RA column */
+  1, 0x1b,			/* FDE encoding pcrel|sdata4 */
+  0x0c, 7, 8,			/* DW_CFA_def_cfa rsp, 8 */
+  0x90, 1,			/* DW_CFA_offset r16, CFA - 8 */
+  0, 0				/* DW_CFA_nop */
+};
+
+#define FDE_SIZE	24
+
+/* Write an FDE for the code at FUNC to P, CIE_OFF bytes past the CIE.  */
+static void
+put_fde (uint8_t *p, const uint8_t *func, size_t cie_off)
+{
+  static const uint8_t insns[] = {
+    0,				/* augmentation data length */
+    0x44, 0x0e, 32,		/* advance 4, DW_CFA_def_cfa_offset 32 */
+    0x46, 0x0e, 8,		/* advance 6, DW_CFA_def_cfa_offset 8 */
+    0				/* DW_CFA_nop */
+  };
+  int32_t v;
+
+  v = FDE_SIZE - 4;
+  memcpy (p, &v, 4);
+  v = cie_off + 4;
+  memcpy (p + 4, &v, 4);
+  v = func - (p + 8);
+  memcpy (p + 8, &v, 4);
+  v = sizeof (code);
+  memcpy (p + 12, &v, 4);
+  memcpy (p + 16, insns, sizeof (insns));
+}
+
+/* Write an .eh_frame covering N functions from FUNC to P and return its
+   size.  */
+static size_t
+put_eh_frame (uint8_t *p, const uint8_t *func, int n)
+{
+  size_t off = sizeof (cie);
+  int i;
+
+  memcpy (p, cie, sizeof (cie));
+  for (i = 0; i < n; ++i, off += FDE_SIZE)
+    put_fde (p + off, func + i * FUNC_SIZE, off);
+  memset (p + off, 0, 4);
+  return off + 4;
+}
+
+static uint8_t *text;
+static int found_jit, found_caller;
+
+static int call_jit (void);
+
+static void NOINLINE
+walk (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  unw_proc_info_t pi;
+  unw_word_t ip;
+  int after_jit = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return;
+  while (unw_step (&cursor) > 0)
+    {
+      unw_get_reg (&cursor, UNW_REG_IP, &ip);
+      if (unw_get_proc_info (&cursor, &pi) < 0)
+	pi.start_ip = pi.end_ip = 0;
+      if (verbose)
+	printf ("  ip 0x%lx, procedure 0x%lx-0x%lx\n",
+		(long) ip, (long) pi.start_ip, (long) pi.end_ip);
+      if (after_jit)
+	{
+	  found_caller = (pi.start_ip == (unw_word_t) (uintptr_t) &call_jit);
+	  break;
+	}
+      if (pi.start_ip == (unw_word_t) (uintptr_t) text
+	  && pi.end_ip == (unw_word_t) (uintptr_t) text + sizeof (code))
+	found_jit = after_jit = 1;
+    }
+}
+
+/* Call the generated code, which calls walk().  */
+static int NOINLINE
+call_jit (void)
+{
+  ((void (*) (void (*) (void))) text) (walk);
+  return found_jit + found_caller;
+}
+
+static int
+lookup (uint8_t *func, unw_proc_info_t *pi)
+{
+  return unw_get_proc_info_by_ip (unw_local_addr_space,
+				  (unw_word_t) (uintptr_t) func + 2, pi, NULL);
+}
+
+static volatile int stop;
+
+/* Look the functions up until told to stop, while their .eh_frame
+   comes and goes, and return how many were found wrong.  */
+static void *
+lookup_thread (void *arg UNUSED)
+{
+  unw_proc_info_t pi;
+  long wrong = 0;
+  int i = 0;
+
+  while (!stop)
+    {
+      if (lookup (text + i * FUNC_SIZE, &pi) == 0
+	  && pi.start_ip != (unw_word_t) (uintptr_t) (text + i * FUNC_SIZE))
+	++wrong;
+      i = (i + 1) % NFUNCS;
+    }
+  return (void *) wrong;
+}
+
+int
+main (int argc, char **argv)
+{
+  size_t page = sysconf (_SC_PAGESIZE), size, off;
+  uint8_t *mem, *eh_frame, *single[NFUNCS];
+  unw_proc_info_t pi;
+  pthread_t thread;
+  void *wrong;
+  int i;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  /* The code in the first pages, the .eh_frames behind it.  */
+  size = 2 * page + NFUNCS * (sizeof (cie) + 2 * FDE_SIZE + 4);
+  mem = mmap (NULL, size, PROT_READ | PROT_WRITE,
+	      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    {
+      printf ("SKIP: cannot map memory\n");
+      return UNW_TEST_EXIT_SKIP;
+    }
+  text = mem;
+  for (i = 0; i < NFUNCS; ++i)
+    memcpy (text + i * FUNC_SIZE, code, sizeof (code));
+  eh_frame = mem + page;
+  off = 0;
+  for (i = 0; i < NFUNCS; ++i)
+    {
+      single[i] = eh_frame + off;
+      off += put_eh_frame (single[i], text + i * FUNC_SIZE, 1);
+    }
+  put_eh_frame (eh_frame + off, text, NFUNCS);
+  if (mprotect (text, page, PROT_READ | PROT_EXEC) < 0)
+    {
+      printf ("SKIP: cannot make code executable\n");
+      return UNW_TEST_EXIT_SKIP;
+    }
+
+  /* One .eh_frame per function...  */
+  UNW_TEST_CHECK (lookup (text, &pi) == -UNW_ENOINFO,
+		  "info found before registering");
+  for (i = 0; i < NFUNCS; ++i)
+    _U_register_frame (single[i]);
+  for (i = 0; i < NFUNCS; ++i)
+    {
+      UNW_TEST_CHECK (lookup (text + i * FUNC_SIZE, &pi) == 0
+		      && pi.start_ip
+			 == (unw_word_t) (uintptr_t) (text + i * FUNC_SIZE)
+		      && pi.end_ip == pi.start_ip + sizeof (code),
+		      "function %d of its own .eh_frame", i);
+    }
+
+#if defined(__x86_64__)
+  /* The caller is only found through the registered CFI: the generated
+     code keeps no frame pointer.  */
+  UNW_TEST_CHECK (call_jit () == 2, "call through the generated code");
+  UNW_TEST_CHECK (found_jit, "generated code not unwound");
+  UNW_TEST_CHECK (found_caller, "its caller not reached");
+#endif
+
+  /* ...of which every other one is cancelled.  */
+  for (i = 0; i < NFUNCS; i += 2)
+    _U_deregister_frame (single[i]);
+  for (i = 0; i < NFUNCS; ++i)
+    UNW_TEST_CHECK ((lookup (text + i * FUNC_SIZE, &pi) == 0)
+		    == (i % 2 == 1),
+		    "function %d after deregistering every other one", i);
+  for (i = 1; i < NFUNCS; i += 2)
+    _U_deregister_frame (single[i]);
+  UNW_TEST_CHECK (lookup (text + FUNC_SIZE, &pi) == -UNW_ENOINFO,
+		  "info found after deregistering");
+
+  /* An .eh_frame with all of them.  */
+  _U_register_frame (eh_frame + off);
+  for (i = 0; i < NFUNCS; ++i)
+    UNW_TEST_CHECK (lookup (text + i * FUNC_SIZE, &pi) == 0
+		    && pi.start_ip
+		       == (unw_word_t) (uintptr_t) (text + i * FUNC_SIZE),
+		    "function %d of the shared .eh_frame", i);
+  UNW_TEST_CHECK (lookup (text + NFUNCS * FUNC_SIZE, &pi) == -UNW_ENOINFO,
+		  "info found past the last function");
+  _U_deregister_frame (eh_frame + off);
+  UNW_TEST_CHECK (lookup (text, &pi) == -UNW_ENOINFO,
+		  "info found after deregistering");
+
+  /* Deregistering frees the table of the .eh_frame, which the lookups
+     of another thread may be searching.  */
+  if (pthread_create (&thread, NULL, lookup_thread, NULL) == 0)
+    {
+      for (i = 0; i < 20000; ++i)
+	{
+	  _U_register_frame (eh_frame + off);
+	  _U_deregister_frame (eh_frame + off);
+	}
+      stop = 1;
+      UNW_TEST_CHECK (pthread_join (thread, &wrong) == 0 && wrong == NULL,
+		      "lookup returned wrong info while deregistering");
+    }
+
+  munmap (mem, size);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
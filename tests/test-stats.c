@@ -0,0 +1,380 @@
+/* libunwind - a platform-independent unwind library
+
+This file is part of libunwind.
+
+Permission is hereby granted, free of charge, to any person obtaining
+a copy of this software and associated documentation files (the
+"Software"), to deal in the Software without restriction, including
+without limitation the rights to use, copy, modify, merge, publish,
+distribute, sublicense, and/or sell copies of the Software, and to
+permit persons to whom the Software is furnished to do so, subject to
+the following conditions:
+
+The above copyright notice and this permission notice shall be
+included in all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE
+LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION
+OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.  */
+
+/* Check that unw_get_stats() counts unwinder events, including those
+   of threads which have since exited, and those of the threads of a
+   child of fork().  */
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define UNW_LOCAL_ONLY
+#include <libunwind.h>
+#include "compiler.h"
+#include "unw_test.h"
+
+#define NSTEPS	50
+#define NTHREADS	100	/* more than get a stats block of their own */
+
+int verbose;
+
+static unw_word_t
+sum (const unw_word_t *v)
+{
+  unw_word_t s = 0;
+  int i;
+
+  for (i = 0; i < UNW_STATS_FRAME_TYPES; ++i)
+    s += v[i];
+  return s;
+}
+
+static void
+print_stats (const char *what, const unw_stats_t *s)
+{
+  if (!verbose)
+    return;
+  printf ("%s:\n", what);
+  printf ("  rs cache: %lu hits, %lu misses, %lu evictions, size %lu, "
+	  "%lu proc info hits\n",
+	  (long) s->rs_cache_hits, (long) s->rs_cache_misses,
+	  (long) s->rs_cache_evictions, (long) s->rs_cache_size,
+	  (long) s->proc_info_hits);
+  printf ("  trace: %lu hits, %lu misses, %lu aborts\n",
+	  (long) sum (s->trace_hits), (long) sum (s->trace_misses),
+	  (long) sum (s->trace_aborts));
+  printf ("  %lu phdr walks, %lu FDEs, %lu/%lu CIEs parsed/cached, "
+	  "%lu CFA instructions, %lu accessor calls, %lu/%lu validations\n",
+	  (long) s->phdr_walks, (long) s->fde_parses, (long) s->cie_parses,
+	  (long) s->cie_cache_hits,
+	  (long) s->cfi_instructions, (long) s->accessor_calls,
+	  (long) s->validation_checks, (long) s->validation_syscalls);
+}
+
+/* Walk the stack with unw_step(); returns the number of frames.  */
+static int NOINLINE
+walk (void)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return 0;
+  while (unw_step (&cursor) > 0)
+    ++n;
+  return n;
+}
+
+/* Walk the stack looking up each frame's procedure info, as the search
+   phase of an exception does; returns the number of frames.  */
+static int NOINLINE
+walk_proc_info (unw_proc_info_t *pi, int max)
+{
+  unw_cursor_t cursor;
+  unw_context_t uc;
+  int n = 0;
+
+  unw_getcontext (&uc);
+  if (unw_init_local (&cursor, &uc) < 0)
+    return 0;
+  do
+    if (unw_get_proc_info (&cursor, &pi[n]) < 0)
+      break;
+  while (++n < max && unw_step (&cursor) > 0);
+  return n;
+}
+
+/* Check that unw_get_proc_info() answers from the rs cache once the
+   frames are in it, with what the uncached lookup finds.  */
+static void
+check_proc_info (void)
+{
+  unw_proc_info_t pi[2][64];
+  unw_stats_t s0, s1;
+  int i, n[2];
+
+  walk_proc_info (pi[0], 64);
+  unw_get_stats (unw_local_addr_space, &s0);
+  n[0] = walk_proc_info (pi[0], 64);
+  unw_get_stats (unw_local_addr_space, &s1);
+  UNW_TEST_CHECK (n[0] > 0, "no frames");
+  UNW_TEST_CHECK (s1.proc_info_hits >= s0.proc_info_hits + n[0] - 1,
+		  "%ld proc info cache hits for %d frames",
+		  (long) (s1.proc_info_hits - s0.proc_info_hits), n[0]);
+
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_NONE);
+  n[1] = walk_proc_info (pi[1], 64);
+  unw_set_caching_policy (unw_local_addr_space, UNW_CACHE_GLOBAL);
+  UNW_TEST_CHECK (n[0] == n[1],
+		  "%d frames with the cache, %d without", n[0], n[1]);
+  for (i = 0; i < n[0] && i < n[1]; ++i)
+    {
+      UNW_TEST_CHECK (pi[0][i].start_ip == pi[1][i].start_ip,
+		      "frame %d: start_ip", i);
+      UNW_TEST_CHECK (pi[0][i].end_ip == pi[1][i].end_ip,
+		      "frame %d: end_ip", i);
+      UNW_TEST_CHECK (pi[0][i].lsda == pi[1][i].lsda, "frame %d: lsda", i);
+      UNW_TEST_CHECK (pi[0][i].handler == pi[1][i].handler,
+		      "frame %d: handler", i);
+      UNW_TEST_CHECK (pi[0][i].flags == pi[1][i].flags, "frame %d: flags", i);
+      UNW_TEST_CHECK (pi[0][i].format == pi[1][i].format,
+		      "frame %d: format", i);
+    }
+}
+
+/* Walk from two call sites, which share one CFI row of this function
+   and therefore one rs-cache entry.  */
+static int NOINLINE
+two_call_sites (unw_stats_t *s)
+{
+  int n;
+
+  n = walk ();
+  unw_get_stats (unw_local_addr_space, &s[0]);
+  n += walk ();
+  unw_get_stats (unw_local_addr_space, &s[1]);
+  return n;
+}
+
+static void *
+worker (void *arg)
+{
+  int i, *frames = arg;
+
+  for (i = 0; i < NSTEPS; ++i)
+    *frames += walk ();
+  return NULL;
+}
+
+/* In a child of fork(), have the forking thread and a new one walk at
+   the same time.  Each counts into a block of its own, so no count is
+   lost; returns the exit status of the child.  */
+static int
+fork_child (void)
+{
+  unw_stats_t s0, s1;
+  pthread_t t;
+  int i, frames = 0, thread_frames = 0;
+
+  unw_get_stats (unw_local_addr_space, &s0);
+  if (pthread_create (&t, NULL, worker, &thread_frames) != 0)
+    return UNW_TEST_EXIT_HARD_ERROR;
+  for (i = 0; i < NSTEPS; ++i)
+    frames += walk ();
+  if (pthread_join (t, NULL) != 0)
+    return UNW_TEST_EXIT_HARD_ERROR;
+  unw_get_stats (unw_local_addr_space, &s1);
+  if (s1.rs_cache_hits + s1.rs_cache_misses
+      < s0.rs_cache_hits + s0.rs_cache_misses + frames + thread_frames)
+    return UNW_TEST_EXIT_FAIL;
+  return UNW_TEST_EXIT_PASS;
+}
+
+static pthread_barrier_t barrier;
+static int thread_frames[NTHREADS];
+
+static void *
+crowd_worker (void *arg)
+{
+  int *frames = arg;
+
+  /* Keep all threads alive while they count.  */
+  pthread_barrier_wait (&barrier);
+  *frames += walk ();
+  pthread_barrier_wait (&barrier);
+  return NULL;
+}
+
+static volatile int handler_frames;
+
+static void
+handler (int sig UNUSED)
+{
+  handler_frames += walk ();
+}
+
+/* Have the first count of a thread happen in a signal handler.  */
+static void *
+signal_worker (void *arg UNUSED)
+{
+  pthread_kill (pthread_self (), SIGUSR1);
+  return NULL;
+}
+
+int
+main (int argc, char **argv)
+{
+  unw_stats_t s[4];
+  void *buffer[64];
+  pthread_t t, crowd[NTHREADS];
+  int i, frames = 0, status;
+  pid_t pid;
+
+  verbose = (argc > 1 && argv[1] != NULL);
+
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, NULL) == -UNW_EINVAL,
+		  "no place for the stats accepted");
+
+  if (unw_get_stats (unw_local_addr_space, &s[0]) == -UNW_ENOINFO)
+    {
+      if (verbose)
+	printf ("statistics compiled out\n");
+      return UNW_TEST_EXIT_SKIP;
+    }
+  print_stats ("initial", &s[0]);
+
+  /* A cold walk parses unwind info, a warm one (from the same call
+     site) hits the rs cache.  */
+  for (i = 0; i < 2; ++i)
+    {
+      frames = walk ();
+      UNW_TEST_CHECK (frames > 0, "no frames");
+      UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[i + 1]) == 0,
+		      "unw_get_stats() failed");
+    }
+  print_stats ("after first walk", &s[1]);
+  UNW_TEST_CHECK (s[1].rs_cache_misses > s[0].rs_cache_misses,
+		  "no rs-cache misses");
+  UNW_TEST_CHECK (s[1].phdr_walks > s[0].phdr_walks, "no phdr walks");
+  UNW_TEST_CHECK (s[1].fde_parses > s[0].fde_parses, "no FDEs parsed");
+  /* The functions of this program share a CIE.  */
+  UNW_TEST_CHECK (s[1].cie_parses > s[0].cie_parses, "no CIEs parsed");
+  UNW_TEST_CHECK (s[1].cie_cache_hits > s[0].cie_cache_hits,
+		  "no CIE cache hits");
+  UNW_TEST_CHECK (s[1].cfi_instructions > s[0].cfi_instructions,
+		  "no CFI instructions run");
+  UNW_TEST_CHECK (s[1].accessor_calls > s[0].accessor_calls,
+		  "no accessor calls");
+  UNW_TEST_CHECK (s[1].rs_cache_size > 0, "no rs cache");
+
+  print_stats ("after second walk", &s[2]);
+  UNW_TEST_CHECK (s[2].rs_cache_hits >= s[1].rs_cache_hits + frames,
+		  "too few rs-cache hits on the warm walk");
+  UNW_TEST_CHECK (s[2].rs_cache_misses == s[1].rs_cache_misses,
+		  "rs-cache misses on the warm walk");
+
+  UNW_TEST_CHECK (two_call_sites (&s[1]) > 0, "no frames");
+  print_stats ("after second call site", &s[2]);
+  UNW_TEST_CHECK (s[2].rs_cache_misses == s[1].rs_cache_misses,
+		  "rs-cache misses from the second call site");
+
+  /* Counts of exited threads are kept.  */
+  frames = 0;
+  UNW_TEST_CHECK (pthread_create (&t, NULL, worker, &frames) == 0,
+		  "cannot create thread");
+  UNW_TEST_CHECK (pthread_join (t, NULL) == 0, "cannot join thread");
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[3]) == 0,
+		  "unw_get_stats() failed");
+  print_stats ("after thread", &s[3]);
+  UNW_TEST_CHECK (s[3].rs_cache_hits + s[3].rs_cache_misses
+		  >= s[2].rs_cache_hits + s[2].rs_cache_misses + frames,
+		  "walks of an exited thread not counted");
+
+  /* So are the counts of threads beyond the preallocated blocks.  */
+  UNW_TEST_CHECK (pthread_barrier_init (&barrier, NULL, NTHREADS) == 0,
+		  "cannot init the barrier");
+  for (i = 0; i < NTHREADS; ++i)
+    UNW_TEST_CHECK (pthread_create (&crowd[i], NULL, crowd_worker,
+				    &thread_frames[i]) == 0,
+		    "cannot create thread %d", i);
+  frames = 0;
+  for (i = 0; i < NTHREADS; ++i)
+    {
+      UNW_TEST_CHECK (pthread_join (crowd[i], NULL) == 0,
+		      "cannot join thread %d", i);
+      frames += thread_frames[i];
+    }
+  pthread_barrier_destroy (&barrier);
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[2]) == 0,
+		  "unw_get_stats() failed");
+  print_stats ("after threads", &s[2]);
+  UNW_TEST_CHECK (s[2].rs_cache_hits + s[2].rs_cache_misses
+		  >= s[3].rs_cache_hits + s[3].rs_cache_misses + frames,
+		  "walks of %d threads not counted", NTHREADS);
+
+  signal (SIGUSR1, handler);
+  UNW_TEST_CHECK (pthread_create (&t, NULL, signal_worker, NULL) == 0,
+		  "cannot create thread");
+  UNW_TEST_CHECK (pthread_join (t, NULL) == 0, "cannot join thread");
+  UNW_TEST_CHECK (handler_frames > 0, "no frames in the signal handler");
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[3]) == 0,
+		  "unw_get_stats() failed");
+  print_stats ("after signal handler", &s[3]);
+  UNW_TEST_CHECK (s[3].rs_cache_hits + s[3].rs_cache_misses
+		  >= s[2].rs_cache_hits + s[2].rs_cache_misses
+		     + handler_frames,
+		  "walk in a signal handler not counted");
+
+#if defined(__x86_64__) || defined(__aarch64__) || defined(__arm__)
+  /* The fast tracer has a cache of its own.  */
+  UNW_TEST_CHECK (unw_backtrace (buffer, 64) > 0, "no backtrace");
+  UNW_TEST_CHECK (unw_backtrace (buffer, 64) > 0, "no backtrace");
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[1]) == 0,
+		  "unw_get_stats() failed");
+  print_stats ("after backtrace", &s[1]);
+  UNW_TEST_CHECK (sum (s[1].trace_misses) > sum (s[3].trace_misses),
+		  "no trace-cache misses");
+  UNW_TEST_CHECK (sum (s[1].trace_hits) > sum (s[3].trace_hits),
+		  "no trace-cache hits");
+#else
+  (void) buffer;
+#endif
+
+  pid = fork ();
+  UNW_TEST_ASSERT (pid >= 0, "cannot fork");
+  if (pid == 0)
+    exit (fork_child ());
+  UNW_TEST_CHECK (waitpid (pid, &status, 0) == pid
+		  && WIFEXITED (status)
+		  && WEXITSTATUS (status) == UNW_TEST_EXIT_PASS,
+		  "walks in a child of fork() not counted");
+
+  check_proc_info ();
+
+  UNW_TEST_CHECK (unw_set_cache_size (unw_local_addr_space, 1024, 0) == 0,
+		  "cannot resize the rs cache");
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[1]) == 0,
+		  "unw_get_stats() failed");
+  UNW_TEST_CHECK (s[1].rs_cache_size == 1024,
+		  "rs cache of %ld entries", (long) s[1].rs_cache_size);
+
+  UNW_TEST_CHECK (unw_set_caching_policy (unw_local_addr_space,
+					  UNW_CACHE_NONE) == 0,
+		  "cannot turn off caching");
+  UNW_TEST_CHECK (unw_get_stats (unw_local_addr_space, &s[1]) == 0,
+		  "unw_get_stats() failed");
+  UNW_TEST_CHECK (s[1].rs_cache_size == 0,
+		  "rs cache of %ld entries without caching",
+		  (long) s[1].rs_cache_size);
+
+  if (verbose && UNW_TEST_CHECK_STATUS () == UNW_TEST_EXIT_PASS)
+    printf ("SUCCESS\n");
+  return UNW_TEST_CHECK_STATUS ();
+}
@@ -81,11 +81,30 @@ enum {
     ? (void)0 \
     : _unw_test_fail_check(#cond, __FILE__, __LINE__, fmt __VA_OPT__(,) __VA_ARGS__)
 
+/**
+ * Exit value for the checks made so far.
+ *
+ * UNW_TEST_EXIT_FAIL if any UNW_TEST_CHECK has failed, UNW_TEST_EXIT_PASS
+ * otherwise.
+ *
+ * Example:
+ * ```
+ * return UNW_TEST_CHECK_STATUS();
+ * ```
+ */
+#define UNW_TEST_CHECK_STATUS() \
+    (_unw_test_check_failures ? UNW_TEST_EXIT_FAIL : UNW_TEST_EXIT_PASS)
+
 /**
  * Maximum length of the formatted error string printed by UNW_TEST_ASSERT.
  */
 #define UNW_TEST_MAX_ERRSTRING_LEN 1024
 
+/**
+ * Number of failed UNW_TEST_CHECKs.
+ */
+static int _unw_test_check_failures = 0;
+
 static inline void
 _unw_test_fail_assertion(char const * const cond_str,
                          char const * const file,
@@ -115,6 +134,7 @@ _unw_test_fail_check(char const * const cond_str,
   vsnprintf(err_str, UNW_TEST_MAX_ERRSTRING_LEN, fmt, args);
   va_end(args);
   fprintf(stderr, "%s:%d CHECK FAIL '%s': %s\n", file, line, cond_str, err_str);
+  ++_unw_test_check_failures;
 }
 
 #endif /* LIBUNWIND_UNW_TEST_H */